@@ -7,6 +7,7 @@ Top module of HDMI output pipeline. This module includes:
 - Decoding and dequantizing of LH2, HL2, and HH2. (LL2 is raw.)
 - Vertical and horizontal IDWT for Stage 2, to recover LL1 color fields.
 - Bilinear interpolation on LL1 color fields for scaling and debayer.
+- Focus peaking overlay from the Stage 2 detail coefficients.
 - Menu overlay.
 - Generation of 8b (s)RGB 4:4:4 HDMI outputs.
 - Generation of HDMI pixel clock, HSYNC, VSYNC, and DE signals.
@@ -197,6 +198,12 @@ wire [11:0] pop_ui_y0;
 wire pop_ui_enabled;
 wire bot_ui_enabled;
 wire top_ui_enabled;
+// Slave Reg 21
+wire [11:0] peak_thr;
+wire [2:0] peak_bands;
+wire peak_enabled;
+// Slave Reg 22
+wire [23:0] peak_color;
 // URAM 00
 wire [11:0] dark_row_raddr;
 wire [63:0] dark_row_rdata;
@@ -307,6 +314,12 @@ HDMI_v1_0_S00_AXI_inst
   .pop_ui_enabled(pop_ui_enabled),
   .bot_ui_enabled(bot_ui_enabled),
   .top_ui_enabled(top_ui_enabled),
+  // Slave Reg 21
+  .peak_thr(peak_thr),
+  .peak_bands(peak_bands),
+  .peak_enabled(peak_enabled),
+  // Slave Reg 22
+  .peak_color(peak_color),
   // URAM 00
   .dark_row_raddr(dark_row_raddr),
   .dark_row_rdata(dark_row_rdata),
@@ -930,6 +943,8 @@ wire [63:0] iv2_out_4px_row0_B1;
 wire [63:0] iv2_out_4px_row1_B1;
 wire [63:0] iv2_out_4px_row0_G2;
 wire [63:0] iv2_out_4px_row1_G2;
+wire [3:0] iv2_out_4pk_G1;
+wire [3:0] iv2_out_4pk_G2;
 
 idwt26_v2
 #(
@@ -943,13 +958,16 @@ iv2_G1
   .wr_en(iv2_wr_en_G1),
   .wr_addr(iv2_wr_addr),
   .wr_data(iv2_wr_data),
+  .peak_thr(peak_thr),
   .out_4px_row0(iv2_out_4px_row0_G1),
-  .out_4px_row1(iv2_out_4px_row1_G1)
+  .out_4px_row1(iv2_out_4px_row1_G1),
+  .out_4pk(iv2_out_4pk_G1)
 );
 
 idwt26_v2 
 #(
-  .PX_MATH_WIDTH(PX_MATH_WIDTH)
+  .PX_MATH_WIDTH(PX_MATH_WIDTH),
+  .PEAKING(0)
 )
 iv2_R1
 (
@@ -959,13 +977,16 @@ iv2_R1
   .wr_en(iv2_wr_en_R1),
   .wr_addr(iv2_wr_addr),
   .wr_data(iv2_wr_data),
+  .peak_thr(peak_thr),
   .out_4px_row0(iv2_out_4px_row0_R1),
-  .out_4px_row1(iv2_out_4px_row1_R1)
+  .out_4px_row1(iv2_out_4px_row1_R1),
+  .out_4pk()
 );
 
 idwt26_v2 
 #(
-  .PX_MATH_WIDTH(PX_MATH_WIDTH)
+  .PX_MATH_WIDTH(PX_MATH_WIDTH),
+  .PEAKING(0)
 )
 iv2_B1
 (
@@ -975,8 +996,10 @@ iv2_B1
   .wr_en(iv2_wr_en_B1),
   .wr_addr(iv2_wr_addr),
   .wr_data(iv2_wr_data),
+  .peak_thr(peak_thr),
   .out_4px_row0(iv2_out_4px_row0_B1),
-  .out_4px_row1(iv2_out_4px_row1_B1)
+  .out_4px_row1(iv2_out_4px_row1_B1),
+  .out_4pk()
 );
 
 idwt26_v2 
@@ -991,8 +1014,10 @@ iv2_G2
   .wr_en(iv2_wr_en_G2),
   .wr_addr(iv2_wr_addr),
   .wr_data(iv2_wr_data),
+  .peak_thr(peak_thr),
   .out_4px_row0(iv2_out_4px_row0_G2),
-  .out_4px_row1(iv2_out_4px_row1_G2)
+  .out_4px_row1(iv2_out_4px_row1_G2),
+  .out_4pk(iv2_out_4pk_G2)
 );
 // -------------------------------------------------------------------------------------------------
 
@@ -1070,6 +1095,10 @@ wire [31:0] out_2px_row0_B1;
 wire [31:0] out_2px_row1_B1;
 wire [31:0] out_2px_row0_G2;
 wire [31:0] out_2px_row1_G2;
+wire [1:0] out_2pk_row0_G1;
+wire [1:0] out_2pk_row1_G1;
+wire [1:0] out_2pk_row0_G2;
+wire [1:0] out_2pk_row1_G2;
 
 idwt26_h2 ih2_G1
 (
@@ -1078,30 +1107,53 @@ idwt26_h2 ih2_G1
   .opx_count(opx_count_G1),
   .in_4px_row0(iv2_out_4px_row0_G1),
   .in_4px_row1(iv2_out_4px_row1_G1),
+  .in_4pk(iv2_out_4pk_G1),
+  .peak_thr(peak_thr),
+  .peak_bands(peak_bands),
   .out_2px_row0(out_2px_row0_G1),
-  .out_2px_row1(out_2px_row1_G1)
+  .out_2px_row1(out_2px_row1_G1),
+  .out_2pk_row0(out_2pk_row0_G1),
+  .out_2pk_row1(out_2pk_row1_G1)
 );
 
-idwt26_h2 ih2_R1
+idwt26_h2
+#(
+  .PEAKING(0)
+)
+ih2_R1
 (
   .SS(SS),
   .opx_clk(hdmi_clk),
   .opx_count(opx_count_R1),
   .in_4px_row0(iv2_out_4px_row0_R1),
   .in_4px_row1(iv2_out_4px_row1_R1),
+  .in_4pk(4'h0),
+  .peak_thr(peak_thr),
+  .peak_bands(peak_bands),
   .out_2px_row0(out_2px_row0_R1),
-  .out_2px_row1(out_2px_row1_R1)
+  .out_2px_row1(out_2px_row1_R1),
+  .out_2pk_row0(),
+  .out_2pk_row1()
 );
 
-idwt26_h2 ih2_B1
+idwt26_h2
+#(
+  .PEAKING(0)
+)
+ih2_B1
 (
   .SS(SS),
   .opx_clk(hdmi_clk),
   .opx_count(opx_count_B1),
   .in_4px_row0(iv2_out_4px_row0_B1),
   .in_4px_row1(iv2_out_4px_row1_B1),
+  .in_4pk(4'h0),
+  .peak_thr(peak_thr),
+  .peak_bands(peak_bands),
   .out_2px_row0(out_2px_row0_B1),
-  .out_2px_row1(out_2px_row1_B1)
+  .out_2px_row1(out_2px_row1_B1),
+  .out_2pk_row0(),
+  .out_2pk_row1()
 );
 
 idwt26_h2 ih2_G2
@@ -1111,8 +1163,13 @@ idwt26_h2 ih2_G2
   .opx_count(opx_count_G2),
   .in_4px_row0(iv2_out_4px_row0_G2),
   .in_4px_row1(iv2_out_4px_row1_G2),
+  .in_4pk(iv2_out_4pk_G2),
+  .peak_thr(peak_thr),
+  .peak_bands(peak_bands),
   .out_2px_row0(out_2px_row0_G2),
-  .out_2px_row1(out_2px_row1_G2)
+  .out_2px_row1(out_2px_row1_G2),
+  .out_2pk_row0(out_2pk_row0_G2),
+  .out_2pk_row1(out_2pk_row1_G2)
 );
 // -------------------------------------------------------------------------------------------------
 
@@ -1191,6 +1248,30 @@ bilinear_16b bilinear_G2
 );
 // -------------------------------------------------------------------------------------------------
 
+// Focus peaking.
+// -------------------------------------------------------------------------------------------------
+wire peak;
+
+focus_peaking focus_peaking_inst
+(
+  .clk(hdmi_clk),
+  
+  .x0_G1(x0_G1B1),
+  .y0_G1(y0_G1R1),
+  .x0_G2(x0_R1G2),
+  .y0_G2(y0_B1G2),
+  .xOut(vxNormP_SW),
+  .yOut(vyNormP_SW),
+  
+  .pk_row0_G1(out_2pk_row0_G1),
+  .pk_row1_G1(out_2pk_row1_G1),
+  .pk_row0_G2(out_2pk_row0_G2),
+  .pk_row1_G2(out_2pk_row1_G2),
+  
+  .peak(peak)
+);
+// -------------------------------------------------------------------------------------------------
+
 // Dark frame subtraction.
 // -------------------------------------------------------------------------------------------------
 wire signed [15:0] G1_dark_10b;
@@ -1303,6 +1384,10 @@ ui_mixer ui_mixer_inst
   .v_count(v_count[9]),
   .inViewport(inViewportP[7]),
   
+  .peak(peak),
+  .peak_enabled(peak_enabled),
+  .peak_color(peak_color),
+  
   .top_ui_enabled(top_ui_enabled),
   .bot_ui_enabled(bot_ui_enabled),
   .pop_ui_enabled(pop_ui_enabled),
@@ -8,8 +8,8 @@ encoder block as a peripheral.
 
 Also includes six URAM buffers for LUTs and UI overlays. Addressing:
 
-0x00000 to 0x0004F    Peripheral Registers (20x32b)
-0x00050 to 0x07FFF    Reserved
+0x00000 to 0x0005B    Peripheral Registers (23x32b)
+0x0005C to 0x07FFF    Reserved
 0x08000 to 0x0FFFF    uram00: Dark Rows
 0x10000 to 0x17FFF    uram01: Dark Cols
 0x18000 to 0x1FFFF    uram02: 1DLUT G1
@@ -116,6 +116,12 @@ module HDMI_v1_0_S00_AXI
   output wire pop_ui_enabled,
   output wire bot_ui_enabled,
   output wire top_ui_enabled,
+  // Slave Reg 21
+  output wire [11:0] peak_thr,
+  output wire [2:0] peak_bands,
+  output wire peak_enabled,
+  // Slave Reg 22
+  output wire [23:0] peak_color,
   // URAM 00
   input wire [11:0] dark_row_raddr,
   output wire [63:0] dark_row_rdata,
@@ -258,8 +264,8 @@ localparam integer OPT_MEM_ADDR_BITS = 4;
 //----------------------------------------------
 //-- Signals for user logic register space example
 //------------------------------------------------
-//-- Number of Slave Registers: 21 <= 2^(OPT_MEM_ADDR_BITS+1)
-reg [C_S_AXI_DATA_WIDTH-1:0] slv_reg [20:0];
+//-- Number of Slave Registers: 23 <= 2^(OPT_MEM_ADDR_BITS+1)
+reg [C_S_AXI_DATA_WIDTH-1:0] slv_reg [22:0];
 wire	 slv_reg_rden;
 wire	 slv_reg_wren;
 reg [C_S_AXI_DATA_WIDTH-1:0]	 reg_data_out;
@@ -370,7 +376,7 @@ begin
     if ( S_AXI_ARESETN == 1'b0 )
     begin : s_axi_areset_block
         integer i;
-        for(i = 0; i < 21; i = i + 1)
+        for(i = 0; i < 23; i = i + 1)
         begin
             slv_reg[i] <= 0;
         end
@@ -828,6 +834,12 @@ assign pop_ui_y0 = slv_reg[20][23:12];
 assign pop_ui_enabled = slv_reg[20][24];
 assign bot_ui_enabled = slv_reg[20][25];
 assign top_ui_enabled = slv_reg[20][26];
+// Slave Reg 21
+assign peak_thr = slv_reg[21][11:0];
+assign peak_bands = slv_reg[21][14:12];
+assign peak_enabled = slv_reg[21][15];
+// Slave Reg 22
+assign peak_color = slv_reg[22][23:0];
 
 // User logic ends
 
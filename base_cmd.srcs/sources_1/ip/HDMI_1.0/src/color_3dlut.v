@@ -106,25 +106,33 @@ begin : reg_LUT3D
 end : reg_LUT3D
 
 // First-Stage Multiplies (15 DSPs, Combinational)
+// Products are assigned at full width before they are shifted. In a 16b assignment, the product itself would be
+// truncated to 16b, leaving only the wrapped low bits for the shift.
 // Common
-wire signed [15:0] dBdR_14b = (dB_14b * dR_14b) >>> 14;
-wire signed [15:0] dRdG_14b = (dR_14b * dG_14b) >>> 14;
-wire signed [15:0] dGdB_14b = (dG_14b * dB_14b) >>> 14;
+wire signed [31:0] dBdR_28b = dB_14b * dR_14b;
+wire signed [31:0] dRdG_28b = dR_14b * dG_14b;
+wire signed [31:0] dGdB_28b = dG_14b * dB_14b;
+wire signed [15:0] dBdR_14b = dBdR_28b >>> 14;
+wire signed [15:0] dRdG_14b = dRdG_28b >>> 14;
+wire signed [15:0] dGdB_14b = dGdB_28b >>> 14;
 // R
 wire signed [31:0] cR1dB_24b = cR_10b[1] * dB_14b;
 wire signed [31:0] cR2dR_24b = cR_10b[2] * dR_14b;
 wire signed [31:0] cR3dG_24b = cR_10b[3] * dG_14b;
-wire signed [15:0] cR7dR_14b = (cR_10b[7] * dR_14b) >>> 10;
+wire signed [31:0] cR7dR_24b = cR_10b[7] * dR_14b;
+wire signed [15:0] cR7dR_14b = cR7dR_24b >>> 10;
 // G
 wire signed [31:0] cG1dB_24b = cG_10b[1] * dB_14b;
 wire signed [31:0] cG2dR_24b = cG_10b[2] * dR_14b;
 wire signed [31:0] cG3dG_24b = cG_10b[3] * dG_14b;
-wire signed [15:0] cG7dR_14b = (cG_10b[7] * dR_14b) >>> 10;
+wire signed [31:0] cG7dR_24b = cG_10b[7] * dR_14b;
+wire signed [15:0] cG7dR_14b = cG7dR_24b >>> 10;
 // B
 wire signed [31:0] cB1dB_24b = cB_10b[1] * dB_14b;
 wire signed [31:0] cB2dR_24b = cB_10b[2] * dR_14b;
 wire signed [31:0] cB3dG_24b = cB_10b[3] * dG_14b;
-wire signed [15:0] cB7dR_14b = (cB_10b[7] * dR_14b) >>> 10;
+wire signed [31:0] cB7dR_24b = cB_10b[7] * dR_14b;
+wire signed [15:0] cB7dR_14b = cB7dR_24b >>> 10;
 
 // Second-Stage Multiplies (12 DSPs, Sequential)
 reg signed [15:0] pR_14b [3:0];
@@ -0,0 +1,87 @@
+`timescale 1 ns / 1 ps
+/*
+===================================================================================
+focus_peaking.v
+
+Selects the focus peaking flag for each HDMI output pixel from the IH2 flag outputs
+of the two green color fields. The flags mark LL1 pixels whose Stage 2 detail
+coefficients (HL2, LH2, HH2, as selected in IH2) are above threshold. Green carries
+most of the luma detail, so the R1 and B1 IV2 and IH2 cores are built with PEAKING = 0
+and compute no flags.
+
+The grid square is the same one used by the bilinear interpolators. Instead of
+interpolating, the flag of the nearest corner is used, so marked edges stay one
+LL1 pixel wide. A pixel is marked if either green field flags it.
+
+The output is delayed to line up with the 8b RGB outputs of the color pipeline:
+1. Bilinear interpolation.
+2. Dark frame subtraction.
+3-6. Color 1DLUTs.
+7-9. Color 3DLUT.
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+===================================================================================
+*/
+
+module focus_peaking
+#(
+  parameter integer GRID_EXP = 6,
+  parameter integer PEAK_LATENCY = 9
+)
+(
+  input wire clk,
+
+  input wire [15:0] x0_G1,
+  input wire [15:0] y0_G1,
+  input wire [15:0] x0_G2,
+  input wire [15:0] y0_G2,
+  input wire [15:0] xOut,
+  input wire [15:0] yOut,
+
+  input wire [1:0] pk_row0_G1,
+  input wire [1:0] pk_row1_G1,
+  input wire [1:0] pk_row0_G2,
+  input wire [1:0] pk_row1_G2,
+
+  output wire peak
+);
+
+// Offsets into the grid square. The MSB selects the nearest corner (combinational).
+wire [15:0] xOffset_G1 = xOut - x0_G1;
+wire [15:0] yOffset_G1 = yOut - y0_G1;
+wire [15:0] xOffset_G2 = xOut - x0_G2;
+wire [15:0] yOffset_G2 = yOut - y0_G2;
+
+wire [1:0] pk_row_G1 = yOffset_G1[GRID_EXP-1] ? pk_row1_G1 : pk_row0_G1;
+wire [1:0] pk_row_G2 = yOffset_G2[GRID_EXP-1] ? pk_row1_G2 : pk_row0_G2;
+wire pk_G1 = pk_row_G1[xOffset_G1[GRID_EXP-1]];
+wire pk_G2 = pk_row_G2[xOffset_G2[GRID_EXP-1]];
+
+// Delay line.
+reg [PEAK_LATENCY-1:0] peakP;
+always @(posedge clk)
+begin
+  peakP <= {peakP[PEAK_LATENCY-2:0], pk_G1 | pk_G2};
+end
+
+assign peak = peakP[PEAK_LATENCY-1];
+
+endmodule
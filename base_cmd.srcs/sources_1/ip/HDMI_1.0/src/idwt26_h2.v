@@ -40,6 +40,9 @@ THE SOFTWARE.
 */
 
 module idwt26_h2
+#(
+  parameter PEAKING = 1             // 0: No focus peaking, out_2pk_row0/1 are always 0.
+)
 (
   input wire SS,
 
@@ -47,13 +50,20 @@ module idwt26_h2
   input wire signed [23:0] opx_count,
   input wire [63:0] in_4px_row0,
   input wire [63:0] in_4px_row1,
+  input wire [3:0] in_4pk,
+  
+  input wire [11:0] peak_thr,
+  input wire [2:0] peak_bands,
   
   output wire [31:0] out_2px_row0,
-  output wire [31:0] out_2px_row1
+  output wire [31:0] out_2px_row1,
+  output wire [1:0] out_2pk_row0,
+  output wire [1:0] out_2pk_row1
 );
 
 // Memory to be inferred as a single URAM (256K = 16 x 1024 x 16b).
-reg [63:0] mem [4095:0];
+// The URAM is 72b wide: bits [67:64] carry the focus peaking flags, one per 16b lane.
+reg [71:0] mem [4095:0];
 
 // Driving state from opx_count LSBs.
 wire [1:0] state = opx_count[1:0];
@@ -98,7 +108,7 @@ wire [11:0] rd_addr = SS ? rd_addr_2K : rd_addr_4K;
 
 // Read operation. (One clock cycle latency between updating rd_addr and latching rd_data.)
 // -------------------------------------------------------------------------------------------------
-reg [63:0] rd_data ;
+reg [71:0] rd_data ;
 
 always @(posedge opx_clk)
 begin
@@ -116,6 +126,9 @@ reg [15:0] out_px_row0 [5:0];   // Output Row 0 Pipeline, 5 -> 0.
 reg [15:0] out_px_row1 [4:0];   // Output Row 1 Pipeline, 4 -> 0.
 reg signed [15:0] S[3:0];       // H2 Sum Pipeline, 3 -> 0.
 reg signed [15:0] D[3:0];       // H2 Diff Pipeline, 3 -> 0.
+reg out_pk_row0 [5:0];          // Output Row 0 Peaking Flag Pipeline, 5 -> 0.
+reg out_pk_row1 [4:0];          // Output Row 1 Peaking Flag Pipeline, 4 -> 0.
+reg [1:0] P[3:0];               // H2 Peaking Flag Pipeline {HH2, LH2}, 3 -> 0.
 
 always @(posedge opx_clk)
 begin
@@ -124,12 +137,15 @@ begin
 
    // Default shifts for Output pipeline.
   out_px_row0[4] <= out_px_row0[5];
+  out_pk_row0[4] <= out_pk_row0[5];
   begin : output_shifts
     integer i;
     for(i = 0; i < 4; i = i + 1)
     begin
       out_px_row0[i] <= out_px_row0[i+1];
       out_px_row1[i] <= out_px_row1[i+1];
+      out_pk_row0[i] <= out_pk_row0[i+1];
+      out_pk_row1[i] <= out_pk_row1[i+1];
     end
   end : output_shifts
   
@@ -142,6 +158,7 @@ begin
     begin
       S[i] <= S[i+1];
       D[i] <= D[i+1];
+      P[i] <= P[i+1];
     end
   end : h2_shifts
 
@@ -158,6 +175,8 @@ begin
     D[2] <= rd_data[16+:16];
     S[3] <= rd_data[32+:16];
     D[3] <= rd_data[48+:16];
+    P[2] <= rd_data[64+:2];
+    P[3] <= rd_data[66+:2];
   end
     
   2'b10: // Receive Row N+0 for Output.
@@ -166,6 +185,10 @@ begin
     out_px_row0[3] <= rd_data[16+:16];
     out_px_row0[4] <= rd_data[32+:16];
     out_px_row0[5] <= rd_data[48+:16];
+    out_pk_row0[2] <= rd_data[64];
+    out_pk_row0[3] <= rd_data[65];
+    out_pk_row0[4] <= rd_data[66];
+    out_pk_row0[5] <= rd_data[67];
   end
     
   2'b11: // Receive Row N+1 for Output.
@@ -174,6 +197,10 @@ begin
     out_px_row1[2] <= rd_data[16+:16];
     out_px_row1[3] <= rd_data[32+:16];
     out_px_row1[4] <= rd_data[48+:16];
+    out_pk_row1[1] <= rd_data[64];
+    out_pk_row1[2] <= rd_data[65];
+    out_pk_row1[3] <= rd_data[66];
+    out_pk_row1[4] <= rd_data[67];
   end
     
   endcase
@@ -183,6 +210,8 @@ end
 
 assign out_2px_row0 = {out_px_row0[1], out_px_row0[0]};
 assign out_2px_row1 = {out_px_row1[1], out_px_row1[0]};
+assign out_2pk_row0 = {out_pk_row0[1], out_pk_row0[0]};
+assign out_2pk_row1 = {out_pk_row1[1], out_pk_row1[0]};
 // -------------------------------------------------------------------------------------------------
 
 /* -------------------------------------------------------------------------------------------------
@@ -197,12 +226,24 @@ processed form left to right across a row, such that:
     S(n-1) is the sum to the left, which arrives earlier (oldest).
     S(n+1) is the sum to the right, which arrives later (newest).
 ------------------------------------------------------------------------------------------------- */
-wire signed [15:0] D2 = D[1] - ((S[0] - S[2] + 16'sh0002) >>> 2);
+wire signed [15:0] Lift = (S[0] - S[2] + 16'sh0002) >>> 2;
+wire signed [15:0] D2 = D[1] - Lift;
 wire signed [15:0] Xeven = S[1] - (D2 >>> 1);
 wire signed [15:0] Xodd = Xeven + D2;
 
+// Focus peaking: D2 is the horizontal detail (HL2) of the pixel pair. The pair is flagged if any
+// selected band is above threshold: peak_bands[0] = HL2, [1] = LH2 (from V2), [2] = HH2 (from V2).
+// As in V2, HL2 must also be more than twice the lift, so that only sharp edges are flagged.
+wire [15:0] D2_abs = D2[15] ? (16'h0000 - D2) : D2;
+wire [15:0] Lift_abs = Lift[15] ? (16'h0000 - Lift) : Lift;
+wire pk = (PEAKING != 0)
+        & ((peak_bands[0] & (D2_abs > {4'h0, peak_thr}) & ({1'b0, D2_abs} > {Lift_abs, 1'b0}))
+        | (peak_bands[1] & P[1][0])
+        | (peak_bands[2] & P[1][1]));
+
 reg signed [15:0] XevenP [1:0]; // Even pixel pipeline, 1->0.
 reg signed [15:0] XoddP [1:0];  // Odd pixel pipeline, 1->0.
+reg PkP [1:0];                  // Pixel pair peaking flag pipeline, 1->0.
 
 always @(posedge opx_clk)
 begin
@@ -210,8 +251,10 @@ if(en & state[0]) // Half speed, only runs on odd states.
 begin
   XevenP[1] <= Xeven;
   XoddP[1] <= Xodd;
+  PkP[1] <= pk;
   XevenP[0] <= XevenP[1];
   XoddP[0] <= XoddP[1];
+  PkP[0] <= PkP[1];
 end
 end
 // -------------------------------------------------------------------------------------------------
@@ -247,18 +290,18 @@ begin
   
   2'b00:
   begin
-    mem[wr_addr] <= {XoddP[1], XevenP[1], XoddP[0], XevenP[0]};
+    mem[wr_addr] <= {4'h0, PkP[1], PkP[1], PkP[0], PkP[0], XoddP[1], XevenP[1], XoddP[0], XevenP[0]};
   end
   
   2'b01:
   begin
     if(wr_odd_row)
     begin // Write odd row from IDWT V2 output.
-      mem[wr_addr] <= in_4px_row1;
+      mem[wr_addr] <= {4'h0, (PEAKING ? in_4pk : 4'h0), in_4px_row1};
     end
     else
     begin // Write even row IDWT V2 OUTPUT.
-      mem[wr_addr] <= in_4px_row0;
+      mem[wr_addr] <= {4'h0, (PEAKING ? in_4pk : 4'h0), in_4px_row0};
     end
   end
   
@@ -42,7 +42,8 @@ THE SOFTWARE.
 
 module idwt26_v2
 #(
-  parameter PX_MATH_WIDTH = 16
+  parameter PX_MATH_WIDTH = 16,
+  parameter PEAKING = 1             // 0: No focus peaking, out_4pk is always 0.
 )
 (
   input wire SS,
@@ -53,8 +54,11 @@ module idwt26_v2
   input wire [11:0] wr_addr,
   input wire [63:0] wr_data,
   
+  input wire [11:0] peak_thr,
+  
   output reg [63:0] out_4px_row0,
-  output reg [63:0] out_4px_row1
+  output reg [63:0] out_4px_row1,
+  output reg [3:0] out_4pk
 );
 
 // Memory to be inferred as a single URAM (256K = 16 x 1024 x 16b).
@@ -172,6 +176,7 @@ processed form left to right across a row, such that:
     S(n-1) is the sum above, which arrives earlier (oldest).
     S(n+1) is the sum below, which arrives later (newest).
 ------------------------------------------------------------------------------------------------- */
+wire signed [15:0] Lift[3:0];
 wire signed [15:0] D2[3:0];
 wire signed [15:0] Xeven[3:0];
 wire signed [15:0] Xodd[3:0];
@@ -179,17 +184,34 @@ wire signed [15:0] Xodd[3:0];
 genvar i;
 for (i = 0; i < 4; i = i + 1)
 begin
-  assign D2[i] = D[i] - ((S_above[i] - S_below[i] + 16'sh0002) >>> 2);
+  assign Lift[i] = (S_above[i] - S_below[i] + 16'sh0002) >>> 2;
+  assign D2[i] = D[i] - Lift[i];
   assign Xeven[i] = S[i] - (D2[i] >>> 1);
   assign Xodd[i] = Xeven[i] + D2[i];
 end
 
+// Focus peaking: D2 is the vertical detail of the row pair. In the L columns (0, 2) it comes from LH2, in the H
+// columns (1, 3) from HH2. Flag each column whose detail magnitude is above threshold, for both rows.
+// The detail must also be more than twice the lift, the slope of the sums above and below. A blurred edge is a ramp
+// that spreads its contrast over the sums, a sharp one puts it all in the detail, whatever the edge contrast.
+wire [15:0] D2_abs[3:0];
+wire [15:0] Lift_abs[3:0];
+wire [3:0] Sharp;
+for (i = 0; i < 4; i = i + 1)
+begin
+  assign D2_abs[i] = D2[i][15] ? (16'h0000 - D2[i]) : D2[i];
+  assign Lift_abs[i] = Lift[i][15] ? (16'h0000 - Lift[i]) : Lift[i];
+  assign Sharp[i] = ({1'b0, D2_abs[i]} > {Lift_abs[i], 1'b0});
+end
+
 always @(posedge opx_clk)
 begin
 if(en & (state == 2'b01))
 begin
   out_4px_row0 <= {Xeven[3], Xeven[2], Xeven[1], Xeven[0]};
   out_4px_row1 <= {Xodd[3], Xodd[2], Xodd[1], Xodd[0]};
+  out_4pk <= PEAKING ? ({(D2_abs[3] > {4'h0, peak_thr}), (D2_abs[2] > {4'h0, peak_thr}),
+                        (D2_abs[1] > {4'h0, peak_thr}), (D2_abs[0] > {4'h0, peak_thr})} & Sharp) : 4'h0;
 end
 end
 // -------------------------------------------------------------------------------------------------
@@ -62,6 +62,10 @@ module ui_mixer
   input wire [15:0] v_count,
   input wire inViewport,
   
+  input wire peak,
+  input wire peak_enabled,
+  input wire [23:0] peak_color,
+  
   input wire top_ui_enabled,
   input wire bot_ui_enabled,
   input wire pop_ui_enabled,
@@ -80,10 +84,16 @@ module ui_mixer
   output reg [7:0] B_out
 );
 
+// Focus peaking replaces flagged preview pixels with the peaking color (combinational).
+wire peak_px = peak && peak_enabled;
+wire [7:0] R_view_8b = peak_px ? peak_color[16+:8] : R_8b;
+wire [7:0] G_view_8b = peak_px ? peak_color[8+:8] : G_8b;
+wire [7:0] B_view_8b = peak_px ? peak_color[0+:8] : B_8b;
+
 // inViewport switch selects preview image or background color (combinational).
-wire [7:0] R_mix_8b = inViewport ? R_8b : BGR_8b;
-wire [7:0] G_mix_8b = inViewport ? G_8b : BGG_8b;
-wire [7:0] B_mix_8b = inViewport ? B_8b : BGB_8b;
+wire [7:0] R_mix_8b = inViewport ? R_view_8b : BGR_8b;
+wire [7:0] G_mix_8b = inViewport ? G_view_8b : BGG_8b;
+wire [7:0] B_mix_8b = inViewport ? B_view_8b : BGB_8b;
 
 // UI masks (combinational).
 wire in_top_ui = ((h_count >= TOP_UI_X0) && (h_count < (TOP_UI_X0 + TOP_UI_W))
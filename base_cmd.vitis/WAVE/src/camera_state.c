@@ -31,6 +31,8 @@ THE SOFTWARE.
 #include "encoder.h"
 #include "frame.h"
 #include "hdmi.h"
+#include "fs.h"
+#include "playback.h"
 
 // Private Pre-Processor Definitions -----------------------------------------------------------------------------------
 
@@ -48,12 +50,19 @@ void cSettingFPSSetVal(u8 val);
 void cSettingShutterSetVal(u8 val);
 void cSettingColorSetVal(u8 val);
 void cSettingGainSetVal(u8 val);
+void cSettingPeakSetVal(u8 val);
+void cSettingPeakColorSetVal(u8 val);
+void cSettingPeakBandsSetVal(u8 val);
+void cSettingScopesSetVal(u8 val);
 void cSettingFormatSetVal(u8 val);
 
 void cSettingFPSPreviewVal(u8 val);
 void cSettingShutterPreviewVal(u8 val);
 void cSettingColorPreviewVal(u8 val);
 void cSettingGainPreviewVal(u8 val);
+void cSettingPeakPreviewVal(u8 val);
+void cSettingPeakColorPreviewVal(u8 val);
+void cSettingPeakBandsPreviewVal(u8 val);
 
 void cSettingDoNothing(u8 val);
 
@@ -73,6 +82,10 @@ CameraSetting_s cSettingFPS;
 CameraSetting_s cSettingShutter;
 CameraSetting_s cSettingColor;
 CameraSetting_s cSettingGain;
+CameraSetting_s cSettingPeak;
+CameraSetting_s cSettingPeakColor;
+CameraSetting_s cSettingPeakBands;
+CameraSetting_s cSettingScopes;
 CameraSetting_s cSettingFormat;
 
 char * cSettingModeName = "  MODE  ";
@@ -236,10 +249,48 @@ CameraSettingValue_s cSettingGainValArray[] = {{" LINEAR ", 0.0f},
 											   {" CAL3   ", 4.0f},
 											   {" CAL4   ", 5.0f}};
 
+// Focus peaking noise floor on the Stage 2 detail coefficients, in LL1 (10b) units. Edges must also be sharp to flag.
+char * cSettingPeakName = "  PEAK  ";
+char * cSettingPeakValFormat = " %6d ";
+CameraSettingValue_s cSettingPeakValArray[] = {{"PEAK OFF", 0.0f},
+											   {"PEAK  16", 16.0f},
+											   {"PEAK  32", 32.0f},
+											   {"PEAK  48", 48.0f},
+											   {"PEAK  64", 64.0f},
+											   {"PEAK  96", 96.0f},
+											   {"PEAK 128", 128.0f},
+											   {"PEAK 192", 192.0f},
+											   {"PEAK 256", 256.0f}};
+
+// Focus peaking overlay color, 0xRRGGBB.
+char * cSettingPeakColorName = "PK COLOR";
+char * cSettingPeakColorValFormat = " %6d ";
+CameraSettingValue_s cSettingPeakColorValArray[] = {{"PK RED  ", (float)0xFF0000},
+													{"PK GREEN", (float)0x00FF00},
+													{"PK BLUE ", (float)0x0000FF},
+													{"PK YELLO", (float)0xFFFF00},
+													{"PK WHITE", (float)0xFFFFFF}};
+
+// Focus peaking subbands, a mask of CSETTING_PEAK_BAND_XXX.
+char * cSettingPeakBandsName = "PK BANDS";
+char * cSettingPeakBandsValFormat = " %6d ";
+CameraSettingValue_s cSettingPeakBandsValArray[] = {{"PK ALL  ", 7.0f},
+													{"PK HL+LH", 3.0f},
+													{"PK HL   ", 1.0f},
+													{"PK LH   ", 2.0f},
+													{"PK HH   ", 4.0f}};
+
+// Exposure scopes on the pop-up UI.
+char * cSettingScopesName = " SCOPES ";
+char * cSettingScopesValFormat = " %6d ";
+CameraSettingValue_s cSettingScopesValArray[] = {{"SCOPEOFF", 0.0f},
+												 {"SCOPE ON", 1.0f}};
+
 char * cSettingFormatName = " FORMAT ";
 char * cSettingFormatValFormat = " %6d ";
 CameraSettingValue_s cSettingFormatValArray[] = {{"Cancel  ", 0.0f},
-												 {"Confirm ", 1.0f}};
+												 {"Confirm ", 1.0f},
+												 {"Opt LBA ", 2.0f}};
 
 // Interrupt Handlers --------------------------------------------------------------------------------------------------
 
@@ -373,10 +424,82 @@ void cStateInit(void)
 	cSettingGain.SetVal = &cSettingGainSetVal;
 	cSettingGain.PreviewVal = &cSettingGainPreviewVal;
 
-	cSettingFormat.id = 7;
+	cSettingPeak.id = 7;
+	cSettingPeak.val = 0;
+	cSettingPeak.count = 9;
+	cSettingPeak.enable[0] = 0x00000000000001FF;
+	cSettingPeak.enable[1] = 0x0000000000000000;
+	cSettingPeak.enable[2] = 0x0000000000000000;
+	cSettingPeak.enable[3] = 0x0000000000000000;
+	cSettingPeak.user[0] = 0x0000000000000000;
+	cSettingPeak.user[1] = 0x0000000000000000;
+	cSettingPeak.user[2] = 0x0000000000000000;
+	cSettingPeak.user[3] = 0x0000000000000000;
+	cSettingPeak.strName = cSettingPeakName;
+	cSettingPeak.strValFormat = cSettingPeakValFormat;
+	cSettingPeak.valArray = cSettingPeakValArray;
+	cSettingPeak.uiDisplayType = CSETTING_UI_DISPLAY_TYPE_VAL_ARRAY;
+	cSettingPeak.SetVal = &cSettingPeakSetVal;
+	cSettingPeak.PreviewVal = &cSettingPeakPreviewVal;
+
+	cSettingPeakColor.id = 8;
+	cSettingPeakColor.val = 0;
+	cSettingPeakColor.count = 5;
+	cSettingPeakColor.enable[0] = 0x000000000000001F;
+	cSettingPeakColor.enable[1] = 0x0000000000000000;
+	cSettingPeakColor.enable[2] = 0x0000000000000000;
+	cSettingPeakColor.enable[3] = 0x0000000000000000;
+	cSettingPeakColor.user[0] = 0x0000000000000000;
+	cSettingPeakColor.user[1] = 0x0000000000000000;
+	cSettingPeakColor.user[2] = 0x0000000000000000;
+	cSettingPeakColor.user[3] = 0x0000000000000000;
+	cSettingPeakColor.strName = cSettingPeakColorName;
+	cSettingPeakColor.strValFormat = cSettingPeakColorValFormat;
+	cSettingPeakColor.valArray = cSettingPeakColorValArray;
+	cSettingPeakColor.uiDisplayType = CSETTING_UI_DISPLAY_TYPE_VAL_ARRAY;
+	cSettingPeakColor.SetVal = &cSettingPeakColorSetVal;
+	cSettingPeakColor.PreviewVal = &cSettingPeakColorPreviewVal;
+
+	cSettingPeakBands.id = 9;
+	cSettingPeakBands.val = 0;
+	cSettingPeakBands.count = 5;
+	cSettingPeakBands.enable[0] = 0x000000000000001F;
+	cSettingPeakBands.enable[1] = 0x0000000000000000;
+	cSettingPeakBands.enable[2] = 0x0000000000000000;
+	cSettingPeakBands.enable[3] = 0x0000000000000000;
+	cSettingPeakBands.user[0] = 0x0000000000000000;
+	cSettingPeakBands.user[1] = 0x0000000000000000;
+	cSettingPeakBands.user[2] = 0x0000000000000000;
+	cSettingPeakBands.user[3] = 0x0000000000000000;
+	cSettingPeakBands.strName = cSettingPeakBandsName;
+	cSettingPeakBands.strValFormat = cSettingPeakBandsValFormat;
+	cSettingPeakBands.valArray = cSettingPeakBandsValArray;
+	cSettingPeakBands.uiDisplayType = CSETTING_UI_DISPLAY_TYPE_VAL_ARRAY;
+	cSettingPeakBands.SetVal = &cSettingPeakBandsSetVal;
+	cSettingPeakBands.PreviewVal = &cSettingPeakBandsPreviewVal;
+
+	cSettingScopes.id = 10;
+	cSettingScopes.val = CSETTING_SCOPES_OFF;
+	cSettingScopes.count = 2;
+	cSettingScopes.enable[0] = 0x0000000000000003;
+	cSettingScopes.enable[1] = 0x0000000000000000;
+	cSettingScopes.enable[2] = 0x0000000000000000;
+	cSettingScopes.enable[3] = 0x0000000000000000;
+	cSettingScopes.user[0] = 0x0000000000000000;
+	cSettingScopes.user[1] = 0x0000000000000000;
+	cSettingScopes.user[2] = 0x0000000000000000;
+	cSettingScopes.user[3] = 0x0000000000000000;
+	cSettingScopes.strName = cSettingScopesName;
+	cSettingScopes.strValFormat = cSettingScopesValFormat;
+	cSettingScopes.valArray = cSettingScopesValArray;
+	cSettingScopes.uiDisplayType = CSETTING_UI_DISPLAY_TYPE_VAL_ARRAY;
+	cSettingScopes.SetVal = &cSettingScopesSetVal;
+	cSettingScopes.PreviewVal = &cSettingDoNothing;
+
+	cSettingFormat.id = 11;
 	cSettingFormat.val = 0;
-	cSettingFormat.count = 2;
-	cSettingFormat.enable[0] = 0x0000000000000003;
+	cSettingFormat.count = 3;
+	cSettingFormat.enable[0] = 0x0000000000000007;
 	cSettingFormat.enable[1] = 0x0000000000000000;
 	cSettingFormat.enable[2] = 0x0000000000000000;
 	cSettingFormat.enable[3] = 0x0000000000000000;
@@ -398,7 +521,11 @@ void cStateInit(void)
 	cState.cSetting[4] = &cSettingShutter;
 	cState.cSetting[5] = &cSettingColor;
 	cState.cSetting[6] = &cSettingGain;
-	cState.cSetting[7] = &cSettingFormat;
+	cState.cSetting[7] = &cSettingPeak;
+	cState.cSetting[8] = &cSettingPeakColor;
+	cState.cSetting[9] = &cSettingPeakBands;
+	cState.cSetting[10] = &cSettingScopes;
+	cState.cSetting[11] = &cSettingFormat;
 
 	// Manually trigger cSettingWidthSetVal() to make sure initial state is applied.
 	cSettingWidthSetVal(CSETTING_WIDTH_4K);
@@ -448,6 +575,11 @@ void cSettingModeSetVal(u8 val)
 			frameCreateClip();
 			cSettingMode.val = CSETTING_MODE_REC;
 		}
+		else if(val == CSETTING_MODE_PLAYBACK)
+		{
+			// Play back the last clip.
+			if(playbackStart(nClip - 1) == PLAYBACK_OK) { cSettingMode.val = CSETTING_MODE_PLAYBACK; }
+		}
 		break;
 	case CSETTING_MODE_REC:
 		if(val == CSETTING_MODE_STANDBY)
@@ -457,6 +589,13 @@ void cSettingModeSetVal(u8 val)
 			cSettingMode.val = CSETTING_MODE_STANDBY;
 		}
 		break;
+	case CSETTING_MODE_PLAYBACK:
+		if(val == CSETTING_MODE_STANDBY)
+		{
+			playbackStop();
+			cSettingMode.val = CSETTING_MODE_STANDBY;
+		}
+		break;
 	}
 }
 
@@ -560,6 +699,38 @@ void cSettingGainSetVal(u8 val)
 	cSettingGain.val = val;
 }
 
+void cSettingPeakSetVal(u8 val)
+{
+	if(!cSettingGetEnabled(CSETTING_PEAK, val)) { return; }
+
+	// Change the focus peaking threshold.
+	cSettingPeak.val = val;
+}
+
+void cSettingPeakColorSetVal(u8 val)
+{
+	if(!cSettingGetEnabled(CSETTING_PEAK_COLOR, val)) { return; }
+
+	// Change the focus peaking color.
+	cSettingPeakColor.val = val;
+}
+
+void cSettingPeakBandsSetVal(u8 val)
+{
+	if(!cSettingGetEnabled(CSETTING_PEAK_BANDS, val)) { return; }
+
+	// Change the focus peaking subbands.
+	cSettingPeakBands.val = val;
+}
+
+void cSettingScopesSetVal(u8 val)
+{
+	if(!cSettingGetEnabled(CSETTING_SCOPES, val)) { return; }
+
+	// Turn the exposure scopes on or off. They are drawn on the pop-up UI once the menu closes.
+	cSettingScopes.val = val;
+}
+
 void cSettingFormatSetVal(u8 val)
 {
 	if(!cSettingGetEnabled(CSETTING_FORMAT, val)) { return; }
@@ -617,6 +788,33 @@ void cSettingGainPreviewVal(u8 val)
 	hdmiApplyCameraState();
 }
 
+void cSettingPeakPreviewVal(u8 val)
+{
+	if(!cSettingGetEnabled(CSETTING_PEAK, val)) { return; }
+
+	// Change the focus peaking threshold and immediately apply it to the HDMI module.
+	cSettingPeak.val = val;
+	hdmiApplyCameraState();
+}
+
+void cSettingPeakColorPreviewVal(u8 val)
+{
+	if(!cSettingGetEnabled(CSETTING_PEAK_COLOR, val)) { return; }
+
+	// Change the focus peaking color and immediately apply it to the HDMI module.
+	cSettingPeakColor.val = val;
+	hdmiApplyCameraState();
+}
+
+void cSettingPeakBandsPreviewVal(u8 val)
+{
+	if(!cSettingGetEnabled(CSETTING_PEAK_BANDS, val)) { return; }
+
+	// Change the focus peaking subbands and immediately apply it to the HDMI module.
+	cSettingPeakBands.val = val;
+	hdmiApplyCameraState();
+}
+
 void cSettingDoNothing(u8 val)
 {
 	return;
@@ -35,7 +35,7 @@ THE SOFTWARE.
 
 // Public Pre-Processor Definitions ------------------------------------------------------------------------------------
 
-#define CSTATE_NUM_SETTINGS 8
+#define CSTATE_NUM_SETTINGS 12
 
 #define CSETTING_MODE 0
 #define CSETTING_MODE_STANDBY 0
@@ -64,9 +64,24 @@ THE SOFTWARE.
 #define CSETTING_GAIN_CAL3 4
 #define CSETTING_GAIN_CAL4 5
 
-#define CSETTING_FORMAT 7
+#define CSETTING_PEAK 7
+#define CSETTING_PEAK_OFF 0
+
+#define CSETTING_PEAK_COLOR 8
+
+#define CSETTING_PEAK_BANDS 9
+#define CSETTING_PEAK_BAND_HL2 0x1
+#define CSETTING_PEAK_BAND_LH2 0x2
+#define CSETTING_PEAK_BAND_HH2 0x4
+
+#define CSETTING_SCOPES 10
+#define CSETTING_SCOPES_OFF 0
+#define CSETTING_SCOPES_ON 1
+
+#define CSETTING_FORMAT 11
 #define CSETTING_FORMAT_CANCEL 0
 #define CSETTING_FORMAT_CONFIRM 1
+#define CSETTING_FORMAT_OPTIMIZE 2
 
 #define CSETTING_UI_DISPLAY_TYPE_NAME 0
 #define CSETTING_UI_DISPLAY_TYPE_VAL_ARRAY 1
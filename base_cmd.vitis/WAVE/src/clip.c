@@ -0,0 +1,316 @@
+/*
+WAVE Clip Reader
+
+Reads clips straight from the SSD, for playback and the USB vendor interface: where each clip file is on the disk,
+direct NVMe reads of byte ranges of it, and a frame index built from the frame headers.
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <string.h>
+#include "clip.h"
+#include "nvme.h"
+#include "ff.h"
+#include "fs.h"
+#include "frame.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define CLIP_NVME_CHUNK            0x20000       // 128KiB per NVMe command.
+#define CLIP_INDEX_RETRIES         3             // Reads of a frame header before the frame is given up on.
+#define CLIP_INDEX_SEARCH          0x8000        // 32KiB per read while looking for the next frame header.
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void clipIndexAdd(clipIndex_s * ix);
+void clipIndexLost(clipIndex_s * ix);
+void clipIndexSearch(clipIndex_s * ix);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// Load the extents of a clip file (or CLIP_FILE_INFO). The file is closed again: reads go straight to the SSD.
+u8 clipOpenFile(clipFile_s * file, int nClip, int nFile)
+{
+	int res;
+
+	if((file->nClip == nClip) && (file->nFile == nFile)) { return CLIP_OK; }
+	clipForgetFile(file);
+
+	if(nFile == CLIP_FILE_INFO) { res = fsOpenClipInfoFile(nClip); }
+	else { res = fsOpenClipFile(nClip, nFile); }
+	if(res != FR_OK) { return CLIP_ERROR_NOT_FOUND; }
+
+	file->size_B = fsGetClipFileSize();
+	file->count = fsGetClipFileExtents(file->extent, CLIP_EXTENTS);
+	fsCloseClipFile();
+
+	// Too fragmented to describe.
+	if((file->size_B > 0) && (file->count == 0)) { return CLIP_ERROR_IO; }
+
+	file->nClip = nClip;
+	file->nFile = nFile;
+
+	return CLIP_OK;
+}
+
+// Drop the loaded extents, e.g. when the disk contents have changed.
+void clipForgetFile(clipFile_s * file)
+{
+	file->nClip = -1;
+	file->nFile = -1;
+}
+
+// Issue the NVMe reads for bytes [offset, offset + length) of a file whose extents are loaded, without waiting for
+// them. dest receives the LBA holding offset. Returns the number of commands issued.
+u16 clipReadStart(const clipFile_s * file, u8 * dest, u64 offset, u32 length)
+{
+	u32 sizeLBA = nvmeGetLBASize();
+	u32 nBlocksPerCommand = CLIP_NVME_CHUNK / sizeLBA;
+	u32 nBlocks;
+	u64 pos = offset - (offset % sizeLBA);
+	u64 end = offset + length;
+	u64 extentEnd;
+	u64 lba;
+	u32 e = 0;
+	u16 nCommands = 0;
+
+	if(file->count == 0) { return 0; }
+
+	while(pos < end)
+	{
+		// Extents are whole clusters, so a command never straddles two of them except at the end of the file.
+		while((e + 1 < file->count) && (pos >= file->extent[e].offset_B + file->extent[e].size_B)) { e++; }
+		extentEnd = file->extent[e].offset_B + file->extent[e].size_B;
+
+		lba = file->extent[e].lba + (pos - file->extent[e].offset_B) / sizeLBA;
+		nBlocks = (((extentEnd < end) ? extentEnd : end) - pos + sizeLBA - 1) / sizeLBA;
+		if(nBlocks > nBlocksPerCommand) { nBlocks = nBlocksPerCommand; }
+
+		nvmeWaitForWrites(lba, nBlocks);
+		nvmeRead(dest, lba, nBlocks);
+		nCommands++;
+
+		dest += nBlocks * sizeLBA;
+		pos += nBlocks * sizeLBA;
+	}
+
+	return nCommands;
+}
+
+void clipIndexStart(clipIndex_s * ix, int nClip)
+{
+	ix->nClip = nClip;
+	ix->nFrames = 0;
+	ix->nLost = 0;
+	ix->complete = 0;
+	ix->status = CLIP_OK;
+	ix->nFile = -1;
+	ix->offset = 0;
+	ix->reading = 0;
+	ix->retries = 0;
+	ix->searching = 0;
+	ix->lost = 0;
+	ix->lastValid = 0;
+	clipForgetFile(&ix->file);
+}
+
+// There is no frame index on the disk: walk the frame headers, each giving the size of its frame. One header read is
+// in flight at a time. Each call takes in the last one, if it has completed, and starts the next. A header that fails
+// to read is read again, and after CLIP_INDEX_RETRIES its frame is lost: see clipIndexLost(). Returns 1 when the
+// index is complete.
+u8 clipIndexStep(clipIndex_s * ix)
+{
+	int ioStatus;
+	u8 status;
+
+	if(ix->complete) { return 1; }
+
+	if(ix->reading)
+	{
+		ioStatus = nvmeCheckCIDRange(ix->cid, ix->nCommands);
+		if(ioStatus == NVME_IO_PENDING) { return 0; }
+		ix->reading = 0;
+
+		if(ioStatus != NVME_IO_OK)
+		{
+			ix->retries++;
+			if(ix->retries == CLIP_INDEX_RETRIES)
+			{
+				ix->retries = 0;
+				clipIndexLost(ix);
+			}
+		}
+		else
+		{
+			ix->retries = 0;
+			if(ix->searching) { clipIndexSearch(ix); }
+			else { clipIndexAdd(ix); }
+		}
+	}
+
+	// Next file once this one has no room left for a frame header.
+	while((ix->nFile < 0) || (ix->offset + sizeof(FrameHeader_s) > ix->file.size_B))
+	{
+		status = clipOpenFile(&ix->file, ix->nClip, ix->nFile + 1);
+		if(status != CLIP_OK)
+		{
+			// Running out of files ends the clip. Not finding the first one means there is no clip.
+			if((status != CLIP_ERROR_NOT_FOUND) || (ix->nFile < 0)) { ix->status = status; }
+			ix->complete = 1;
+			return 1;
+		}
+		ix->nFile++;
+		ix->offset = 0;
+		ix->searching = 0;		// Each file starts with a frame header.
+	}
+
+	if(ix->nFrames == ix->maxFrames)
+	{
+		ix->complete = 1;
+		return 1;
+	}
+
+	ix->length = sizeof(FrameHeader_s);
+	if(ix->searching)
+	{
+		ix->length = CLIP_INDEX_SEARCH;
+		if(ix->offset + ix->length > ix->file.size_B) { ix->length = ix->file.size_B - ix->offset; }
+	}
+
+	ix->cid = nvmeGetIOCID();
+	ix->nCommands = clipReadStart(&ix->file, ix->header, ix->offset, ix->length);
+	ix->reading = 1;
+
+	return 0;
+}
+
+// Wait for the frame header read in flight, if any. The next clipIndexStep() takes it in.
+void clipIndexWait(clipIndex_s * ix)
+{
+	if(ix->reading) { nvmeWaitCIDRange(ix->cid, ix->nCommands); }
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Index the frame whose header was just read.
+void clipIndexAdd(clipIndex_s * ix)
+{
+	FrameHeader_s * fh = (FrameHeader_s *)(ix->header + ix->offset % nvmeGetLBASize());
+	u64 size;
+	u32 sizeCS;
+	u32 nLost;
+
+	size = sizeof(FrameHeader_s);
+	sizeCS = sizeof(FrameHeader_s);
+	for(int iCS = 0; iCS < 16; iCS++)
+	{
+		size += fh->csSize[iCS];
+		if(iCS < ix->nCS) { sizeCS += fh->csSize[iCS]; }
+	}
+
+	// A frame cut short by the end of the file (e.g. power lost while recording) ends the file.
+	if((memcmp(fh->strDelimiter, "WAVE HELLO!\n", 12) != 0) || (ix->offset + size > ix->file.size_B))
+	{
+		ix->offset = ix->file.size_B;
+		return;
+	}
+
+	// The frame numbers on either side of a lost frame tell how many were lost with it.
+	if(ix->lost && ix->lastValid && (fh->nFrame > ix->lastFrame + 1 + ix->lost))
+	{
+		nLost = fh->nFrame - ix->lastFrame - 1 - ix->lost;
+		if(nLost > ix->maxFrames - 1 - ix->nFrames) { nLost = ix->maxFrames - 1 - ix->nFrames; }
+		for(u32 i = 0; i < nLost; i++)
+		{
+			ix->index[ix->nFrames].nFile = ix->nFile;
+			ix->index[ix->nFrames].size_B = 0;
+			ix->index[ix->nFrames].offset_B = ix->offset;
+			ix->nFrames++;
+		}
+		ix->nLost += nLost;
+	}
+	ix->lost = 0;
+	ix->lastFrame = fh->nFrame;
+	ix->lastValid = 1;
+
+	ix->index[ix->nFrames].nFile = ix->nFile;
+	ix->index[ix->nFrames].size_B = sizeCS;
+	ix->index[ix->nFrames].offset_B = ix->offset;
+	ix->nFrames++;
+	ix->offset += size;
+}
+
+// A frame whose header can't be read keeps its place in the index, as an entry with no data that readers skip, so
+// frame numbers and seeks still line up. Its size is unknown: the next frame header is searched for from the end of
+// this one. A search block that can't be read is passed over.
+void clipIndexLost(clipIndex_s * ix)
+{
+	if(ix->searching)
+	{
+		ix->offset += ix->length - 11;
+		return;
+	}
+
+	xil_printf("Clip c%04d: read error at frame %d, searching for the next one.\r\n", ix->nClip, ix->nFrames);
+
+	ix->index[ix->nFrames].nFile = ix->nFile;
+	ix->index[ix->nFrames].size_B = 0;
+	ix->index[ix->nFrames].offset_B = ix->offset;
+	ix->nFrames++;
+	ix->nLost++;
+	ix->lost++;
+
+	ix->offset += sizeof(FrameHeader_s);
+	ix->searching = 1;
+}
+
+// Look for a frame delimiter in the search block just read. The next block overlaps this one by 11 bytes, so one that
+// straddles the two is found in the next.
+void clipIndexSearch(clipIndex_s * ix)
+{
+	u8 * block = ix->header + ix->offset % nvmeGetLBASize();
+	u8 * p = block;
+	u8 * end = block + ix->length;
+
+	while((p = memchr(p, 'W', end - p)) != NULL)
+	{
+		if(p + 12 > end) { break; }
+		if(memcmp(p, "WAVE HELLO!\n", 12) == 0)
+		{
+			ix->offset += p - block;
+			ix->searching = 0;
+			return;
+		}
+		p++;
+	}
+
+	ix->offset += ix->length - 11;
+}
@@ -0,0 +1,104 @@
+/*
+WAVE Clip Reader Include
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __CLIP_INCLUDE__
+#define __CLIP_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "main.h"
+#include "fs.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// Clip Reader Status
+#define CLIP_OK                    0
+#define CLIP_ERROR_NOT_FOUND       1
+#define CLIP_ERROR_IO              2
+
+#define CLIP_FILE_INFO             -1            // File number of the clip info file.
+#define CLIP_EXTENTS               1024
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Where a clip file is on the disk, for reading it with direct NVMe commands.
+typedef struct
+{
+	int nClip;					// -1: none loaded.
+	int nFile;					// .kwv file number, or CLIP_FILE_INFO.
+	u64 size_B;
+	u32 count;
+	fsExtent_s extent[CLIP_EXTENTS];
+} clipFile_s;
+
+// 16B Clip Index Entry, one per frame: where its frame header and codestreams are in the clip's .kwv files. A frame
+// whose header could not be read has size_B 0.
+typedef struct __attribute__((packed))
+{
+	u32 nFile;					// .kwv file number.
+	u32 size_B;					// Frame header and the first nCS codestreams in [B].
+	u64 offset_B;				// Offset of the frame header in the file in [B].
+} clipFrameIndex_s;
+
+// Clip index, built from the frame headers a step at a time. The owner sets index, maxFrames, nCS, and header.
+typedef struct
+{
+	clipFrameIndex_s * index;	// Entries.
+	u32 maxFrames;
+	u8 nCS;						// Codestreams counted in each entry's size_B, 1 to 16.
+	u8 * header;				// Frame header and search reads, 64KiB.
+
+	int nClip;
+	u32 nFrames;				// Frames indexed so far.
+	u32 nLost;					// Frames whose header could not be read.
+	u8 complete;
+	u8 status;					// CLIP_OK, or why the index ended early.
+
+	int nFile;					// File being indexed.
+	u64 offset;					// Next frame header in the file being indexed.
+	u8 reading;
+	u16 cid;
+	u16 nCommands;
+	u32 length;					// Bytes being read.
+	u8 retries;					// Failed reads of the current frame header or search block.
+	u8 searching;				// Looking for the next frame header after one that could not be read.
+	u32 lost;					// Frames lost since the last frame header read.
+	u32 lastFrame;				// Frame number of the last frame header read, if lastValid.
+	u8 lastValid;
+	clipFile_s file;
+} clipIndex_s;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+u8 clipOpenFile(clipFile_s * file, int nClip, int nFile);
+void clipForgetFile(clipFile_s * file);
+u16 clipReadStart(const clipFile_s * file, u8 * dest, u64 offset, u32 length);
+
+void clipIndexStart(clipIndex_s * ix, int nClip);
+u8 clipIndexStep(clipIndex_s * ix);
+void clipIndexWait(clipIndex_s * ix);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
@@ -59,6 +59,7 @@ THE SOFTWARE.
 // Private Function Prototypes -----------------------------------------------------------------------------------------
 
 void cmvLinkTrain(void);
+void cmvUpdateTemp(void);
 
 void cmvRegInit(XSpiPs * spiDevice);
 void cmvRegSetMode(XSpiPs * spiDevice);
@@ -113,6 +114,8 @@ u16 cmvRegValInit[] =
 };
 
 CMV_Settings_s CMV_Settings_R;
+
+float cmvTempFiltered = -100.0f;	// Sensor temperature in [C], filtered once per cmvService().
 u8 cmvRegAddrSettings[] = {1,2,66,67,68,71,72,75,76,77,78,79,82,83,84,85,86,87,88,98,106,113,114,115,117,122,127};
 
 // Interrupt Handlers --------------------------------------------------------------------------------------------------
@@ -179,6 +182,8 @@ void cmvService(void)
 			cmvRegWrite(&Spi0, cmvRegAddrSettings[i], *((u16 *)(&CMV_Settings_W) + i));
 		}
 	}
+
+	cmvUpdateTemp();
 }
 
 void cmvApplyCameraState(void)
@@ -328,35 +333,39 @@ void cmvSetVtfl(u8 Vtfl2, u8 Vtfl3)
 	CMV_Settings_W.Vtfl = ((u16)(Vtfl3 & 0x7F) << 7) | (u16)(Vtfl2 & 0x7F);
 }
 
+// Filtered sensor temperature in [C], as of the last cmvService().
 float cmvGetTemp(void)
+{
+	return cmvTempFiltered;
+}
+
+u32 cmvGetExposure(void)
+{
+	// TO-DO: Add a bit flag for three-slope exposure enabled.
+	return ((u32)CMV_Settings_R.Exp_time_H << 16) | (u32)CMV_Settings_R.Exp_time_L;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Step the temperature filter with the sensor register just read. Runs once per frame, from cmvService(), so the
+// time constant doesn't depend on how often the temperature is read.
+void cmvUpdateTemp(void)
 {
 	float cmvDN0 = fhActive.cmvTempDN0;
 	float cmvT0 = fhActive.cmvTempT0;
 	float cmvTSlope = 0.143f;
 
-	static float cmvTf = -100.0f;
-
 	float cmvT = ((float)(CMV_Settings_R.Temp_sensor) - cmvDN0) * cmvTSlope + cmvT0;
-	if(cmvTf == -100.0f)
+	if(cmvTempFiltered == -100.0f)
 	{
-		cmvTf = cmvT;
+		cmvTempFiltered = cmvT;
 	}
 	else
 	{
-		cmvTf = 0.95f * cmvTf + 0.05f * cmvT;
+		cmvTempFiltered = 0.95f * cmvTempFiltered + 0.05f * cmvT;
 	}
-
-	return cmvTf;
 }
 
-u32 cmvGetExposure(void)
-{
-	// TO-DO: Add a bit flag for three-slope exposure enabled.
-	return ((u32)CMV_Settings_R.Exp_time_H << 16) | (u32)CMV_Settings_R.Exp_time_L;
-}
-
-// Private Function Definitions ----------------------------------------------------------------------------------------
-
 // CMV12000 Link Training Routine
 void cmvLinkTrain(void)
 {
@@ -7,10 +7,212 @@
 /* storage control modules to the FatFs module with a defined API.       */
 /*-----------------------------------------------------------------------*/
 
+#include <string.h>
 #include "ff.h"			/* Obtains integer types */
 #include "diskio.h"		/* Declarations of disk functions */
 #include "nvme.h"
 
+/*-----------------------------------------------------------------------*/
+/* Metadata Sector Cache                                                 */
+/*-----------------------------------------------------------------------*/
+/* Single-sector transfers from FatFs' own buffers (FAT, bitmap, and     */
+/* directory windows, partial file sectors) are cached in DDR4. Writes   */
+/* are absorbed and written back later from the cache with write slip,   */
+/* so they no longer drain the codestream write pipeline. Multi-sector   */
+/* transfers bypass the cache.                                           */
+
+#define DISK_IMAGE_DDR_BASE		0x10000000	// Buffers above this are image DDR4, written with slip.
+#define DISK_SLIP_MAX			16			// 1/4 of the IO queue depth.
+#define DISK_CACHE_SLOTS		64
+#define DISK_CACHE_SLOT_SIZE	4096		// FF_MAX_SS
+#define DISK_CACHE_DIRTY_MAX	16			// Write back the oldest dirty sector beyond this.
+
+typedef struct
+{
+	LBA_t sector;
+	DWORD lastUse;
+	u16 cid;			// CID of the write-back, while inFlight.
+	u8 valid;
+	u8 dirty;
+	u8 inFlight;
+} diskCacheSlot_s;
+
+// Cache sector data, 256KiB: 0x10060000 - 0x100A0000.
+u8 * diskCacheData = (u8 *)(0x10060000);
+diskCacheSlot_s diskCacheSlot[DISK_CACHE_SLOTS];
+DWORD diskCacheUseCounter = 0;
+UINT diskCacheDirty = 0;
+
+diskWriteCallback_t diskWriteCallback = NULL;
+
+static void diskWaitSlip(u16 nSlipAllowed)
+{
+	while(nvmeGetIOSlip() > nSlipAllowed)
+	{
+		nvmeServiceIOCompletions(16);
+	}
+}
+
+static u8 * diskCacheSlotData(int i)
+{
+	return diskCacheData + i * DISK_CACHE_SLOT_SIZE;
+}
+
+// Wait for a slot's write-back to complete, so its data can be modified or reused.
+static void diskCacheWait(int i)
+{
+	if(!diskCacheSlot[i].inFlight) { return; }
+
+	while(!nvmeIOCompleted(diskCacheSlot[i].cid))
+	{
+		nvmeServiceIOCompletions(16);
+	}
+	diskCacheSlot[i].inFlight = 0;
+}
+
+static int diskCacheFind(LBA_t sector)
+{
+	for(int i = 0; i < DISK_CACHE_SLOTS; i++)
+	{
+		if(diskCacheSlot[i].valid && (diskCacheSlot[i].sector == sector)) { return i; }
+	}
+
+	return -1;
+}
+
+// Start writing a dirty slot back. Does not wait for completion.
+static DRESULT diskCacheWriteBack(int i)
+{
+	if(diskWriteCallback != NULL) { diskWriteCallback(diskCacheSlot[i].sector, 1); }
+
+	diskCacheSlot[i].cid = nvmeGetIOCID();
+	if(nvmeWrite(diskCacheSlotData(i), (u64) diskCacheSlot[i].sector, 1) != NVME_RW_OK) { return RES_ERROR; }
+
+	diskCacheSlot[i].dirty = 0;
+	diskCacheSlot[i].inFlight = 1;
+	diskCacheDirty--;
+
+	diskWaitSlip(DISK_SLIP_MAX);
+
+	return RES_OK;
+}
+
+static DRESULT diskCacheWriteBackOldest(void)
+{
+	int iOldest = -1;
+
+	for(int i = 0; i < DISK_CACHE_SLOTS; i++)
+	{
+		if(diskCacheSlot[i].dirty && ((iOldest < 0) || (diskCacheSlot[i].lastUse < diskCacheSlot[iOldest].lastUse)))
+		{
+			iOldest = i;
+		}
+	}
+
+	if(iOldest < 0) { return RES_OK; }
+
+	return diskCacheWriteBack(iOldest);
+}
+
+// Write back all dirty slots and wait for every write-back in flight, including older ones, to complete. A sector
+// whose write-back failed is dirty again, for the next flush.
+static DRESULT diskCacheFlush(void)
+{
+	DRESULT res = RES_OK;
+
+	for(int i = 0; i < DISK_CACHE_SLOTS; i++)
+	{
+		if(diskCacheSlot[i].dirty && (diskCacheWriteBack(i) != RES_OK)) { return RES_ERROR; }
+	}
+
+	for(int i = 0; i < DISK_CACHE_SLOTS; i++)
+	{
+		if(!diskCacheSlot[i].inFlight) { continue; }
+
+		if((nvmeWaitCIDRange(diskCacheSlot[i].cid, 1) != NVME_IO_OK) && diskCacheSlot[i].valid)
+		{
+			diskCacheSlot[i].dirty = 1;
+			diskCacheDirty++;
+			res = RES_ERROR;
+		}
+		diskCacheSlot[i].inFlight = 0;
+	}
+
+	return res;
+}
+
+// Get a slot for a new sector: an empty one, else the least recently used clean one.
+// Prefers slots whose write-back has already completed. Writes back the oldest dirty sector if all are dirty.
+static int diskCacheAlloc(LBA_t sector)
+{
+	int iLRU, iLRUIdle;
+
+	while(1)
+	{
+		iLRU = -1;
+		iLRUIdle = -1;
+		for(int i = 0; i < DISK_CACHE_SLOTS; i++)
+		{
+			if(diskCacheSlot[i].inFlight && nvmeIOCompleted(diskCacheSlot[i].cid)) { diskCacheSlot[i].inFlight = 0; }
+			if(diskCacheSlot[i].dirty) { continue; }
+
+			if(!diskCacheSlot[i].valid && !diskCacheSlot[i].inFlight) { iLRUIdle = i; break; }
+			if((iLRU < 0) || (diskCacheSlot[i].lastUse < diskCacheSlot[iLRU].lastUse)) { iLRU = i; }
+			if(!diskCacheSlot[i].inFlight
+			&& ((iLRUIdle < 0) || (diskCacheSlot[i].lastUse < diskCacheSlot[iLRUIdle].lastUse))) { iLRUIdle = i; }
+		}
+
+		if(iLRUIdle >= 0) { iLRU = iLRUIdle; }
+		if(iLRU >= 0) { break; }
+
+		if(diskCacheWriteBackOldest() != RES_OK) { return -1; }
+	}
+
+	diskCacheWait(iLRU);
+	diskCacheSlot[iLRU].sector = sector;
+	diskCacheSlot[iLRU].valid = 1;
+
+	return iLRU;
+}
+
+// Drop cached copies of sectors about to be overwritten by a multi-sector write.
+static void diskCacheInvalidate(LBA_t sector, UINT count)
+{
+	for(int i = 0; i < DISK_CACHE_SLOTS; i++)
+	{
+		if(diskCacheSlot[i].valid && (diskCacheSlot[i].sector >= sector) && (diskCacheSlot[i].sector < sector + count))
+		{
+			// Don't let an older write-back race the new write to the same sector.
+			diskCacheWait(i);
+			if(diskCacheSlot[i].dirty) { diskCacheDirty--; }
+			diskCacheSlot[i].valid = 0;
+			diskCacheSlot[i].dirty = 0;
+		}
+	}
+}
+
+// Copy cached sectors over a multi-sector read. The cache always holds the newest data.
+static void diskCacheOverlay(BYTE *buff, LBA_t sector, UINT count, WORD sizeLBA)
+{
+	for(int i = 0; i < DISK_CACHE_SLOTS; i++)
+	{
+		if(diskCacheSlot[i].valid && (diskCacheSlot[i].sector >= sector) && (diskCacheSlot[i].sector < sector + count))
+		{
+			memcpy(buff + (diskCacheSlot[i].sector - sector) * sizeLBA, diskCacheSlotData(i), sizeLBA);
+		}
+	}
+}
+
+// Forget all cached sectors without writing them back, e.g. when the LBA format or the disk contents have changed
+// outside of FatFs. Anything dirty would be written to the wrong place, so fs.c flushes with CTRL_SYNC before it
+// unmounts. Write-backs already in flight are waited for.
+static void diskCacheReset(void)
+{
+	diskWaitSlip(0);
+	memset(diskCacheSlot, 0, sizeof(diskCacheSlot));
+	diskCacheDirty = 0;
+}
+
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
 /*-----------------------------------------------------------------------*/
@@ -40,7 +242,12 @@ DSTATUS disk_initialize (
 	{
 		nvmeStatus = nvmeInit();
 	}
-	if(nvmeStatus == NVME_OK) { return 0; }
+	if(nvmeStatus == NVME_OK)
+	{
+		// (Re)mount: the disk may have been reformatted or written over USB since the last one.
+		diskCacheReset();
+		return 0;
+	}
 
 	return STA_NOINIT;
 }
@@ -58,19 +265,44 @@ DRESULT disk_read (
 	UINT count		/* Number of sectors to read */
 )
 {
-	// Finish all slipped writes before switching to read.
-	while(nvmeGetIOSlip() > 0)
+	WORD sizeLBA = nvmeGetLBASize();
+	int i = -1;
+
+	// Single sectors into FatFs buffers come from the cache if present.
+	if((count == 1) && ((u64)buff < DISK_IMAGE_DDR_BASE))
 	{
-		nvmeServiceIOCompletions(16);
+		i = diskCacheFind(sector);
+		if(i >= 0)
+		{
+			memcpy(buff, diskCacheSlotData(i), sizeLBA);
+			diskCacheSlot[i].lastUse = ++diskCacheUseCounter;
+			return RES_OK;
+		}
 	}
 
+	// Only slipped writes to the sectors being read must finish first. Other writes keep streaming.
+	nvmeWaitForWrites((u64) sector, count);
+
+	u16 cid = nvmeGetIOCID();
 	int nvmeRWStatus = nvmeRead(buff, (u64) sector, count);
 	if(nvmeRWStatus != NVME_RW_OK) { return RES_ERROR; }
 
-	// No command slip allowed for reading. TO-DO: What about fast reading?
-	while(nvmeGetIOSlip() > 0)
+	// Wait for this read only. A failed read is never cached or handed to FatFs as data.
+	if(nvmeWaitCIDRange(cid, 1) != NVME_IO_OK) { return RES_ERROR; }
+
+	if((count == 1) && ((u64)buff < DISK_IMAGE_DDR_BASE))
 	{
-		nvmeServiceIOCompletions(16);
+		// Cache the sector for the next read-modify-write.
+		i = diskCacheAlloc(sector);
+		if(i >= 0)
+		{
+			memcpy(diskCacheSlotData(i), buff, sizeLBA);
+			diskCacheSlot[i].lastUse = ++diskCacheUseCounter;
+		}
+	}
+	else
+	{
+		diskCacheOverlay(buff, sector, count, sizeLBA);
 	}
 
 	return RES_OK;
@@ -90,21 +322,44 @@ DRESULT disk_write (
 )
 {
 	u8 nSlipAllowed = 0;
+	int i;
+
+	// Single sectors from FatFs buffers are absorbed by the cache and written back later.
+	if((count == 1) && ((u64)buff < DISK_IMAGE_DDR_BASE))
+	{
+		i = diskCacheFind(sector);
+		if(i < 0) { i = diskCacheAlloc(sector); }
+		else { diskCacheWait(i); }
+		if(i < 0) { return RES_ERROR; }
+
+		memcpy(diskCacheSlotData(i), buff, nvmeGetLBASize());
+		diskCacheSlot[i].lastUse = ++diskCacheUseCounter;
+		if(!diskCacheSlot[i].dirty)
+		{
+			diskCacheSlot[i].dirty = 1;
+			diskCacheDirty++;
+		}
+
+		if(diskCacheDirty > DISK_CACHE_DIRTY_MAX) { return diskCacheWriteBackOldest(); }
+
+		return RES_OK;
+	}
+
+	diskCacheInvalidate(sector, count);
+
+	if(diskWriteCallback != NULL) { diskWriteCallback(sector, count); }
 
 	int nvmeRWStatus = nvmeWrite(buff, (u64) sector, count);
 	if(nvmeRWStatus != NVME_RW_OK) { return RES_ERROR; }
 
 	// APPLICATION SPECIFIC: If we're writing from image DDR4, allow write slip
 	// of up to 1/4 of the IO queue depth for high-speed transfer.
-	if((u64)buff > 0x10000000)
+	if((u64)buff > DISK_IMAGE_DDR_BASE)
 	{
-		nSlipAllowed = 16;
+		nSlipAllowed = DISK_SLIP_MAX;
 	}
 
-	while(nvmeGetIOSlip() > nSlipAllowed)
-	{
-		nvmeServiceIOCompletions(16);
-	}
+	diskWaitSlip(nSlipAllowed);
 
 	return RES_OK;
 }
@@ -126,18 +381,17 @@ DRESULT disk_ioctl (
 	switch(cmd)
 	{
 	case CTRL_SYNC:
+		// The FLUSH only covers writes that have completed, so the write-backs must land first.
+		if(diskCacheFlush() != RES_OK) { return RES_ERROR; }
 		nvmeFlush();
 
 		// No command slip allowed for flushing.
-		while(nvmeGetIOSlip() > 0)
-		{
-			nvmeServiceIOCompletions(16);
-		}
+		diskWaitSlip(0);
 
 		return RES_OK;
 	case GET_SECTOR_COUNT:
 		numLBA = nvmeGetLBACount();
-		if((numLBA == 0) || (numLBA > 0x100000000))
+		if(numLBA == 0)
 		{
 			return RES_ERROR;
 		}
@@ -166,3 +420,16 @@ DRESULT disk_ioctl (
 	return RES_PARERR;
 }
 
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Set Write Callback                                                    */
+/*-----------------------------------------------------------------------*/
+
+void diskSetWriteCallback (
+	diskWriteCallback_t callback	/* Called before each write, NULL for none */
+)
+{
+	diskWriteCallback = callback;
+}
@@ -32,6 +32,11 @@ DRESULT disk_read (BYTE pdrv, BYTE* buff, LBA_t sector, UINT count);
 DRESULT disk_write (BYTE pdrv, const BYTE* buff, LBA_t sector, UINT count);
 DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
 
+/* Called with the sectors of every write before it goes to the disk, so */
+/* caches of disk data above this layer can drop what it overwrites.     */
+typedef void (*diskWriteCallback_t)(LBA_t sector, UINT count);
+void diskSetWriteCallback (diskWriteCallback_t callback);
+
 
 /* Disk Status Bits (DSTATUS) */
 
@@ -0,0 +1,266 @@
+/*
+DMA Upload Engine
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "main.h"
+#include "dma.h"
+#include "xil_exception.h"
+#include "xpseudo_asm.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define DMA_QUEUE_SIZE 32
+
+// Channel Interrupt Bits
+#define DMA_IRQ_DONE          0x00000400
+#define DMA_IRQ_ERROR         0x000003F9	// AXI data and descriptor, accounting, byte count and APB errors.
+#define DMA_IRQ_ALL           0x00000FFF
+
+// Channel Control Bits
+#define DMA_CTRL0_OVR_FETCH   0x00000080	// Reset value: simple mode, normal read/write.
+#define DMA_CTRL2_EN          0x00000001
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// ZynqMP GDMA channel registers (UG1087, ZDMA).
+typedef struct
+{
+	u32 errCtrl;			// 0x000
+	u32 reserved0[63];
+	u32 isr;				// 0x100 Interrupt status, write 1 to clear.
+	u32 imr;				// 0x104 Interrupt mask, read only.
+	u32 ien;				// 0x108 Write 1 to unmask.
+	u32 ids;				// 0x10C Write 1 to mask.
+	u32 ctrl0;				// 0x110
+	u32 ctrl1;				// 0x114
+	u32 fci;				// 0x118
+	u32 status;				// 0x11C
+	u32 dataAttr;			// 0x120
+	u32 dscrAttr;			// 0x124
+	u32 srcDscr[4];			// 0x128 Simple mode source: address LSB, address MSB, size, control.
+	u32 dstDscr[4];			// 0x138 Simple mode destination: address LSB, address MSB, size, control.
+	u32 reserved1[16];
+	u32 totalByte;			// 0x188
+	u32 rateCntl;			// 0x18C
+	u32 irqSrcAcct;			// 0x190
+	u32 irqDstAcct;			// 0x194
+	u32 reserved2[26];
+	u32 ctrl2;				// 0x200 Channel enable.
+} DMAChannel_s;
+
+typedef struct
+{
+	u64 dst;
+	u64 src;
+	u32 size;				// Upload size in [B], or 0 for a fence.
+	dmaCallback_t callback;
+	void * ctx;
+} DMAUpload_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void dmaQueue(u64 dst, u64 src, u32 size, dmaCallback_t callback, void * ctx);
+void dmaStartNext(void);
+u32 dmaLock(void);
+void dmaUnlock(u32 daif);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// FPD GDMA Channel 0
+DMAChannel_s * const dmaCh = (DMAChannel_s * const) 0xFD500000;
+
+DMAUpload_s dmaUploads[DMA_QUEUE_SIZE];
+volatile u32 dmaHead = 0;			// Oldest entry, running if dmaRunning is set.
+volatile u32 dmaCount = 0;
+volatile u32 dmaRunning = 0;
+u32 dmaFenceStatus = DMA_OK;		// Status of the uploads since the last fence.
+u32 dmaErrorCount = 0;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+void isrDMA(void * CallbackRef)
+{
+	u32 isr = dmaCh->isr;
+	u32 status;
+	dmaCallback_t callback;
+	void * ctx;
+
+	dmaCh->isr = isr;
+
+	if(!dmaRunning || !(isr & (DMA_IRQ_DONE | DMA_IRQ_ERROR))) { return; }
+
+	if(isr & DMA_IRQ_ERROR)
+	{
+		dmaCh->ctrl2 = 0;
+		dmaErrorCount++;
+		dmaFenceStatus = DMA_ERROR;
+		status = DMA_ERROR;
+	}
+	else
+	{
+		status = DMA_OK;
+	}
+
+	callback = dmaUploads[dmaHead].callback;
+	ctx = dmaUploads[dmaHead].ctx;
+	dmaHead = (dmaHead + 1) % DMA_QUEUE_SIZE;
+	dmaCount--;
+	dmaRunning = 0;
+
+	if(callback) { callback(ctx, status); }
+
+	dmaStartNext();
+}
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+void dmaInit(void)
+{
+	dmaCh->ctrl2 = 0;
+	dmaCh->ids = DMA_IRQ_ALL;
+	dmaCh->isr = DMA_IRQ_ALL;
+
+	// Simple mode, one descriptor pair in the channel registers. The D-Cache is disabled, so no coherency is needed.
+	dmaCh->ctrl0 = DMA_CTRL0_OVR_FETCH;
+	dmaCh->srcDscr[3] = 0;
+	dmaCh->dstDscr[3] = 0;
+
+	dmaCh->ien = DMA_IRQ_DONE | DMA_IRQ_ERROR;
+}
+
+void dmaUpload(void * dst, const void * src, u32 size, dmaCallback_t callback, void * ctx)
+{
+	if(size == 0) { return; }
+
+	dmaQueue((u64) dst, (u64) src, size, callback, ctx);
+}
+
+void dmaFence(dmaCallback_t callback, void * ctx)
+{
+	dmaQueue(0, 0, 0, callback, ctx);
+}
+
+u32 dmaBusy(void)
+{
+	return (dmaCount > 0);
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+void dmaQueue(u64 dst, u64 src, u32 size, dmaCallback_t callback, void * ctx)
+{
+	DMAUpload_s * up;
+	u32 i, first;
+	u32 daif;
+
+	daif = dmaLock();
+
+	// Update a pending upload of the same table, back to the last fence. A fence right behind the same fence is
+	// already there.
+	first = dmaRunning ? 1 : 0;
+	for(i = dmaCount; i > first; i--)
+	{
+		up = &dmaUploads[(dmaHead + i - 1) % DMA_QUEUE_SIZE];
+		if((up->dst == dst) && (up->size == size) && (up->callback == callback) && (up->ctx == ctx))
+		{
+			up->src = src;
+			dmaUnlock(daif);
+			return;
+		}
+		if((up->size == 0) || (size == 0)) { break; }
+	}
+
+	// If the queue is full, service completions by polling, since interrupts are masked.
+	while(dmaCount == DMA_QUEUE_SIZE)
+	{
+		if(dmaCh->isr & (DMA_IRQ_DONE | DMA_IRQ_ERROR)) { isrDMA(NULL); }
+	}
+
+	up = &dmaUploads[(dmaHead + dmaCount) % DMA_QUEUE_SIZE];
+	up->dst = dst;
+	up->src = src;
+	up->size = size;
+	up->callback = callback;
+	up->ctx = ctx;
+	dmaCount++;
+
+	dmaStartNext();
+
+	dmaUnlock(daif);
+}
+
+// Start the oldest upload, running any fences ahead of it. Called with interrupts masked or from isrDMA().
+void dmaStartNext(void)
+{
+	DMAUpload_s * up;
+	dmaCallback_t callback;
+	void * ctx;
+	u32 status;
+
+	while(!dmaRunning && (dmaCount > 0))
+	{
+		up = &dmaUploads[dmaHead];
+
+		if(up->size == 0)
+		{
+			callback = up->callback;
+			ctx = up->ctx;
+			status = dmaFenceStatus;
+			dmaFenceStatus = DMA_OK;
+			dmaHead = (dmaHead + 1) % DMA_QUEUE_SIZE;
+			dmaCount--;
+
+			if(callback) { callback(ctx, status); }
+			continue;
+		}
+
+		dmaCh->srcDscr[0] = (u32)(up->src);
+		dmaCh->srcDscr[1] = (u32)(up->src >> 32);
+		dmaCh->srcDscr[2] = up->size;
+		dmaCh->dstDscr[0] = (u32)(up->dst);
+		dmaCh->dstDscr[1] = (u32)(up->dst >> 32);
+		dmaCh->dstDscr[2] = up->size;
+
+		dmaRunning = 1;
+		dmaCh->ctrl2 = DMA_CTRL2_EN;
+	}
+}
+
+// The queue is shared with isrDMA() and uploads queued from other interrupt handlers, so it is modified with IRQs
+// masked at the CPU. Returns the previous mask state for dmaUnlock().
+u32 dmaLock(void)
+{
+	u32 daif = mfcpsr();
+
+	mtcpsr(daif | XIL_EXCEPTION_IRQ);
+	return daif;
+}
+
+void dmaUnlock(u32 daif)
+{
+	mtcpsr(daif);
+}
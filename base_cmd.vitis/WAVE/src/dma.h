@@ -0,0 +1,64 @@
+/*
+DMA Upload Engine Include
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __DMA_INCLUDE__
+#define __DMA_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// GIC interrupt ID of FPD GDMA channel 0.
+#define DMA_INTR_ID 156
+
+// Upload Status
+#define DMA_OK 0
+#define DMA_ERROR 1
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Upload completion callback. Runs in the DMA interrupt, so it should be short.
+typedef void (*dmaCallback_t)(void * ctx, u32 status);
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+void isrDMA(void * CallbackRef);
+
+void dmaInit(void);
+
+// Queue a copy of size bytes from src to dst. The copy runs in the background, in the order queued, and src must not
+// be modified until it completes. A queued copy that is not yet running is updated instead if the same dst, size and
+// callback are queued again, so repeated uploads of a table only move it once. Can be called from interrupt handlers.
+void dmaUpload(void * dst, const void * src, u32 size, dmaCallback_t callback, void * ctx);
+
+// Queue a callback that runs once everything queued before it has completed. Its status is DMA_ERROR if any of those
+// uploads failed.
+void dmaFence(dmaCallback_t callback, void * ctx);
+
+// Returns 1 while uploads are queued or running.
+u32 dmaBusy(void);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
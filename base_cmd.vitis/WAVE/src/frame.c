@@ -33,6 +33,7 @@ THE SOFTWARE.
 #include "nvme.h"
 #include "camera_state.h"
 #include "hdmi_dark_frame.h"
+#include "usb_vendor.h"
 
 // Private Pre-Processor Definitions -----------------------------------------------------------------------------------
 
@@ -75,6 +76,9 @@ s8 frameTempPL = 0x00;
 s8 frameTempCMV = 0x00;
 s8 frameTempSSD = 0x00;
 
+// Clip catalog entry for the clip being recorded, completed when it closes.
+fsCatalogEntry_s clipCatalogEntry;
+
 // Interrupt Handlers --------------------------------------------------------------------------------------------------
 
 /*
@@ -193,7 +197,9 @@ void frameCreateClip(void)
 	ClipHeader_s clipHeader;
 
 	XGpioPs_WritePin(&Gpio, REC_LED_PIN, 1);
+	nvmeExitStandby();		// SSD back to full power before the first write.
 	fsCreateClip();
+	vendorInvalidate();		// A clip index cached as NOT_FOUND for this clip number is stale.
 
 	// Build the clip header.
 	memcpy(clipHeader.strDelimiter, "WAVE HELLO!\n",12);
@@ -216,12 +222,24 @@ void frameCreateClip(void)
 	clipHeader.hdrKp2Window = 0.005f;
 	memcpy(&clipHeader.cmvSettings, &CMV_Settings_W, sizeof(CMV_Settings_s));
 
+	// Settings for the clip catalog.
+	memset(&clipCatalogEntry, 0, sizeof(fsCatalogEntry_s));
+	clipCatalogEntry.wFrame = clipHeader.wFrame;
+	clipCatalogEntry.hFrame = clipHeader.hFrame;
+	clipCatalogEntry.fps = clipHeader.fps;
+	clipCatalogEntry.shutterAngle = clipHeader.shutterAngle;
+	clipCatalogEntry.colorTemp = clipHeader.colorTemp;
+	clipCatalogEntry.gain = clipHeader.gain;
+
 	// Write the clip header and dark frames to the clip info file.
 	fsWriteClipInfo((u64)(&clipHeader), sizeof(ClipHeader_s));
 	fsWriteClipInfo((u64)dfCold, sizeof(DarkFrame_s));
 	fsWriteClipInfo((u64)dfWarm, sizeof(DarkFrame_s));
 	fsCloseClipInfo();
 
+	// Start a fresh SSD write histogram for this clip.
+	nvmeHistogramReset();
+
 	// Start recording at the current frame.
 	nFramesOutStart = nFramesIn;
 	nFramesOut = nFramesOutStart;
@@ -234,7 +252,21 @@ void frameAddToClip(void)
 
 void frameCloseClip(void)
 {
+	ClipTrailer_s clipTrailer;
+
+	// Append the clip trailer with the SSD write histograms to the clip info file.
+	memset(&clipTrailer, 0, sizeof(ClipTrailer_s));
+	memcpy(clipTrailer.strDelimiter, "WAVE STATS!\n", 12);
+	clipTrailer.nFrames = nFramesOut - nFramesOutStart;
+	memcpy(&clipTrailer.ssdWrite, nvmeGetHistogram(), sizeof(nvmeHistogram_s));
+	fsAppendClipInfo((u64)(&clipTrailer), sizeof(ClipTrailer_s));
+
+	clipCatalogEntry.nFrames = clipTrailer.nFrames;
+	fsCatalogAddClip(&clipCatalogEntry);
+
 	fsCloseClip();
+	vendorInvalidate();		// The clip's files and extents are final.
+	nvmeEnterStandby();		// Let the SSD cool down between takes.
 	XGpioPs_WritePin(&Gpio, REC_LED_PIN, 0);
 }
 
@@ -265,6 +297,7 @@ void frameRecord(void)
 	u32 iFrameOut;
 	u32 csAddrBuffer[16];
 	u32 csSizeBuffer[16];
+	nvmeWindow_s ssdWindow;
 
 	// XGpioPs_WritePin(&Gpio, GPIO2_PIN, 1);		// Mark frame recorder entry.
 
@@ -280,6 +313,12 @@ void frameRecord(void)
 	fhBuffer[iFrameOut].tempCMV = frameTempCMV;
 	fhBuffer[iFrameOut].tempSSD = frameTempSSD;
 
+	// Fill in SSD write telemetry.
+	nvmeGetWriteWindow(&ssdWindow);
+	fhBuffer[iFrameOut].ssdLatencyMax_us = ssdWindow.latencyMax_us;
+	fhBuffer[iFrameOut].ssdQueueDepthMax = ssdWindow.queueDepthMax;
+	fhBuffer[iFrameOut].ssdWrites = ssdWindow.nWrites;
+
 	// Copy the codestream addresses and sizes once to minimize DDR access.
 	memcpy(csAddrBuffer, fhBuffer[iFrameOut].csAddr, 16 * sizeof(u32));
 	memcpy(csSizeBuffer, fhBuffer[iFrameOut].csSize, 16 * sizeof(u32));
@@ -30,6 +30,7 @@ THE SOFTWARE.
 #include "main.h"
 #include "hdmi_lut1d.h"
 #include "cmv12000.h"
+#include "nvme.h"
 
 // Public Pre-Processor Definitions ------------------------------------------------------------------------------------
 
@@ -99,10 +100,24 @@ typedef struct __attribute__((packed))
 	s8 tempCMV;					// Image sensor temperature in [C].
 	s8 tempSSD;					// SSD temperature in [C].
 
-	// Padding [284B];
-	u8 reserved2[284];			// Reserved.
+	// SSD Write Telemetry [8B], covering writes completed since the previous frame header was written.
+	u32 ssdLatencyMax_us;		// Max SSD write command latency in [us].
+	u16 ssdQueueDepthMax;		// Max SSD I/O commands outstanding at write submission.
+	u16 ssdWrites;				// SSD write commands completed.
+
+	// Padding [276B];
+	u8 reserved2[276];			// Reserved.
 } FrameHeader_s;
 
+// 512B Clip Trailer Structure, appended to the clip info file when the clip is closed.
+typedef struct __attribute__((packed))
+{
+	char strDelimiter[12];		// Trailer delimiter, always "WAVE STATS!\n"
+	u32 nFrames;				// Number of frames recorded.
+	nvmeHistogram_s ssdWrite;	// SSD write command histograms for the whole clip [244B].
+	u8 reserved0[252];			// Reserved.
+} ClipTrailer_s;
+
 // Public Function Prototypes ------------------------------------------------------------------------------------------
 
 void frameInit(void);
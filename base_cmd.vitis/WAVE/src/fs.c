@@ -24,19 +24,46 @@ THE SOFTWARE.
 
 // Include Headers -----------------------------------------------------------------------------------------------------
 
+#include <string.h>
 #include "fs.h"
 #include "ff.h"
+#include "frame.h"
+#include "nvme.h"
+#include "diskio.h"
 #include "xrtcpsu.h"
 
 // Private Pre-Processor Definitions -----------------------------------------------------------------------------------
 
 #define RTC_DEVICE_ID              XPAR_XRTCPSU_0_DEVICE_ID
+#define FS_AU_SIZE                 0x100000      // exFAT cluster size: 1MiB, fewer bitmap updates per file.
+#define FS_FILE_RESERVE            0x100000000   // Contiguous free space to look for ahead of each file.
+#define FS_CLMT_SIZE               0x4000        // Cluster link map table size in DWORDs: 2 per fragment, plus 2.
+#define FS_CATALOG_PATH            "/clips.kwc"
 
 // Private Type Definitions --------------------------------------------------------------------------------------------
 
+// 512B Clip Catalog Header, followed by nEntries fsCatalogEntry_s.
+typedef struct __attribute__((packed))
+{
+	char strDelimiter[12];		// Catalog delimiter, always "WAVE CLIPS!\n"
+	u32 nClipNext;				// Next clip number to create.
+	u32 nEntries;				// Number of catalog entries following the header.
+	u8 reserved[492];			// Reserved.
+} fsCatalogHeader_s;
+
 // Private Function Prototypes -----------------------------------------------------------------------------------------
 
 void fsUpdateFreeSizeGB(void);
+void fsCatalogLoad(void);
+void fsCatalogCreate(u32 nClipNext);
+void fsCatalogWriteHeader(void);
+u8 fsCatalogAppend(fsCatalogEntry_s * entry);
+u8 fsCatalogInsert(fsCatalogEntry_s * entry);
+u8 fsCatalogWriteEntry(u32 i, fsCatalogEntry_s * entry);
+void fsCatalogScan(void);
+FRESULT fsCatalogScanClip(u32 nClipScan, fsCatalogEntry_s * entry);
+u8 fsClipExists(u32 nClipCheck);
+int fsOpenRead(const char * path);
 
 // Public Global Variables ---------------------------------------------------------------------------------------------
 
@@ -49,6 +76,13 @@ int nClip = -1;
 FATFS fs;
 FIL fil;
 FIL filClipInfo;
+FIL filRead;
+FIL filCatalog;
+fsCatalogHeader_s catalogHeader;
+u64 clipSize_B = 0;
+
+// Cluster link map table for the clip file open for reading, 64KiB.
+DWORD * clmtRead = (DWORD *)(0x10050000);
 
 int nFile = 0;
 u32 fsFreeGB = 0;
@@ -74,22 +108,33 @@ void fsInit(void)
 	if(res) { xil_printf("SSD mount failed.\r\n"); }
 	else { xil_printf("SSD mount successful.\r\n"); }
 
+	fsCatalogLoad();
 	nClip = fsGetNextClip();
 }
 
-void fsFormat(void)
+void fsFormat(u8 optimizeLBA)
 {
 	FRESULT res;
 	MKFS_PARM opt;
 	BYTE work[FF_MAX_SS];
 
+	// Write back the sector cache while the old LBA format is still in place. It is dropped on remount.
+	disk_ioctl(0, CTRL_SYNC, 0);
 	f_mount(0, "", 0);
 
-	opt.fmt = FM_FAT32;
-	opt.au_size = 0x10000;
+	// Optionally switch the namespace to its best-performing LBA format (usually 4KiB) before building the FAT.
+	if(optimizeLBA)
+	{
+		if(nvmeSelectBestLBAFormat() != NVME_OK) { xil_printf("SSD LBA format change failed.\r\n"); }
+		xil_printf("SSD LBA size: %dB.\r\n", nvmeGetLBASize());
+	}
+
+	// exFAT with 64-bit LBAs: whole drive usable above 2TiB, no 4GiB file limit, contiguous files without FAT chains.
+	opt.fmt = FM_EXFAT;
+	opt.au_size = FS_AU_SIZE;
 	opt.align = 1;
 	opt.n_fat = 1;
-	opt.n_root = 512;
+	opt.n_root = 0;
 	res = f_mkfs("", &opt, work, sizeof work);
 	if(res) { xil_printf("SSD format failed.\r\n"); }
 	else { xil_printf("SSD format successful.\r\n"); }
@@ -98,32 +143,16 @@ void fsFormat(void)
 	if(res) { xil_printf("SSD mount failed.\r\n"); }
 	else { xil_printf("SSD mount successful.\r\n"); }
 
-	fsGetNextClip();
+	fsCatalogCreate(0);
+	nClip = fsGetNextClip();
 }
 
+// Next clip number, from the catalog loaded at mount. Constant time, no directory access.
 u32 fsGetNextClip(void)
 {
-	FRESULT fr;
-	DIR dirWork;
-	FILINFO fInfo;
-	char strWorking[8];
-	int nClipNext = 0;
-
-	sprintf(strWorking, "c%04d", nClipNext);
-	fr = f_opendir(&dirWork, "");
-
-	fr = f_findfirst(&dirWork, &fInfo, "", strWorking);
-
-	while((fr == FR_OK) && fInfo.fname[0])
-	{
-		nClipNext++;
-		sprintf(strWorking, "c%04d", nClipNext);
-		fr = f_findfirst(&dirWork, &fInfo, "", strWorking);
-	}
-
 	fsUpdateFreeSizeGB();
 
-	return nClipNext;
+	return catalogHeader.nClipNext;
 }
 
 void fsCreateClip(void)
@@ -138,6 +167,12 @@ void fsCreateClip(void)
 	if(res) { xil_printf("Warning: New clip creation failed.\r\n"); }
 	else { xil_printf("Created new clip.\r\n"); }
 
+	// Claim the clip number in the catalog right away, so it stays consistent with the directory if recording
+	// is interrupted.
+	catalogHeader.nClipNext = nClip + 1;
+	fsCatalogWriteHeader();
+	clipSize_B = 0;
+
 	// Create and open the clip info file.
 	sprintf(strWorking, "/c%04d/c%04d.kwi", nClip, nClip);
 	res = f_open(&filClipInfo, strWorking, FA_CREATE_NEW | FA_WRITE);
@@ -157,6 +192,23 @@ void fsCloseClipInfo(void)
 	f_close(&filClipInfo);
 }
 
+// Reopen the current clip's info file and append to it. Must be called before fsCloseClip().
+void fsAppendClipInfo(u64 srcAddress, u32 size)
+{
+	FRESULT res;
+	UINT bw;
+	char strWorking[32];
+
+	sprintf(strWorking, "/c%04d/c%04d.kwi", nClip, nClip);
+	res = f_open(&filClipInfo, strWorking, FA_OPEN_APPEND | FA_WRITE);
+	if(res == FR_OK)
+	{
+		res = f_write(&filClipInfo, (u8 *) srcAddress, size, &bw);
+		f_close(&filClipInfo);
+	}
+	(void) res;
+}
+
 void fsCreateFile(void)
 {
 	FRESULT res;
@@ -171,7 +223,11 @@ void fsCreateFile(void)
 
 	sprintf(strWorking, "/c%04d/f%06d.kwv", nClip, nFile);
 	res = f_open(&fil, strWorking, FA_CREATE_NEW | FA_WRITE);
-	res = f_expand(&fil, 0x1000000, 1);		// Reserve 16MiB.
+
+	// Point the cluster allocator at a contiguous free run large enough for the whole file, without allocating it.
+	// On exFAT a file that grows contiguously keeps the NoFatChain flag, so writes never touch the FAT. Allocating
+	// up front instead would make every partial-sector write below the file size a read-modify-write.
+	res = f_expand(&fil, FS_FILE_RESERVE, 0);
 
 	nFile++;
 
@@ -184,6 +240,7 @@ void fsWriteFile(u64 srcAddress, u32 size)
 	UINT bw;
 
 	res = f_write(&fil, (u8 *) srcAddress, size, &bw);
+	clipSize_B += bw;
 	(void) res;
 }
 
@@ -197,27 +254,417 @@ void fsCloseClip(void)
 	nFile = 0;
 }
 
+// Append a closed clip to the catalog. The caller fills in frame count and settings. Must be called before
+// fsCloseClip(), while nClip and nFile still refer to the clip being closed.
+void fsCatalogAddClip(fsCatalogEntry_s * entry)
+{
+	entry->nClip = nClip;
+	entry->nFiles = nFile;
+	entry->size_B = clipSize_B;
+
+	if(fsCatalogAppend(entry)) { fsCatalogWriteHeader(); }
+}
+
+u32 fsCatalogGetCount(void)
+{
+	return catalogHeader.nEntries;
+}
+
+// Read up to maxEntries catalog entries, starting at entry first. Returns the number read.
+u32 fsCatalogRead(fsCatalogEntry_s * entries, u32 first, u32 maxEntries)
+{
+	FRESULT res;
+	UINT br;
+
+	if(first >= catalogHeader.nEntries) { return 0; }
+	if(maxEntries > catalogHeader.nEntries - first) { maxEntries = catalogHeader.nEntries - first; }
+
+	res = f_lseek(&filCatalog, sizeof(fsCatalogHeader_s) + (FSIZE_t) first * sizeof(fsCatalogEntry_s));
+	if(res == FR_OK) { res = f_read(&filCatalog, entries, maxEntries * sizeof(fsCatalogEntry_s), &br); }
+	if(res != FR_OK) { return 0; }
+
+	return br / sizeof(fsCatalogEntry_s);
+}
+
+// Open a clip file for reading with a cluster link map table, so seeks cost the same at any file offset.
+// Returns 0 if the file was opened. A file too fragmented for the table falls back to walking the FAT chain.
+int fsOpenClipFile(int nClipRead, int nFileRead)
+{
+	char strWorking[32];
+
+	sprintf(strWorking, "/c%04d/f%06d.kwv", nClipRead, nFileRead);
+	return fsOpenRead(strWorking);
+}
+
+// Open a clip's info file (clip header, dark frames, trailer) for reading, as fsOpenClipFile().
+int fsOpenClipInfoFile(int nClipRead)
+{
+	char strWorking[32];
+
+	sprintf(strWorking, "/c%04d/c%04d.kwi", nClipRead, nClipRead);
+	return fsOpenRead(strWorking);
+}
+
+u64 fsGetClipFileSize(void)
+{
+	return f_size(&filRead);
+}
+
+// Describe where the clip file open for reading is on the disk, from its cluster link map table, so it can be read
+// with direct NVMe commands. Returns the number of extents, or 0 if there is no table or more than maxExtents.
+u32 fsGetClipFileExtents(fsExtent_s * extents, u32 maxExtents)
+{
+	DWORD * tbl;
+	u64 sizeCluster;
+	u64 offset = 0;
+	u32 n = 0;
+
+	if(!filRead.obj.fs || !filRead.cltbl) { return 0; }
+
+	sizeCluster = (u64) fs.csize * fs.ssize;
+
+	// Table entries after the size: pairs of cluster count and first cluster, terminated by 0.
+	tbl = filRead.cltbl + 1;
+	while((tbl[0] != 0) && (offset < f_size(&filRead)))
+	{
+		if(n == maxExtents) { return 0; }
+
+		extents[n].offset_B = offset;
+		extents[n].size_B = tbl[0] * sizeCluster;
+		if(offset + extents[n].size_B > f_size(&filRead)) { extents[n].size_B = f_size(&filRead) - offset; }
+		extents[n].lba = fs.database + (LBA_t)(tbl[1] - 2) * fs.csize;
+
+		offset += extents[n].size_B;
+		n++;
+		tbl += 2;
+	}
+
+	return n;
+}
+
+int fsSeekClipFile(u64 offset)
+{
+	return f_lseek(&filRead, offset);
+}
+
+int fsReadClipFile(u64 destAddress, u32 size)
+{
+	FRESULT res;
+	UINT br;
+
+	res = f_read(&filRead, (u8 *) destAddress, size, &br);
+	if((res == FR_OK) && (br != size)) { res = FR_DENIED; }
+
+	return res;
+}
+
+// Open any file for reading, as fsOpenClipFile(). Closed with fsCloseClipFile().
+int fsOpenFile(const char * path)
+{
+	return fsOpenRead(path);
+}
+
+// Read up to size bytes from the file open for reading. Fewer are read only at the end of the file.
+int fsReadFile(u8 * dest, u32 size, u32 * bytesRead)
+{
+	FRESULT res;
+	UINT br = 0;
+
+	res = f_read(&filRead, dest, size, &br);
+	*bytesRead = br;
+
+	return res;
+}
+
+void fsCloseClipFile(void)
+{
+	if(filRead.obj.fs) { f_close(&filRead); }
+	filRead.cltbl = 0;
+}
+
 void fsDeinit(void)
 {
 	FRESULT res;
 
+	fsCloseClipFile();
+	f_close(&filCatalog);
+
 	res = f_truncate(&fil);
 	res = f_close(&fil);
+
+	// Write back the sector cache before the disk is exposed over USB. It is dropped on remount.
+	disk_ioctl(0, CTRL_SYNC, 0);
 	res = f_mount(0, "", 0);
 	(void) res;
 }
 
 // Private Function Definitions ----------------------------------------------------------------------------------------
 
+// Open the clip catalog and check it against the directory: the last claimed clip must exist and the next one
+// must not. Costs two lookups instead of one per clip. If the catalog is missing, shorter than its header says, or
+// the check fails (e.g. clips deleted over USB), it is rebuilt from the clips on disk. A claimed clip with no entry
+// was cut short before frameCloseClip() (e.g. by power loss), and gets one from the clip on disk.
+void fsCatalogLoad(void)
+{
+	fsCatalogEntry_s entry;
+	FRESULT res;
+	UINT br;
+
+	res = f_open(&filCatalog, FS_CATALOG_PATH, FA_READ | FA_WRITE);
+	if(res == FR_OK)
+	{
+		res = f_read(&filCatalog, &catalogHeader, sizeof(fsCatalogHeader_s), &br);
+		if((res != FR_OK) || (br != sizeof(fsCatalogHeader_s))
+		|| (memcmp(catalogHeader.strDelimiter, "WAVE CLIPS!\n", 12) != 0)
+		|| (catalogHeader.nEntries > catalogHeader.nClipNext)
+		|| (f_size(&filCatalog) < sizeof(fsCatalogHeader_s)
+		                          + (FSIZE_t) catalogHeader.nEntries * sizeof(fsCatalogEntry_s)))
+		{
+			f_close(&filCatalog);
+			res = FR_NO_FILE;
+		}
+	}
+
+	if(res != FR_OK)
+	{
+		xil_printf("Creating clip catalog.\r\n");
+		fsCatalogCreate(0);
+		fsCatalogScan();
+		return;
+	}
+
+	if(((catalogHeader.nClipNext == 0) || fsClipExists(catalogHeader.nClipNext - 1))
+	&& !fsClipExists(catalogHeader.nClipNext))
+	{
+		if((catalogHeader.nClipNext == 0) || (catalogHeader.nEntries == 0)
+		|| (fsCatalogRead(&entry, catalogHeader.nEntries - 1, 1) == 1))
+		{
+			if((catalogHeader.nClipNext > 0)
+			&& ((catalogHeader.nEntries == 0) || (entry.nClip != catalogHeader.nClipNext - 1))
+			&& (fsCatalogScanClip(catalogHeader.nClipNext - 1, &entry) == FR_OK))
+			{
+				xil_printf("Adding interrupted clip to catalog.\r\n");
+				if(fsCatalogAppend(&entry)) { fsCatalogWriteHeader(); }
+			}
+			return;
+		}
+	}
+
+	xil_printf("Rebuilding clip catalog.\r\n");
+	f_close(&filCatalog);
+	fsCatalogCreate(0);
+	fsCatalogScan();
+}
+
+// Start a new, empty catalog.
+void fsCatalogCreate(u32 nClipNext)
+{
+	FRESULT res;
+
+	memset(&catalogHeader, 0, sizeof(fsCatalogHeader_s));
+	memcpy(catalogHeader.strDelimiter, "WAVE CLIPS!\n", 12);
+	catalogHeader.nClipNext = nClipNext;
+	catalogHeader.nEntries = 0;
+
+	res = f_open(&filCatalog, FS_CATALOG_PATH, FA_CREATE_ALWAYS | FA_READ | FA_WRITE);
+	if(res == FR_OK) { fsCatalogWriteHeader(); }
+}
+
+void fsCatalogWriteHeader(void)
+{
+	FRESULT res;
+	UINT bw;
+
+	res = f_lseek(&filCatalog, 0);
+	if(res == FR_OK) { res = f_write(&filCatalog, &catalogHeader, sizeof(fsCatalogHeader_s), &bw); }
+	if(res == FR_OK) { res = f_sync(&filCatalog); }
+	(void) res;
+}
+
+// Write an entry after the last one. The caller writes the header. Returns 1 if the entry was written.
+u8 fsCatalogAppend(fsCatalogEntry_s * entry)
+{
+	if(!fsCatalogWriteEntry(catalogHeader.nEntries, entry)) { return 0; }
+
+	catalogHeader.nEntries++;
+	return 1;
+}
+
+// Write an entry in clip order, moving the entries of later clips up one. Clip folders are usually listed in the
+// order they were created, so this is an append unless a deleted clip's directory entries were reused. The caller
+// writes the header. Returns 1 if the entry was written.
+u8 fsCatalogInsert(fsCatalogEntry_s * entry)
+{
+	fsCatalogEntry_s entryLater;
+	u32 i = catalogHeader.nEntries;
+
+	while((i > 0) && (fsCatalogRead(&entryLater, i - 1, 1) == 1) && (entryLater.nClip > entry->nClip))
+	{
+		if(!fsCatalogWriteEntry(i, &entryLater)) { return 0; }
+		i--;
+	}
+	if(!fsCatalogWriteEntry(i, entry)) { return 0; }
+
+	catalogHeader.nEntries++;
+	return 1;
+}
+
+u8 fsCatalogWriteEntry(u32 i, fsCatalogEntry_s * entry)
+{
+	FRESULT res;
+	UINT bw;
+
+	res = f_lseek(&filCatalog, sizeof(fsCatalogHeader_s) + (FSIZE_t) i * sizeof(fsCatalogEntry_s));
+	if(res == FR_OK) { res = f_write(&filCatalog, entry, sizeof(fsCatalogEntry_s), &bw); }
+
+	return (res == FR_OK) && (bw == sizeof(fsCatalogEntry_s));
+}
+
+// Fill an empty catalog from the clips on disk, in one pass over the root directory. Each clip folder gets its entry
+// as it is listed, so clip numbers with no folder are never looked up, and the next clip number is one past the last.
+void fsCatalogScan(void)
+{
+	fsCatalogEntry_s entry;
+	FRESULT res;
+	DIR dirWork;
+	FILINFO fInfo;
+	u32 nClipNext = 0;
+	u32 nClipFound;
+
+	res = f_opendir(&dirWork, "");
+	while(res == FR_OK)
+	{
+		res = f_readdir(&dirWork, &fInfo);
+		if((res != FR_OK) || (fInfo.fname[0] == 0)) { break; }
+
+		// Clip folders are named cNNNN.
+		if((fInfo.fattrib & AM_DIR) && (fInfo.fname[0] == 'c') && (strlen(fInfo.fname) == 5)
+		&& (strspn(fInfo.fname + 1, "0123456789") == 4))
+		{
+			nClipFound = atoi(fInfo.fname + 1);
+			if(nClipFound >= nClipNext) { nClipNext = nClipFound + 1; }
+			if(fsCatalogScanClip(nClipFound, &entry) == FR_OK) { fsCatalogInsert(&entry); }
+		}
+	}
+	f_closedir(&dirWork);
+
+	catalogHeader.nClipNext = nClipNext;
+	fsCatalogWriteHeader();
+}
+
+// Catalog entry of a clip on disk: file count and size from its directory, settings from its clip header, frame size
+// from its first frame header, and frame count from its trailer. A clip without a trailer is marked incomplete.
+FRESULT fsCatalogScanClip(u32 nClipScan, fsCatalogEntry_s * entry)
+{
+	FRESULT res;
+	DIR dirWork;
+	FILINFO fInfo;
+	char strWorking[32];
+	union
+	{
+		ClipHeader_s clip;
+		FrameHeader_s frame;
+		ClipTrailer_s trailer;
+	} header;
+
+	memset(entry, 0, sizeof(fsCatalogEntry_s));
+	entry->nClip = nClipScan;
+	entry->flags = FS_CLIP_INCOMPLETE;
+
+	// Clip files are named fNNNNNN.kwv.
+	sprintf(strWorking, "/c%04d", (int) nClipScan);
+	res = f_opendir(&dirWork, strWorking);
+	if(res != FR_OK) { return res; }
+	while(1)
+	{
+		res = f_readdir(&dirWork, &fInfo);
+		if((res != FR_OK) || (fInfo.fname[0] == 0)) { break; }
+
+		if(!(fInfo.fattrib & AM_DIR) && (fInfo.fname[0] == 'f') && (strlen(fInfo.fname) == 11)
+		&& (strspn(fInfo.fname + 1, "0123456789") == 6) && (strcmp(fInfo.fname + 7, ".kwv") == 0))
+		{
+			entry->nFiles++;
+			entry->size_B += fInfo.fsize;
+		}
+	}
+	f_closedir(&dirWork);
+
+	// Clip header at the start of the clip info file, trailer at its end. The file is read through filRead, which
+	// is not in use while the catalog is loaded at mount.
+	if(fsOpenClipInfoFile(nClipScan) == FR_OK)
+	{
+		if((fsReadClipFile((u64) &header, sizeof(ClipHeader_s)) == FR_OK)
+		&& (memcmp(header.clip.strDelimiter, "WAVE HELLO!\n", 12) == 0))
+		{
+			entry->wFrame = header.clip.wFrame;
+			entry->hFrame = header.clip.hFrame;
+			entry->fps = header.clip.fps;
+			entry->shutterAngle = header.clip.shutterAngle;
+			entry->colorTemp = header.clip.colorTemp;
+			entry->gain = header.clip.gain;
+		}
+
+		if((fsGetClipFileSize() >= sizeof(ClipHeader_s) + sizeof(ClipTrailer_s))
+		&& (fsSeekClipFile(fsGetClipFileSize() - sizeof(ClipTrailer_s)) == FR_OK)
+		&& (fsReadClipFile((u64) &header, sizeof(ClipTrailer_s)) == FR_OK)
+		&& (memcmp(header.trailer.strDelimiter, "WAVE STATS!\n", 12) == 0))
+		{
+			entry->nFrames = header.trailer.nFrames;
+			entry->flags &= ~FS_CLIP_INCOMPLETE;
+		}
+	}
+
+	// Frame size as recorded, from the first frame header.
+	if((fsOpenClipFile(nClipScan, 0) == FR_OK)
+	&& (fsReadClipFile((u64) &header, sizeof(FrameHeader_s)) == FR_OK)
+	&& (memcmp(header.frame.strDelimiter, "WAVE HELLO!\n", 12) == 0))
+	{
+		entry->wFrame = header.frame.wFrame;
+		entry->hFrame = header.frame.hFrame;
+	}
+	fsCloseClipFile();
+
+	return FR_OK;
+}
+
+u8 fsClipExists(u32 nClipCheck)
+{
+	FILINFO fInfo;
+	char strWorking[8];
+
+	sprintf(strWorking, "c%04d", (int) nClipCheck);
+
+	return (f_stat(strWorking, &fInfo) == FR_OK);
+}
+
 void fsUpdateFreeSizeGB(void)
 {
 	FATFS *fsLocal;
 	FRESULT res;
-	u32 nFreeClusters = 0;
+	DWORD nFreeClusters = 0;
+	u64 szCluster = (u64) fs.csize * fs.ssize;
 
-	fsSizeGB = (fs.n_fatent - 2) / 15259;
+	fsSizeGB = (u32)(((u64)(fs.n_fatent - 2) * szCluster) / 1000000000);
 
 	res = f_getfree("", &nFreeClusters, &fsLocal);
-	if(res == FR_OK) { fsFreeGB = nFreeClusters / 15259; }
+	if(res == FR_OK) { fsFreeGB = (u32)(((u64) nFreeClusters * szCluster) / 1000000000); }
 	else { fsFreeGB = 0; }
 }
+
+// Open a file as filRead, with a cluster link map table if the file is not too fragmented for it.
+int fsOpenRead(const char * path)
+{
+	FRESULT res;
+
+	fsCloseClipFile();
+
+	res = f_open(&filRead, path, FA_READ);
+	if(res != FR_OK) { return res; }
+
+	clmtRead[0] = FS_CLMT_SIZE;
+	filRead.cltbl = clmtRead;
+	res = f_lseek(&filRead, CREATE_LINKMAP);
+	if(res != FR_OK) { filRead.cltbl = 0; }
+
+	return FR_OK;
+}
@@ -31,19 +31,61 @@ THE SOFTWARE.
 
 // Public Pre-Processor Definitions ------------------------------------------------------------------------------------
 
+// Clip catalog entry flags.
+#define FS_CLIP_INCOMPLETE         0x01          // No clip trailer, e.g. power was lost while recording.
+
 // Public Type Definitions ---------------------------------------------------------------------------------------------
 
+// 64B Clip Catalog Entry, one per clip in /clips.kwc.
+typedef struct __attribute__((packed))
+{
+	u32 nClip;					// Clip number.
+	u32 nFiles;					// Number of .kwv files in the clip.
+	u32 nFrames;				// Number of frames recorded, from the clip trailer (0 if incomplete).
+	u32 reserved0;				// Reserved.
+	u64 size_B;					// Total size of the .kwv files in [B].
+	u16 wFrame;					// Frame width in [px].
+	u16 hFrame;					// Frame height in [px].
+	float fps;					// Target capture frame rate in [fps].
+	float shutterAngle;			// Target shutter angle in [deg].
+	float colorTemp;			// Color temperature hint in [K].
+	u8 gain;					// Enumerated gain setting (0: Linear, 1: HDR).
+	u8 flags;					// Clip flags (FS_CLIP_INCOMPLETE).
+	u8 reserved1[22];			// Reserved.
+} fsCatalogEntry_s;
+
+// Run of consecutive LBAs holding bytes [offset_B, offset_B + size_B) of the clip file open for reading.
+typedef struct
+{
+	u64 offset_B;				// File offset in [B].
+	u64 size_B;					// Extent size in [B].
+	u64 lba;					// First LBA.
+} fsExtent_s;
+
 // Public Function Prototypes ------------------------------------------------------------------------------------------
 
 void fsInit(void);
-void fsFormat(void);
+void fsFormat(u8 optimizeLBA);
 u32 fsGetNextClip(void);
 void fsCreateClip(void);
 void fsWriteClipInfo(u64 srcAddress, u32 size);
 void fsCloseClipInfo(void);
+void fsAppendClipInfo(u64 srcAddress, u32 size);
 void fsCreateFile(void);
 void fsWriteFile(u64 srcAddress, u32 size);
 void fsCloseClip(void);
+void fsCatalogAddClip(fsCatalogEntry_s * entry);
+u32 fsCatalogGetCount(void);
+u32 fsCatalogRead(fsCatalogEntry_s * entries, u32 first, u32 maxEntries);
+int fsOpenClipFile(int nClipRead, int nFileRead);
+int fsOpenClipInfoFile(int nClipRead);
+u64 fsGetClipFileSize(void);
+u32 fsGetClipFileExtents(fsExtent_s * extents, u32 maxExtents);
+int fsSeekClipFile(u64 offset);
+int fsReadClipFile(u64 destAddress, u32 size);
+int fsOpenFile(const char * path);
+int fsReadFile(u8 * dest, u32 size, u32 * bytesRead);
+void fsCloseClipFile(void);
 void fsDeinit(void);
 
 // Externed Public Global Variables ------------------------------------------------------------------------------------
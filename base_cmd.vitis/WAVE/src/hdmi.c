@@ -29,11 +29,14 @@ THE SOFTWARE.
 #include "hdmi_dark_frame.h"
 #include "hdmi_lut1d.h"
 #include "hdmi_lut3d.h"
+#include "dma.h"
 #include "gpio.h"
 #include "frame.h"
 #include "xiicps.h"
 #include "camera_state.h"
 #include "cmv12000.h"
+#include "playback.h"
+#include "scope.h"
 #include <math.h>
 
 // Private Pre-Processor Definitions -----------------------------------------------------------------------------------
@@ -58,6 +61,11 @@ THE SOFTWARE.
 #define HDMI_CTRL_M00_AXI_ARM                 0x10000000
 #define HDMI_CTRL_VSYNC_IF					  0x00010000
 
+// HDMI Focus Peaking Register Bitfield
+#define HDMI_PEAK_THR_MASK                    0x00000FFF
+#define HDMI_PEAK_BANDS_POS                   12
+#define HDMI_PEAK_EN                          0x00008000
+
 // Private Type Definitions --------------------------------------------------------------------------------------------
 
 typedef struct
@@ -109,11 +117,32 @@ typedef struct
 	u32 SS;							// 4K/2K switch.
 	// Slave Reg 20
 	u32 ui_control;		// Top, bottom, and pop-up UI control.
+	// Slave Reg 21
+	u32 peak_control;	// Focus peaking threshold [11:0], subbands [14:12], and enable [15].
+	// Slave Reg 22
+	u32 peak_color;		// Focus peaking color, 0xRRGGBB.
 } HDMI_s;
 
+// Inputs of the stages built by the last hdmiApplyCameraState().
+typedef struct
+{
+	u8 val[CSTATE_NUM_SETTINGS];
+	float fVal[CSTATE_NUM_SETTINGS];
+	float wFrame;
+	float hFrame;
+	u32 oetf;
+	u32 valid;
+} HDMIAppliedState_s;
+
 // Private Function Prototypes -----------------------------------------------------------------------------------------
 
 void hdmiApplyCameraStateSync(void);
+void hdmiUploadDone(void * ctx, u32 status);
+u32 hdmiDirtyStages(float wFrame, float hFrame);
+void hdmiApplyViewport(float wFrame, float hFrame);
+void hdmiApplyPeaking(u16 threshold, u8 bands, u32 color);
+void hdmiStageTime(u32 stage, XTime tStart);
+u32 hdmiStageIndex(u32 stage);
 void hdmiI2CWriteMasked(u8 addr, u8 data, u8 mask);
 void hdmiWriteTestPattern4K(void);
 void hdmiWriteTestPattern2K(void);
@@ -124,6 +153,9 @@ void hdmiPushTestPatternBits(u16 data, u8 count);
 
 u32 hdmiActive = 0;
 
+// Time taken by each stage the last time it was rebuilt, in [us]. Uploads run after this, in the background.
+u32 hdmiStageTime_us[HDMI_STAGES];
+
 // Private Global Variables --------------------------------------------------------------------------------------------
 
 HDMI_s * const hdmi = (HDMI_s * const) 0xA0100000;
@@ -138,22 +170,47 @@ s32 hdmiFrame = -1;
 HDMI_s hdmiSync;
 u32 hdmiApplyCameraStateSyncFlag = 0;
 
+HDMIAppliedState_s hdmiApplied;
+volatile u32 hdmiUploadRetry = 0;		// Stages whose upload failed, rebuilt by hdmiService().
+
+// Stages that depend on each camera setting.
+const u32 hdmiSettingStages[CSTATE_NUM_SETTINGS] =
+{
+	[CSETTING_WIDTH] = HDMI_STAGE_VIEWPORT | HDMI_STAGE_DARK_FRAME,
+	[CSETTING_HEIGHT] = HDMI_STAGE_VIEWPORT | HDMI_STAGE_DARK_FRAME,
+	[CSETTING_COLOR] = HDMI_STAGE_LUT1D,
+	[CSETTING_GAIN] = HDMI_STAGE_DARK_FRAME | HDMI_STAGE_LUT1D | HDMI_STAGE_LUT3D,
+	[CSETTING_PEAK] = HDMI_STAGE_PEAKING,
+	[CSETTING_PEAK_COLOR] = HDMI_STAGE_PEAKING,
+	[CSETTING_PEAK_BANDS] = HDMI_STAGE_PEAKING,
+};
+
 // Interrupt Handlers --------------------------------------------------------------------------------------------------
 void isrVSYNC(void * CallbackRef)
 {
 	FrameHeader_s fhSnapshot;
+	FrameHeader_s * fhDisplay = NULL;
 	u32 bitDiscard[4];
 
 	XGpioPs_WritePin(&Gpio, GPIO2_PIN, 1);	// Mark ISR entry.
 
 	hdmi->control &= ~HDMI_CTRL_VSYNC_IF;	// Clear the VSYNC interrupt flag.
 
-	hdmiFrame = frameLastCapturedIndex();
+	if(playbackIsActive())
+	{
+		// Frame from the read-ahead ring that is due, or none to keep decoding the one on screen.
+		fhDisplay = playbackVSYNC();
+	}
+	else
+	{
+		hdmiFrame = frameLastCapturedIndex();
+		if(hdmiFrame >= 0) { fhDisplay = frameGetHeader(hdmiFrame); }
+	}
 
-	if(hdmiFrame >= 0)
+	if(fhDisplay != NULL)
 	{
 		// Take a snapshot of the frame header for the HDMI frame to be displayed, to consolidate RAM read access.
-		memcpy(&fhSnapshot, frameGetHeader(hdmiFrame), sizeof(FrameHeader_s));
+		memcpy(&fhSnapshot, fhDisplay, sizeof(FrameHeader_s));
 
 		// Compute the bits to be discarded for each bitfield.
 		for(u8 i = 0; i < 4; i++)
@@ -173,17 +230,28 @@ void isrVSYNC(void * CallbackRef)
 		hdmi->bit_discard_update_HL2 = bitDiscard[2];
 		hdmi->bit_discard_update_HH2 = bitDiscard[3];
 
-		// Load the quantizer settings. TO-DO: Add sharpening/focus assist setting.
+		// Load the quantizer settings. TO-DO: Add sharpening setting.
 		hdmi->q_mult_inv_HL2_LH2 = 65536 / (fhSnapshot.q_mult_HH2_HL2_LH2 & 0xFFFF);
 		hdmi->q_mult_inv_HH2 = 65536 / (fhSnapshot.q_mult_HH2_HL2_LH2 >> 16);
+
+		// Offer the same frame to the exposure scopes.
+		scopeVSYNC(&fhSnapshot);
 	}
 
-	// Apply camera state settings to HDMI module.
-	if(hdmiApplyCameraStateSyncFlag)
+	// Apply camera state settings to HDMI module. A dark frame rebuilt for them is uploaded by the swap, so they wait
+	// for it rather than running a frame with the old dark frame rows.
+	if(hdmiApplyCameraStateSyncFlag && !hdmiDarkFrameSwapPending())
 	{
 		hdmiApplyCameraStateSync();
 	}
 
+	// Swap in a new dark frame. Settings still waiting are applied once its upload is done.
+	if(hdmiDarkFrameSwap() && hdmiApplyCameraStateSyncFlag)
+	{
+		hdmiApplyCameraStateSyncFlag = 0;
+		dmaFence(hdmiUploadDone, (void *)(u64) HDMI_STAGE_DARK_FRAME);
+	}
+
 	mainServiceTrigger();
 
 	XGpioPs_WritePin(&Gpio, GPIO2_PIN, 0);	// Mark ISR exit.
@@ -193,6 +261,8 @@ void isrVSYNC(void * CallbackRef)
 
 void hdmiInit(void)
 {
+	int cubeStatus;
+
 	// hdmiWriteTestPattern4K();
 	// hdmiWriteTestPattern2K();
 
@@ -208,6 +278,12 @@ void hdmiInit(void)
 	hdmi->bit_discard_update_HL2 = 0;
 	hdmi->bit_discard_update_HH2 = 0;
 
+	hdmiDarkFrameInit();
+
+	// User 3D LUT, if there is one on the SSD.
+	cubeStatus = hdmiLUT3DLoadCube(HDMI_LUT3D_CUBE_PATH);
+	if((cubeStatus != HDMI_LUT3D_OK) && (cubeStatus != HDMI_LUT3D_ERROR_FILE)) { xil_printf("3D LUT not supported.\r\n"); }
+
 	hdmiApplyCameraState();
 	hdmiApplyCameraStateSync();
 
@@ -232,6 +308,12 @@ void hdmiInit(void)
 u32 skip = 30;
 void hdmiService(void)
 {
+	// Track sensor temperature drift in the background.
+	hdmiDarkFrameAdapt(cmvGetTemp());
+
+	// Rebuild the stages whose upload failed, once the DMA has nothing else queued.
+	if(hdmiUploadRetry && !dmaBusy()) { hdmiApplyCameraState(); }
+
 	if(skip > 0)
 	{
 		skip--;
@@ -281,15 +363,188 @@ u32 debugOETF;
 void hdmiApplyCameraState(void)
 {
 	float wFrame, hFrame;
+	float colorTemp;
+	u8 gain;
+	u16 peakThreshold;
+	u8 peakBands;
+	u32 peakColor;
+	u32 dirty;
+	XTime tStart;
+
+	wFrame = cState.cSetting[CSETTING_WIDTH]->valArray[cState.cSetting[CSETTING_WIDTH]->val].fVal;
+	hFrame = cState.cSetting[CSETTING_HEIGHT]->valArray[cState.cSetting[CSETTING_HEIGHT]->val].fVal;
+	colorTemp = cState.cSetting[CSETTING_COLOR]->valArray[cState.cSetting[CSETTING_COLOR]->val].fVal;
+	gain = cState.cSetting[CSETTING_GAIN]->val;
+	peakThreshold = (u16)cState.cSetting[CSETTING_PEAK]->valArray[cState.cSetting[CSETTING_PEAK]->val].fVal;
+	peakBands = (u8)cState.cSetting[CSETTING_PEAK_BANDS]->valArray[cState.cSetting[CSETTING_PEAK_BANDS]->val].fVal;
+	peakColor = (u32)cState.cSetting[CSETTING_PEAK_COLOR]->valArray[cState.cSetting[CSETTING_PEAK_COLOR]->val].fVal;
+
+	// The viewport follows the clip being played back instead of the sensor.
+	if(playbackIsActive()) { playbackGetFrameSize(&wFrame, &hFrame); }
+
+	dirty = hdmiDirtyStages(wFrame, hFrame);
+
+	// With the DMA idle, no fence is left to add to the failed stages.
+	if(!dmaBusy())
+	{
+		dirty |= hdmiUploadRetry;
+		hdmiUploadRetry = 0;
+	}
+	if(dirty == 0) { return; }
+
+	if(dirty & HDMI_STAGE_VIEWPORT)
+	{
+		XTime_GetTime(&tStart);
+		hdmiApplyViewport(wFrame, hFrame);
+		hdmiStageTime(HDMI_STAGE_VIEWPORT, tStart);
+	}
+
+	if(dirty & HDMI_STAGE_DARK_FRAME)
+	{
+		XTime_GetTime(&tStart);
+		if(gain == CSETTING_GAIN_CAL1)
+		{
+			// Dark Frame Calibration
+			hdmiDarkFrameZero();
+		}
+		else
+		{
+			hdmiDarkFrameCreate((u16)wFrame, cmvGetTemp());
+		}
+		hdmiDarkFrameApply((u16)wFrame, (u16)hFrame);
+		hdmiStageTime(HDMI_STAGE_DARK_FRAME, tStart);
+	}
+
+	if(dirty & HDMI_STAGE_LUT1D)
+	{
+		XTime_GetTime(&tStart);
+		switch(gain)
+		{
+		case CSETTING_GAIN_LINEAR:
+			hdmiLUT1DCreate(colorTemp, debugOETF);
+			break;
+		case CSETTING_GAIN_HDR:
+			hdmiLUT1DCreate(colorTemp, HDMI_LUT1D_OETF_CMVHDR);
+			break;
+		default:
+			// Dark Frame, HDR Kneepoint, and Color Matrix Calibration
+			hdmiLUT1DIdentity();
+			break;
+		}
+		hdmiLUT1DApply();
+		hdmiStageTime(HDMI_STAGE_LUT1D, tStart);
+	}
+
+	if(dirty & HDMI_STAGE_LUT3D)
+	{
+		XTime_GetTime(&tStart);
+		switch(gain)
+		{
+		case CSETTING_GAIN_LINEAR:
+		case CSETTING_GAIN_HDR:
+			hdmiLUT3DCube(HDMI_LUT3D_RANGE_REC709);
+			break;
+		case CSETTING_GAIN_CAL1:
+			// Dark Frame Calibration
+			hdmiLUT3DIdentity(HDMI_LUT3D_RANGE_FULL);
+			break;
+		default:
+			// HDR Kneepoint and Color Matrix Calibration
+			hdmiLUT3DIdentity(HDMI_LUT3D_RANGE_REC709);
+			break;
+		}
+		hdmiLUT3DApply();
+		hdmiStageTime(HDMI_STAGE_LUT3D, tStart);
+	}
+
+	if(dirty & HDMI_STAGE_PEAKING)
+	{
+		XTime_GetTime(&tStart);
+		hdmiApplyPeaking(peakThreshold, peakBands, peakColor);
+		hdmiStageTime(HDMI_STAGE_PEAKING, tStart);
+	}
+
+	// Wait for the uploads to finish, then the next VSYNC, to apply camera settings.
+	dmaFence(hdmiUploadDone, (void *)(u64) dirty);
+}
+
+u32 hdmiGetStageTime_us(u32 stage)
+{
+	return hdmiStageTime_us[hdmiStageIndex(stage)];
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+void hdmiApplyCameraStateSync(void)
+{
+	hdmi->SS = hdmiSync.SS;
+	hdmi->opx_count_iv2_out_offset = hdmiSync.opx_count_iv2_out_offset;
+	hdmi->opx_count_iv2_in_offset = hdmiSync.opx_count_iv2_in_offset;
+	hdmi->opx_count_dc_en_offset = hdmiSync.opx_count_dc_en_offset;
+
+	hdmi->vy0_vx0 = hdmiSync.vy0_vx0;
+	hdmi->vyDiv_vxDiv = hdmiSync.vyDiv_vxDiv;
+	hdmi->hImage2048_wHDMI = hdmiSync.hImage2048_wHDMI;
+
+	hdmi->peak_control = hdmiSync.peak_control;
+	hdmi->peak_color = hdmiSync.peak_color;
+
+	hdmiApplyCameraStateSyncFlag = 0;
+}
+
+// ctx holds the stages behind the fence. If an upload failed they stay dirty, and the registers wait for the retry so
+// they change together with the tables.
+void hdmiUploadDone(void * ctx, u32 status)
+{
+	if(status != DMA_OK)
+	{
+		hdmiUploadRetry |= (u32)(u64) ctx;
+		return;
+	}
+
+	hdmiApplyCameraStateSyncFlag = 1;
+}
+
+// Returns the stages whose inputs changed since the last hdmiApplyCameraState(), and records the new inputs.
+u32 hdmiDirtyStages(float wFrame, float hFrame)
+{
+	u32 dirty = 0;
+	u8 val;
+	float fVal;
+
+	for(u8 i = 0; i < CSTATE_NUM_SETTINGS; i++)
+	{
+		val = cState.cSetting[i]->val;
+		fVal = cState.cSetting[i]->valArray[val].fVal;
+		if((val != hdmiApplied.val[i]) || (fVal != hdmiApplied.fVal[i])) { dirty |= hdmiSettingStages[i]; }
+		hdmiApplied.val[i] = val;
+		hdmiApplied.fVal[i] = fVal;
+	}
+
+	if((wFrame != hdmiApplied.wFrame) || (hFrame != hdmiApplied.hFrame))
+	{
+		dirty |= HDMI_STAGE_VIEWPORT | HDMI_STAGE_DARK_FRAME;
+	}
+	hdmiApplied.wFrame = wFrame;
+	hdmiApplied.hFrame = hFrame;
+
+	if(debugOETF != hdmiApplied.oetf) { dirty |= HDMI_STAGE_LUT1D; }
+	hdmiApplied.oetf = debugOETF;
+
+	if(!hdmiApplied.valid) { dirty = HDMI_STAGES_ALL; }
+	hdmiApplied.valid = 1;
+
+	return dirty;
+}
+
+void hdmiApplyViewport(float wFrame, float hFrame)
+{
 	float xScale, yScale;
 	float wViewport, hViewport;
 	float xOffset, yOffset;
 	int vx0, vy0, vxDiv, vyDiv;
 	u16 hImage2048;
 
-	wFrame = cState.cSetting[CSETTING_WIDTH]->valArray[cState.cSetting[CSETTING_WIDTH]->val].fVal;
-	hFrame = cState.cSetting[CSETTING_HEIGHT]->valArray[cState.cSetting[CSETTING_HEIGHT]->val].fVal;
-
 	if(wFrame == 4096.0f)
 	{
 		// 4K Mode
@@ -361,68 +616,31 @@ void hdmiApplyCameraState(void)
 	hdmiSync.vy0_vx0 = ((u32)vy0 << 16) | (u32)vx0;
 	hdmiSync.vyDiv_vxDiv = ((u32)vyDiv << 16) | (u32)vxDiv;
 	hdmiSync.hImage2048_wHDMI = ((u32)hImage2048 << 16) | 2200;
-
-	// Set the Dark Frame, LUT1D, and LUT3D.
-	float colorTemp = cState.cSetting[CSETTING_COLOR]->valArray[cState.cSetting[CSETTING_COLOR]->val].fVal;
-	switch(cState.cSetting[CSETTING_GAIN]->val)
-	{
-	case CSETTING_GAIN_LINEAR:
-		hdmiDarkFrameCreate((u16)wFrame, cmvGetTemp());
-		hdmiLUT1DCreate(colorTemp, debugOETF);
-		hdmiLUT3DIdentity(HDMI_LUT3D_RANGE_REC709);
-		break;
-	case CSETTING_GAIN_HDR:
-		hdmiDarkFrameCreate((u16)wFrame, cmvGetTemp());
-		hdmiLUT1DCreate(colorTemp, HDMI_LUT1D_OETF_CMVHDR);
-		hdmiLUT3DIdentity(HDMI_LUT3D_RANGE_REC709);
-		break;
-	case CSETTING_GAIN_CAL1:
-		// Dark Frame Calibration
-		hdmiDarkFrameZero();
-		hdmiLUT1DIdentity();
-		hdmiLUT3DIdentity(HDMI_LUT3D_RANGE_FULL);
-		break;
-	case CSETTING_GAIN_CAL2:
-		// HDR Kneepoint 1 Calibration
-		hdmiDarkFrameCreate((u16)wFrame, cmvGetTemp());
-		hdmiLUT1DIdentity();
-		hdmiLUT3DIdentity(HDMI_LUT3D_RANGE_REC709);
-		break;
-	case CSETTING_GAIN_CAL3:
-		// HDR Kneepoint 2 Calibration
-		hdmiDarkFrameCreate((u16)wFrame, cmvGetTemp());
-		hdmiLUT1DIdentity();
-		hdmiLUT3DIdentity(HDMI_LUT3D_RANGE_REC709);
-		break;
-	case CSETTING_GAIN_CAL4:
-		// Color Matrix Calibration
-		hdmiDarkFrameCreate((u16)wFrame, cmvGetTemp());
-		hdmiLUT1DIdentity();
-		hdmiLUT3DIdentity(HDMI_LUT3D_RANGE_REC709);
-		break;
-	}
-	hdmiDarkFrameApply((u16)wFrame, (u16)hFrame);
-	hdmiLUT1DApply();
-	hdmiLUT3DApply();
-
-	// Wait for the next VSYNC to apply camera settings.
-	hdmiApplyCameraStateSyncFlag = 1;
 }
 
-// Private Function Definitions ----------------------------------------------------------------------------------------
+// Focus peaking marks LL1 pixels whose selected Stage 2 detail coefficients are above threshold.
+// A threshold of zero (CSETTING_PEAK_OFF) disables the overlay.
+void hdmiApplyPeaking(u16 threshold, u8 bands, u32 color)
+{
+	hdmiSync.peak_control = (threshold & HDMI_PEAK_THR_MASK) | ((u32)(bands & 0x7) << HDMI_PEAK_BANDS_POS);
+	if(threshold > 0) { hdmiSync.peak_control |= HDMI_PEAK_EN; }
+	hdmiSync.peak_color = color & 0xFFFFFF;
+}
 
-void hdmiApplyCameraStateSync(void)
+void hdmiStageTime(u32 stage, XTime tStart)
 {
-	hdmi->SS = hdmiSync.SS;
-	hdmi->opx_count_iv2_out_offset = hdmiSync.opx_count_iv2_out_offset;
-	hdmi->opx_count_iv2_in_offset = hdmiSync.opx_count_iv2_in_offset;
-	hdmi->opx_count_dc_en_offset = hdmiSync.opx_count_dc_en_offset;
+	XTime tEnd;
 
-	hdmi->vy0_vx0 = hdmiSync.vy0_vx0;
-	hdmi->vyDiv_vxDiv = hdmiSync.vyDiv_vxDiv;
-	hdmi->hImage2048_wHDMI = hdmiSync.hImage2048_wHDMI;
+	XTime_GetTime(&tEnd);
+	hdmiStageTime_us[hdmiStageIndex(stage)] = (tEnd - tStart) * US_PER_COUNT;
+}
 
-	hdmiApplyCameraStateSyncFlag = 0;
+u32 hdmiStageIndex(u32 stage)
+{
+	u32 i = 0;
+
+	while((stage >> i) > 1) { i++; }
+	return i;
 }
 
 void hdmiI2CWriteMasked(u8 addr, u8 data, u8 mask)
@@ -29,6 +29,15 @@ THE SOFTWARE.
 
 // Public Pre-Processor Definitions ------------------------------------------------------------------------------------
 
+// Stages of hdmiApplyCameraState(), each rebuilt only when its inputs change.
+#define HDMI_STAGES 5
+#define HDMI_STAGE_VIEWPORT   0x01	// Viewport and 4K/2K registers, applied at VSYNC.
+#define HDMI_STAGE_DARK_FRAME 0x02	// Dark frame interpolation and upload.
+#define HDMI_STAGE_LUT1D      0x04	// Color mixer and curve build and upload.
+#define HDMI_STAGE_LUT3D      0x08	// 3D LUT build and upload.
+#define HDMI_STAGE_PEAKING    0x10	// Focus peaking registers, applied at VSYNC.
+#define HDMI_STAGES_ALL       0x1F
+
 // Public Type Definitions ---------------------------------------------------------------------------------------------
 
 // Public Function Prototypes ------------------------------------------------------------------------------------------
@@ -37,6 +46,9 @@ void hdmiInit(void);
 void hdmiService(void);
 void hdmiApplyCameraState(void);
 
+// Time the last rebuild of a stage (HDMI_STAGE_*) took, in [us]. For debugging.
+u32 hdmiGetStageTime_us(u32 stage);
+
 // Externed Public Global Variables ------------------------------------------------------------------------------------
 
 #endif
@@ -28,28 +28,76 @@ THE SOFTWARE.
 #include "hdmi_dark_frame.h"
 #include "frame.h"
 #include "cmv12000.h"
+#include "dma.h"
+#include <math.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
 
 // Private Pre-Processor Definitions -----------------------------------------------------------------------------------
 
 #define DARK_FRAME_USER_FLAG  0x80	//   index[7]: Factory, 1: User
 #define DARK_FRAME_INDEX_MASK 0x0F  // index[3:0]: Dark Frame Index (0 to 15)
 
+// RAM copies of the flash dark frames, 4 * 64KiB: 0x7B600000 - 0x7B640000.
+#define DARK_FRAME_RAM_ADDR 0x7B600000
+
+// Fixed-point fraction bits of the temperature interpolation weight. Reference temperatures are whole degrees and the
+// sensor temperature is clamped to 0-70C, so the weight is within +/-198 (1C span): under 2^24 in Q16. Its products
+// with s16 differences take s64 accumulators. Q16 keeps the rounding of the weight under 1/2LSB of the output for
+// any difference. DARK_FRAME_WEIGHT_MAX is only a guard, no weight reaches it.
+#define DARK_FRAME_WEIGHT_Q 16
+#define DARK_FRAME_WEIGHT_MAX (256 << DARK_FRAME_WEIGHT_Q)
+
+// Rows and columns are interpolated as one array of s16 values.
+#define DARK_FRAME_VALUES ((DARK_FRAME_H + DARK_FRAME_W) * 4)
+
+// Background temperature tracking by hdmiDarkFrameAdapt().
+#define DARK_FRAME_ADAPT_TEMP_STEP 0.25f	// Sensor temperature change that starts a new dark frame.
+#define DARK_FRAME_ADAPT_CHUNKS 8			// Passes that a new dark frame is interpolated over.
+#define DARK_FRAME_ADAPT_CHUNK (DARK_FRAME_VALUES / DARK_FRAME_ADAPT_CHUNKS)
+
+// Adaptation States
+#define DARK_FRAME_ADAPT_OFF 0				// The active dark frame is not interpolated (zero or test).
+#define DARK_FRAME_ADAPT_IDLE 1
+#define DARK_FRAME_ADAPT_BUILD 2
+#define DARK_FRAME_ADAPT_READY 3			// Spare buffer waiting for hdmiDarkFrameSwap() at VSYNC.
+
 // Private Type Definitions --------------------------------------------------------------------------------------------
 
 // Private Function Prototypes -----------------------------------------------------------------------------------------
 
 DarkFrameColor_s readPixelInLL2(s32 frame, u16 x, u16 y);
 u32 bitOffsetInLL2(u16 x, u16 y, u8 color, u16 wLL2);
+float darkFrameWeight(float temp);
+void interpolateDarkFrame(s16 * out, const s16 * cold, const s16 * warm, float wTemp, u32 n);
+void interpolateDarkFrameOffsets(DarkFrame_s * out, float wTemp);
+void darkFrameUpload(void);
+DarkFrame_s * darkFrameSpare(void);
+void darkFrameReady(float temp, u32 adaptState);
 
 // Public Global Variables ---------------------------------------------------------------------------------------------
 
-// Active dark frame.
+// Active dark frame, in one of two buffers. The other one is built in the background by hdmiDarkFrameAdapt().
 DarkFrame_s * dfCold;
 DarkFrame_s * dfWarm;
-DarkFrame_s dfActive;
+DarkFrame_s dfBuffer[2];
+DarkFrame_s * dfActive = &dfBuffer[0];
 
 // Private Global Variables --------------------------------------------------------------------------------------------
 
+float dfActiveTemp;					// Temperature the active dark frame was interpolated for.
+
+// Rows of the active dark frame in the dark row URAM, set by hdmiDarkFrameApply().
+u16 dfRowStart = 0;
+u16 dfRowCount = 0;
+
+// Background temperature tracking.
+volatile u32 dfAdaptState = DARK_FRAME_ADAPT_OFF;
+float dfAdaptTemp;
+u32 dfAdaptChunk;
+u32 dfSwapState;					// dfAdaptState once the spare buffer is swapped in.
+
 const DarkFrameColor_s dfColorZero = {0, 0, 0, 0};
 const DarkFrameColor_s dfColorTest = {64, 64, 64, 64};
 
@@ -59,6 +107,12 @@ DarkFrame_s * const dfWarm4K = (DarkFrame_s * const) 0xC0910000;
 DarkFrame_s * const dfCold2K = (DarkFrame_s * const) 0xC0920000;
 DarkFrame_s * const dfWarm2K = (DarkFrame_s * const) 0xC0930000;
 
+// RAM copies of the flash dark frames, loaded by hdmiDarkFrameInit().
+DarkFrame_s * const dfCold4KRAM = (DarkFrame_s * const) (DARK_FRAME_RAM_ADDR + 0x00000);
+DarkFrame_s * const dfWarm4KRAM = (DarkFrame_s * const) (DARK_FRAME_RAM_ADDR + 0x10000);
+DarkFrame_s * const dfCold2KRAM = (DarkFrame_s * const) (DARK_FRAME_RAM_ADDR + 0x20000);
+DarkFrame_s * const dfWarm2KRAM = (DarkFrame_s * const) (DARK_FRAME_RAM_ADDR + 0x30000);
+
 // DarkFrame_s dfError;
 
 // HDMI peripheral addresses of dark row and dark column URAMs.
@@ -69,122 +123,156 @@ u32 * const hdmiDarkCols =   (u32 * const) 0xA0110000;
 
 // Public Function Definitions -----------------------------------------------------------------------------------------
 
+void hdmiDarkFrameInit(void)
+{
+	// Copy the dark frames out of flash once, instead of reading them over QSPI for every interpolation.
+	memcpy(dfCold4KRAM, dfCold4K, sizeof(DarkFrame_s));
+	memcpy(dfWarm4KRAM, dfWarm4K, sizeof(DarkFrame_s));
+	memcpy(dfCold2KRAM, dfCold2K, sizeof(DarkFrame_s));
+	memcpy(dfWarm2KRAM, dfWarm2K, sizeof(DarkFrame_s));
+}
+
+// The active dark frame may be uploading, so it is built in the spare buffer and swapped in at VSYNC.
 void hdmiDarkFrameCreate(u16 wFrame, float temp)
 {
-	float dTemp, wTemp;
-	float fVal;
+	DarkFrame_s * dfNext;
+	float wTemp;
+
+	// Cancel a background update or a pending swap, they were for the previous sources.
+	dfAdaptState = DARK_FRAME_ADAPT_IDLE;
+	dfNext = darkFrameSpare();
 
 	if(wFrame == 4096)
 	{
-		dfCold = dfCold4K;
-		dfWarm = dfWarm4K;
+		dfCold = dfCold4KRAM;
+		dfWarm = dfWarm4KRAM;
 	}
 	else
 	{
-		dfCold = dfCold2K;
-		dfWarm = dfWarm2K;
+		dfCold = dfCold2KRAM;
+		dfWarm = dfWarm2KRAM;
 	}
 
-	dTemp = (float)(dfWarm->temp - dfCold->temp);
-	if(dTemp == 0.0f)
-	{
-		// Both dark frames have the same temperature, just use the first one.
-		wTemp = 0.0f;
-	}
-	else
-	{
-		// Get an interpolation factor from the temperature passed in.
-		if(temp < 0.0f) { temp = 0.0f; }			// Lower limit for extrapolation.
-		else if(temp > 70.0f) { temp = 70.0f; }		// Upper limit for extrapolation.
-		wTemp = (temp - (float)(dfCold->temp)) / dTemp;
-	}
+	wTemp = darkFrameWeight(temp);
 
 	// Interpolate the dark rows and dark columns.
-	// TO-DO: The interpolated output is restricted to be positive because of a timing issue that
-	// causes some color channels to use bit-mixed dark frame LUT data from two addresses. The
-	// symptom is milder if the two data points are both positive.
-	for(u16 r = 0; r < DARK_FRAME_H; r++)
-	{
-		fVal = (float) dfCold->row[r].G1 + wTemp * (float) (dfWarm->row[r].G1 - dfCold->row[r].G1);
-		if(fVal < 0.0f) { fVal = 0.0f; }
-		dfActive.row[r].G1 = (s16) fVal;
-		fVal = (float) dfCold->row[r].R1 + wTemp * (float) (dfWarm->row[r].R1 - dfCold->row[r].R1);
-		if(fVal < 0.0f) { fVal = 0.0f; }
-		dfActive.row[r].R1 = (s16) fVal;
-		fVal = (float) dfCold->row[r].B1 + wTemp * (float) (dfWarm->row[r].B1 - dfCold->row[r].B1);
-		if(fVal < 0.0f) { fVal = 0.0f; }
-		dfActive.row[r].B1 = (s16) fVal;
-		fVal = (float) dfCold->row[r].G2 + wTemp * (float) (dfWarm->row[r].G2 - dfCold->row[r].G2);
-		if(fVal < 0.0f) { fVal = 0.0f; }
-		dfActive.row[r].G2 = (s16) fVal;
-
-	}
-	for(u16 c = 0; c < DARK_FRAME_W; c++)
-	{
-		fVal = (float) dfCold->col[c].G1 + wTemp * (float) (dfWarm->col[c].G1 - dfCold->col[c].G1);
-		if(fVal < 0.0f) { fVal = 0.0f; }
-		dfActive.col[c].G1 = (s16) fVal;
-		fVal = (float) dfCold->col[c].R1 + wTemp * (float) (dfWarm->col[c].R1 - dfCold->col[c].R1);
-		if(fVal < 0.0f) { fVal = 0.0f; }
-		dfActive.col[c].R1 = (s16) fVal;
-		fVal = (float) dfCold->col[c].B1 + wTemp * (float) (dfWarm->col[c].B1 - dfCold->col[c].B1);
-		if(fVal < 0.0f) { fVal = 0.0f; }
-		dfActive.col[c].B1 = (s16) fVal;
-		fVal = (float) dfCold->col[c].G2 + wTemp * (float) (dfWarm->col[c].G2 - dfCold->col[c].G2);
-		if(fVal < 0.0f) { fVal = 0.0f; }
-		dfActive.col[c].G2 = (s16) fVal;
-	}
+	interpolateDarkFrame((s16 *) dfNext->row, (const s16 *) dfCold->row, (const s16 *) dfWarm->row, wTemp,
+	                     DARK_FRAME_VALUES);
 
 	// Interpolate the offsets.
-	fVal = (float) dfCold->offsetBot + wTemp * (float) (dfWarm->offsetBot - dfCold->offsetBot);
-	if(fVal < 0.0f) { fVal = 0.0f; }
-	dfActive.offsetBot = (u16) fVal;
-
-	fVal = (float) dfCold->offsetTop + wTemp * (float) (dfWarm->offsetTop - dfCold->offsetTop);
-	if(fVal < 0.0f) { fVal = 0.0f; }
-	dfActive.offsetTop = (u16) fVal;
+	interpolateDarkFrameOffsets(dfNext, wTemp);
 
-	dfActive.temp = temp;
+	dfNext->temp = temp;
+	darkFrameReady(temp, DARK_FRAME_ADAPT_IDLE);
 }
 
 void hdmiDarkFrameZero(void)
 {
+	DarkFrame_s * dfNext;
+
+	dfAdaptState = DARK_FRAME_ADAPT_OFF;
+	dfNext = darkFrameSpare();
+
 	// Default sensor offset with plenty of black margin.
-	dfActive.offsetBot = 512;
-	dfActive.offsetTop = 512;
+	dfNext->offsetBot = 512;
+	dfNext->offsetTop = 512;
 
 	// Rows
 	for(u16 r = 0; r < DARK_FRAME_H; r++)
-	{ dfActive.row[r] = dfColorZero; }
+	{ dfNext->row[r] = dfColorZero; }
 
 	// Columns
 	for(u16 c = 0; c < DARK_FRAME_W; c++)
-	{ dfActive.col[c] = dfColorZero; }
+	{ dfNext->col[c] = dfColorZero; }
+
+	darkFrameReady(0.0f, DARK_FRAME_ADAPT_OFF);
 }
 
 void hdmiDarkFrameTest(void)
 {
+	DarkFrame_s * dfNext;
+
+	dfAdaptState = DARK_FRAME_ADAPT_OFF;
+	dfNext = darkFrameSpare();
+
 	// Rows
 	for(u16 r = 0; r < DARK_FRAME_H; r++)
 	{
 		if (r < (DARK_FRAME_H / 2))
-		{ dfActive.row[r] = dfColorTest; }
+		{ dfNext->row[r] = dfColorTest; }
 		else
-		{ dfActive.row[r] = dfColorZero; }
+		{ dfNext->row[r] = dfColorZero; }
 	}
 
 	// Columns
 	for(u16 c = 0; c < DARK_FRAME_W; c++)
 	{
 		if (c < (DARK_FRAME_W / 2))
-		{ dfActive.col[c] = dfColorTest; }
+		{ dfNext->col[c] = dfColorTest; }
 		else
-		{ dfActive.col[c] = dfColorZero; }
+		{ dfNext->col[c] = dfColorZero; }
+	}
+
+	darkFrameReady(0.0f, DARK_FRAME_ADAPT_OFF);
+}
+
+void hdmiDarkFrameAdapt(float temp)
+{
+	DarkFrame_s * dfNext = darkFrameSpare();
+	u32 offset;
+	float wTemp;
+
+	switch(dfAdaptState)
+	{
+	case DARK_FRAME_ADAPT_IDLE:
+		if(fabsf(temp - dfActiveTemp) < DARK_FRAME_ADAPT_TEMP_STEP) { break; }
+		dfAdaptTemp = temp;
+		dfAdaptChunk = 0;
+		dfAdaptState = DARK_FRAME_ADAPT_BUILD;
+		break;
+	case DARK_FRAME_ADAPT_BUILD:
+		wTemp = darkFrameWeight(dfAdaptTemp);
+		offset = dfAdaptChunk * DARK_FRAME_ADAPT_CHUNK;
+		interpolateDarkFrame((s16 *) dfNext->row + offset, (const s16 *) dfCold->row + offset,
+		                     (const s16 *) dfWarm->row + offset, wTemp, DARK_FRAME_ADAPT_CHUNK);
+		dfAdaptChunk++;
+
+		if(dfAdaptChunk == DARK_FRAME_ADAPT_CHUNKS)
+		{
+			interpolateDarkFrameOffsets(dfNext, wTemp);
+			dfNext->temp = dfAdaptTemp;
+			darkFrameReady(dfAdaptTemp, DARK_FRAME_ADAPT_IDLE);
+		}
+		break;
+	default:
+		break;
 	}
 }
 
+u32 hdmiDarkFrameSwap(void)
+{
+	if(dfAdaptState != DARK_FRAME_ADAPT_READY) { return 0; }
+
+	// Anything else queued would push the upload out of vertical blanking, so wait for another VSYNC.
+	if(dmaBusy()) { return 0; }
+
+	dfActive = darkFrameSpare();
+	dfActiveTemp = dfAdaptTemp;
+	dfAdaptState = dfSwapState;
+
+	cmvSetOffsets(dfActive->offsetBot, dfActive->offsetTop);
+	darkFrameUpload();
+
+	return 1;
+}
+
+u32 hdmiDarkFrameSwapPending(void)
+{
+	return (dfAdaptState == DARK_FRAME_ADAPT_READY);
+}
+
 /*
-void hdmiDarkFrameAdapt(s32 frame, u32 nSamples, s16 targetBlack)
+void hdmiDarkFrameAdaptLL2(s32 frame, u32 nSamples, s16 targetBlack)
 {
 	u16 wFrame, hFrame;
 	u16 wLL2, hLL2;
@@ -225,45 +313,45 @@ void hdmiDarkFrameAdapt(s32 frame, u32 nSamples, s16 targetBlack)
 		for(int y = yAdapt; y < (yAdapt + hAdapt); y++)
 		{
 			// G1
-			error = targetBlack - (colorSample.G1 - dfActive.row[y].G1);
-			if (error > 0) { dfActive.row[y].G1--; }
-			else if (error < 0) { dfActive.row[y].G1++; }
+			error = targetBlack - (colorSample.G1 - dfActive->row[y].G1);
+			if (error > 0) { dfActive->row[y].G1--; }
+			else if (error < 0) { dfActive->row[y].G1++; }
 			// R1
-			error = targetBlack - (colorSample.R1 - dfActive.row[y].R1);
-			if (error > 0) { dfActive.row[y].R1--; }
-			else if (error < 0) { dfActive.row[y].R1++; }
+			error = targetBlack - (colorSample.R1 - dfActive->row[y].R1);
+			if (error > 0) { dfActive->row[y].R1--; }
+			else if (error < 0) { dfActive->row[y].R1++; }
 			// B1
-			error = targetBlack - (colorSample.B1 - dfActive.row[y].B1);
-			if (error > 0) { dfActive.row[y].B1--; }
-			else if (error < 0) { dfActive.row[y].B1++; }
+			error = targetBlack - (colorSample.B1 - dfActive->row[y].B1);
+			if (error > 0) { dfActive->row[y].B1--; }
+			else if (error < 0) { dfActive->row[y].B1++; }
 			// G2
-			error = targetBlack - (colorSample.G2 - dfActive.row[y].G2);
-			if (error > 0) { dfActive.row[y].G2--; }
-			else if (error < 0) { dfActive.row[y].G2++; }
+			error = targetBlack - (colorSample.G2 - dfActive->row[y].G2);
+			if (error > 0) { dfActive->row[y].G2--; }
+			else if (error < 0) { dfActive->row[y].G2++; }
 		}
 
 		// Adapt Columns
 		for(int x = xAdapt; x < (xAdapt + wAdapt); x++)
 		{
 			// G1
-			error = targetBlack - (colorSample.G1 - dfActive.col[x].G1);
+			error = targetBlack - (colorSample.G1 - dfActive->col[x].G1);
 			dfError.col[x].G1 += error;
-			dfActive.col[x].G1 -= (dfError.col[x].G1 / 256);
+			dfActive->col[x].G1 -= (dfError.col[x].G1 / 256);
 			dfError.col[x].G1 = dfError.col[x].G1 % 256;
 			// R1
-			error = targetBlack - (colorSample.R1 - dfActive.col[x].R1);
+			error = targetBlack - (colorSample.R1 - dfActive->col[x].R1);
 			dfError.col[x].R1 += error;
-			dfActive.col[x].R1 -= (dfError.col[x].R1 / 256);
+			dfActive->col[x].R1 -= (dfError.col[x].R1 / 256);
 			dfError.col[x].R1 = dfError.col[x].R1 % 256;
 			// B1
-			error = targetBlack - (colorSample.B1 - dfActive.col[x].B1);
+			error = targetBlack - (colorSample.B1 - dfActive->col[x].B1);
 			dfError.col[x].B1 += error;
-			dfActive.col[x].B1 -= (dfError.col[x].B1 / 256);
+			dfActive->col[x].B1 -= (dfError.col[x].B1 / 256);
 			dfError.col[x].B1 = dfError.col[x].B1 % 256;
 			// G2
-			error = targetBlack - (colorSample.G2 - dfActive.col[x].G2);
+			error = targetBlack - (colorSample.G2 - dfActive->col[x].G2);
 			dfError.col[x].G2 += error;
-			dfActive.col[x].G2 -= (dfError.col[x].G2 / 256);
+			dfActive->col[x].G2 -= (dfError.col[x].G2 / 256);
 			dfError.col[x].G2 = dfError.col[x].G2 % 256;
 		}
 
@@ -273,9 +361,7 @@ void hdmiDarkFrameAdapt(s32 frame, u32 nSamples, s16 targetBlack)
 
 void hdmiDarkFrameApply(u16 wFrame, u16 hFrame)
 {
-	u16 yStart, yHeight;
-
-	cmvSetOffsets(dfActive.offsetBot, dfActive.offsetTop);
+	u16 yHeight;
 
 	// Dark frames are always 4K, so scale hFrame by 2x in 2K mode.
 	if(wFrame == 4096)
@@ -284,13 +370,14 @@ void hdmiDarkFrameApply(u16 wFrame, u16 hFrame)
 	{ yHeight = 2 * hFrame; }
 
 	// Assume the frame is centered in the sensor.
-	yStart = (3072 - yHeight) / 2;
+	dfRowStart = (3072 - yHeight) / 2;
+	dfRowCount = yHeight;
 
-	// Dark row copy of vertical region-of-interest.
-	memcpy(hdmiDarkRows, &dfActive.row[yStart], sizeof(DarkFrameColor_s) * yHeight);
+	// A new dark frame waiting for VSYNC is uploaded by the swap, with these rows.
+	if(dfAdaptState == DARK_FRAME_ADAPT_READY) { return; }
 
-	// Dark column copy of fill width.
-	memcpy(hdmiDarkCols, &dfActive.col[0], sizeof(DarkFrameColor_s) * DARK_FRAME_W);
+	cmvSetOffsets(dfActive->offsetBot, dfActive->offsetTop);
+	darkFrameUpload();
 }
 
 // Private Function Definitions ----------------------------------------------------------------------------------------
@@ -388,3 +475,99 @@ u32 bitOffsetInLL2(u16 x, u16 y, u8 color, u16 wLL2)
 	return bitOffset;
 }
 
+// Interpolation factor between the cold (0.0) and warm (1.0) dark frames.
+float darkFrameWeight(float temp)
+{
+	float dTemp = (float)(dfWarm->temp - dfCold->temp);
+
+	// Both dark frames have the same temperature, just use the first one.
+	if(dTemp == 0.0f) { return 0.0f; }
+
+	if(temp < 0.0f) { temp = 0.0f; }			// Lower limit for extrapolation.
+	else if(temp > 70.0f) { temp = 70.0f; }		// Upper limit for extrapolation.
+	return (temp - (float)(dfCold->temp)) / dTemp;
+}
+
+// out = max(0, cold + wTemp * (warm - cold)) over n values of the rows and columns, n a multiple of 8.
+// TO-DO: The interpolated output is restricted to be positive because of a timing issue that
+// causes some color channels to use bit-mixed dark frame LUT data from two addresses. The
+// symptom is milder if the two data points are both positive.
+void interpolateDarkFrame(s16 * out, const s16 * cold, const s16 * warm, float wTemp, u32 n)
+{
+	s32 w = (s32) lroundf(wTemp * (float)(1 << DARK_FRAME_WEIGHT_Q));
+
+	if(w < -DARK_FRAME_WEIGHT_MAX) { w = -DARK_FRAME_WEIGHT_MAX; }
+	else if(w > DARK_FRAME_WEIGHT_MAX) { w = DARK_FRAME_WEIGHT_MAX; }
+
+#ifdef __ARM_NEON
+	const int16x8_t zero = vdupq_n_s16(0);
+	int16x8_t c, h;
+	int32x4_t c32, d32;
+	int64x2_t accLo, accHi;
+	int32x4_t out32[2];
+
+	for(u32 i = 0; i < n; i += 8)
+	{
+		c = vld1q_s16(&cold[i]);
+		h = vld1q_s16(&warm[i]);
+
+		for(int k = 0; k < 2; k++)
+		{
+			c32 = vmovl_s16(k ? vget_high_s16(c) : vget_low_s16(c));
+			d32 = k ? vsubl_s16(vget_high_s16(h), vget_high_s16(c)) : vsubl_s16(vget_low_s16(h), vget_low_s16(c));
+			accLo = vmlal_n_s32(vshll_n_s32(vget_low_s32(c32), DARK_FRAME_WEIGHT_Q), vget_low_s32(d32), w);
+			accHi = vmlal_n_s32(vshll_n_s32(vget_high_s32(c32), DARK_FRAME_WEIGHT_Q), vget_high_s32(d32), w);
+			out32[k] = vcombine_s32(vqshrn_n_s64(accLo, DARK_FRAME_WEIGHT_Q), vqshrn_n_s64(accHi, DARK_FRAME_WEIGHT_Q));
+		}
+
+		vst1q_s16(&out[i], vmaxq_s16(vcombine_s16(vqmovn_s32(out32[0]), vqmovn_s32(out32[1])), zero));
+	}
+#else
+	s64 acc;
+
+	for(u32 i = 0; i < n; i++)
+	{
+		acc = ((s64) cold[i] * (1 << DARK_FRAME_WEIGHT_Q) + ((s64) warm[i] - cold[i]) * w) >> DARK_FRAME_WEIGHT_Q;
+		if(acc < 0) { acc = 0; }
+		else if(acc > 32767) { acc = 32767; }
+		out[i] = (s16) acc;
+	}
+#endif
+}
+
+void interpolateDarkFrameOffsets(DarkFrame_s * out, float wTemp)
+{
+	float fVal;
+
+	fVal = (float) dfCold->offsetBot + wTemp * (float) (dfWarm->offsetBot - dfCold->offsetBot);
+	if(fVal < 0.0f) { fVal = 0.0f; }
+	out->offsetBot = (u16) fVal;
+
+	fVal = (float) dfCold->offsetTop + wTemp * (float) (dfWarm->offsetTop - dfCold->offsetTop);
+	if(fVal < 0.0f) { fVal = 0.0f; }
+	out->offsetTop = (u16) fVal;
+}
+
+// Upload the active dark frame's rows of interest and full width of columns. The active dark frame is not written
+// again until it has been swapped out, which waits for the DMA to be idle.
+void darkFrameUpload(void)
+{
+	DarkFrame_s * df = dfActive;
+
+	dmaUpload(hdmiDarkRows, &df->row[dfRowStart], sizeof(DarkFrameColor_s) * dfRowCount, NULL, NULL);
+	dmaUpload(hdmiDarkCols, &df->col[0], sizeof(DarkFrameColor_s) * DARK_FRAME_W, NULL, NULL);
+}
+
+// The buffer that is not active, free to build in unless a swap is pending.
+DarkFrame_s * darkFrameSpare(void)
+{
+	return (dfActive == &dfBuffer[0]) ? &dfBuffer[1] : &dfBuffer[0];
+}
+
+// Hand the spare buffer, built for temp, to hdmiDarkFrameSwap(). Adaptation continues in adaptState after the swap.
+void darkFrameReady(float temp, u32 adaptState)
+{
+	dfAdaptTemp = temp;
+	dfSwapState = adaptState;
+	dfAdaptState = DARK_FRAME_ADAPT_READY;
+}
@@ -54,25 +54,39 @@ typedef struct __attribute__((packed))
 
 // Public Function Prototypes ------------------------------------------------------------------------------------------
 
-// Load a dark frame from flash into the active dark frame in RAM.
+// Copy the dark frames from flash to RAM. Call once before hdmiDarkFrameCreate().
+void hdmiDarkFrameInit(void);
+
+// Interpolate the dark frames in RAM for temp into the spare dark frame buffer. It replaces the active one, which may
+// still be uploading, at the next hdmiDarkFrameSwap().
 void hdmiDarkFrameCreate(u16 wFrame, float temp);
 
-// Zero the dark frame in RAM.
+// Zero the spare dark frame buffer, swapped in as for hdmiDarkFrameCreate().
 void hdmiDarkFrameZero(void);
 
-// Build a test dark frame in RAM that darkens the top half and left half of the image.
+// Build a test dark frame in the spare buffer that darkens the top half and left half of the image, swapped in as for
+// hdmiDarkFrameCreate().
 void hdmiDarkFrameTest(void);
 
-// Adapt the dark frame in RAM based on the last captured frame.
-// void hdmiDarkFrameAdapt(s32 frame, u32 nSamples, s16 targetBlack);
+// Track the sensor temperature in the background. When it has drifted, a new dark frame is interpolated in the spare
+// buffer over several calls, one per frame, and then waits for hdmiDarkFrameSwap(). Call from the main loop.
+void hdmiDarkFrameAdapt(float temp);
+
+// Make a finished spare dark frame active and upload it. Call from the VSYNC interrupt, so the upload lands during
+// vertical blanking. Returns 1 if it swapped, with the upload queued.
+u32 hdmiDarkFrameSwap(void);
+
+// Returns 1 while a finished spare dark frame waits for hdmiDarkFrameSwap().
+u32 hdmiDarkFrameSwapPending(void);
 
-// Apply the active dark frame in RAM to the HDMI peripheral dark frame URAMs.
+// Apply the active dark frame in RAM to the HDMI peripheral dark frame URAMs. The upload runs in the background. A
+// spare dark frame waiting to be swapped in is uploaded by the swap instead.
 void hdmiDarkFrameApply(u16 wFrame, u16 hFrame);
 
 // Externed Public Global Variables ------------------------------------------------------------------------------------
 
 extern DarkFrame_s * dfCold;
 extern DarkFrame_s * dfWarm;
-extern DarkFrame_s dfActive;
+extern DarkFrame_s * dfActive;
 
 #endif
@@ -26,10 +26,31 @@ THE SOFTWARE.
 
 #include "main.h"
 #include "hdmi_lut1d.h"
+#include "dma.h"
 #include <math.h>
 
 // Private Pre-Processor Definitions -----------------------------------------------------------------------------------
 
+// Fixed-point fraction bits of the color mixer gains and inputs. Outputs are 14-bit, so products are shifted right by
+// (2 * LUT1D_MIXER_Q - 14).
+#define LUT1D_MIXER_Q 20
+
+// Curve entries between evaluated points of a gamma curve. The rest are linearly interpolated, which is well below
+// 1LSB of error for the gamma range of all OETFs.
+#define LUT1D_CURVE_STEP 16
+
+// Sub-tables, for tracking which ones have to be rebuilt and uploaded.
+#define LUT1D_TABLES 4
+#define LUT1D_TABLE_G 0			// G1 and G2 color mixer.
+#define LUT1D_TABLE_R 1			// R1 color mixer.
+#define LUT1D_TABLE_B 2			// B1 color mixer.
+#define LUT1D_TABLE_CURVE 3		// R, G, and B curves.
+#define LUT1D_TABLES_ALL 0x0F
+
+// Cache of built packs, 16 * 256KiB: 0x7B000000 - 0x7B400000.
+#define LUT1D_CACHE_ADDR 0x7B000000
+#define LUT1D_CACHE_SLOTS 16
+
 // Private Type Definitions --------------------------------------------------------------------------------------------
 
 typedef struct __attribute__((packed))
@@ -58,15 +79,56 @@ typedef enum
 	HDR_ENABLED
 } hdrStateType;
 
+// HDR kneepoint curve, with the coefficients that only depend on the kneepoints.
+typedef struct
+{
+	double x_kp1;
+	double x_win;
+	double m0, m1;
+	double y_kp1;
+	double x0, x1;
+	double y0, y1;
+	double a, b, c;
+	u32 valid;
+} hdrKnee_s;
+
+// Inputs of the tables in a pack.
+typedef struct
+{
+	s32 mixerGain[3][3];			// [G/R/B input][R/G/B output] gains, Q(LUT1D_MIXER_Q).
+	hdrStateType mixerHDR;			// Input linearization of the color mixer.
+	hdmiLUT1DOETF_Type curveOETF;	// Curve.
+	double x_kp1;					// HDR kneepoints, used by the HDR input linearization and curve.
+	double x_win;
+	u32 valid;						// Sub-tables (1 << LUT1D_TABLE_*) that match the inputs above.
+} LUT1DBuildState_s;
+
+typedef struct
+{
+	LUT1DBuildState_s state;
+	u32 lastUse;
+} LUT1DCacheSlot_s;
+
 // Private Function Prototypes -----------------------------------------------------------------------------------------
 
-void buildRGBMixerFromMatrix(LUT1DMatrix_s m, hdrStateType hdrState);
-void buildRGBCurveFromGamma(float gamma, float x0, float m, float A);
-void buildRGBCurveHDR();
+void lut1dTarget(LUT1DBuildState_s * target, LUT1DMatrix_s m, hdrStateType hdrState, hdmiLUT1DOETF_Type oetf);
+void lut1dSelect(const LUT1DBuildState_s * target);
+u32 lut1dSlotLRU(void);
+u32 lut1dTableMatches(const LUT1DBuildState_s * s, const LUT1DBuildState_s * target, int table);
+void lut1dCopyTable(LUT1DPack_s * dst, const LUT1DPack_s * src, int table);
+void lut1dUploadDone(void * ctx, u32 status);
+
+void buildRGBMixer(LUT1DPack_s * pack, const LUT1DBuildState_s * target, u32 tables);
+void buildRGBMixerTable(LUT1DColor_s * table, LUT1DColor_s * table2, const s32 * gain);
+void buildRGBMixerInput(const LUT1DBuildState_s * target);
+void buildRGBCurve(LUT1DPack_s * pack, hdmiLUT1DOETF_Type oetf);
+void buildRGBCurveFromGamma(LUT1DPack_s * pack, float gamma, float x0, float m, float A);
+void buildRGBCurveHDR(LUT1DPack_s * pack);
 
 LUT1DMatrix_s interpolateMatrix(LUT1DMatrix_s m0, LUT1DMatrix_s m1, float x);
-float HDRtoLinear(double x);
-float LineartoHDR(double y);
+void hdrKneeUpdate(void);
+float HDRtoLinear(const hdrKnee_s * k, double x);
+float LineartoHDR(const hdrKnee_s * k, double y);
 
 // Public Global Variables ---------------------------------------------------------------------------------------------
 
@@ -89,10 +151,21 @@ const LUT1DMatrix_s m3200K = { 1.24495f, -0.288141f, -0.241375f,
 		  	  	  	  	  	  -0.250881f,  1.25f, -0.491039f,
 							  -0.0946473f, -0.814871f,  2.69544f };
 
-LUT1DPack_s lut1dActive;
-
 // Private Global Variables --------------------------------------------------------------------------------------------
 
+LUT1DPack_s * const lut1dCache = (LUT1DPack_s * const) LUT1D_CACHE_ADDR;
+LUT1DCacheSlot_s lut1dSlot[LUT1D_CACHE_SLOTS];
+u32 lut1dActiveSlot = 0;		// Pack selected by the last Create/Identity.
+u32 lut1dUseCount = 0;
+
+LUT1DBuildState_s lut1dUploaded;	// Inputs of the tables in the URAMs.
+
+// Color mixer input for each 12-bit input code, Q(LUT1D_MIXER_Q).
+s32 lut1dMixerIn[4096];
+LUT1DBuildState_s lut1dMixerInState;	// Linearization and kneepoints of lut1dMixerIn.
+
+hdrKnee_s hdrKnee;
+
 // Interrupt Handlers --------------------------------------------------------------------------------------------------
 
 // Public Function Definitions -----------------------------------------------------------------------------------------
@@ -101,171 +174,339 @@ void hdmiLUT1DCreate(float colorTemp, hdmiLUT1DOETF_Type oetf)
 {
 	float x = (colorTemp - 3200.0f) / 2400.0f;
 	LUT1DMatrix_s mColorTemp = interpolateMatrix(m3200K, m5600K, x);
+	LUT1DBuildState_s target;
 
-	switch(oetf)
-	{
-	case HDMI_LUT1D_OETF_LINEAR:
-		buildRGBMixerFromMatrix(mColorTemp, HDR_DISABLED);
-		buildRGBCurveFromGamma(1.0f, 0.0f, 1.0f, 1.0f);
-		break;
-	case HDMI_LUT1D_OETF_REC709:
-		buildRGBMixerFromMatrix(mColorTemp, HDR_DISABLED);
-		buildRGBCurveFromGamma(1.0f / 0.45f, 0.018f, 4.5f, 1.099f);
-		break;
-	case HDMI_LUT1D_OETF_G18M3:
-		buildRGBMixerFromMatrix(mColorTemp, HDR_DISABLED);
-		buildRGBCurveFromGamma(1.8f, 0.025746f, 3.0f, 1.061793f);
-		break;
-	case HDMI_LUT1D_OETF_CMVHDR:
-		buildRGBMixerFromMatrix(mColorTemp, HDR_ENABLED);
-		buildRGBCurveHDR();
-		break;
-	}
+	if(oetf == HDMI_LUT1D_OETF_CMVHDR)
+	{ lut1dTarget(&target, mColorTemp, HDR_ENABLED, oetf); }
+	else
+	{ lut1dTarget(&target, mColorTemp, HDR_DISABLED, oetf); }
+
+	lut1dSelect(&target);
 }
 
 void hdmiLUT1DIdentity(void)
 {
-	buildRGBMixerFromMatrix(mIdentity, HDR_DISABLED);
-	buildRGBCurveFromGamma(1.0f, 0.0f, 1.0f, 1.0f);
+	LUT1DBuildState_s target;
+
+	lut1dTarget(&target, mIdentity, HDR_DISABLED, HDMI_LUT1D_OETF_LINEAR);
+	lut1dSelect(&target);
 }
 
 void hdmiLUT1DApply(void)
 {
+	const LUT1DPack_s * pack = &lut1dCache[lut1dActiveSlot];
+	const LUT1DBuildState_s * state = &lut1dSlot[lut1dActiveSlot].state;
+
 	// RGB Color Mixer
-	memcpy(lutG1, &lut1dActive.lut1D_G1[0], sizeof(LUT1DColor_s) * 4096);
-	memcpy(lutR1, &lut1dActive.lut1D_R1[0], sizeof(LUT1DColor_s) * 4096);
-	memcpy(lutB1, &lut1dActive.lut1D_B1[0], sizeof(LUT1DColor_s) * 4096);
-	memcpy(lutG2, &lut1dActive.lut1D_G2[0], sizeof(LUT1DColor_s) * 4096);
-
-	// RGB Curves
-	memcpy(lutR, &lut1dActive.lut1D_R[0], sizeof(s16) * 16384);
-	memcpy(lutG, &lut1dActive.lut1D_G[0], sizeof(s16) * 16384);
-	memcpy(lutB, &lut1dActive.lut1D_B[0], sizeof(s16) * 16384);
+	if(!lut1dTableMatches(&lut1dUploaded, state, LUT1D_TABLE_G))
+	{
+		dmaUpload(lutG1, &pack->lut1D_G1[0], sizeof(LUT1DColor_s) * 4096, lut1dUploadDone, NULL);
+		dmaUpload(lutG2, &pack->lut1D_G2[0], sizeof(LUT1DColor_s) * 4096, lut1dUploadDone, NULL);
+	}
+	if(!lut1dTableMatches(&lut1dUploaded, state, LUT1D_TABLE_R))
+	{ dmaUpload(lutR1, &pack->lut1D_R1[0], sizeof(LUT1DColor_s) * 4096, lut1dUploadDone, NULL); }
+	if(!lut1dTableMatches(&lut1dUploaded, state, LUT1D_TABLE_B))
+	{ dmaUpload(lutB1, &pack->lut1D_B1[0], sizeof(LUT1DColor_s) * 4096, lut1dUploadDone, NULL); }
+
+	// RGB Curves, contiguous in both the pack and the URAMs.
+	if(!lut1dTableMatches(&lut1dUploaded, state, LUT1D_TABLE_CURVE))
+	{ dmaUpload(lutR, &pack->lut1D_R[0], sizeof(s16) * 16384 * 3, lut1dUploadDone, NULL); }
+
+	lut1dUploaded = *state;
 }
 
 // Private Function Definitions ----------------------------------------------------------------------------------------
 
-void buildRGBMixerFromMatrix(LUT1DMatrix_s m, hdrStateType hdrState)
+void lut1dTarget(LUT1DBuildState_s * target, LUT1DMatrix_s m, hdrStateType hdrState, hdmiLUT1DOETF_Type oetf)
 {
-	float fIn, fOut;
-	LUT1DColor_s cOut;
+	const float scale = (float)(1 << LUT1D_MIXER_Q);
+
+	// G1 and G2 each contribute half of G.
+	target->mixerGain[0][0] = (s32) lroundf(m.GtoR * scale / 2.0f);
+	target->mixerGain[0][1] = (s32) lroundf(m.GtoG * scale / 2.0f);
+	target->mixerGain[0][2] = (s32) lroundf(m.GtoB * scale / 2.0f);
+	target->mixerGain[1][0] = (s32) lroundf(m.RtoR * scale);
+	target->mixerGain[1][1] = (s32) lroundf(m.RtoG * scale);
+	target->mixerGain[1][2] = (s32) lroundf(m.RtoB * scale);
+	target->mixerGain[2][0] = (s32) lroundf(m.BtoR * scale);
+	target->mixerGain[2][1] = (s32) lroundf(m.BtoG * scale);
+	target->mixerGain[2][2] = (s32) lroundf(m.BtoB * scale);
+
+	target->mixerHDR = hdrState;
+	target->curveOETF = oetf;
+
+	hdrKneeUpdate();
+	target->x_kp1 = hdrKnee.x_kp1;
+	target->x_win = hdrKnee.x_win;
+
+	target->valid = LUT1D_TABLES_ALL;
+}
 
-	for(int cIn = 0; cIn < 4096; cIn++)
+// Makes a pack built from the target inputs active: a cached one if available, otherwise the least recently used one
+// is rebuilt. Its tables that already match are kept, tables that match in the active pack are copied, and only the
+// rest are built.
+void lut1dSelect(const LUT1DBuildState_s * target)
+{
+	LUT1DPack_s * pack;
+	LUT1DBuildState_s * state;
+	const LUT1DBuildState_s * activeState = &lut1dSlot[lut1dActiveSlot].state;
+	u32 slot, build = 0;
+	int table;
+
+	lut1dUseCount++;
+
+	for(slot = 0; slot < LUT1D_CACHE_SLOTS; slot++)
 	{
-		if(cIn < 1024)
-		{ fIn = (float) cIn / 1024.0f; }	// In Range
-		else if(cIn < 2048)
-		{ fIn = 1.0f; }						// Clip High
-		else
-		{ fIn = 0.0f; }						// Clip Low
+		for(table = 0; table < LUT1D_TABLES; table++)
+		{
+			if(!lut1dTableMatches(&lut1dSlot[slot].state, target, table)) { break; }
+		}
+		if(table == LUT1D_TABLES) { break; }
+	}
 
-		if(hdrState == HDR_ENABLED)
-		{ fIn = HDRtoLinear((double)fIn); }
+	if(slot == LUT1D_CACHE_SLOTS)
+	{
+		slot = lut1dSlotLRU();
+		pack = &lut1dCache[slot];
+		state = &lut1dSlot[slot].state;
 
-		// G1/G2 to R
-		fOut = (m.GtoR / 2.0f) * fIn * 16384.0f;
-		if(fOut > 16383.0f) { fOut = 16383.0f; }
-		else if(fOut < 0.0f) { fOut = 0.0f; }
-		cOut.R = (s16)fOut;
+		for(table = 0; table < LUT1D_TABLES; table++)
+		{
+			if(lut1dTableMatches(state, target, table)) { continue; }
 
-		// G1/G2 to G
-		fOut = (m.GtoG / 2.0f) * fIn * 16384.0f;
-		if(fOut > 16383.0f) { fOut = 16383.0f; }
-		else if(fOut < 0.0f) { fOut = 0.0f; }
-		cOut.G = (s16)fOut;
+			if(lut1dTableMatches(activeState, target, table))
+			{ lut1dCopyTable(pack, &lut1dCache[lut1dActiveSlot], table); }
+			else
+			{ build |= (1 << table); }
+		}
 
-		// G1/G2 to B
-		fOut = (m.GtoB / 2.0f) * fIn * 16384.0f;
-		if(fOut > 16383.0f) { fOut = 16383.0f; }
-		else if(fOut < 0.0f) { fOut = 0.0f; }
-		cOut.B = (s16)fOut;
+		buildRGBMixer(pack, target, build);
+		if(build & (1 << LUT1D_TABLE_CURVE)) { buildRGBCurve(pack, target->curveOETF); }
 
-		lut1dActive.lut1D_G1[cIn] = cOut;
-		lut1dActive.lut1D_G2[cIn] = cOut;
+		*state = *target;
+	}
 
-		// R1 to R
-		fOut = m.RtoR * fIn * 16384.0f;
-		if(fOut > 16383.0f) { fOut = 16383.0f; }
-		else if(fOut < 0.0f) { fOut = 0.0f; }
-		cOut.R = (s16)fOut;
+	lut1dSlot[slot].lastUse = lut1dUseCount;
+	lut1dActiveSlot = slot;
+}
 
-		// R1 to G
-		fOut = m.RtoG * fIn * 16384.0f;
-		if(fOut > 16383.0f) { fOut = 16383.0f; }
-		else if(fOut < 0.0f) { fOut = 0.0f; }
-		cOut.G = (s16)fOut;
+// Least recently used slot other than the active one. Unused slots come first.
+u32 lut1dSlotLRU(void)
+{
+	u32 lru = (lut1dActiveSlot == 0) ? 1 : 0;
 
-		// R1 to B
-		fOut = m.RtoB * fIn * 16384.0f;
-		if(fOut > 16383.0f) { fOut = 16383.0f; }
-		else if(fOut < 0.0f) { fOut = 0.0f; }
-		cOut.B = (s16)fOut;
+	for(u32 slot = 0; slot < LUT1D_CACHE_SLOTS; slot++)
+	{
+		if(slot == lut1dActiveSlot) { continue; }
+		if(lut1dSlot[slot].lastUse < lut1dSlot[lru].lastUse) { lru = slot; }
+	}
 
-		lut1dActive.lut1D_R1[cIn] = cOut;
+	return lru;
+}
 
-		// B1 to R
-		fOut = m.BtoR * fIn * 16384.0f;
-		if(fOut > 16383.0f) { fOut = 16383.0f; }
-		else if(fOut < 0.0f) { fOut = 0.0f; }
-		cOut.R = (s16)fOut;
+u32 lut1dTableMatches(const LUT1DBuildState_s * s, const LUT1DBuildState_s * target, int table)
+{
+	u32 hdr;
 
-		// B1 to G
-		fOut = m.BtoG * fIn * 16384.0f;
-		if(fOut > 16383.0f) { fOut = 16383.0f; }
-		else if(fOut < 0.0f) { fOut = 0.0f; }
-		cOut.G = (s16)fOut;
+	if(!(s->valid & (1 << table))) { return 0; }
 
-		// B1 to B
-		fOut = m.BtoB * fIn * 16384.0f;
-		if(fOut > 16383.0f) { fOut = 16383.0f; }
-		else if(fOut < 0.0f) { fOut = 0.0f; }
-		cOut.B = (s16)fOut;
+	if(table == LUT1D_TABLE_CURVE)
+	{
+		if(s->curveOETF != target->curveOETF) { return 0; }
+		hdr = (target->curveOETF == HDMI_LUT1D_OETF_CMVHDR);
+	}
+	else
+	{
+		if(memcmp(s->mixerGain[table], target->mixerGain[table], sizeof(s->mixerGain[table])) != 0) { return 0; }
+		if(s->mixerHDR != target->mixerHDR) { return 0; }
+		hdr = (target->mixerHDR == HDR_ENABLED);
+	}
+
+	// The kneepoints only matter to HDR tables.
+	if(hdr && ((s->x_kp1 != target->x_kp1) || (s->x_win != target->x_win))) { return 0; }
 
-		lut1dActive.lut1D_B1[cIn] = cOut;
+	return 1;
+}
+
+void lut1dCopyTable(LUT1DPack_s * dst, const LUT1DPack_s * src, int table)
+{
+	switch(table)
+	{
+	case LUT1D_TABLE_G:
+		memcpy(dst->lut1D_G1, src->lut1D_G1, sizeof(dst->lut1D_G1));
+		memcpy(dst->lut1D_G2, src->lut1D_G2, sizeof(dst->lut1D_G2));
+		break;
+	case LUT1D_TABLE_R:
+		memcpy(dst->lut1D_R1, src->lut1D_R1, sizeof(dst->lut1D_R1));
+		break;
+	case LUT1D_TABLE_B:
+		memcpy(dst->lut1D_B1, src->lut1D_B1, sizeof(dst->lut1D_B1));
+		break;
+	case LUT1D_TABLE_CURVE:
+		memcpy(dst->lut1D_R, src->lut1D_R, sizeof(dst->lut1D_R));
+		memcpy(dst->lut1D_G, src->lut1D_G, sizeof(dst->lut1D_G));
+		memcpy(dst->lut1D_B, src->lut1D_B, sizeof(dst->lut1D_B));
+		break;
 	}
 }
 
-void buildRGBCurveFromGamma(float gamma, float x0, float m, float A)
+// A failed upload leaves the URAMs unknown, so the next Apply uploads every table.
+void lut1dUploadDone(void * ctx, u32 status)
 {
-	float fIn, fOut;
+	if(status != DMA_OK) { lut1dUploaded.valid = 0; }
+}
 
-	for(int cIn = 0; cIn < 16384; cIn++)
+void buildRGBMixer(LUT1DPack_s * pack, const LUT1DBuildState_s * target, u32 tables)
+{
+	if(!(tables & ((1 << LUT1D_TABLE_G) | (1 << LUT1D_TABLE_R) | (1 << LUT1D_TABLE_B)))) { return; }
+
+	buildRGBMixerInput(target);
+
+	if(tables & (1 << LUT1D_TABLE_G))
+	{ buildRGBMixerTable(pack->lut1D_G1, pack->lut1D_G2, target->mixerGain[LUT1D_TABLE_G]); }
+	if(tables & (1 << LUT1D_TABLE_R))
+	{ buildRGBMixerTable(pack->lut1D_R1, NULL, target->mixerGain[LUT1D_TABLE_R]); }
+	if(tables & (1 << LUT1D_TABLE_B))
+	{ buildRGBMixerTable(pack->lut1D_B1, NULL, target->mixerGain[LUT1D_TABLE_B]); }
+}
+
+// One input's R/G/B contributions for all input codes. table2, if not NULL, gets a copy.
+void buildRGBMixerTable(LUT1DColor_s * table, LUT1DColor_s * table2, const s32 * gain)
+{
+	const int shift = 2 * LUT1D_MIXER_Q - 14;
+	LUT1DColor_s cOut;
+	s32 out[3];
+
+	cOut.reserved = 0;
+	for(int cIn = 0; cIn < 4096; cIn++)
 	{
-		fIn = cIn / 16384.0f;
-		if(fIn < x0)
+		for(int i = 0; i < 3; i++)
 		{
-			// Linear range below x0.
-			fOut = m * fIn;
+			out[i] = (s32)(((s64) gain[i] * lut1dMixerIn[cIn]) >> shift);
+			if(out[i] > 16383) { out[i] = 16383; }
+			else if(out[i] < 0) { out[i] = 0; }
 		}
+		cOut.R = (s16) out[0];
+		cOut.G = (s16) out[1];
+		cOut.B = (s16) out[2];
+
+		table[cIn] = cOut;
+		if(table2 != NULL) { table2[cIn] = cOut; }
+	}
+}
+
+void buildRGBMixerInput(const LUT1DBuildState_s * target)
+{
+	const double scale = (double)(1 << LUT1D_MIXER_Q);
+	double fIn;
+
+	if(lut1dMixerInState.valid && (lut1dMixerInState.mixerHDR == target->mixerHDR)
+	&& ((target->mixerHDR == HDR_DISABLED)
+	|| ((lut1dMixerInState.x_kp1 == target->x_kp1) && (lut1dMixerInState.x_win == target->x_win))))
+	{ return; }
+
+	for(int cIn = 0; cIn < 4096; cIn++)
+	{
+		if(cIn < 1024)
+		{ fIn = (double) cIn / 1024.0; }	// In Range
+		else if(cIn < 2048)
+		{ fIn = 1.0; }						// Clip High
 		else
+		{ fIn = 0.0; }						// Clip Low
+
+		if(target->mixerHDR == HDR_ENABLED)
+		{ fIn = HDRtoLinear(&hdrKnee, fIn); }
+
+		lut1dMixerIn[cIn] = (s32) lround(fIn * scale);
+	}
+
+	lut1dMixerInState = *target;
+}
+
+void buildRGBCurve(LUT1DPack_s * pack, hdmiLUT1DOETF_Type oetf)
+{
+	switch(oetf)
+	{
+	case HDMI_LUT1D_OETF_LINEAR:
+		buildRGBCurveFromGamma(pack, 1.0f, 0.0f, 1.0f, 1.0f);
+		break;
+	case HDMI_LUT1D_OETF_REC709:
+		buildRGBCurveFromGamma(pack, 1.0f / 0.45f, 0.018f, 4.5f, 1.099f);
+		break;
+	case HDMI_LUT1D_OETF_G18M3:
+		buildRGBCurveFromGamma(pack, 1.8f, 0.025746f, 3.0f, 1.061793f);
+		break;
+	case HDMI_LUT1D_OETF_CMVHDR:
+		buildRGBCurveHDR(pack);
+		break;
+	}
+}
+
+void buildRGBCurveFromGamma(LUT1DPack_s * pack, float gamma, float x0, float m, float A)
+{
+	const int step = LUT1D_CURVE_STEP;
+	float fIn, fOut;
+	s32 k0, k1, out;
+	int cIn;
+
+	// Knots in 1/16LSB, every step entries.
+	k1 = 0;
+	for(int cKnot = -step; cKnot < 16384; cKnot += step)
+	{
+		k0 = k1;
+		fIn = (cKnot + step) / 16384.0f;
+		if(fIn < x0) { fOut = m * fIn; }
+		else { fOut = A * powf(fIn, 1.0f / gamma) - (A - 1.0f); }
+		k1 = (s32) lroundf(fOut * 16384.0f * 16.0f);
+		if(cKnot < 0) { continue; }
+
+		if((cKnot / 16384.0f < x0) && (fIn >= x0))
 		{
-			// Gamma range above x0.
-			fOut = A * powf(fIn, 1.0f / gamma) - (A - 1.0f);
+			// Linear to gamma transition inside this span: evaluate every entry.
+			for(cIn = cKnot; cIn < cKnot + step; cIn++)
+			{
+				fIn = cIn / 16384.0f;
+				if(fIn < x0) { fOut = m * fIn; }
+				else { fOut = A * powf(fIn, 1.0f / gamma) - (A - 1.0f); }
+				out = (s32)(fOut * 16384.0f);
+				if(out > 16383) { out = 16383; }
+				else if(out < 0) { out = 0; }
+
+				pack->lut1D_R[cIn] = (s16) out;
+				pack->lut1D_G[cIn] = (s16) out;
+				pack->lut1D_B[cIn] = (s16) out;
+			}
+			continue;
 		}
-		fOut *= 16384.0f;
-		if(fOut > 16383.0f) { fOut = 16383.0f; }
-		else if(fOut < 0.0f) { fOut = 0.0f; }
 
-		lut1dActive.lut1D_R[cIn] = (s16)fOut;
-		lut1dActive.lut1D_G[cIn] = (s16)fOut;
-		lut1dActive.lut1D_B[cIn] = (s16)fOut;
+		for(int i = 0; i < step; i++)
+		{
+			out = (k0 * (step - i) + k1 * i) / (step * 16);
+			if(out > 16383) { out = 16383; }
+			else if(out < 0) { out = 0; }
+
+			cIn = cKnot + i;
+			pack->lut1D_R[cIn] = (s16) out;
+			pack->lut1D_G[cIn] = (s16) out;
+			pack->lut1D_B[cIn] = (s16) out;
+		}
 	}
 }
 
-void buildRGBCurveHDR(void)
+void buildRGBCurveHDR(LUT1DPack_s * pack)
 {
 	float fIn, fOut;
 
 	for(int cIn = 0; cIn < 16384; cIn++)
 	{
 		fIn = cIn / 16384.0f;
-		fOut = LineartoHDR((double)fIn) * 16384.0f;
+		fOut = LineartoHDR(&hdrKnee, (double)fIn) * 16384.0f;
 		if(fOut > 16383.0f) { fOut = 16383.0f; }
 		else if(fOut < 0.0f) { fOut = 0.0f; }
 
-		lut1dActive.lut1D_R[cIn] = (s16)fOut;
-		lut1dActive.lut1D_G[cIn] = (s16)fOut;
-		lut1dActive.lut1D_B[cIn] = (s16)fOut;
+		pack->lut1D_R[cIn] = (s16)fOut;
+		pack->lut1D_G[cIn] = (s16)fOut;
+		pack->lut1D_B[cIn] = (s16)fOut;
 	}
 }
 
@@ -287,41 +528,54 @@ LUT1DMatrix_s interpolateMatrix(LUT1DMatrix_s m0, LUT1DMatrix_s m1, float x)
 double debug_x_kp1 = 0.68;
 double debug_x_win = 0.10;
 
-float HDRtoLinear(double x)
+// Recomputes the kneepoint coefficients if the kneepoints changed. Tables built from them are matched by kneepoints.
+void hdrKneeUpdate(void)
 {
-	double y;
+	hdrKnee_s * k = &hdrKnee;
+
+	if(k->valid && (k->x_kp1 == debug_x_kp1) && (k->x_win == debug_x_win)) { return; }
+
+	k->x_kp1 = debug_x_kp1;
+	k->x_win = debug_x_win;
 
-	double m0 = 0.0625;
-	double x_kp1 = debug_x_kp1;
-	double y_kp1 = m0 * x_kp1;
+	k->m0 = 0.0625;
+	k->y_kp1 = k->m0 * k->x_kp1;
 	double x_kp2 = 1.0;
 	double y_kp2 = 0.5;
 
-	double m1 = (y_kp2 - y_kp1) / (x_kp2 - x_kp1);
+	k->m1 = (y_kp2 - k->y_kp1) / (x_kp2 - k->x_kp1);
 
-	double x_win = debug_x_win;
-	double x0 = x_kp1 - x_win;
-	double x1 = x_kp1 + x_win;
-	double y0 = y_kp1 - m0 * x_win;
-	double y1 = y_kp1 + m1 * x_win;
+	k->x0 = k->x_kp1 - k->x_win;
+	k->x1 = k->x_kp1 + k->x_win;
+	k->y0 = k->y_kp1 - k->m0 * k->x_win;
+	k->y1 = k->y_kp1 + k->m1 * k->x_win;
 
-	double a, b, c;
+	double m0 = k->m0, m1 = k->m1;
+	double x0 = k->x0, x1 = k->x1;
+	double y0 = k->y0, y1 = k->y1;
 	double den = (x0-x1)*(x0-x1)*(x0-x1);
-	a = (-m0*(x0-x1)*(x0+2.0*x1)+m1*(-2.0*x0*x0+x1*x0+x1*x1)+3.0*(x0+x1)*(y0-y1))/den;
-	b = (m1*x0*(x0-x1)*(x0+2.0*x1)-x1*(m0*(-2.0*x0*x0+x1*x0+x1*x1)+6.0*x0*(y0-y1)))/den;
-	c = ((x0-3.0*x1)*y1*x0*x0+x1*(x0*(x1-x0)*(m1*x0+m0*x1)-x1*(x1-3.0*x0)*y0))/den;
+	k->a = (-m0*(x0-x1)*(x0+2.0*x1)+m1*(-2.0*x0*x0+x1*x0+x1*x1)+3.0*(x0+x1)*(y0-y1))/den;
+	k->b = (m1*x0*(x0-x1)*(x0+2.0*x1)-x1*(m0*(-2.0*x0*x0+x1*x0+x1*x1)+6.0*x0*(y0-y1)))/den;
+	k->c = ((x0-3.0*x1)*y1*x0*x0+x1*(x0*(x1-x0)*(m1*x0+m0*x1)-x1*(x1-3.0*x0)*y0))/den;
+
+	k->valid = 1;
+}
+
+float HDRtoLinear(const hdrKnee_s * k, double x)
+{
+	double y;
 
-	if(x < x0)
+	if(x < k->x0)
 	{
-		y = m0 * x;
+		y = k->m0 * x;
 	}
-	else if(x < x1)
+	else if(x < k->x1)
 	{
-		y = a * x * x + b * x + c;
+		y = k->a * x * x + k->b * x + k->c;
 	}
 	else if(x < 1.0)
 	{
-		y = m1 * (x - x_kp1) + y_kp1;
+		y = k->m1 * (x - k->x_kp1) + k->y_kp1;
 	}
 	else
 	{
@@ -331,46 +585,26 @@ float HDRtoLinear(double x)
 	return (float) y;
 }
 
-float LineartoHDR(double y)
+float LineartoHDR(const hdrKnee_s * k, double y)
 {
 	double x;
-
-	double m0 = 0.0625;
-	double x_kp1 = debug_x_kp1;
-	double y_kp1 = m0 * x_kp1;
-	double x_kp2 = 1.0;
-	double y_kp2 = 0.5;
-
-	double m1 = (y_kp2 - y_kp1) / (x_kp2 - x_kp1);
-
-	double x_win = debug_x_win;
-	double x0 = x_kp1 - x_win;
-	double x1= x_kp1 + x_win;
-	double y0 = y_kp1 - m0 * x_win;
-	double y1 = y_kp1 + m1 * x_win;
-
-	double a, b, c;
-	double den = (x0-x1)*(x0-x1)*(x0-x1);
-	a = (-m0*(x0-x1)*(x0+2.0*x1)+m1*(-2.0*x0*x0+x1*x0+x1*x1)+3.0*(x0+x1)*(y0-y1))/den;
-	b = (m1*x0*(x0-x1)*(x0+2.0*x1)-x1*(m0*(-2.0*x0*x0+x1*x0+x1*x1)+6.0*x0*(y0-y1)))/den;
-	c = ((x0-3.0*x1)*y1*x0*x0+x1*(x0*(x1-x0)*(m1*x0+m0*x1)-x1*(x1-3.0*x0)*y0))/den;
-
+	double c;
 	double sqrt_operand = 0.0f;
 
-	if(y < y0)
+	if(y < k->y0)
 	{
-		x = (1.0 / m0) * y;
+		x = (1.0 / k->m0) * y;
 	}
-	else if(y < y1)
+	else if(y < k->y1)
 	{
-		c = c - y;
-		sqrt_operand = b*b-4.0*a*c;
+		c = k->c - y;
+		sqrt_operand = k->b*k->b-4.0*k->a*c;
 		if(sqrt_operand < 0.0) { sqrt_operand = 0.0; }
-		x = (-b+sqrt(sqrt_operand))/(2.0*a);
+		x = (-k->b+sqrt(sqrt_operand))/(2.0*k->a);
 	}
 	else if(y < 0.5)
 	{
-		x = (1.0 / m1) * (y - y_kp1) + x_kp1;
+		x = (1.0 / k->m1) * (y - k->y_kp1) + k->x_kp1;
 	}
 	else
 	{
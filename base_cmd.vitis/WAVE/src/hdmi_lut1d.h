@@ -60,7 +60,7 @@ void hdmiLUT1DCreate(float colorTemp, hdmiLUT1DOETF_Type oetf);
 // Build an identity LUT1D Pack in RAM.
 void hdmiLUT1DIdentity(void);
 
-// Apply the active LUT1D Pack in RAM to the HDMI peripheral LUT1D URAMs.
+// Apply the active LUT1D Pack in RAM to the HDMI peripheral LUT1D URAMs. The upload runs in the background.
 void hdmiLUT1DApply(void);
 
 // Externed Public Global Variables ------------------------------------------------------------------------------------
@@ -26,9 +26,23 @@ THE SOFTWARE.
 
 #include "main.h"
 #include "hdmi_lut3d.h"
+#include "fs.h"
+#include "dma.h"
+#include <math.h>
 
 // Private Pre-Processor Definitions -----------------------------------------------------------------------------------
 
+// Cache of built packs, 8 * 256KiB: 0x7B400000 - 0x7B600000.
+#define LUT3D_CACHE_ADDR 0x7B400000
+#define LUT3D_CACHE_SLOTS 8
+
+// Grid points per axis of the HDMI peripheral's LUT: 16 cubes, each interpolated from its 8 corners.
+#define LUT3D_GRID 17
+
+// .cube loader
+#define CUBE_SIZE_MAX 65		// Largest LUT_3D_SIZE.
+#define CUBE_READ_SIZE 16384	// File bytes read at a time. Also the longest line.
+
 // Private Type Definitions --------------------------------------------------------------------------------------------
 
 typedef struct
@@ -50,8 +64,44 @@ typedef struct
 	u8 reserved[65536];
 } LUT3DPack_s; // [256KiB]
 
+// Inputs of a pack.
+typedef struct
+{
+	hdmiLUT3DRangeType range;
+	u32 cube;					// Loaded .cube LUT, or 0 for identity.
+	u32 valid;
+} LUT3DKey_s;
+
+// .cube parser state
+typedef struct
+{
+	int size;					// LUT_3D_SIZE, 0 until read.
+	float domainMin[3];			// R, G, B.
+	float domainMax[3];
+	u32 nEntries;				// Table entries read.
+	int i0[3][LUT3D_GRID];		// Lower table index of each grid point, per axis.
+	float f[3][LUT3D_GRID];		// Position between the lower and upper table index of each grid point, per axis.
+} cubeParser_s;
+
+typedef struct
+{
+	LUT3DKey_s key;
+	u32 lastUse;
+} LUT3DCacheSlot_s;
+
 // Private Function Prototypes -----------------------------------------------------------------------------------------
 
+u32 lut3dSelect(const LUT3DKey_s * key);
+u32 lut3dKeyMatches(const LUT3DKey_s * a, const LUT3DKey_s * b);
+void lut3dUploadDone(void * ctx, u32 status);
+s16 lut3dCoef(float x, float scale);
+
+int cubeParseLine(cubeParser_s * p, char * line);
+int cubeParseEntry(cubeParser_s * p, const char * line);
+void cubeResampleSlice(cubeParser_s * p, int b);
+const char * cubeParseFloat(const char * str, float * val);
+const char * cubeKeyword(const char * line, const char * keyword);
+
 // Public Global Variables ---------------------------------------------------------------------------------------------
 
 u32 * const lut3dC30R =  (u32 * const) 0xA0150000;
@@ -61,10 +111,24 @@ u32 * const lut3dC74G =  (u32 * const) 0xA0168000;
 u32 * const lut3dC30B =  (u32 * const) 0xA0170000;
 u32 * const lut3dC74B =  (u32 * const) 0xA0178000;
 
-LUT3DPack_s lut3dActive;
-
 // Private Global Variables --------------------------------------------------------------------------------------------
 
+LUT3DPack_s * const lut3dCache = (LUT3DPack_s * const) LUT3D_CACHE_ADDR;
+LUT3DCacheSlot_s lut3dSlot[LUT3D_CACHE_SLOTS];
+u32 lut3dActiveSlot = 0;		// Pack selected by the last Identity or Cube.
+u32 lut3dUseCount = 0;
+
+LUT3DKey_s lut3dUploaded;		// Inputs of the pack in the URAMs.
+
+// Loaded .cube LUT resampled to the grid, [B][G][R][R/G/B] in the file's 0.0-1.0 output range.
+float lut3dCubeGrid[LUT3D_GRID][LUT3D_GRID][LUT3D_GRID][3];
+u32 lut3dCube = 0;				// Number of the loaded .cube LUT, or 0 if none is loaded.
+u32 lut3dCubeCount = 0;
+
+// Two consecutive B slices of the .cube table, the most recent one in (slice & 1).
+char cubeReadBuffer[CUBE_READ_SIZE + 1];
+float cubeSlice[2][CUBE_SIZE_MAX * CUBE_SIZE_MAX][3];
+
 // 3D LUT Curves
 s16 linFull[] = {0, 1024, 2048, 3072, 4096, 5120, 6144, 7168, 8192, 9216, 10240, 11264, 12288, 13312, 14336, 15360};
 s16 dlinFull[] = {1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024};
@@ -78,10 +142,18 @@ s16 dlin709[] = {896, 896, 896, 896, 896, 896, 896, 896, 896, 896, 896, 896, 896
 
 void hdmiLUT3DIdentity(hdmiLUT3DRangeType range)
 {
+	LUT3DPack_s * pack;
+	LUT3DKey_s key;
 	int lutIndex;
 	s16 * lut;
 	s16 * dlut;
 
+	key.range = range;
+	key.cube = 0;
+	key.valid = 1;
+	if(lut3dSelect(&key)) { return; }
+	pack = &lut3dCache[lut3dActiveSlot];
+
 	if(range == HDMI_LUT3D_RANGE_FULL)
 	{
 		lut = linFull;
@@ -102,47 +174,448 @@ void hdmiLUT3DIdentity(hdmiLUT3DRangeType range)
 				lutIndex = (b << 8) + (g << 4) + r;
 
 				// Red Output
-				lut3dActive.lut3D_C30_R[lutIndex].c0 = lut[r];
-				lut3dActive.lut3D_C30_R[lutIndex].c1 = 0;
-				lut3dActive.lut3D_C30_R[lutIndex].c2 = dlut[r];
-				lut3dActive.lut3D_C30_R[lutIndex].c3 = 0;
-				lut3dActive.lut3D_C74_R[lutIndex].c4 = 0;
-				lut3dActive.lut3D_C74_R[lutIndex].c5 = 0;
-				lut3dActive.lut3D_C74_R[lutIndex].c6 = 0;
-				lut3dActive.lut3D_C74_R[lutIndex].c7 = 0;
+				pack->lut3D_C30_R[lutIndex].c0 = lut[r];
+				pack->lut3D_C30_R[lutIndex].c1 = 0;
+				pack->lut3D_C30_R[lutIndex].c2 = dlut[r];
+				pack->lut3D_C30_R[lutIndex].c3 = 0;
+				pack->lut3D_C74_R[lutIndex].c4 = 0;
+				pack->lut3D_C74_R[lutIndex].c5 = 0;
+				pack->lut3D_C74_R[lutIndex].c6 = 0;
+				pack->lut3D_C74_R[lutIndex].c7 = 0;
 
 				// Green Output
-				lut3dActive.lut3D_C30_G[lutIndex].c0 = lut[g];
-				lut3dActive.lut3D_C30_G[lutIndex].c1 = 0;
-				lut3dActive.lut3D_C30_G[lutIndex].c2 = 0;
-				lut3dActive.lut3D_C30_G[lutIndex].c3 = dlut[g];
-				lut3dActive.lut3D_C74_G[lutIndex].c4 = 0;
-				lut3dActive.lut3D_C74_G[lutIndex].c5 = 0;
-				lut3dActive.lut3D_C74_G[lutIndex].c6 = 0;
-				lut3dActive.lut3D_C74_G[lutIndex].c7 = 0;
+				pack->lut3D_C30_G[lutIndex].c0 = lut[g];
+				pack->lut3D_C30_G[lutIndex].c1 = 0;
+				pack->lut3D_C30_G[lutIndex].c2 = 0;
+				pack->lut3D_C30_G[lutIndex].c3 = dlut[g];
+				pack->lut3D_C74_G[lutIndex].c4 = 0;
+				pack->lut3D_C74_G[lutIndex].c5 = 0;
+				pack->lut3D_C74_G[lutIndex].c6 = 0;
+				pack->lut3D_C74_G[lutIndex].c7 = 0;
 
 				// Blue Output
-				lut3dActive.lut3D_C30_B[lutIndex].c0 = lut[b];
-				lut3dActive.lut3D_C30_B[lutIndex].c1 = dlut[b];
-				lut3dActive.lut3D_C30_B[lutIndex].c2 = 0;
-				lut3dActive.lut3D_C30_B[lutIndex].c3 = 0;
-				lut3dActive.lut3D_C74_B[lutIndex].c4 = 0;
-				lut3dActive.lut3D_C74_B[lutIndex].c5 = 0;
-				lut3dActive.lut3D_C74_B[lutIndex].c6 = 0;
-				lut3dActive.lut3D_C74_B[lutIndex].c7 = 0;
+				pack->lut3D_C30_B[lutIndex].c0 = lut[b];
+				pack->lut3D_C30_B[lutIndex].c1 = dlut[b];
+				pack->lut3D_C30_B[lutIndex].c2 = 0;
+				pack->lut3D_C30_B[lutIndex].c3 = 0;
+				pack->lut3D_C74_B[lutIndex].c4 = 0;
+				pack->lut3D_C74_B[lutIndex].c5 = 0;
+				pack->lut3D_C74_B[lutIndex].c6 = 0;
+				pack->lut3D_C74_B[lutIndex].c7 = 0;
+			}
+		}
+	}
+}
+
+void hdmiLUT3DCube(hdmiLUT3DRangeType range)
+{
+	LUT3DPack_s * pack;
+	LUT3DKey_s key;
+	LUT3DCoefGroup_s * c30[3];
+	LUT3DCoefGroup_s * c74[3];
+	float offset, scale;
+	float v[8];
+	int lutIndex;
+
+	if(lut3dCube == 0)
+	{
+		hdmiLUT3DIdentity(range);
+		return;
+	}
+
+	key.range = range;
+	key.cube = lut3dCube;
+	key.valid = 1;
+	if(lut3dSelect(&key)) { return; }
+	pack = &lut3dCache[lut3dActiveSlot];
+
+	c30[0] = pack->lut3D_C30_R;
+	c74[0] = pack->lut3D_C74_R;
+	c30[1] = pack->lut3D_C30_G;
+	c74[1] = pack->lut3D_C74_G;
+	c30[2] = pack->lut3D_C30_B;
+	c74[2] = pack->lut3D_C74_B;
+
+	// Output range, as in lin709[] and linFull[].
+	if(range == HDMI_LUT3D_RANGE_FULL)
+	{
+		offset = 0.0f;
+		scale = 16384.0f;
+	}
+	else
+	{
+		offset = 1024.0f;
+		scale = 14336.0f;
+	}
+
+	for(int b = 0; b < 16; b++)
+	{
+		for(int g = 0; g < 16; g++)
+		{
+			for(int r = 0; r < 16; r++)
+			{
+				lutIndex = (b << 8) + (g << 4) + r;
+
+				for(int ch = 0; ch < 3; ch++)
+				{
+					// Cube corners, index bit 0: R, bit 1: G, bit 2: B.
+					for(int i = 0; i < 8; i++)
+					{
+						v[i] = offset + scale * lut3dCubeGrid[b + (i >> 2)][g + ((i >> 1) & 1)][r + (i & 1)][ch];
+					}
+
+					// Trilinear interpolation as a polynomial in the remainders dR, dG, dB, with the peripheral's
+					// scaling of the second and third order terms.
+					c30[ch][lutIndex].c0 = lut3dCoef(v[0], 1.0f);
+					c30[ch][lutIndex].c1 = lut3dCoef(v[4] - v[0], 1.0f);								// dB
+					c30[ch][lutIndex].c2 = lut3dCoef(v[1] - v[0], 1.0f);								// dR
+					c30[ch][lutIndex].c3 = lut3dCoef(v[2] - v[0], 1.0f);								// dG
+					c74[ch][lutIndex].c4 = lut3dCoef(v[5] - v[4] - v[1] + v[0], 16.0f);				// dB * dR
+					c74[ch][lutIndex].c5 = lut3dCoef(v[3] - v[2] - v[1] + v[0], 16.0f);				// dR * dG
+					c74[ch][lutIndex].c6 = lut3dCoef(v[6] - v[4] - v[2] + v[0], 16.0f);				// dG * dB
+					c74[ch][lutIndex].c7 = lut3dCoef(v[7] - v[6] - v[5] - v[3] + v[4] + v[2] + v[1] - v[0], 256.0f);
+				}
 			}
 		}
 	}
 }
 
+// Parses the file in CUBE_READ_SIZE pieces. Each B slice of the table is resampled to the grid as soon as the next
+// one is complete, so only two slices are kept. If the file is not a usable 3D LUT, no LUT is loaded.
+int hdmiLUT3DLoadCube(const char * path)
+{
+	cubeParser_s p;
+	u32 fill = 0, start, br;
+	int eof = 0;
+	int status = HDMI_LUT3D_OK;
+
+	lut3dCube = 0;
+
+	if(fsOpenFile(path) != 0) { return HDMI_LUT3D_ERROR_FILE; }
+
+	memset(&p, 0, sizeof(p));
+	for(int a = 0; a < 3; a++) { p.domainMax[a] = 1.0f; }
+
+	while(status == HDMI_LUT3D_OK)
+	{
+		if(fsReadFile((u8 *) cubeReadBuffer + fill, CUBE_READ_SIZE - fill, &br) != 0)
+		{
+			status = HDMI_LUT3D_ERROR_FILE;
+			break;
+		}
+		if(br == 0) { eof = 1; }
+		fill += br;
+
+		// Complete lines.
+		start = 0;
+		for(u32 i = 0; (i < fill) && (status == HDMI_LUT3D_OK); i++)
+		{
+			if(cubeReadBuffer[i] == '\n')
+			{
+				cubeReadBuffer[i] = '\0';
+				status = cubeParseLine(&p, &cubeReadBuffer[start]);
+				start = i + 1;
+			}
+		}
+		if(status != HDMI_LUT3D_OK) { break; }
+
+		if(eof)
+		{
+			// Last line without a newline.
+			cubeReadBuffer[fill] = '\0';
+			if(start < fill) { status = cubeParseLine(&p, &cubeReadBuffer[start]); }
+			break;
+		}
+
+		if((start == 0) && (fill == CUBE_READ_SIZE)) { status = HDMI_LUT3D_ERROR_FORMAT; }
+		memmove(cubeReadBuffer, &cubeReadBuffer[start], fill - start);
+		fill -= start;
+	}
+
+	fsCloseClipFile();
+
+	if((status == HDMI_LUT3D_OK) && ((p.size == 0) || (p.nEntries != (u32)(p.size * p.size * p.size))))
+	{ status = HDMI_LUT3D_ERROR_FORMAT; }
+
+	if(status == HDMI_LUT3D_OK)
+	{
+		lut3dCubeCount++;
+		lut3dCube = lut3dCubeCount;
+	}
+
+	return status;
+}
+
 void hdmiLUT3DApply(void)
 {
-	memcpy(lut3dC30R, &lut3dActive.lut3D_C30_R[0], sizeof(LUT3DCoefGroup_s) * 4096);
-	memcpy(lut3dC74R, &lut3dActive.lut3D_C74_R[0], sizeof(LUT3DCoefGroup_s) * 4096);
-	memcpy(lut3dC30G, &lut3dActive.lut3D_C30_G[0], sizeof(LUT3DCoefGroup_s) * 4096);
-	memcpy(lut3dC74G, &lut3dActive.lut3D_C74_G[0], sizeof(LUT3DCoefGroup_s) * 4096);
-	memcpy(lut3dC30B, &lut3dActive.lut3D_C30_B[0], sizeof(LUT3DCoefGroup_s) * 4096);
-	memcpy(lut3dC74B, &lut3dActive.lut3D_C74_B[0], sizeof(LUT3DCoefGroup_s) * 4096);
+	const LUT3DPack_s * pack = &lut3dCache[lut3dActiveSlot];
+
+	if(lut3dKeyMatches(&lut3dUploaded, &lut3dSlot[lut3dActiveSlot].key)) { return; }
+
+	// The six coefficient tables are contiguous in both the pack and the URAMs.
+	dmaUpload(lut3dC30R, &pack->lut3D_C30_R[0], sizeof(LUT3DCoefGroup_s) * 4096 * 6, lut3dUploadDone, NULL);
+	lut3dUploaded = lut3dSlot[lut3dActiveSlot].key;
 }
 
 // Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Makes the pack built from key active. Returns 1 if it was cached, or 0 if the least recently used pack was assigned
+// to key and has to be built.
+u32 lut3dSelect(const LUT3DKey_s * key)
+{
+	u32 slot, lru;
+
+	lut3dUseCount++;
+
+	for(slot = 0; slot < LUT3D_CACHE_SLOTS; slot++)
+	{
+		if(lut3dKeyMatches(&lut3dSlot[slot].key, key))
+		{
+			lut3dSlot[slot].lastUse = lut3dUseCount;
+			lut3dActiveSlot = slot;
+			return 1;
+		}
+	}
+
+	// Least recently used slot other than the active one. Unused slots come first.
+	lru = (lut3dActiveSlot == 0) ? 1 : 0;
+	for(slot = 0; slot < LUT3D_CACHE_SLOTS; slot++)
+	{
+		if(slot == lut3dActiveSlot) { continue; }
+		if(lut3dSlot[slot].lastUse < lut3dSlot[lru].lastUse) { lru = slot; }
+	}
+
+	lut3dSlot[lru].key = *key;
+	lut3dSlot[lru].lastUse = lut3dUseCount;
+	lut3dActiveSlot = lru;
+	return 0;
+}
+
+u32 lut3dKeyMatches(const LUT3DKey_s * a, const LUT3DKey_s * b)
+{
+	return a->valid && b->valid && (a->range == b->range) && (a->cube == b->cube);
+}
+
+// A failed upload leaves the URAMs unknown, so the next Apply uploads the pack again.
+void lut3dUploadDone(void * ctx, u32 status)
+{
+	if(status != DMA_OK) { lut3dUploaded.valid = 0; }
+}
+
+// Rounds and saturates a coefficient. Only the second and third order terms of very steep LUTs can saturate.
+s16 lut3dCoef(float x, float scale)
+{
+	long c = lroundf(x * scale);
+
+	if(c > 32767) { c = 32767; }
+	else if(c < -32768) { c = -32768; }
+
+	return (s16) c;
+}
+
+int cubeParseLine(cubeParser_s * p, char * line)
+{
+	const char * str;
+
+	while((*line == ' ') || (*line == '\t')) { line++; }
+
+	// Table entry
+	if(((*line >= '0') && (*line <= '9')) || (*line == '-') || (*line == '+') || (*line == '.'))
+	{
+		return cubeParseEntry(p, line);
+	}
+
+	// Keywords come before the table.
+	if(p->nEntries > 0) { return ((*line == '\0') || (*line == '\r') || (*line == '#')) ? HDMI_LUT3D_OK : HDMI_LUT3D_ERROR_FORMAT; }
+
+	if((str = cubeKeyword(line, "LUT_3D_SIZE")) != NULL)
+	{
+		p->size = atoi(str);
+		if((p->size < 2) || (p->size > CUBE_SIZE_MAX)) { return HDMI_LUT3D_ERROR_SIZE; }
+	}
+	else if((str = cubeKeyword(line, "DOMAIN_MIN")) != NULL)
+	{
+		for(int a = 0; a < 3; a++)
+		{
+			str = cubeParseFloat(str, &p->domainMin[a]);
+			if(str == NULL) { return HDMI_LUT3D_ERROR_FORMAT; }
+		}
+	}
+	else if((str = cubeKeyword(line, "DOMAIN_MAX")) != NULL)
+	{
+		for(int a = 0; a < 3; a++)
+		{
+			str = cubeParseFloat(str, &p->domainMax[a]);
+			if(str == NULL) { return HDMI_LUT3D_ERROR_FORMAT; }
+		}
+	}
+	else if((str = cubeKeyword(line, "LUT_3D_INPUT_RANGE")) != NULL)
+	{
+		// Older form of DOMAIN_MIN/MAX, the same for all axes.
+		if((str = cubeParseFloat(str, &p->domainMin[0])) == NULL) { return HDMI_LUT3D_ERROR_FORMAT; }
+		if((str = cubeParseFloat(str, &p->domainMax[0])) == NULL) { return HDMI_LUT3D_ERROR_FORMAT; }
+		for(int a = 1; a < 3; a++)
+		{
+			p->domainMin[a] = p->domainMin[0];
+			p->domainMax[a] = p->domainMax[0];
+		}
+	}
+	else if(cubeKeyword(line, "LUT_1D_SIZE") != NULL)
+	{
+		return HDMI_LUT3D_ERROR_FORMAT;
+	}
+
+	// TITLE, comments, blank lines, and other keywords are ignored.
+	return HDMI_LUT3D_OK;
+}
+
+int cubeParseEntry(cubeParser_s * p, const char * line)
+{
+	u32 sliceSize, slice;
+	float * entry;
+	float t;
+
+	if(p->size == 0) { return HDMI_LUT3D_ERROR_FORMAT; }
+	sliceSize = p->size * p->size;
+	slice = p->nEntries / sliceSize;
+	if(slice == (u32) p->size) { return HDMI_LUT3D_ERROR_FORMAT; }
+
+	if(p->nEntries == 0)
+	{
+		// Header complete: place the grid points in the table. Grid point n is input n / 16 on each axis.
+		for(int a = 0; a < 3; a++)
+		{
+			if(!(p->domainMax[a] > p->domainMin[a])) { return HDMI_LUT3D_ERROR_FORMAT; }
+
+			for(int n = 0; n < LUT3D_GRID; n++)
+			{
+				t = ((float) n / (LUT3D_GRID - 1) - p->domainMin[a]) / (p->domainMax[a] - p->domainMin[a]);
+				t *= (float)(p->size - 1);
+				if(t < 0.0f) { t = 0.0f; }
+				else if(t > (float)(p->size - 1)) { t = (float)(p->size - 1); }
+
+				p->i0[a][n] = (int) t;
+				if(p->i0[a][n] > p->size - 2) { p->i0[a][n] = p->size - 2; }
+				p->f[a][n] = t - (float) p->i0[a][n];
+			}
+		}
+	}
+
+	// R changes fastest, then G, then B.
+	entry = cubeSlice[slice & 1][p->nEntries % sliceSize];
+	for(int ch = 0; ch < 3; ch++)
+	{
+		line = cubeParseFloat(line, &entry[ch]);
+		if(line == NULL) { return HDMI_LUT3D_ERROR_FORMAT; }
+	}
+	p->nEntries++;
+
+	if((slice > 0) && ((p->nEntries % sliceSize) == 0)) { cubeResampleSlice(p, slice - 1); }
+
+	return HDMI_LUT3D_OK;
+}
+
+// Grid points between B slice b and b + 1 of the table, by trilinear interpolation.
+void cubeResampleSlice(cubeParser_s * p, int b)
+{
+	const float (* s0)[3] = cubeSlice[b & 1];
+	const float (* s1)[3] = cubeSlice[(b + 1) & 1];
+	int size = p->size;
+	int i00, i01, i10, i11;
+	float fR, fG, fB;
+	float c0, c1;
+
+	for(int nB = 0; nB < LUT3D_GRID; nB++)
+	{
+		if(p->i0[2][nB] != b) { continue; }
+		fB = p->f[2][nB];
+
+		for(int nG = 0; nG < LUT3D_GRID; nG++)
+		{
+			fG = p->f[1][nG];
+			for(int nR = 0; nR < LUT3D_GRID; nR++)
+			{
+				fR = p->f[0][nR];
+				i00 = p->i0[1][nG] * size + p->i0[0][nR];
+				i01 = i00 + 1;
+				i10 = i00 + size;
+				i11 = i10 + 1;
+
+				for(int ch = 0; ch < 3; ch++)
+				{
+					c0 = (1.0f - fG) * ((1.0f - fR) * s0[i00][ch] + fR * s0[i01][ch])
+					   + fG * ((1.0f - fR) * s0[i10][ch] + fR * s0[i11][ch]);
+					c1 = (1.0f - fG) * ((1.0f - fR) * s1[i00][ch] + fR * s1[i01][ch])
+					   + fG * ((1.0f - fR) * s1[i10][ch] + fR * s1[i11][ch]);
+					lut3dCubeGrid[nB][nG][nR][ch] = c0 + fB * (c1 - c0);
+				}
+			}
+		}
+	}
+}
+
+// Decimal floating point number, with optional exponent. Returns the end of the number, or NULL if there is none.
+const char * cubeParseFloat(const char * str, float * val)
+{
+	static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+	u64 mantissa = 0;
+	int exponent = 0, exponentIn = 0;
+	int digits = 0;
+	int negative = 0, negativeExponent = 0;
+	double d;
+
+	while((*str == ' ') || (*str == '\t')) { str++; }
+
+	if(*str == '-') { negative = 1; str++; }
+	else if(*str == '+') { str++; }
+
+	for(; (*str >= '0') && (*str <= '9'); str++, digits++)
+	{
+		if(mantissa < 100000000000000000ULL) { mantissa = mantissa * 10 + (*str - '0'); }
+		else { exponent++; }
+	}
+	if(*str == '.')
+	{
+		for(str++; (*str >= '0') && (*str <= '9'); str++, digits++)
+		{
+			if(mantissa < 100000000000000000ULL)
+			{
+				mantissa = mantissa * 10 + (*str - '0');
+				exponent--;
+			}
+		}
+	}
+	if(digits == 0) { return NULL; }
+
+	if((*str == 'e') || (*str == 'E'))
+	{
+		str++;
+		if(*str == '-') { negativeExponent = 1; str++; }
+		else if(*str == '+') { str++; }
+		for(; (*str >= '0') && (*str <= '9'); str++)
+		{
+			if(exponentIn < 1000) { exponentIn = exponentIn * 10 + (*str - '0'); }
+		}
+		exponent += negativeExponent ? -exponentIn : exponentIn;
+	}
+
+	d = (double) mantissa;
+	if((exponent >= 0) && (exponent <= 22)) { d *= pow10[exponent]; }
+	else if((exponent < 0) && (exponent >= -22)) { d /= pow10[-exponent]; }
+	else { d *= pow(10.0, exponent); }
+
+	*val = (float)(negative ? -d : d);
+	return str;
+}
+
+// Returns the rest of the line if it starts with keyword, otherwise NULL.
+const char * cubeKeyword(const char * line, const char * keyword)
+{
+	size_t n = strlen(keyword);
+
+	if(strncmp(line, keyword, n) != 0) { return NULL; }
+	if((line[n] != ' ') && (line[n] != '\t') && (line[n] != '\r') && (line[n] != '\0')) { return NULL; }
+
+	return line + n;
+}
@@ -29,6 +29,15 @@ THE SOFTWARE.
 
 // Public Pre-Processor Definitions ------------------------------------------------------------------------------------
 
+// User 3D LUT, loaded from the SSD at startup if present.
+#define HDMI_LUT3D_CUBE_PATH "/lut.cube"
+
+// .cube loader status
+#define HDMI_LUT3D_OK                   0x00
+#define HDMI_LUT3D_ERROR_FILE           0x01    // Could not be opened or read.
+#define HDMI_LUT3D_ERROR_FORMAT         0x02    // Malformed, or not a 3D LUT.
+#define HDMI_LUT3D_ERROR_SIZE           0x03    // Grid size not supported.
+
 // Public Type Definitions ---------------------------------------------------------------------------------------------
 
 typedef enum
@@ -42,7 +51,13 @@ typedef enum
 // Build an identity LUT1D Pack in RAM.
 void hdmiLUT3DIdentity(hdmiLUT3DRangeType range);
 
-// Apply the active LUT1D Pack in RAM to the HDMI peripheral LUT1D URAMs.
+// Build a LUT3D Pack in RAM from the loaded .cube LUT, or an identity LUT3D Pack if none is loaded.
+void hdmiLUT3DCube(hdmiLUT3DRangeType range);
+
+// Load a .cube 3D LUT of any grid size from the SSD, resampled to the HDMI peripheral's 17x17x17 grid.
+int hdmiLUT3DLoadCube(const char * path);
+
+// Apply the active LUT3D Pack in RAM to the HDMI peripheral LUT3D URAMs. The upload runs in the background.
 void hdmiLUT3DApply(void);
 
 // Externed Public Global Variables ------------------------------------------------------------------------------------
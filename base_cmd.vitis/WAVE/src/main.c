@@ -46,6 +46,9 @@
 #include "frame.h"
 #include "camera_state.h"
 #include "cal.h"
+#include "dma.h"
+#include "playback.h"
+#include "scope.h"
 
 #include "xscugic.h"
 #include "xil_cache.h"
@@ -58,6 +61,11 @@
 #define MAIN_SERVICE_SUPERVISOR 2
 #define MAIN_SERVICE_UI 3
 #define MAIN_SERVICE_HDMI 4
+#define MAIN_SERVICE_SCOPE 5
+
+// Time per frame given to the exposure scopes. Less while recording, so frameAddToClip() is not held off as long.
+#define MAIN_SCOPE_BUDGET_US 2000
+#define MAIN_SCOPE_BUDGET_REC_US 500
 
 void isrFOT(void * CallbackRef);
 void isrVSYNC(void * CallbackRef);
@@ -98,6 +106,7 @@ int main()
 
     // Configure peripherals.
     gpioInit();
+    dmaInit();
     supervisorInit();
     xil_printf("WAVE HELLO!\r\n");
     calInit();
@@ -147,15 +156,22 @@ int main()
     XScuGic_SetPriorityTriggerType(&Gic, 48, 0x10, 0x01);
     XScuGic_Enable(&Gic, 48);
 
+    // Configure and enable the DMA upload interrupt (Lowest Priority: 0x18).
+    XScuGic_Connect(&Gic, DMA_INTR_ID, (Xil_ExceptionHandler) isrDMA, (void *) &Gic);
+    XScuGic_SetPriorityTriggerType(&Gic, DMA_INTR_ID, 0x18, 0x01);
+    XScuGic_Enable(&Gic, DMA_INTR_ID);
+
     Xil_ExceptionEnable();
 
     usleep(1000);
 
     fsInit();
+    nvmeEnterStandby();		// Camera starts in STANDBY.
     hdmiInit();
     usbInit();
     frameInit();
     uiInit();
+    scopeInit();
     imuInit();
 
     // Main loop.
@@ -167,6 +183,10 @@ int main()
     	{
     		frameAddToClip();
     	}
+    	else if(cState.cSetting[CSETTING_MODE]->val == CSETTING_MODE_PLAYBACK)
+    	{
+    		playbackService();
+    	}
 
     	// Main loop service state machine.
     	switch(mainServiceState)
@@ -191,17 +211,37 @@ int main()
     		break;
     	case MAIN_SERVICE_HDMI:
     		hdmiService();
+    		mainServiceState = MAIN_SERVICE_SCOPE;
+    		break;
+    	case MAIN_SERVICE_SCOPE:
+    		if(cState.cSetting[CSETTING_SCOPES]->val == CSETTING_SCOPES_ON)
+    		{
+    			if(cState.cSetting[CSETTING_MODE]->val == CSETTING_MODE_REC)
+    			{ scopeService(MAIN_SCOPE_BUDGET_REC_US); }
+    			else
+    			{ scopeService(MAIN_SCOPE_BUDGET_US); }
+    		}
     		mainServiceState = MAIN_SERVICE_IDLE;
+    		break;
     	case MAIN_SERVICE_IDLE:
     	default:
     		mainServiceState = MAIN_SERVICE_IDLE;
     		break;
     	}
 
+    	// A plain format keeps the LBA format. Switching it is a separate choice, since Format NVM can hold up the main
+    	// loop for up to a minute on some drives.
     	if(cState.cSetting[CSETTING_FORMAT]->val == CSETTING_FORMAT_CONFIRM)
     	{
     		cState.cSetting[CSETTING_FORMAT]->val = CSETTING_FORMAT_CANCEL;
-    		fsFormat();
+    		fsFormat(0);
+    		usbUpdateCapacity();
+    	}
+    	else if(cState.cSetting[CSETTING_FORMAT]->val == CSETTING_FORMAT_OPTIMIZE)
+    	{
+    		cState.cSetting[CSETTING_FORMAT]->val = CSETTING_FORMAT_CANCEL;
+    		fsFormat(1);
+    		usbUpdateCapacity();
     	}
 
     	if(closeFileSystem)
@@ -46,6 +46,14 @@ THE SOFTWARE.
 
 #define WORKLOAD_SEQUENTIAL 0x2     // Workload Hint for NVMe Controller
 
+#define HMB_SIZE_MAX 0x4000         // Host Memory Buffer Size Limit: 64MiB in [4KiB]
+
+#define FORMAT_TIMEOUT_MS 60000     // Format NVM without secure erase. Usually completes in a few seconds.
+
+#define STANDBY_LATENCY_MAX_US 50000    // Entry + exit latency budget for the standby power state.
+#define APST_IDLE_MIN_MS 100            // Minimum idle time before an autonomous transition.
+#define APST_IDLE_LATENCY_MULT 50       // Idle time as a multiple of the state's entry + exit latency.
+
 // Private Type Definitions --------------------------------------------------------------------------------------------
 
 // Private Function Prototypes -----------------------------------------------------------------------------------------
@@ -56,6 +64,8 @@ int nvmeInitController(u32 tTimeout_ms);
 int nvmeIdentifyController(u32 tTimeout_ms);
 int nvmeIdentifyNamespace(u32 tTimeout_ms);
 int nvmeSetPowerState(u8 PS, u8 WH, u32 tTimeout_ms);
+int nvmeSetHostMemoryBuffer(u32 tTimeout_ms);
+int nvmeSetAPST(u8 enable, u32 tTimeout_ms);
 int nvmeCreateIOQueues(u32 tTimeout_ms);
 int nvmeGetSMARTHealth(void);
 
@@ -64,9 +74,13 @@ void nvmeParsePowerStates();
 int nvmeAdminCommand(const sqe_prp_type * sqe, cqe_type * cqe, u32 tTimeout_ms);
 void nvmeSubmitAdminCommand(const sqe_prp_type * sqe);
 int nvmeCompleteAdminCommand(cqe_type * cqe, u32 tTimeout_ms);
+void nvmeServiceAdminCompletions(void);
 
 void nvmeSubmitIOCommand(const sqe_prp_type * sqe);
 int nvmeCompleteIOCommands(cqe_type * cqe, u16 maxCompletions);
+void nvmeHistogramSubmit(u32 size);
+void nvmeWaitIOSlot(void);
+void nvmeHistogramComplete(u16 cid);
 
 int nvmeCheckTimeout(XTime tStart, u32 tTimeout_ms);
 
@@ -104,10 +118,18 @@ idController_type * idController = (idController_type *)(0x10004000);
 idNamespace_type * idNamespace = (idNamespace_type *)(0x10005000);
 logSMARTHealth_type * logSMARTHealth = (logSMARTHealth_type *)(0x10006000);
 
+// Host Memory Buffer for DRAM-less drives, sized by HMPRE up to HMB_SIZE_MAX.
+// One contiguous buffer described by a single-entry descriptor list. Buffer ends at the frame header ring (0x18000000).
+hmbDescriptor_type * hmbDescriptorList = (hmbDescriptor_type *)(0x10007000);
+u8 * hmbBuffer = (u8 *)(0x14000000);
+
 // Heap space for PRP lists for IO Transfers.
 // Heap size is (IOSQ_SIZE + 1) * DDR_PAGE_SIZE.
 u64 * prpListHeap = (u64 *)(0x10008000);
 
+// Autonomous Power State Transition table, 32 QWORD entries.
+u64 * apstTable = (u64 *)(0x10048000);
+
 descPowerState_type descPowerState[32];
 
 u16 asq_tail_local = 0;
@@ -121,10 +143,28 @@ int nvmeStatus = NVME_NOINIT;
 u32 nsid = 1;
 u8 lba_exp = 9;
 u8 ps_idle = 0;
+u8 ps_standby = 0;
+u8 apst_enabled = 0;
 u32 lba_size = 512;
 u16 admin_cid = 0;
 u16 io_cid = 0;
 u16 io_cid_last_completed = 0xFFFF;
+u16 io_outstanding = 0;
+u32 hmb_size = 0;
+
+// Write command telemetry. Submit timestamps are indexed by CID, same as the PRP list heap.
+nvmeHistogram_s writeHistogram;
+nvmeWindow_s writeWindow;
+XTime io_tSubmit[IOSQ_SIZE + 1];
+u8 io_timed[IOSQ_SIZE + 1];
+
+// Outstanding I/O commands and the LBA range of outstanding writes, indexed by CID like the PRP list heap.
+// Commands may complete out of order, so completion is tracked per CID rather than by the last CID completed.
+u8 io_pending[IOSQ_SIZE + 1];
+u64 io_slba[IOSQ_SIZE + 1];
+u32 io_nlb[IOSQ_SIZE + 1];			// 0 for reads and flushes.
+u8 io_failed[IOSQ_SIZE + 1];		// Completed with a non-zero status.
+u32 io_errors = 0;					// I/O commands completed with a non-zero status, since init.
 
 // Interrupt Handlers --------------------------------------------------------------------------------------------------
 
@@ -151,6 +191,9 @@ int nvmeInit(void)
 	// nvmeStatus |= nvmeSetPowerState(0, WORKLOAD_SEQUENTIAL, 1000);
 	// if(nvmeStatus != NVME_OK) { return nvmeStatus; }
 
+	// Not fatal: a DRAM-less drive still works without its Host Memory Buffer, just much slower.
+	nvmeSetHostMemoryBuffer(10);
+
 	nvmeStatus |= nvmeCreateIOQueues(10);
 	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
 
@@ -207,6 +250,111 @@ float nvmeGetTemp(void)
 	return nvmeTf;
 }
 
+// Drop to the standby power state between takes. With APST, the drive enters it on its own once idle.
+int nvmeEnterStandby(void)
+{
+	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
+	if(ps_idle == 0) { return NVME_OK; }	// No non-operational state within the latency budget.
+
+	if(idController->APSTA & 0x01)
+	{
+		if(nvmeSetAPST(1, 10) == NVME_OK)
+		{
+			apst_enabled = 1;
+			ps_standby = ps_idle;
+			return NVME_OK;
+		}
+	}
+
+	if(nvmeSetPowerState(ps_idle, 0, 10) != NVME_OK) { return NVME_ERROR_POWER_STATE_TRANSITION; }
+	ps_standby = ps_idle;
+
+	return NVME_OK;
+}
+
+// Return to full power before recording, waiting out the standby state's exit latency.
+int nvmeExitStandby(void)
+{
+	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
+
+	if(apst_enabled)
+	{
+		nvmeSetAPST(0, 10);
+		apst_enabled = 0;
+	}
+
+	if(nvmeSetPowerState(0, WORKLOAD_SEQUENTIAL, 10) != NVME_OK)
+	{
+		// Workload hints are optional. Retry without one.
+		if(nvmeSetPowerState(0, 0, 10) != NVME_OK) { return NVME_ERROR_POWER_STATE_TRANSITION; }
+	}
+
+	if(ps_standby != 0)
+	{
+		usleep(descPowerState[ps_standby].tExit_us + descPowerState[0].tEnter_us);
+		ps_standby = 0;
+	}
+
+	return NVME_OK;
+}
+
+// Reformat the namespace to the LBA format with the best Relative Performance, preferring larger LBAs on a tie.
+// Destroys all data. Does nothing if the current format is already the best one or the drive can't format.
+int nvmeSelectBestLBAFormat(void)
+{
+	sqe_prp_type sqe;
+	cqe_type cqe;
+	u32 lbaf;
+	u8 lbads, rp;
+	u8 iBest = idNamespace->FLBAS & FLBAS_FORMAT_Msk;
+	u8 lbadsBest = lba_exp;
+	u8 rpBest = (idNamespace->LBAF[iBest] & LBAF_RP_Msk) >> LBAF_RP_Pos;
+
+	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
+	if(!(idController->OACS & OACS_FORMAT_NVM)) { return NVME_OK; }
+
+	for(int i = 0; i <= idNamespace->NLBAF; i++)
+	{
+		lbaf = idNamespace->LBAF[i];
+		lbads = (lbaf & LBAF_LBADS_Msk) >> LBAF_LBADS_Pos;
+		rp = (lbaf & LBAF_RP_Msk) >> LBAF_RP_Pos;
+		if((lbaf & LBAF_MS_Msk) || (lbads < 9) || (lbads > 12)) { continue; }
+
+		if((rp < rpBest) || ((rp == rpBest) && (lbads > lbadsBest)))
+		{
+			iBest = i;
+			lbadsBest = lbads;
+			rpBest = rp;
+		}
+	}
+	if(iBest == (idNamespace->FLBAS & FLBAS_FORMAT_Msk)) { return NVME_OK; }
+
+	// No I/O may be outstanding across a format.
+	while(nvmeGetIOSlip() > 0)
+	{
+		nvmeServiceIOCompletions(16);
+	}
+
+	// Format NVM: No secure erase, no protection information, metadata (none) in separate buffer.
+	memset(&sqe, 0, sizeof(sqe_prp_type));
+	sqe.CID = admin_cid;
+	sqe.OPC = 0x80;
+	sqe.NSID = nsid;
+	sqe.CDW10 = iBest & FLBAS_FORMAT_Msk;
+	if(nvmeAdminCommand(&sqe, &cqe, FORMAT_TIMEOUT_MS) != NVME_OK) { return NVME_ERROR_FORMAT; }
+	if(cqe.SF_P >> 1) { return NVME_ERROR_FORMAT; }
+
+	// Pick up the new LBA size and count.
+	nvmeStatus = nvmeIdentifyNamespace(10);
+
+	return nvmeStatus;
+}
+
+u32 nvmeGetHMBSize(void)
+{
+	return hmb_size << DDR_PAGE_EXP;
+}
+
 int nvmeWrite(const u8 * srcByte, u64 destLBA, u32 numLBA)
 {
 	sqe_prp_type sqe;
@@ -216,6 +364,7 @@ int nvmeWrite(const u8 * srcByte, u64 destLBA, u32 numLBA)
 	u64 * prpList = prpListHeap + ((io_cid & IOSQ_SIZE) * (DDR_PAGE_SIZE >> 3));
 
 	if ((u64) srcByte & 0x3) { return 1; } 	// Must be DWORD-aligned!
+	nvmeWaitIOSlot();
 
 	memset(&sqe, 0, sizeof(sqe_prp_type));
 	sqe.CID = io_cid;
@@ -253,6 +402,7 @@ int nvmeWrite(const u8 * srcByte, u64 destLBA, u32 numLBA)
 		}
 	}
 
+	nvmeHistogramSubmit(numLBA << lba_exp);
 	nvmeSubmitIOCommand(&sqe);
 
 	return 0;
@@ -263,6 +413,7 @@ int nvmeFlush()
 	sqe_prp_type sqe;
 	XTime tStart;
 	XTime_GetTime(&tStart);
+	nvmeWaitIOSlot();
 
 	memset(&sqe, 0, sizeof(sqe_prp_type));
 	sqe.CID = io_cid;
@@ -283,6 +434,7 @@ int nvmeRead(u8 * destByte, u64 srcLBA, u32 numLBA)
 	u64 * prpList = prpListHeap + ((io_cid & IOSQ_SIZE) * (DDR_PAGE_SIZE >> 3));
 
 	if ((u64) destByte & 0x3) { return 1; } 	// Must be DWORD-aligned!
+	nvmeWaitIOSlot();
 
 	memset(&sqe, 0, sizeof(sqe_prp_type));
 	sqe.CID = io_cid;
@@ -337,7 +489,107 @@ int nvmeServiceIOCompletions(u16 maxCompletions)
 
 u16 nvmeGetIOSlip(void)
 {
-	return (u16)(io_cid - io_cid_last_completed - 1);
+	return io_outstanding;
+}
+
+// CID the next I/O command will be submitted with.
+u16 nvmeGetIOCID(void)
+{
+	return io_cid;
+}
+
+// Count of I/O commands completed with an error. Unlike nvmeCheckCIDRange(), never loses one to CID reuse.
+u32 nvmeGetIOErrorCount(void)
+{
+	return io_errors;
+}
+
+// Valid for the last (IOSQ_SIZE + 1) CIDs submitted.
+u8 nvmeIOCompleted(u16 cid)
+{
+	return !io_pending[cid & IOSQ_SIZE];
+}
+
+// Status of the commands with CIDs [cidFirst, cidFirst + nCommands): NVME_IO_PENDING until all have completed, then
+// NVME_IO_ERROR if any completed with an error. CIDs older than the I/O queue depth have completed and their slots
+// were reused, so their status is no longer known and they count as OK.
+int nvmeCheckCIDRange(u16 cidFirst, u16 nCommands)
+{
+	int status = NVME_IO_OK;
+	u16 cid;
+
+	for(u16 c = 0; c < nCommands; c++)
+	{
+		cid = cidFirst + c;
+		if((u16)(io_cid - cid) > (IOSQ_SIZE + 1)) { continue; }
+
+		if(io_pending[cid & IOSQ_SIZE]) { return NVME_IO_PENDING; }
+		if(io_failed[cid & IOSQ_SIZE]) { status = NVME_IO_ERROR; }
+	}
+
+	return status;
+}
+
+// Blocking version of nvmeCheckCIDRange(): NVME_IO_OK or NVME_IO_ERROR.
+int nvmeWaitCIDRange(u16 cidFirst, u16 nCommands)
+{
+	int status;
+
+	while((status = nvmeCheckCIDRange(cidFirst, nCommands)) == NVME_IO_PENDING)
+	{
+		nvmeServiceIOCompletions(16);
+	}
+
+	return status;
+}
+
+// Wait only for outstanding writes that overlap [lba, lba + numLBA), e.g. before reading those LBAs.
+void nvmeWaitForWrites(u64 lba, u32 numLBA)
+{
+	for(int i = 0; i <= IOSQ_SIZE; i++)
+	{
+		while(io_pending[i] && (io_nlb[i] > 0) && (io_slba[i] < lba + numLBA) && (lba < io_slba[i] + io_nlb[i]))
+		{
+			nvmeServiceIOCompletions(16);
+		}
+	}
+}
+
+void nvmeHistogramReset(void)
+{
+	memset(&writeHistogram, 0, sizeof(nvmeHistogram_s));
+	memset(&writeWindow, 0, sizeof(nvmeWindow_s));
+}
+
+const nvmeHistogram_s * nvmeGetHistogram(void)
+{
+	return &writeHistogram;
+}
+
+// Upper edge of the latency bin containing the p-th percentile (0.0 to 1.0) of writes, in [us].
+u32 nvmeHistogramPercentile_us(float p)
+{
+	u64 nTarget;
+	u64 nCumulative = 0;
+
+	if(writeHistogram.nWrites == 0) { return 0; }
+
+	nTarget = (u64)(p * (float) writeHistogram.nWrites);
+	if(nTarget >= writeHistogram.nWrites) { return writeHistogram.latencyMax_us; }
+
+	for(int b = 0; b < NVME_HIST_LATENCY_BINS - 1; b++)
+	{
+		nCumulative += writeHistogram.latency[b];
+		if(nCumulative > nTarget) { return (1 << b); }
+	}
+
+	return writeHistogram.latencyMax_us;
+}
+
+void nvmeGetWriteWindow(nvmeWindow_s * window)
+{
+	*window = writeWindow;
+	memset(&writeWindow, 0, sizeof(nvmeWindow_s));
 }
 
 // Private Function Definitions ----------------------------------------------------------------------------------------
@@ -440,6 +692,7 @@ int nvmeIdentifyNamespace(u32 tTimeout_ms)
 	u32 nvmeStatus = NVME_OK;
 	sqe_prp_type sqe;
 	cqe_type cqe;
+	u32 lbaf;
 
 	// First, get a list of all Active NSIDs.
 	memset(&sqe, 0, sizeof(sqe_prp_type));
@@ -463,7 +716,10 @@ int nvmeIdentifyNamespace(u32 tTimeout_ms)
 	nvmeStatus = nvmeAdminCommand(&sqe, &cqe, tTimeout_ms);
 	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
 
-	lba_exp = (idNamespace->LBAF[idNamespace->FLBAS]) >> 16;
+	// FLBAS bit 4 selects extended metadata, only bits 3:0 index the format. Formats with metadata aren't supported.
+	lbaf = idNamespace->LBAF[idNamespace->FLBAS & FLBAS_FORMAT_Msk];
+	if(lbaf & LBAF_MS_Msk) { return NVME_ERROR_LBA_SIZE; }
+	lba_exp = (lbaf & LBAF_LBADS_Msk) >> LBAF_LBADS_Pos;
 	if((lba_exp < 9) || (lba_exp > 12)) { return NVME_ERROR_LBA_SIZE; }
 	lba_size = (1 << lba_exp);
 
@@ -489,12 +745,82 @@ int nvmeSetPowerState(u8 PS, u8 WH, u32 tTimeout_ms)
 	}
 	nvmeStatus = nvmeAdminCommand(&sqe, &cqe, tTimeout_ms);
 	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
+	if(cqe.SF_P >> 1) { return NVME_ERROR_POWER_STATE_TRANSITION; }
 
 	// Not checking for Power State in the CQE because it may indicate the current state rather than the target state.
 
 	return NVME_OK;
 }
 
+int nvmeSetHostMemoryBuffer(u32 tTimeout_ms)
+{
+	u32 nvmeStatus = NVME_OK;
+	sqe_prp_type sqe;
+	cqe_type cqe;
+	u32 size;
+
+	// Drives with their own DRAM don't request a Host Memory Buffer.
+	if(idController->HMPRE == 0) { return NVME_OK; }
+
+	size = idController->HMPRE;
+	if(size > HMB_SIZE_MAX) { size = HMB_SIZE_MAX; }
+	if(size < idController->HMMIN) { return NVME_ERROR_HMB; }
+	if(size < idController->HMMINDS) { return NVME_ERROR_HMB; }
+
+	memset(hmbDescriptorList, 0, DDR_PAGE_SIZE);
+	hmbDescriptorList[0].BADD = (u64) hmbBuffer;
+	hmbDescriptorList[0].BSIZE = size;
+
+	// Set Features: Host Memory Buffer
+	memset(&sqe, 0, sizeof(sqe_prp_type));
+	sqe.CID = admin_cid;
+	sqe.OPC = 0x09;
+	sqe.CDW10 = 0x0D;
+	sqe.CDW11 = 0x00000001;	// Enable Host Memory, contents not preserved.
+	sqe.CDW12 = size;
+	sqe.CDW13 = (u64) hmbDescriptorList & 0xFFFFFFFF;
+	sqe.CDW14 = ((u64) hmbDescriptorList >> 32) & 0xFFFFFFFF;
+	sqe.CDW15 = 1;			// Descriptor List Entry Count
+	nvmeStatus = nvmeAdminCommand(&sqe, &cqe, tTimeout_ms);
+	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
+	if(cqe.SF_P >> 1) { return NVME_ERROR_HMB; }
+
+	hmb_size = size;
+
+	return NVME_OK;
+}
+
+int nvmeSetAPST(u8 enable, u32 tTimeout_ms)
+{
+	u32 nvmeStatus = NVME_OK;
+	sqe_prp_type sqe;
+	cqe_type cqe;
+	u32 tIdle_ms;
+
+	// Every operational state transitions to the standby state after an idle time that scales with its latency.
+	memset(apstTable, 0, 32 * sizeof(u64));
+	tIdle_ms = (descPowerState[ps_idle].tEnter_us + descPowerState[ps_idle].tExit_us) * APST_IDLE_LATENCY_MULT / 1000;
+	if(tIdle_ms < APST_IDLE_MIN_MS) { tIdle_ms = APST_IDLE_MIN_MS; }
+	for(int i = 0; i <= idController->NPSS; i++)
+	{
+		if(descPowerState[i].NOPS) { continue; }
+		apstTable[i] = ((u64)(tIdle_ms & 0xFFFFFF) << 8) | ((ps_idle & 0x1F) << 3);
+	}
+
+	// Set Features: Autonomous Power State Transition
+	memset(&sqe, 0, sizeof(sqe_prp_type));
+	sqe.CID = admin_cid;
+	sqe.OPC = 0x09;
+	sqe.PRP1 = (u64) apstTable;
+	sqe.CDW10 = 0x0C;
+	sqe.CDW11 = enable & 0x1;
+	nvmeStatus = nvmeAdminCommand(&sqe, &cqe, tTimeout_ms);
+	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
+	if(cqe.SF_P >> 1) { return NVME_ERROR_POWER_STATE_TRANSITION; }
+
+	return NVME_OK;
+}
+
 int nvmeCreateIOQueues(u32 tTimeout_ms)
 {
 	u32 nvmeStatus = NVME_OK;
@@ -532,6 +858,9 @@ int nvmeGetSMARTHealth(void)
 	sqe_prp_type sqe;
 	cqe_type cqe;
 
+	// Completions from previous non-blocking requests were never consumed. Retire them so the ACQ can't fill.
+	nvmeServiceAdminCompletions();
+
 	// Get Log Page 02: SMART / Health Information
 	memset(&sqe, 0, sizeof(sqe_prp_type));
 	sqe.CID = admin_cid;
@@ -595,8 +924,10 @@ void nvmeParsePowerStates(void)
 		descPowerState[i].RWL = ((*(u32 *)(psBaseAddress + PSD_RXX_Offset)) & PSD_RWL_Msk) >> PSD_RWL_Pos;
 		descPowerState[i].APW = ((*(u32 *)(psBaseAddress + PSD_APW_Offset)) & PSD_APW_Msk) >> PSD_APW_Pos;
 
-		// Set the idle power state to the first one to indicate NOPS.
-		if((descPowerState[i].NOPS) && (ps_idle == 0))
+		// Set the idle power state to the lowest-power NOPS state that can be entered and exited within budget.
+		if((descPowerState[i].NOPS)
+		&& ((descPowerState[i].tEnter_us + descPowerState[i].tExit_us) <= STANDBY_LATENCY_MAX_US)
+		&& ((ps_idle == 0) || (descPowerState[i].pMax < descPowerState[ps_idle].pMax)))
 		{
 			ps_idle = i;
 		}
@@ -665,11 +996,41 @@ int nvmeCompleteAdminCommand(cqe_type * cqe, u32 tTimeout_ms)
 	return NVME_OK;
 }
 
+// Non-Blocking Admin Command Completion, discarding results.
+void nvmeServiceAdminCompletions(void)
+{
+	cqe_type * cqeTemp;
+	u8 nCompletions = 0;
+
+	while(1)
+	{
+		isb(); dsb(); // Xil_DCacheInvalidate();
+		cqeTemp = (cqe_type *)((u64)acq + acq_head_local * sizeof(cqe_type));
+		if((cqeTemp->SF_P & 0x0001) == acq_phase) { break; }
+
+		acq_head_local = (acq_head_local + 1) & ACQ_SIZE;
+		if(acq_head_local == 0) { acq_phase ^= 0x01; }
+		nCompletions++;
+	}
+
+	if(nCompletions > 0)
+	{
+		isb(); dsb(); // Xil_DCacheFlush();
+		*regCQ0HDBL = acq_head_local;
+	}
+}
+
 void nvmeSubmitIOCommand(const sqe_prp_type * sqe)
 {
 	u64 iosq_offset = iosq_tail_local * sizeof(sqe_prp_type);
 	memcpy((void *)((u64)iosq + iosq_offset), sqe, sizeof(sqe_prp_type));
 	iosq_tail_local = (iosq_tail_local + 1) & IOSQ_SIZE;
+
+	io_pending[io_cid & IOSQ_SIZE] = 1;
+	io_slba[io_cid & IOSQ_SIZE] = ((u64) sqe->CDW11 << 32) | sqe->CDW10;
+	io_nlb[io_cid & IOSQ_SIZE] = (sqe->OPC == 0x01) ? ((sqe->CDW12 & 0xFFFF) + 1) : 0;
+	io_failed[io_cid & IOSQ_SIZE] = 0;
+	io_outstanding++;
 	io_cid++;
 
 	isb(); dsb(); // Xil_DCacheFlush();
@@ -693,6 +1054,14 @@ int nvmeCompleteIOCommands(cqe_type * cqe, u16 nCompletionsMax)
 		if((cqeTemp->SF_P & 0x0001) == iocq_phase) { break; }
 
 		io_cid_last_completed = cqeTemp->CID;
+		if(io_pending[cqeTemp->CID & IOSQ_SIZE])
+		{
+			io_pending[cqeTemp->CID & IOSQ_SIZE] = 0;
+			io_failed[cqeTemp->CID & IOSQ_SIZE] = ((cqeTemp->SF_P >> 1) != 0);
+			io_errors += io_failed[cqeTemp->CID & IOSQ_SIZE];
+			io_outstanding--;
+		}
+		nvmeHistogramComplete(cqeTemp->CID);
 
 		iocq_head_local = (iocq_head_local + 1) & IOCQ_SIZE;
 		if(iocq_head_local == 0) { iocq_phase ^= 0x01; }
@@ -709,6 +1078,56 @@ int nvmeCompleteIOCommands(cqe_type * cqe, u16 nCompletionsMax)
 	return nCompletions;
 }
 
+// The CID slot (and its PRP list) can't be reused until the command that last used it has completed. The IOSQ also
+// holds at most IOSQ_SIZE commands, one less than its entries: tail == head means empty.
+void nvmeWaitIOSlot(void)
+{
+	while(io_pending[io_cid & IOSQ_SIZE] || (io_outstanding >= IOSQ_SIZE))
+	{
+		nvmeServiceIOCompletions(16);
+	}
+}
+
+// Timestamp and bin a write command about to be submitted with the current CID.
+void nvmeHistogramSubmit(u32 size)
+{
+	u16 qd = nvmeGetIOSlip();
+	int b;
+
+	XTime_GetTime(&io_tSubmit[io_cid & IOSQ_SIZE]);
+	io_timed[io_cid & IOSQ_SIZE] = 1;
+
+	writeHistogram.queueDepth[(qd < NVME_HIST_QD_BINS) ? qd : (NVME_HIST_QD_BINS - 1)]++;
+	if(qd > writeWindow.queueDepthMax) { writeWindow.queueDepthMax = qd; }
+
+	// Bin 0 starts at 512B, the smallest LBA size.
+	b = (size < 1024) ? 0 : (31 - __builtin_clz(size)) - 9;
+	writeHistogram.size[(b < NVME_HIST_SIZE_BINS) ? b : (NVME_HIST_SIZE_BINS - 1)]++;
+	writeHistogram.bytesWritten += size;
+}
+
+// Bin the latency of a completed command, if it was a timed write.
+void nvmeHistogramComplete(u16 cid)
+{
+	XTime tNow;
+	u32 latency_us;
+	int b;
+
+	if(!io_timed[cid & IOSQ_SIZE]) { return; }
+	io_timed[cid & IOSQ_SIZE] = 0;
+
+	XTime_GetTime(&tNow);
+	latency_us = (u32)((tNow - io_tSubmit[cid & IOSQ_SIZE]) / (COUNTS_PER_SECOND / 1000000));
+
+	b = (latency_us == 0) ? 0 : (32 - __builtin_clz(latency_us));
+	writeHistogram.latency[(b < NVME_HIST_LATENCY_BINS) ? b : (NVME_HIST_LATENCY_BINS - 1)]++;
+	writeHistogram.nWrites++;
+	if(latency_us > writeHistogram.latencyMax_us) { writeHistogram.latencyMax_us = latency_us; }
+
+	writeWindow.nWrites++;
+	if(latency_us > writeWindow.latencyMax_us) { writeWindow.latencyMax_us = latency_us; }
+}
+
 int nvmeCheckTimeout(XTime tStart, u32 tTimeout_ms)
 {
 	XTime tNow;
@@ -46,12 +46,43 @@ THE SOFTWARE.
 #define NVME_ERROR_LBA_SIZE                0x00000200
 #define NVME_ERROR_POWER_STATE_TRANSITION  0x00000400
 #define NVME_ERROR_QUEUE_CREATION          0x00000800
+#define NVME_ERROR_HMB                     0x00001000
+#define NVME_ERROR_FORMAT                  0x00002000
 
 #define NVME_RW_OK                         0x00000000
 #define NVME_RW_BAD_ALIGNMENT              0x00000001
 
+#define NVME_IO_OK                         0x00000000
+#define NVME_IO_PENDING                    0x00000001
+#define NVME_IO_ERROR                      0x00000002
+
+#define NVME_HIST_LATENCY_BINS 24          // Bin n: [2^(n-1), 2^n) [us], bin 0: < 1us, last bin: >= 4.2s.
+#define NVME_HIST_QD_BINS 17               // Bin n: n writes outstanding at submit, last bin: >= 16.
+#define NVME_HIST_SIZE_BINS 14             // Bin n: [2^(n+9), 2^(n+10)) [B], last bin: >= 4MiB.
+
 // Public Type Definitions ---------------------------------------------------------------------------------------------
 
+// Write command telemetry, accumulated from submission to (host-observed) completion.
+// High latency with a full queue points at the SSD. Low queue depth while the frame backlog grows points at the CPU.
+typedef struct __attribute__((packed))
+{
+	u32 latency[NVME_HIST_LATENCY_BINS];	// Write latency, submission to completion.
+	u32 queueDepth[NVME_HIST_QD_BINS];		// I/O commands outstanding when the write was submitted.
+	u32 size[NVME_HIST_SIZE_BINS];			// Bytes per write command.
+	u64 nWrites;							// Write commands completed.
+	u64 bytesWritten;						// [B]
+	u32 latencyMax_us;						// [us]
+	u32 reserved;
+} nvmeHistogram_s;
+
+// Write command telemetry since the last call to nvmeGetWriteWindow(), e.g. one frame.
+typedef struct __attribute__((packed))
+{
+	u32 latencyMax_us;						// [us]
+	u16 queueDepthMax;						// I/O commands outstanding at submit.
+	u16 nWrites;							// Write commands completed.
+} nvmeWindow_s;
+
 // Public Function Prototypes ------------------------------------------------------------------------------------------
 
 int nvmeInit(void);
@@ -60,12 +91,27 @@ u64 nvmeGetLBACount(void);
 u16 nvmeGetLBASize(void);
 int nvmeGetMetrics(void);
 float nvmeGetTemp(void);
+u32 nvmeGetHMBSize(void);
+int nvmeEnterStandby(void);
+int nvmeExitStandby(void);
+int nvmeSelectBestLBAFormat(void);
 
 int nvmeWrite(const u8 * srcByte, u64 destLBA, u32 numLBA);
 int nvmeFlush();
 int nvmeRead(u8 * destByte, u64 srcLBA, u32 numLBA);
 int nvmeServiceIOCompletions(u16 maxCompletions);
 u16 nvmeGetIOSlip(void);
+u16 nvmeGetIOCID(void);
+u32 nvmeGetIOErrorCount(void);
+u8 nvmeIOCompleted(u16 cid);
+int nvmeCheckCIDRange(u16 cidFirst, u16 nCommands);
+int nvmeWaitCIDRange(u16 cidFirst, u16 nCommands);
+void nvmeWaitForWrites(u64 lba, u32 numLBA);
+
+void nvmeHistogramReset(void);
+const nvmeHistogram_s * nvmeGetHistogram(void);
+u32 nvmeHistogramPercentile_us(float p);
+void nvmeGetWriteWindow(nvmeWindow_s * window);
 
 // Externed Public Global Variables ------------------------------------------------------------------------------------
 
@@ -85,6 +85,19 @@ THE SOFTWARE.
 #define REG_CSTS_RDY                 0x00000001
 // ====================================================================================
 
+// Identify Bitfields
+// ====================================================================================
+#define OACS_FORMAT_NVM             0x00000002
+
+#define FLBAS_FORMAT_Msk                  0x0F
+
+#define LBAF_MS_Msk                 0x0000FFFF
+#define LBAF_LBADS_Msk              0x00FF0000
+#define LBAF_LBADS_Pos                      16
+#define LBAF_RP_Msk                 0x03000000
+#define LBAF_RP_Pos                         24
+// ====================================================================================
+
 // Power State Descriptor Bitfields
 // ====================================================================================
 #define PSD_MXPS_Offset                      0
@@ -153,6 +166,14 @@ typedef struct __attribute__((packed))
 	u16 SF_P;
 } cqe_type;
 
+// 16B Host Memory Buffer Descriptor Entry
+typedef struct __attribute__((packed))
+{
+	u64 BADD;           // Buffer Address, Page-Aligned
+	u32 BSIZE;          // Buffer Size in [Memory Page Size]
+	u32 reserved;
+} hmbDescriptor_type;
+
 // Identify Controller
 typedef struct __attribute__((packed))
 {
@@ -0,0 +1,523 @@
+/*
+WAVE Clip Playback
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <string.h>
+#include <math.h>
+#include "playback.h"
+#include "nvme.h"
+#include "ff.h"
+#include "fs.h"
+#include "frame.h"
+#include "clip.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Clip header and frame header reads (0x7B7F0000 - 0x7B800000).
+#define PLAYBACK_HEADER_ADDR      0x7B7F0000
+
+// Clip index, one clip at a time (0x7B800000 - 0x7C000000).
+#define PLAYBACK_INDEX_ADDR       0x7B800000
+#define PLAYBACK_INDEX_MAX        0x80000       // 8MiB of clipFrameIndex_s.
+
+// Read-ahead ring, frames in display order (0x7C000000 - 0x80000000).
+#define PLAYBACK_RING_ADDR        0x7C000000
+#define PLAYBACK_SLOTS            16
+#define PLAYBACK_SLOT_SIZE        0x400000      // 4MiB per frame.
+#define PLAYBACK_SLOT_GUARD       0x10000       // Left free at the end of a slot for the decoder to read ahead into.
+#define PLAYBACK_PRIME            8             // Frames read before the clock starts.
+#define PLAYBACK_READS_MAX        2             // Slots being read at once, to stay within the NVMe I/O queue.
+
+#define PLAYBACK_PREVIEW_CS       4             // LL2, LH2, HL2, HH2: the codestreams the HDMI decoder reads.
+#define PLAYBACK_DROP_MAX         4             // Frames dropped in one second that lower the display rate.
+#define PLAYBACK_READ_MARGIN      0.9f          // Share of the measured read rate to display at after dropping.
+#define PLAYBACK_K_END            0xFFFFFFFF    // End of the clip not reached yet.
+
+// Playback States
+#define PLAYBACK_STATE_OFF        0
+#define PLAYBACK_STATE_PRIME      1             // Filling the ring. The clock is stopped.
+#define PLAYBACK_STATE_RUN        2             // Clock running, unless paused.
+#define PLAYBACK_STATE_SEEK       3             // Flushing the ring. VSYNC keeps the frame on screen.
+
+// Slot States
+#define PLAYBACK_SLOT_EMPTY       0
+#define PLAYBACK_SLOT_READ        1             // NVMe reads in flight.
+#define PLAYBACK_SLOT_READY       2
+#define PLAYBACK_SLOT_FAILED      3             // A read failed. Never shown.
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	u8 state;
+	u32 k;					// Position in the display sequence.
+	u32 iFrame;				// Clip frame.
+	u32 skew;				// Offset of the frame header in the slot [B].
+	u16 cidFirst;			// NVMe commands filling the slot: cidFirst to cidFirst + nCommands - 1.
+	u16 nCommands;
+	u32 ioErrors;			// nvmeGetIOErrorCount() before the slot's commands were issued.
+} playbackSlot_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+u8 * playbackSlotAddr(u32 s);
+void playbackSetStep(void);
+void playbackIndexStep(void);
+void playbackFill(void);
+void playbackSlotDone(playbackSlot_s * slot, u32 s, int status);
+void playbackWaitReads(void);
+void playbackAdapt(void);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+int playClip = -1;
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+volatile u8 playState = PLAYBACK_STATE_OFF;
+volatile u8 playPaused = 0;
+u16 playWidth;
+u16 playHeight;
+float playRate;					// Recorded frames per second.
+u32 playDecimation;				// Every playDecimation-th frame is shown.
+u32 playStepQ16;				// Display sequence advance per VSYNC, Q16.
+
+// Display sequence: clip frame playBase + k * playDecimation is due once playTargetK reaches k.
+u32 playBase = 0;
+volatile u32 playTargetK = 0;
+u32 playPhaseQ16 = 0;
+volatile u32 playLastK = PLAYBACK_K_END;
+
+// Read-ahead ring. The head slot is on screen, or is the next to be shown. VSYNC frees it once its successor is due
+// and ready. playbackService() reads frames into the slots after it.
+playbackSlot_s playSlot[PLAYBACK_SLOTS];
+volatile u32 playHead = 0;
+volatile u32 playTail = 0;
+u32 playRingStart = 0;			// First slot read since the last seek.
+u32 playReadK = 0;				// Next display sequence position to read.
+clipFile_s playReadFile;
+
+// Statistics
+volatile u32 playVSYNCs = 0;
+volatile u32 playLate = 0;		// VSYNCs that showed an older frame because the one due was not ready.
+u32 playDropped = 0;			// Frames skipped because they were read too late to be shown.
+u32 playRead = 0;				// Frames read into the ring.
+u32 playReadErrors = 0;			// Frames skipped because the SSD failed a read.
+u32 playVSYNCsCheck = 0;
+u32 playDroppedCheck = 0;
+u32 playReadCheck = 0;
+
+// Clip index of the preview codestreams, built in the background.
+clipIndex_s playIndex = {(clipFrameIndex_s *)(PLAYBACK_INDEX_ADDR), PLAYBACK_INDEX_MAX, PLAYBACK_PREVIEW_CS,
+                         (u8 *)(PLAYBACK_HEADER_ADDR)};
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+FrameHeader_s * playbackVSYNC(void)
+{
+	playbackSlot_s * slot;
+	playbackSlot_s * next;
+	u32 s;
+
+	if((playState == PLAYBACK_STATE_OFF) || (playState == PLAYBACK_STATE_SEEK)) { return NULL; }
+
+	playVSYNCs++;
+
+	if((playState == PLAYBACK_STATE_RUN) && !playPaused)
+	{
+		playPhaseQ16 += playStepQ16;
+		playTargetK += playPhaseQ16 >> 16;
+		playPhaseQ16 &= 0xFFFF;
+
+		// End of the clip: hold the last frame.
+		if(playTargetK >= playLastK)
+		{
+			playTargetK = playLastK;
+			playPaused = 1;
+		}
+	}
+
+	// Move on to the latest frame that is due and ready, past any whose reads failed. A slot is only freed once no
+	// reads are in flight to it.
+	while(playTail - playHead > 1)
+	{
+		slot = &playSlot[playHead % PLAYBACK_SLOTS];
+		if((slot->state != PLAYBACK_SLOT_READY) && (slot->state != PLAYBACK_SLOT_FAILED)) { break; }
+
+		s = playHead + 1;
+		while((s != playTail) && (playSlot[s % PLAYBACK_SLOTS].state == PLAYBACK_SLOT_FAILED)) { s++; }
+		if(s == playTail) { break; }
+		next = &playSlot[s % PLAYBACK_SLOTS];
+		if((next->state != PLAYBACK_SLOT_READY) || (next->k > playTargetK)) { break; }
+
+		for(; playHead != s; playHead++) { playSlot[playHead % PLAYBACK_SLOTS].state = PLAYBACK_SLOT_EMPTY; }
+	}
+
+	if(playTail == playHead) { return NULL; }
+	slot = &playSlot[playHead % PLAYBACK_SLOTS];
+	if(slot->state != PLAYBACK_SLOT_READY) { return NULL; }
+
+	if((playState == PLAYBACK_STATE_RUN) && (slot->k < playTargetK)) { playLate++; }
+
+	return (FrameHeader_s *)(playbackSlotAddr(playHead % PLAYBACK_SLOTS) + slot->skew);
+}
+
+int playbackStart(int nClipPlay)
+{
+	ClipHeader_s * clipHeader = (ClipHeader_s *)(PLAYBACK_HEADER_ADDR);
+	float h4x3;
+	u32 nSubframes;
+	int res;
+
+	playbackStop();
+
+	if(nClipPlay < 0) { return PLAYBACK_ERROR_NOT_FOUND; }
+	if(fsOpenClipInfoFile(nClipPlay) != FR_OK) { return PLAYBACK_ERROR_NOT_FOUND; }
+	res = fsReadClipFile((u64) clipHeader, sizeof(ClipHeader_s));
+	fsCloseClipFile();
+	if((res != FR_OK) || (memcmp(clipHeader->strDelimiter, "WAVE HELLO!\n", 12) != 0)) { return PLAYBACK_ERROR_IO; }
+
+	playClip = nClipPlay;
+	playWidth = clipHeader->wFrame;
+	playHeight = clipHeader->hFrame;
+
+	// Frames shorter than 4:3 hold several sensor frames stacked, as set up by frameApplyCameraState().
+	h4x3 = (playWidth == 4096) ? 3072.0f : 1536.0f;
+	nSubframes = (u32)(h4x3 / (float) playHeight);
+	if(nSubframes == 0) { nSubframes = 1; }
+	playRate = clipHeader->fps / (float) nSubframes;
+
+	// Clips faster than the HDMI output show every Nth frame, which keeps their motion even.
+	playDecimation = (u32) ceilf(playRate / (float) PLAYBACK_VSYNC_HZ);
+	if(playDecimation == 0) { playDecimation = 1; }
+	playbackSetStep();
+
+	clipIndexStart(&playIndex, playClip);
+	clipForgetFile(&playReadFile);
+
+	for(u32 s = 0; s < PLAYBACK_SLOTS; s++) { playSlot[s].state = PLAYBACK_SLOT_EMPTY; }
+	playHead = 0;
+	playTail = 0;
+	playPaused = 0;
+	playVSYNCs = 0;
+	playLate = 0;
+	playDropped = 0;
+	playRead = 0;
+	playReadErrors = 0;
+	playVSYNCsCheck = 0;
+	playDroppedCheck = 0;
+	playReadCheck = 0;
+
+	nvmeExitStandby();
+
+	xil_printf("Playback c%04d: %dx%d, %d fps recorded, every %d shown.\r\n", playClip, playWidth, playHeight,
+	           (int)(playRate + 0.5f), playDecimation);
+
+	playState = PLAYBACK_STATE_SEEK;
+	playbackSeek(0);
+
+	return PLAYBACK_OK;
+}
+
+void playbackStop(void)
+{
+	if(playState == PLAYBACK_STATE_OFF) { return; }
+
+	// VSYNC goes back to live frames. Reads in flight are allowed to finish.
+	playState = PLAYBACK_STATE_OFF;
+	playbackWaitReads();
+	clipIndexWait(&playIndex);
+
+	xil_printf("Playback stopped: %d VSYNCs, %d late, %d frames dropped, %d read errors.\r\n", playVSYNCs, playLate,
+	           playDropped, playReadErrors);
+
+	nvmeEnterStandby();
+}
+
+// Called from the main loop in PLAYBACK mode.
+void playbackService(void)
+{
+	u32 ready = 0;
+
+	if(playState == PLAYBACK_STATE_OFF) { return; }
+
+	nvmeServiceIOCompletions(16);
+	playbackIndexStep();
+	playbackFill();
+
+	// Start the clock once the ring has enough frames to ride out slow reads, or holds the rest of the clip.
+	if(playState == PLAYBACK_STATE_PRIME)
+	{
+		for(u32 s = playRingStart; s != playTail; s++)
+		{
+			if((playSlot[s % PLAYBACK_SLOTS].state == PLAYBACK_SLOT_READY)
+			|| (playSlot[s % PLAYBACK_SLOTS].state == PLAYBACK_SLOT_FAILED)) { ready++; }
+		}
+		if((ready >= PLAYBACK_PRIME) || ((playLastK != PLAYBACK_K_END) && (ready == playTail - playRingStart)))
+		{
+			playState = PLAYBACK_STATE_RUN;
+		}
+	}
+
+	playbackAdapt();
+}
+
+void playbackSeek(u32 iFrame)
+{
+	if(playState == PLAYBACK_STATE_OFF) { return; }
+
+	// Keep the frame on screen, which the decoder is still reading, and drop the rest of the ring.
+	playState = PLAYBACK_STATE_SEEK;
+	playbackWaitReads();
+	if(playTail != playHead) { playTail = playHead + 1; }
+	for(u32 s = playTail; s != playHead + PLAYBACK_SLOTS; s++) { playSlot[s % PLAYBACK_SLOTS].state = PLAYBACK_SLOT_EMPTY; }
+
+	if(playIndex.complete && (playIndex.nFrames > 0) && (iFrame >= playIndex.nFrames)) { iFrame = playIndex.nFrames - 1; }
+
+	playBase = iFrame;
+	playReadK = 0;
+	playTargetK = 0;
+	playPhaseQ16 = 0;
+	playLastK = PLAYBACK_K_END;
+	playRingStart = playTail;
+
+	playState = PLAYBACK_STATE_PRIME;
+}
+
+void playbackPause(u8 pause)
+{
+	if(playState == PLAYBACK_STATE_OFF) { return; }
+
+	// Play at the end of the clip starts it again.
+	if(!pause && playPaused && (playLastK != PLAYBACK_K_END) && (playTargetK >= playLastK)) { playbackSeek(0); }
+
+	playPaused = pause;
+}
+
+u8 playbackIsActive(void)
+{
+	return (playState != PLAYBACK_STATE_OFF);
+}
+
+u8 playbackIsPaused(void)
+{
+	return playPaused;
+}
+
+// Clip frame on screen.
+u32 playbackGetFrame(void)
+{
+	u32 head = playHead;
+
+	if((playTail != head) && (playSlot[head % PLAYBACK_SLOTS].state == PLAYBACK_SLOT_READY))
+	{
+		return playSlot[head % PLAYBACK_SLOTS].iFrame;
+	}
+
+	return playBase;
+}
+
+// Frames indexed so far. Final once the whole clip has been indexed.
+u32 playbackGetFrameCount(void)
+{
+	return playIndex.nFrames;
+}
+
+void playbackGetFrameSize(float * wFrame, float * hFrame)
+{
+	*wFrame = (float) playWidth;
+	*hFrame = (float) playHeight;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+u8 * playbackSlotAddr(u32 s)
+{
+	return (u8 *)((u64) PLAYBACK_RING_ADDR + (u64) s * PLAYBACK_SLOT_SIZE);
+}
+
+void playbackSetStep(void)
+{
+	playStepQ16 = (u32)(65536.0f * playRate / (float)(playDecimation * PLAYBACK_VSYNC_HZ));
+}
+
+// Index the clip a frame at a time, reporting once it is complete.
+void playbackIndexStep(void)
+{
+	if(playIndex.complete) { return; }
+
+	if(clipIndexStep(&playIndex))
+	{
+		xil_printf("Playback c%04d: %d frames indexed, %d lost.\r\n", playClip, playIndex.nFrames, playIndex.nLost);
+	}
+}
+
+// Finish slots whose reads are done, then read the next frames of the display sequence into free slots.
+void playbackFill(void)
+{
+	playbackSlot_s * slot;
+	clipFrameIndex_s * entry;
+	u32 sizeLBA = nvmeGetLBASize();
+	u32 reads = 0;
+	u32 iFrame;
+	u32 skew;
+	int status;
+
+	for(u32 s = playHead; s != playTail; s++)
+	{
+		slot = &playSlot[s % PLAYBACK_SLOTS];
+		if(slot->state != PLAYBACK_SLOT_READ) { continue; }
+
+		status = nvmeCheckCIDRange(slot->cidFirst, slot->nCommands);
+		if(status != NVME_IO_PENDING) { playbackSlotDone(slot, s % PLAYBACK_SLOTS, status); }
+		else { reads++; }
+	}
+
+	// Failed frames at the end of the ring are given back. One at the head was never shown, so it can go too.
+	while((playTail != playHead) && (playSlot[(playTail - 1) % PLAYBACK_SLOTS].state == PLAYBACK_SLOT_FAILED))
+	{
+		playSlot[(playTail - 1) % PLAYBACK_SLOTS].state = PLAYBACK_SLOT_EMPTY;
+		playTail--;
+	}
+
+	while((reads < PLAYBACK_READS_MAX) && (playTail - playHead < PLAYBACK_SLOTS) && (playLastK == PLAYBACK_K_END))
+	{
+		// Frames already past due are skipped, so playback keeps time when the SSD falls behind.
+		if((playState == PLAYBACK_STATE_RUN) && (playReadK < playTargetK))
+		{
+			playDropped += playTargetK - playReadK;
+			playReadK = playTargetK;
+		}
+
+		iFrame = playBase + playReadK * playDecimation;
+		if(iFrame >= playIndex.nFrames)
+		{
+			// Wait for the index, unless the clip ends here.
+			if(playIndex.complete) { playLastK = (playReadK > 0) ? (playReadK - 1) : 0; }
+			break;
+		}
+
+		entry = &playIndex.index[iFrame];
+		skew = entry->offset_B % sizeLBA;
+		if((entry->size_B == 0) || (clipOpenFile(&playReadFile, playClip, entry->nFile) != CLIP_OK)
+		|| (skew + entry->size_B + sizeLBA > PLAYBACK_SLOT_SIZE - PLAYBACK_SLOT_GUARD))
+		{
+			// Lost while indexing, unreadable, or too large for a slot: show the frame before it for longer.
+			playDropped++;
+			playReadK++;
+			continue;
+		}
+
+		slot = &playSlot[playTail % PLAYBACK_SLOTS];
+		slot->k = playReadK;
+		slot->iFrame = iFrame;
+		slot->skew = skew;
+		slot->cidFirst = nvmeGetIOCID();
+		slot->ioErrors = nvmeGetIOErrorCount();
+		slot->state = PLAYBACK_SLOT_READ;
+		slot->nCommands = clipReadStart(&playReadFile, playbackSlotAddr(playTail % PLAYBACK_SLOTS), entry->offset_B,
+		                                entry->size_B);
+		playTail++;
+		playReadK++;
+		reads++;
+	}
+}
+
+// Point the frame header's codestream addresses at the copies in the slot: LL2, LH2, HL2 and HH2 follow the header.
+// A frame the SSD failed to read is skipped: the frame before it stays on screen for longer. The reads in flight can
+// outnumber the I/O queue depth, and the status counts CIDs that old as OK, so any I/O error since the slot was issued
+// fails it.
+void playbackSlotDone(playbackSlot_s * slot, u32 s, int status)
+{
+	FrameHeader_s * fh = (FrameHeader_s *)(playbackSlotAddr(s) + slot->skew);
+	u32 addr = (u32)((u64) fh + sizeof(FrameHeader_s));
+
+	if((status != NVME_IO_OK) || (nvmeGetIOErrorCount() != slot->ioErrors))
+	{
+		slot->state = PLAYBACK_SLOT_FAILED;
+		playReadErrors++;
+		return;
+	}
+
+	for(int iCS = 0; iCS < PLAYBACK_PREVIEW_CS; iCS++)
+	{
+		fh->csAddr[iCS] = addr;
+		addr += fh->csSize[iCS];
+	}
+
+	slot->state = PLAYBACK_SLOT_READY;
+	playRead++;
+}
+
+void playbackWaitReads(void)
+{
+	playbackSlot_s * slot;
+
+	for(u32 s = playHead; s != playTail; s++)
+	{
+		slot = &playSlot[s % PLAYBACK_SLOTS];
+		if(slot->state != PLAYBACK_SLOT_READ) { continue; }
+
+		playbackSlotDone(slot, s % PLAYBACK_SLOTS, nvmeWaitCIDRange(slot->cidFirst, slot->nCommands));
+	}
+}
+
+// Once a second: if the SSD could not keep up, show every (N+1)th frame instead of every Nth.
+void playbackAdapt(void)
+{
+	float readRate;
+	u32 decimation;
+
+	if((playState != PLAYBACK_STATE_RUN) || playPaused)
+	{
+		playVSYNCsCheck = playVSYNCs;
+		playDroppedCheck = playDropped;
+		playReadCheck = playRead;
+		return;
+	}
+
+	if(playVSYNCs - playVSYNCsCheck < PLAYBACK_VSYNC_HZ) { return; }
+
+	// Show frames no faster than the SSD delivered them over the last second, with some margin.
+	if(playDropped - playDroppedCheck > PLAYBACK_DROP_MAX)
+	{
+		readRate = (float)(playRead - playReadCheck) * PLAYBACK_VSYNC_HZ / (playVSYNCs - playVSYNCsCheck);
+		decimation = playDecimation + 1;
+		if(readRate > 0.0f) { decimation = (u32) ceilf(playRate / (PLAYBACK_READ_MARGIN * readRate)); }
+		if(decimation <= playDecimation) { decimation = playDecimation + 1; }
+
+		xil_printf("Playback c%04d: %d frames dropped, every %d shown.\r\n", playClip, playDropped - playDroppedCheck,
+		           decimation);
+		playDecimation = decimation;
+		playbackSetStep();
+		playbackSeek(playbackGetFrame());
+	}
+
+	playVSYNCsCheck = playVSYNCs;
+	playDroppedCheck = playDropped;
+	playReadCheck = playRead;
+}
@@ -0,0 +1,70 @@
+/*
+WAVE Clip Playback Include
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __PLAYBACK_INCLUDE__
+#define __PLAYBACK_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "main.h"
+#include "frame.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// HDMI output refresh rate (1080p60), the rate playbackVSYNC() is called at.
+#define PLAYBACK_VSYNC_HZ 60
+
+// Playback Status
+#define PLAYBACK_OK 0
+#define PLAYBACK_ERROR_NOT_FOUND 1
+#define PLAYBACK_ERROR_IO 2
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+// Called from the VSYNC interrupt. Returns the header of the frame to decode, with its codestream addresses pointing
+// into the read-ahead ring, or NULL to keep decoding the last one.
+FrameHeader_s * playbackVSYNC(void);
+
+// Start playing a clip from its first frame. The clip is indexed and read in the background by playbackService().
+int playbackStart(int nClipPlay);
+void playbackStop(void);
+void playbackService(void);
+
+// Scrubbing: jump to a frame. Playback continues from there, or shows just that frame while paused.
+void playbackSeek(u32 iFrame);
+void playbackPause(u8 pause);
+
+u8 playbackIsActive(void);
+u8 playbackIsPaused(void);
+u32 playbackGetFrame(void);
+u32 playbackGetFrameCount(void);
+void playbackGetFrameSize(float * wFrame, float * hFrame);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+extern int playClip;
+
+#endif
@@ -0,0 +1,321 @@
+/*
+WAVE Exposure Scopes
+
+Histogram, waveform, and RGB parade of the frame on the HDMI output, from the raw 10b LL2 data of its preview
+codestream. A frame is scanned a few rows at a time from the main loop, within a time budget set by the caller, so the
+scopes never hold up the other services. They update at a fraction of the frame rate instead.
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "main.h"
+#include "scope.h"
+#include "frame.h"
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define SCOPE_W_LL2_MAX 512								// 4K Mode
+#define SCOPE_ROW_PX_MAX (4 * SCOPE_W_LL2_MAX)			// All four color fields of one LL2 row.
+#define SCOPE_ROW_BYTES_MAX (SCOPE_ROW_PX_MAX * 10 / 8)
+
+// Scan States
+#define SCOPE_STATE_IDLE 0
+#define SCOPE_STATE_CLEAR 1
+#define SCOPE_STATE_SCAN 2
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Where a frame's LL2 rows are. Rows are whole bytes long, so every row starts at the same bit phase.
+typedef struct
+{
+	u32 nFrame;
+	u64 addr;			// Byte address of the first LL2 pixel.
+	u8 phase;			// Bit offset of the first LL2 pixel in that byte.
+	u16 wLL2;
+	u16 hLL2;
+} ScopeSource_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void scopeBuildColumns(u16 wLL2);
+void scopeScanRow(u16 y);
+void scopeAlignRow(u8 * row, u8 phase, u32 nBytes);
+void scopeUnpackRow(u16 * px, const u8 * row, u32 nPx);
+void scopeAccumulateRow(Scope_s * acc, const u16 * px, u32 nPx);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// Latched by scopeVSYNC() when scopeNextReady is clear, taken by scopeService() when it is set.
+ScopeSource_s scopeNext;
+volatile u8 scopeNextReady = 0;
+
+ScopeSource_s scopeSource;
+u32 scopeState = SCOPE_STATE_IDLE;
+u16 scopeRow;
+
+// Scans accumulate into one buffer while the other holds the last result.
+Scope_s scopeBuffer[2];
+Scope_s * scopeAcc = &scopeBuffer[0];
+Scope_s * scopeResult = &scopeBuffer[1];
+u32 scopeResultCount = 0;
+
+// One LL2 row, with slack for the 16B NEON loads past the end.
+u8 scopeRowRaw[SCOPE_ROW_BYTES_MAX + 16] __attribute__((aligned(16)));
+u16 scopeRowPx[SCOPE_ROW_PX_MAX] __attribute__((aligned(16)));
+
+// Waveform and parade column of each pixel in an LL2 row, for scopeColumnsW.
+u8 scopeWaveCol[SCOPE_ROW_PX_MAX];
+u8 scopeParadeCol[SCOPE_ROW_PX_MAX];
+u16 scopeColumnsW = 0;
+
+const u8 scopeParadeSection[4] = {SCOPE_PARADE_R, SCOPE_PARADE_G, SCOPE_PARADE_G, SCOPE_PARADE_B};
+
+#ifdef __ARM_NEON
+// Eight 10b pixels from ten bytes: the byte pair each one starts in, and its right shift within the pair.
+const u8 scopeUnpackIndex[16] = {0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9};
+const s16 scopeUnpackShift[8] = {0, -2, -4, -6, 0, -2, -4, -6};
+#endif
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+void scopeInit(void)
+{
+	memset(scopeBuffer, 0, sizeof(scopeBuffer));
+	scopeState = SCOPE_STATE_IDLE;
+	scopeNextReady = 0;
+}
+
+void scopeVSYNC(const FrameHeader_s * fh)
+{
+	u32 bitDiscard;
+	u32 pxDiscard;
+	u32 bitStart;
+
+	if(scopeNextReady) { return; }
+
+	scopeNext.wLL2 = fh->wFrame >> 3;
+	scopeNext.hLL2 = fh->hFrame >> 3;
+	if((scopeNext.wLL2 == 0) || (scopeNext.wLL2 > SCOPE_W_LL2_MAX)) { return; }
+
+	// Same discarded bits and pixels as readPixelInLL2().
+	bitDiscard = fh->csFIFOState[0] + ((fh->csFIFOFlags >> (16 + 0)) & 0x1) * 64;
+	if(scopeNext.wLL2 == 512)
+	{ pxDiscard = 6336; }	// 4K Mode
+	else
+	{ pxDiscard = 3328; }	// 2K Mode
+
+	bitStart = bitDiscard + 10 * pxDiscard;
+	scopeNext.addr = (u64) fh->csAddr[0] + (bitStart >> 3);
+	scopeNext.phase = bitStart & 0x7;
+	scopeNext.nFrame = fh->nFrame;
+	scopeNextReady = 1;
+}
+
+void scopeService(u32 tBudget_us)
+{
+	XTime tStart, tNow;
+	Scope_s * swap;
+
+	XTime_GetTime(&tStart);
+
+	do
+	{
+		switch(scopeState)
+		{
+		case SCOPE_STATE_IDLE:
+			if(!scopeNextReady) { return; }
+			memcpy(&scopeSource, &scopeNext, sizeof(ScopeSource_s));
+			scopeNextReady = 0;
+			if(scopeSource.wLL2 != scopeColumnsW) { scopeBuildColumns(scopeSource.wLL2); }
+			scopeState = SCOPE_STATE_CLEAR;
+			break;
+		case SCOPE_STATE_CLEAR:
+			memset(scopeAcc, 0, sizeof(Scope_s));
+			scopeAcc->nFrame = scopeSource.nFrame;
+			scopeRow = 0;
+			scopeState = SCOPE_STATE_SCAN;
+			break;
+		case SCOPE_STATE_SCAN:
+			// The frame's buffer can be reused while it is being scanned. Then some rows are from a later frame, which
+			// is harmless here.
+			scopeScanRow(scopeRow);
+			scopeRow += SCOPE_ROW_STEP;
+			if(scopeRow >= scopeSource.hLL2)
+			{
+				swap = scopeResult;
+				scopeResult = scopeAcc;
+				scopeAcc = swap;
+				scopeResultCount++;
+				scopeState = SCOPE_STATE_IDLE;
+			}
+			break;
+		default:
+			scopeState = SCOPE_STATE_IDLE;
+			break;
+		}
+
+		XTime_GetTime(&tNow);
+	} while((tNow - tStart) * US_PER_COUNT < tBudget_us);
+}
+
+const Scope_s * scopeGetResult(void)
+{
+	return scopeResult;
+}
+
+u32 scopeGetResultCount(void)
+{
+	return scopeResultCount;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Invert the LL2 row mapping of bitOffsetInLL2() for every pixel of a row, into its waveform and parade columns.
+void scopeBuildColumns(u16 wLL2)
+{
+	u16 xShifted, x;
+
+	for(u32 k = 0; k < 4 * wLL2; k++)
+	{
+		if(wLL2 == 512)
+		{
+			// 4K Mapping
+			xShifted =  ((k >> 0) & 0x03) << 0;		// xShifted[1:0] = k[1:0]
+			xShifted += ((k >> 2) & 0x03) << 7;		// xShifted[8:7] = k[3:2]
+			xShifted += ((k >> 6) & 0x1F) << 2;		// xShifted[6:2] = k[10:6]
+		}
+		else
+		{
+			// 2K Mapping
+			xShifted =  ((k >> 0) & 0x03) << 0;		// xShifted[1:0] = k[1:0]
+			xShifted += ((k >> 2) & 0x03) << 6;		// xShifted[7:6] = k[3:2]
+			xShifted += ((k >> 6) & 0x0F) << 2;		// xShifted[5:2] = k[9:6]
+		}
+
+		// Undo the horizontal circular wrap of 1px.
+		x = (xShifted + 1) % wLL2;
+
+		scopeWaveCol[k] = (x * SCOPE_WAVE_COLS) / wLL2;
+		scopeParadeCol[k] = (x * SCOPE_PARADE_COLS) / wLL2;
+	}
+
+	scopeColumnsW = wLL2;
+}
+
+// Copy one LL2 row out of DDR in a single pass, then unpack and count it from RAM.
+void scopeScanRow(u16 y)
+{
+	u32 nPx = 4 * scopeSource.wLL2;
+	u32 nBytes = nPx * 10 / 8;
+	u64 addr = scopeSource.addr + (u64) y * nBytes;
+
+	// One more byte for the bits of the last pixel that spill over when the phase is not zero.
+	memcpy(scopeRowRaw, (void *) addr, nBytes + 1);
+	if(scopeSource.phase) { scopeAlignRow(scopeRowRaw, scopeSource.phase, nBytes); }
+
+	scopeUnpackRow(scopeRowPx, scopeRowRaw, nPx);
+	scopeAccumulateRow(scopeAcc, scopeRowPx, nPx);
+}
+
+// Shift the row down by phase bits, in place, so that it starts on a byte boundary. nBytes a multiple of 16.
+void scopeAlignRow(u8 * row, u8 phase, u32 nBytes)
+{
+#ifdef __ARM_NEON
+	const int8x16_t shiftLo = vdupq_n_s8(-(s8) phase);
+	const int8x16_t shiftHi = vdupq_n_s8(8 - (s8) phase);
+	uint8x16_t lo, hi;
+
+	// Byte i + 1 is loaded before byte i is stored, in this pass and the next.
+	for(u32 i = 0; i < nBytes; i += 16)
+	{
+		lo = vld1q_u8(&row[i]);
+		hi = vld1q_u8(&row[i + 1]);
+		vst1q_u8(&row[i], vorrq_u8(vshlq_u8(lo, shiftLo), vshlq_u8(hi, shiftHi)));
+	}
+#else
+	for(u32 i = 0; i < nBytes; i++)
+	{
+		row[i] = (row[i] >> phase) | (row[i + 1] << (8 - phase));
+	}
+#endif
+}
+
+// Unpack 10b pixels, packed LSB first. nPx a multiple of 8.
+void scopeUnpackRow(u16 * px, const u8 * row, u32 nPx)
+{
+#ifdef __ARM_NEON
+	const uint8x16_t index = vld1q_u8(scopeUnpackIndex);
+	const int16x8_t shift = vld1q_s16(scopeUnpackShift);
+	const uint16x8_t mask = vdupq_n_u16(0x3FF);
+	uint16x8_t pairs;
+
+	// Each 16B load uses ten bytes, the last one reads into the slack past the row.
+	for(u32 i = 0; i < nPx; i += 8)
+	{
+		pairs = vreinterpretq_u16_u8(vqtbl1q_u8(vld1q_u8(&row[i * 10 / 8]), index));
+		vst1q_u16(&px[i], vandq_u16(vshlq_u16(pairs, shift), mask));
+	}
+#else
+	u32 bit;
+
+	for(u32 i = 0; i < nPx; i++)
+	{
+		bit = 10 * i;
+		px[i] = ((row[bit >> 3] | (row[(bit >> 3) + 1] << 8)) >> (bit & 0x7)) & 0x3FF;
+	}
+#endif
+}
+
+// Count an unpacked row. Color fields come in runs of 16 pixels, in LL2 order.
+void scopeAccumulateRow(Scope_s * acc, const u16 * px, u32 nPx)
+{
+	u32 * hist;
+	u16 (* parade)[SCOPE_PARADE_COLS];
+	u8 green;
+	u16 v;
+	u32 k;
+
+	for(u32 k0 = 0; k0 < nPx; k0 += 16)
+	{
+		hist = acc->hist[(k0 >> 4) & 0x3];
+		parade = acc->parade[scopeParadeSection[(k0 >> 4) & 0x3]];
+		green = (((k0 >> 4) & 0x3) == SCOPE_G1) || (((k0 >> 4) & 0x3) == SCOPE_G2);
+
+		for(k = k0; k < k0 + 16; k++)
+		{
+			v = px[k];
+			hist[v >> 3]++;
+			parade[v >> 4][scopeParadeCol[k]]++;
+			if(green) { acc->wave[v >> 4][scopeWaveCol[k]]++; }
+		}
+	}
+
+	acc->nPx += nPx / 4;
+}
@@ -0,0 +1,82 @@
+/*
+WAVE Exposure Scopes Include
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __SCOPE_INCLUDE__
+#define __SCOPE_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "main.h"
+#include "frame.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+#define SCOPE_ROW_STEP 4			// Every 4th LL2 row is sampled.
+#define SCOPE_HIST_BINS 128			// Histogram bins, 10b values >> 3.
+#define SCOPE_LEVELS 64				// Waveform and parade levels, 10b values >> 4.
+#define SCOPE_WAVE_COLS 128			// Waveform columns across the frame.
+#define SCOPE_PARADE_COLS 40		// Parade columns across the frame, per color.
+
+// Color fields, in LL2 order.
+#define SCOPE_R1 0
+#define SCOPE_G1 1
+#define SCOPE_G2 2
+#define SCOPE_B1 3
+
+// Parade sections.
+#define SCOPE_PARADE_R 0
+#define SCOPE_PARADE_G 1
+#define SCOPE_PARADE_B 2
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Counts from one scan of a frame's LL2, sampled every SCOPE_ROW_STEP rows. Level 0 is black.
+typedef struct
+{
+	u32 nFrame;										// Frame number of the scanned frame.
+	u32 nPx;										// Pixels sampled per color field.
+	u32 hist[4][SCOPE_HIST_BINS];					// Histogram of each color field.
+	u16 wave[SCOPE_LEVELS][SCOPE_WAVE_COLS];		// Waveform of G1 and G2.
+	u16 parade[3][SCOPE_LEVELS][SCOPE_PARADE_COLS];	// Waveforms of R1, G1 and G2, and B1.
+} Scope_s;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+void scopeInit(void);
+
+// Called from the VSYNC interrupt with the header of the frame going to the decoder. It is scanned next if no scan
+// is in progress.
+void scopeVSYNC(const FrameHeader_s * fh);
+
+// Scan LL2 rows of the latched frame for up to tBudget_us, then return. A scan takes several calls, one per frame.
+void scopeService(u32 tBudget_us);
+
+// The last completed scan, and a count of completed scans to tell when it has changed. The result stays valid until
+// the next call to scopeService().
+const Scope_s * scopeGetResult(void);
+u32 scopeGetResultCount(void);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
@@ -32,6 +32,9 @@ THE SOFTWARE.
 #include "fs.h"
 #include "frame.h"
 #include "supervisor.h"
+#include "dma.h"
+#include "playback.h"
+#include "scope.h"
 
 // Private Pre-Processor Definitions -----------------------------------------------------------------------------------
 
@@ -52,10 +55,24 @@ THE SOFTWARE.
 #define UI_CONTROL_BOT_EN  0x02000000
 #define UI_CONTROL_TOP_EN  0x04000000
 
+#define UI_PLANE_SIZE 32768
+
 #define FONT_W 1536
 #define CHAR_W 16
 #define CHAR_H 32
 
+// Exposure scopes on the pop-up UI: position on screen, and the top row of each scope in the plane.
+#define UI_SCOPE_X0 1840
+#define UI_SCOPE_Y0 521
+#define UI_SCOPE_HIST_Y0 32
+#define UI_SCOPE_HIST_H 64
+#define UI_SCOPE_WAVE_Y0 96
+#define UI_SCOPE_PARADE_Y0 160
+#define UI_SCOPE_PARADE_GAP 4
+#define UI_SCOPE_BAR 0xC0			// Histogram bars.
+#define UI_SCOPE_GRID 0x30			// Waveform and parade graticule, every 256 LSB.
+#define UI_SCOPE_STEP 20			// Waveform and parade intensity step per doubling of the count.
+
 // Private Type Definitions --------------------------------------------------------------------------------------------
 
 // Private Function Prototypes -----------------------------------------------------------------------------------------
@@ -77,6 +94,12 @@ void uiDrawChar(u8 uiID, char c, u16 x0, u16 y0);
 void uiInvertRectColRow(u8 uiID, u16 col, u16 row, u16 wCol, u16 hRow);
 void uiInvertRect(u8 uiID, u16 x0, u16 y0, u16 w, u16 h);
 
+void uiMarkDirty(u8 uiID, u16 y0, u16 h);
+void uiFlush(void);
+
+void uiDrawScopes(const Scope_s * scope);
+u8 uiScopeIntensity(u32 count, u8 level);
+
 u16 uiColX0(u8 col);
 u16 uiRowY0(u8 row);
 
@@ -92,6 +115,11 @@ const u32 uiBaseAddr[] = {0xA0180000, 0xA0188000, 0xA0190000};
 const u16 uiW[] = {1024, 1024, 128};
 const u16 uiH[] = {32, 32, 256};
 
+// UI planes are drawn in RAM and uploaded to the URAMs by uiFlush(), so drawing and inverting run at RAM speed.
+u8 uiPlane[3][UI_PLANE_SIZE] __attribute__((aligned(64)));
+u16 uiDirtyY0[] = {0xFFFF, 0xFFFF, 0xFFFF};		// Rows changed since the last flush, [uiDirtyY0, uiDirtyY1).
+u16 uiDirtyY1[] = {0, 0, 0};
+
 // UI Event Tracking
 u32 uiPinStatePrev = UI_MASK;
 u32 gpioPinStatePrev = GPIO_MASK;
@@ -112,6 +140,9 @@ int userInputActive = -1;
 
 u32 uiServiceCounter = 0;
 
+u8 uiScopeDrawn = 0;		// The pop-up UI holds the exposure scopes, not a menu.
+u32 uiScopeCount = 0;		// scopeGetResultCount() of the scan drawn.
+
 // Interrupt Handlers --------------------------------------------------------------------------------------------------
 void isrUI(void *CallBackRef, u32 Bank, u32 Status)
 {
@@ -179,6 +210,7 @@ void uiInit(void)
 {
 	uiHideAll();
 	uiClearAll(UI_BG);
+	uiFlush();
 }
 
 void uiService(void)
@@ -302,6 +334,25 @@ void uiService(void)
 			goto uiServiceComplete;
 		}
 	}
+	else if(cState.cSetting[CSETTING_MODE]->val == CSETTING_MODE_PLAYBACK)
+	{
+		if(uiRecClicked)
+		{
+			// Play or pause the clip.
+			playbackPause(!playbackIsPaused());
+			goto uiServiceComplete;
+		}
+
+		if((topMenuActive == -1) && (uiEncScrolled != 0))
+		{
+			// Scrub through the clip one frame per detent, paused on the frame it lands on.
+			s32 iFrame = (s32) playbackGetFrame() + uiEncScrolled;
+			if(iFrame < 0) { iFrame = 0; }
+			playbackPause(1);
+			playbackSeek((u32) iFrame);
+			goto uiServiceComplete;
+		}
+	}
 
 	// Otherwise, handle encoder-based menu interactions.
 	if(topMenuActive == -1)
@@ -461,21 +512,36 @@ uiServiceComplete:
 	uiEncClicked = 0;
 	uiEncScrolled = 0;
 
-	sprintf(strWorking, "c%04d", nClip);
-	uiDrawStringColRow(UI_ID_BOT, strWorking, 0, 0);
+	if(playbackIsActive())
+	{
+		// Clip being played back and the frame on screen.
+		sprintf(strWorking, "c%04d", playClip);
+		uiDrawStringColRow(UI_ID_BOT, strWorking, 0, 0);
+
+		sprintf(strWorking, "%5d/%-5d", playbackGetFrame(), playbackGetFrameCount());
+		uiDrawStringColRow(UI_ID_BOT, strWorking, 8, 0);
+	}
+	else
+	{
+		sprintf(strWorking, "c%04d", nClip);
+		uiDrawStringColRow(UI_ID_BOT, strWorking, 0, 0);
 
-	sprintf(strWorking, "%5.2f:1 Q%-2d", frameCompressionRatio, frameCompressionProfile);
-	uiDrawStringColRow(UI_ID_BOT, strWorking, 8, 0);
+		sprintf(strWorking, "%5.2f:1 Q%-2d", frameCompressionRatio, frameCompressionProfile);
+		uiDrawStringColRow(UI_ID_BOT, strWorking, 8, 0);
+	}
 
 	sprintf(strWorking, "%4d/%-4d GB", fsFreeGB, fsSizeGB);
 	uiDrawStringColRow(UI_ID_BOT, strWorking, 20, 0);
 
-	if((uiServiceCounter % 384) < 128)
+	// Rotate through temperatures and the SSD's 99.9th percentile write latency for the current/last clip.
+	if((uiServiceCounter % 512) < 128)
 	{ sprintf(strWorking, "CPU:%3.0f*C", psplGetTemp(psTemp)); }
-	else if((uiServiceCounter % 384) < 256)
+	else if((uiServiceCounter % 512) < 256)
 	{ sprintf(strWorking, "SSD:%3.0f*C", nvmeGetTemp()); }
-	else
+	else if((uiServiceCounter % 512) < 384)
 	{ sprintf(strWorking, " IS:%3.0f*C", cmvGetTemp()); }
+	else
+	{ sprintf(strWorking, "LAT:%4.0fms", (float) nvmeHistogramPercentile_us(0.999f) / 1000.0f); }
 	uiDrawStringColRow(UI_ID_BOT, strWorking, 42, 0);
 
 	sprintf(strWorking, "%2d.%1dV", supervisorVBatt / 10, supervisorVBatt % 10);
@@ -498,6 +564,29 @@ uiServiceComplete:
 	sprintf(strWorking, "SD:%3.0f*C", nvmeGetTemp());
 	uiDrawStringColRow(UI_ID_BOT, strWorking, 48, 0);
 	*/
+
+	// The exposure scopes use the pop-up UI while no pop-up menu is open.
+	if(popMenuActive != -1)
+	{
+		uiScopeDrawn = 0;
+	}
+	else if(cState.cSetting[CSETTING_SCOPES]->val == CSETTING_SCOPES_ON)
+	{
+		if((scopeGetResultCount() > 0) && (!uiScopeDrawn || (scopeGetResultCount() != uiScopeCount)))
+		{
+			uiScopeCount = scopeGetResultCount();
+			uiDrawScopes(scopeGetResult());
+			uiShow(UI_ID_POP, UI_SCOPE_X0, UI_SCOPE_Y0);
+			uiScopeDrawn = 1;
+		}
+	}
+	else if(uiScopeDrawn)
+	{
+		uiHide(UI_ID_POP);
+		uiScopeDrawn = 0;
+	}
+
+	uiFlush();
 }
 
 // Private Function Definitions ----------------------------------------------------------------------------------------
@@ -668,7 +757,8 @@ void uiClear(u8 uiID, u8 bg)
 {
 	if(uiID > UI_ID_POP) { return; }
 
-	memset((void *) ((u64) uiBaseAddr[uiID]), bg, 32768);
+	memset(uiPlane[uiID], bg, UI_PLANE_SIZE);
+	uiMarkDirty(uiID, 0, uiH[uiID]);
 }
 
 void uiDrawStringColRow(u8 uiID, const char * str, u16 col, u16 row)
@@ -717,7 +807,7 @@ void uiDrawString(u8 uiID, const char * str, u16 x0, u16 y0)
 void uiDrawChar(u8 uiID, char c, u16 x0, u16 y0)
 {
 	u32 srcAddr;
-	u32 destAddr;
+	u8 * dest;
 
 	if(uiID > UI_ID_POP) { return; }
 
@@ -731,9 +821,10 @@ void uiDrawChar(u8 uiID, char c, u16 x0, u16 y0)
 	for(u8 y = 0; y < CHAR_H; y++)
 	{
 		srcAddr = FONT_BASE_ADDR + FONT_W * y + CHAR_W * (c - 32);
-		destAddr = uiBaseAddr[uiID] + uiW[uiID] * (y0 + y) + x0;
-		memcpy((void *) ((u64) destAddr), (void *) ((u64) srcAddr), CHAR_W);
+		dest = &uiPlane[uiID][uiW[uiID] * (y0 + y) + x0];
+		memcpy(dest, (void *) ((u64) srcAddr), CHAR_W);
 	}
+	uiMarkDirty(uiID, y0, CHAR_H);
 }
 
 void uiInvertRectColRow(u8 uiID, u16 col, u16 row, u16 wCol, u16 hRow)
@@ -760,7 +851,7 @@ void uiInvertRectColRow(u8 uiID, u16 col, u16 row, u16 wCol, u16 hRow)
 
 void uiInvertRect(u8 uiID, u16 x0, u16 y0, u16 w, u16 h)
 {
-	u32 invAddr;
+	u32 * inv;
 
 	if(uiID > UI_ID_POP) { return; }
 
@@ -775,8 +866,119 @@ void uiInvertRect(u8 uiID, u16 x0, u16 y0, u16 w, u16 h)
 	{
 		for(u8 x = 0; x < w; x += 4)
 		{
-			invAddr = uiBaseAddr[uiID] + uiW[uiID] * (y0 + y) + x0 + x;
-			*(u32*)((u64) invAddr) = ~(*(u32*)((u64) invAddr));
+			inv = (u32 *) &uiPlane[uiID][uiW[uiID] * (y0 + y) + x0 + x];
+			*inv = ~(*inv);
+		}
+	}
+	uiMarkDirty(uiID, y0, h);
+}
+
+void uiMarkDirty(u8 uiID, u16 y0, u16 h)
+{
+	if(y0 < uiDirtyY0[uiID]) { uiDirtyY0[uiID] = y0; }
+	if((y0 + h) > uiDirtyY1[uiID]) { uiDirtyY1[uiID] = y0 + h; }
+}
+
+// Draw the exposure scopes on the pop-up UI. From the top: the share of clipped pixels, a histogram of all color
+// fields, a waveform of G1 and G2, and a parade of R1, G1 and G2, and B1. The UI is monochrome, so the parade sections
+// are labelled instead of colored.
+void uiDrawScopes(const Scope_s * scope)
+{
+	char strWorking[16];
+	u8 * plane = uiPlane[UI_ID_POP];
+	u16 w = uiW[UI_ID_POP];
+	u32 sum[SCOPE_HIST_BINS];
+	u32 sumMax = 1;
+	u32 clipped = 0;
+	u32 h;
+	u16 x0;
+	float pctClipped = 0.0f;
+
+	uiClear(UI_ID_POP, UI_BG);
+
+	// Pixels in the top histogram bin.
+	for(u8 c = 0; c < 4; c++) { clipped += scope->hist[c][SCOPE_HIST_BINS - 1]; }
+	if(scope->nPx > 0) { pctClipped = 100.0f * (float) clipped / (float)(4 * scope->nPx); }
+	if(pctClipped > 99.9f) { pctClipped = 99.9f; }
+	sprintf(strWorking, "CLP%4.1f%%", pctClipped);
+	uiDrawStringColRow(UI_ID_POP, strWorking, 0, 0);
+
+	// Histogram, scaled to the tallest bin away from the ends, so a clipped spike doesn't flatten the rest.
+	for(u16 b = 0; b < SCOPE_HIST_BINS; b++)
+	{
+		sum[b] = scope->hist[0][b] + scope->hist[1][b] + scope->hist[2][b] + scope->hist[3][b];
+		if((b > 0) && (b < SCOPE_HIST_BINS - 1) && (sum[b] > sumMax)) { sumMax = sum[b]; }
+	}
+	for(u16 b = 0; b < SCOPE_HIST_BINS; b++)
+	{
+		h = (sum[b] * UI_SCOPE_HIST_H) / sumMax;
+		if(h > UI_SCOPE_HIST_H) { h = UI_SCOPE_HIST_H; }
+		if((h == 0) && (sum[b] > 0)) { h = 1; }
+		for(u16 y = UI_SCOPE_HIST_Y0 + UI_SCOPE_HIST_H - h; y < UI_SCOPE_HIST_Y0 + UI_SCOPE_HIST_H; y++)
+		{
+			plane[w * y + b] = (b == SCOPE_HIST_BINS - 1) ? 0xFF : UI_SCOPE_BAR;
+		}
+	}
+
+	// Waveform and parade, level 0 at the bottom.
+	for(u8 level = 0; level < SCOPE_LEVELS; level++)
+	{
+		for(u16 col = 0; col < SCOPE_WAVE_COLS; col++)
+		{
+			plane[w * (UI_SCOPE_WAVE_Y0 + SCOPE_LEVELS - 1 - level) + col] =
+				uiScopeIntensity(scope->wave[level][col], level);
+		}
+
+		for(u8 section = 0; section < 3; section++)
+		{
+			x0 = section * (SCOPE_PARADE_COLS + UI_SCOPE_PARADE_GAP);
+			for(u16 col = 0; col < SCOPE_PARADE_COLS; col++)
+			{
+				plane[w * (UI_SCOPE_PARADE_Y0 + SCOPE_LEVELS - 1 - level) + x0 + col] =
+					uiScopeIntensity(scope->parade[section][level][col], level);
+			}
 		}
 	}
+
+	uiDrawStringColRow(UI_ID_POP, " R  G B ", 0, 7);
+}
+
+// Waveform and parade pixel for a count, or the graticule if there are none.
+u8 uiScopeIntensity(u32 count, u8 level)
+{
+	u32 intensity = UI_BG;
+
+	if(count == 0)
+	{
+		if((level > 0) && ((level % 16) == 0)) { return UI_SCOPE_GRID; }
+		return UI_BG;
+	}
+
+	while(count)
+	{
+		intensity += UI_SCOPE_STEP;
+		count >>= 1;
+	}
+	if(intensity > 0xFF) { intensity = 0xFF; }
+
+	return (u8) intensity;
+}
+
+// Upload the changed rows of each UI plane. Drawing during an upload can tear it, but then the plane is dirty again
+// and the next flush corrects it.
+void uiFlush(void)
+{
+	u32 offset;
+
+	for(u8 uiID = UI_ID_TOP; uiID <= UI_ID_POP; uiID++)
+	{
+		if(uiDirtyY1[uiID] <= uiDirtyY0[uiID]) { continue; }
+
+		offset = uiW[uiID] * uiDirtyY0[uiID];
+		dmaUpload((void *) ((u64) (uiBaseAddr[uiID] + offset)), &uiPlane[uiID][offset],
+		          uiW[uiID] * (uiDirtyY1[uiID] - uiDirtyY0[uiID]), NULL, NULL);
+
+		uiDirtyY0[uiID] = 0xFFFF;
+		uiDirtyY1[uiID] = 0;
+	}
 }
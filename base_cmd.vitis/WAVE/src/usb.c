@@ -25,11 +25,15 @@ THE SOFTWARE.
 // Include Headers -----------------------------------------------------------------------------------------------------
 
 #include "usb.h"
+#include "usb_uas.h"
+#include "usb_vendor.h"
 #include "xusb_ch9_storage.h"
 #include "xusb_class_storage.h"
 #include "xusb_wrapper.h"
 #include "xiicps.h"
 #include "nvme.h"
+#include "ff.h"
+#include "diskio.h"
 
 // Private Pre-Processor Definitions -----------------------------------------------------------------------------------
 
@@ -98,8 +102,28 @@ THE SOFTWARE.
 // #define MEMORY_SIZE (64U * 1024U)
 #define MEMORY_SIZE 64U
 
+// SSD to USB read-ahead ring in SSD2USB (0x70000000 - 0x78000000).
+#define USB_READ_SLOTS       16
+#define USB_READ_SLOT_SIZE   0x800000       // 8MiB per slot, sent as one bulk-IN TRB: must stay under 16MiB.
+#define USB_READ_AHEAD       2              // Sequential ranges read ahead of the host.
+#define USB_NVME_CHUNK       0x20000        // 128KiB per NVMe command: fits one PRP list page and typical MDTS.
+
+// USB to SSD receive ring in USB2SSD (0x78000000 - 0x79000000).
+#define USB_WRITE_SLOTS      16
+#define USB_WRITE_SLOT_SIZE  0x100000       // 1MiB received per bulk-OUT transfer.
+
 // Private Type Definitions --------------------------------------------------------------------------------------------
 
+typedef struct
+{
+	u64 lba;
+	u32 nBlocks;			// 0: Empty.
+	u16 cidFirst;			// NVMe commands filling the slot: cidFirst to cidFirst + nCommands - 1.
+	u16 nCommands;
+	u32 ioErrors;			// nvmeGetIOErrorCount() before the slot's commands were issued.
+	u32 lastUse;
+} usbBridgeSlot_s;
+
 // Private Function Prototypes -----------------------------------------------------------------------------------------
 
 // USB function prototypes.
@@ -108,10 +132,20 @@ void usbInitLane1(void);
 void usbPSU_Mask_Write(unsigned long offset, unsigned long mask, unsigned long val);
 void usbI2CWriteMasked(u8 addr, u8 data, u8 mask);
 
+u8 * usbReadSlotAddr(int i);
+void usbReadSlotStart(int i, u64 lba, u32 nBlocks);
+int usbReadSlotFind(u64 lba, u32 nBlocks);
+int usbReadSlotAlloc(int iExclude);
+u8 * usbWriteSlotAddr(int i);
+void usbWriteSlotStart(int i, u64 lba, u32 nBlocks);
+int usbBridgeSlotWait(usbBridgeSlot_s * slot);
+void usbBridgeDiskWrite(LBA_t sector, UINT count);
+
 void BulkOutHandler(void *CallBackRef, u32 RequestedBytes,
 							u32 BytesTxed);
 void BulkInHandler(void *CallBackRef, u32 RequestedBytes,
 							u32 BytesTxed);
+void usbSetInterface(struct Usb_DevData *InstancePtr, SetupPacket *SetupData);
 
 // Public Global Variables ---------------------------------------------------------------------------------------------
 
@@ -130,7 +164,19 @@ u8 Buffer[MEMORY_SIZE] ALIGNMENT_CACHELINE;
 
 USB_CBW CBW ALIGNMENT_CACHELINE;
 USB_CSW CSW ALIGNMENT_CACHELINE;
-u32 VFLASH_NUM_BLOCKS;
+u64 VFLASH_NUM_BLOCKS;
+u32 VFLASH_BLOCK_SIZE;
+
+usbBridgeSlot_s usbReadSlot[USB_READ_SLOTS];
+u32 usbReadUseCounter = 0;
+u64 usbReadLBA;				// Next piece of the bridge READ being sent.
+u32 usbReadBlocksLeft = 0;
+int usbReadStatus = NVME_IO_OK;	// NVME_IO_ERROR if any piece of the bridge READ failed.
+
+usbBridgeSlot_s usbWriteSlot[USB_WRITE_SLOTS];
+int usbWriteSlotIndex = 0;	// Slot being received into.
+u64 usbWriteLBA;			// Destination of the slot being received into.
+int usbWriteStatus = NVME_IO_OK;	// NVME_IO_ERROR if any slot of the bridge WRITE failed.
 
 u8	Phase;
 u32	rxBytesLeft;
@@ -153,7 +199,7 @@ static USBCH9_DATA storage_data = {
 				.Usb_SetConfigurationApp =
 						Usb_SetConfigurationApp,
 				/* hook the set interface handler */
-				.Usb_SetInterfaceHandler = NULL,
+				.Usb_SetInterfaceHandler = usbSetInterface,
 				/* hook up storage class handler */
 				.Usb_ClassReq = ClassReq,
 				.Usb_GetDescReply = NULL,
@@ -182,7 +228,10 @@ void usbInit(void)
 	usbI2CWriteMasked(0x02, 0x03, 0x03);
 
 	// Get the disk size from NVMe.
-	VFLASH_NUM_BLOCKS = nvmeGetLBACount();
+	usbUpdateCapacity();
+
+	// The bridge must not serve read-ahead data from before a firmware write through FatFs.
+	diskSetWriteCallback(usbBridgeDiskWrite);
 
 	UsbConfigPtr = LookupConfig(USB_DEVICE_ID);
 	CfgInitialize(&UsbInstance, UsbConfigPtr, UsbConfigPtr->BaseAddress);
@@ -191,9 +240,17 @@ void usbInit(void)
 	Set_DrvData(UsbInstance.PrivateData, &storage_data);
 	EpConfigure(UsbInstance.PrivateData, 1U, USB_EP_DIR_OUT, USB_EP_TYPE_BULK);
 	EpConfigure(UsbInstance.PrivateData, 1U, USB_EP_DIR_IN, USB_EP_TYPE_BULK);
+	EpConfigure(UsbInstance.PrivateData, 2U, USB_EP_DIR_OUT, USB_EP_TYPE_BULK);
+	EpConfigure(UsbInstance.PrivateData, 2U, USB_EP_DIR_IN, USB_EP_TYPE_BULK);
+	EpConfigure(UsbInstance.PrivateData, 3U, USB_EP_DIR_OUT, USB_EP_TYPE_BULK);
+	EpConfigure(UsbInstance.PrivateData, 3U, USB_EP_DIR_IN, USB_EP_TYPE_BULK);
 	ConfigureDevice(UsbInstance.PrivateData, Buffer, MEMORY_SIZE);
 	SetEpHandler(UsbInstance.PrivateData, 1U, USB_EP_DIR_OUT, BulkOutHandler);
 	SetEpHandler(UsbInstance.PrivateData, 1U, USB_EP_DIR_IN, BulkInHandler);
+	SetEpHandler(UsbInstance.PrivateData, 2U, USB_EP_DIR_OUT, uasCommandHandler);
+	SetEpHandler(UsbInstance.PrivateData, 2U, USB_EP_DIR_IN, uasStatusHandler);
+	SetEpHandler(UsbInstance.PrivateData, 3U, USB_EP_DIR_OUT, vendorCommandHandler);
+	SetEpHandler(UsbInstance.PrivateData, 3U, USB_EP_DIR_IN, vendorDataInHandler);
 	UsbEnableEvent(UsbInstance.PrivateData, XUSBPSU_DEVTEN_EVNTOVERFLOWEN |
 						 	 	 	 	 	XUSBPSU_DEVTEN_WKUPEVTEN |
 											XUSBPSU_DEVTEN_ULSTCNGEN |
@@ -207,10 +264,255 @@ void usbInit(void)
 void usbPoll(void)
 {
 	UsbPollHandler(UsbInstance.PrivateData);
+	uasService();
+	vendorService();
+}
+
+// Block count and size reported to the host follow the NVMe namespace format, 512B or 4KiB.
+void usbUpdateCapacity(void)
+{
+	// Drives over 2^32 blocks are described by READ CAPACITY(16).
+	VFLASH_NUM_BLOCKS = nvmeGetLBACount();
+	VFLASH_BLOCK_SIZE = nvmeGetLBASize();
+
+	// Called again after a format: read-ahead data and clip indexes built for the vendor interface are stale.
+	usbBridgeInvalidateAll();
+	vendorInvalidate();
+}
+
+// Mass storage bridge read of at most one slot. Returns a buffer in SSD2USB holding nBlocks from lba, then reads the next
+// USB_READ_AHEAD ranges of the same size into other slots, so the SSD works on them while this one is on the wire.
+u8 * usbBridgeRead(u64 lba, u32 nBlocks)
+{
+	int i, j;
+	u64 lbaNext;
+
+	i = usbReadSlotFind(lba, nBlocks);
+	if(i < 0)
+	{
+		i = usbReadSlotAlloc(-1);
+		usbReadSlotStart(i, lba, nBlocks);
+	}
+	usbReadSlot[i].lastUse = ++usbReadUseCounter;
+
+	// Queue the read-ahead before waiting, so the SSD never idles between host requests.
+	lbaNext = lba + nBlocks;
+	for(int k = 0; k < USB_READ_AHEAD; k++)
+	{
+		if(lbaNext + nBlocks > nvmeGetLBACount()) { break; }
+		if(usbReadSlotFind(lbaNext, nBlocks) < 0)
+		{
+			j = usbReadSlotAlloc(i);
+			usbReadSlotStart(j, lbaNext, nBlocks);
+		}
+		lbaNext += nBlocks;
+	}
+
+	// A failed slot is sent once, then dropped so the next READ of it goes back to the SSD.
+	if(usbBridgeSlotWait(&usbReadSlot[i]) != NVME_IO_OK)
+	{
+		usbReadStatus = NVME_IO_ERROR;
+		usbReadSlot[i].nBlocks = 0;
+	}
+
+	return usbReadSlotAddr(i) + (lba - usbReadSlot[i].lba) * VFLASH_BLOCK_SIZE;
+}
+
+// Mass storage bridge READ of any length: sent in pieces of at most one slot, see usbBridgeReadNext().
+void usbBridgeReadStart(u64 lba, u32 nBlocks)
+{
+	usbReadLBA = lba;
+	usbReadBlocksLeft = nBlocks;
+	usbReadStatus = NVME_IO_OK;
+}
+
+// Next piece of the bridge READ. Returns its length [B], or 0 when the READ is complete.
+u32 usbBridgeReadNext(u8 ** buffer)
+{
+	u32 nBlocks = USB_READ_SLOT_SIZE / VFLASH_BLOCK_SIZE;
+
+	if(usbReadBlocksLeft == 0) { return 0; }
+	if(nBlocks > usbReadBlocksLeft) { nBlocks = usbReadBlocksLeft; }
+
+	*buffer = usbBridgeRead(usbReadLBA, nBlocks);
+	usbReadLBA += nBlocks;
+	usbReadBlocksLeft -= nBlocks;
+
+	return nBlocks * VFLASH_BLOCK_SIZE;
+}
+
+// NVME_IO_ERROR if the SSD failed any piece of the bridge READ sent so far.
+int usbBridgeReadStatus(void)
+{
+	return usbReadStatus;
+}
+
+// Drop read-ahead data overlapping LBAs being written, by the host or by the firmware through diskio.c.
+void usbBridgeInvalidate(u64 lba, u32 nBlocks)
+{
+	for(int i = 0; i < USB_READ_SLOTS; i++)
+	{
+		if(usbReadSlot[i].nBlocks && (usbReadSlot[i].lba < lba + nBlocks) && (lba < usbReadSlot[i].lba + usbReadSlot[i].nBlocks))
+		{
+			usbBridgeSlotWait(&usbReadSlot[i]);
+			usbReadSlot[i].nBlocks = 0;
+		}
+	}
+}
+
+// Drop all read-ahead data, once its reads are done.
+void usbBridgeInvalidateAll(void)
+{
+	for(int i = 0; i < USB_READ_SLOTS; i++)
+	{
+		usbBridgeSlotWait(&usbReadSlot[i]);
+		usbReadSlot[i].nBlocks = 0;
+	}
+}
+
+// Mass storage bridge write. Sets up the receive ring for nBlocks to lba and returns the length of the first
+// bulk-OUT transfer, to be received at VirtFlashWritePointer.
+u32 usbBridgeWriteStart(u64 lba, u32 nBlocks)
+{
+	usbBridgeInvalidate(lba, nBlocks);
+	vendorInvalidate();
+
+	usbWriteSlotIndex = (usbWriteSlotIndex + 1) % USB_WRITE_SLOTS;
+	usbBridgeSlotWait(&usbWriteSlot[usbWriteSlotIndex]);
+	usbWriteLBA = lba;
+	usbWriteStatus = NVME_IO_OK;
+
+	VirtFlashWritePointer = usbWriteSlotAddr(usbWriteSlotIndex);
+	rxBytesLeft = nBlocks * VFLASH_BLOCK_SIZE;
+
+	return (rxBytesLeft < USB_WRITE_SLOT_SIZE) ? rxBytesLeft : USB_WRITE_SLOT_SIZE;
+}
+
+// Wait for every bridge write to complete. Returns NVME_IO_ERROR if any of them failed.
+int usbBridgeWriteDrain(void)
+{
+	int status = NVME_IO_OK;
+
+	for(int i = 0; i < USB_WRITE_SLOTS; i++)
+	{
+		if(usbBridgeSlotWait(&usbWriteSlot[i]) != NVME_IO_OK) { status = NVME_IO_ERROR; }
+	}
+
+	return status;
 }
 
 // Private Function Definitions ----------------------------------------------------------------------------------------
 
+u8 * usbReadSlotAddr(int i)
+{
+	return (u8 *)((u64) SSD2USB_BUFFER_ADDR + i * USB_READ_SLOT_SIZE);
+}
+
+// Issue the NVMe reads for a slot without waiting for them.
+void usbReadSlotStart(int i, u64 lba, u32 nBlocks)
+{
+	u32 nBlocksPerCommand = USB_NVME_CHUNK / VFLASH_BLOCK_SIZE;
+	u32 nBlocksCommand;
+	u8 * dest = usbReadSlotAddr(i);
+
+	nvmeWaitForWrites(lba, nBlocks);
+
+	usbReadSlot[i].lba = lba;
+	usbReadSlot[i].nBlocks = nBlocks;
+	usbReadSlot[i].cidFirst = nvmeGetIOCID();
+	usbReadSlot[i].nCommands = 0;
+	usbReadSlot[i].ioErrors = nvmeGetIOErrorCount();
+	usbReadSlot[i].lastUse = ++usbReadUseCounter;
+
+	for(u32 offset = 0; offset < nBlocks; offset += nBlocksCommand)
+	{
+		nBlocksCommand = (nBlocks - offset < nBlocksPerCommand) ? (nBlocks - offset) : nBlocksPerCommand;
+		nvmeRead(dest + offset * VFLASH_BLOCK_SIZE, lba + offset, nBlocksCommand);
+		usbReadSlot[i].nCommands++;
+	}
+}
+
+// Wait for the slot's NVMe commands. Returns NVME_IO_OK or NVME_IO_ERROR, once: the slot is then idle. A slot has
+// more commands than the I/O queue depth, and nvmeWaitCIDRange() counts the older ones as OK, so any I/O error since
+// the slot was issued fails it.
+int usbBridgeSlotWait(usbBridgeSlot_s * slot)
+{
+	int status;
+
+	if(slot->nCommands == 0) { return NVME_IO_OK; }
+
+	status = nvmeWaitCIDRange(slot->cidFirst, slot->nCommands);
+	if(nvmeGetIOErrorCount() != slot->ioErrors) { status = NVME_IO_ERROR; }
+	slot->nCommands = 0;
+
+	return status;
+}
+
+// diskio write callback: FatFs writes from the firmware go around the bridge's read slots.
+void usbBridgeDiskWrite(LBA_t sector, UINT count)
+{
+	usbBridgeInvalidate((u64) sector, count);
+}
+
+// Slot that holds [lba, lba + nBlocks), or -1.
+int usbReadSlotFind(u64 lba, u32 nBlocks)
+{
+	for(int i = 0; i < USB_READ_SLOTS; i++)
+	{
+		if(usbReadSlot[i].nBlocks && (lba >= usbReadSlot[i].lba)
+		&& (lba + nBlocks <= usbReadSlot[i].lba + usbReadSlot[i].nBlocks)) { return i; }
+	}
+
+	return -1;
+}
+
+u8 * usbWriteSlotAddr(int i)
+{
+	return (u8 *)((u64) USB2SSD_BUFFER_ADDR + i * USB_WRITE_SLOT_SIZE);
+}
+
+// Issue the NVMe writes for a received slot without waiting for them.
+void usbWriteSlotStart(int i, u64 lba, u32 nBlocks)
+{
+	u32 nBlocksPerCommand = USB_NVME_CHUNK / VFLASH_BLOCK_SIZE;
+	u32 nBlocksCommand;
+	u8 * src = usbWriteSlotAddr(i);
+
+	// The SSD may complete overlapping writes in any order.
+	nvmeWaitForWrites(lba, nBlocks);
+
+	usbWriteSlot[i].lba = lba;
+	usbWriteSlot[i].nBlocks = nBlocks;
+	usbWriteSlot[i].cidFirst = nvmeGetIOCID();
+	usbWriteSlot[i].nCommands = 0;
+	usbWriteSlot[i].ioErrors = nvmeGetIOErrorCount();
+
+	for(u32 offset = 0; offset < nBlocks; offset += nBlocksCommand)
+	{
+		nBlocksCommand = (nBlocks - offset < nBlocksPerCommand) ? (nBlocks - offset) : nBlocksPerCommand;
+		nvmeWrite(src + offset * VFLASH_BLOCK_SIZE, lba + offset, nBlocksCommand);
+		usbWriteSlot[i].nCommands++;
+	}
+}
+
+// Least recently used slot, other than the one being sent.
+int usbReadSlotAlloc(int iExclude)
+{
+	int iLRU = -1;
+
+	for(int i = 0; i < USB_READ_SLOTS; i++)
+	{
+		if(i == iExclude) { continue; }
+		if((iLRU < 0) || (usbReadSlot[i].lastUse < usbReadSlot[iLRU].lastUse)) { iLRU = i; }
+	}
+
+	// A stale read-ahead may still be filling it.
+	usbBridgeSlotWait(&usbReadSlot[iLRU]);
+
+	return iLRU;
+}
+
+
 void usbInitLane0(void)
 {
 	usbPSU_Mask_Write(SERDES_PLL_REF_SEL0_OFFSET, 0x0000001FU, 0x0000000DU);
@@ -301,6 +603,35 @@ void usbI2CWriteMasked(u8 addr, u8 data, u8 mask)
 	while (XIicPs_BusIsBusy(&usbIic));
 }
 
+// SET_INTERFACE: alternate setting 0 is Bulk-Only Transport, 1 is UAS (high speed only). The vendor interface has
+// alternate setting 0 only, selecting it again resets it.
+void usbSetInterface(struct Usb_DevData *InstancePtr, SetupPacket *SetupData)
+{
+	if(SetupData->wIndex == USB_VENDOR_INTERFACE)
+	{
+		vendorStop();
+		vendorStart(InstancePtr);
+		return;
+	}
+
+	// Both transports share SSD2USB and the SSD, start from a clean slate.
+	usbBridgeWriteDrain();
+	usbBridgeInvalidateAll();
+	usbBridgeReadStart(0, 0);
+	uasStop();
+	StopTransfer(InstancePtr->PrivateData, 1U, USB_EP_DIR_OUT);
+
+	if((SetupData->wValue == USB_ALT_UAS) && (InstancePtr->Speed != USB_SPEED_SUPER))
+	{
+		uasStart(InstancePtr);
+	}
+	else
+	{
+		Phase = USB_EP_STATE_COMMAND;
+		EpBufferRecv(InstancePtr->PrivateData, 1U, (u8 *) &CBW, sizeof(CBW));
+	}
+}
+
 /****************************************************************************/
 /**
 * This function is Bulk Out Endpoint handler/Callback called by driver when
@@ -321,31 +652,54 @@ void BulkOutHandler(void *CallBackRef, u32 RequestedBytes,
 {
 	struct Usb_DevData *InstancePtr = CallBackRef;
 
+	if (uasIsActive()) {
+		uasDataOutHandler(CallBackRef, RequestedBytes, BytesTxed);
+		return;
+	}
+
 	if (Phase == USB_EP_STATE_COMMAND) {
 		ParseCBW(InstancePtr);
 	} else if (Phase == USB_EP_STATE_DATA_OUT) {
+		AddCSWData(BytesTxed);
 		/* WRITE command */
 		switch (CBW.CBWCB[0U]) {
 		case USB_RBC_WRITE:
+		case USB_RBC_WRITE16:
 		{
 			// NVMe Bridge Write
 			// ----------------------------------------------------------------------------
-			u32 lbOffset = htonl(((SCSI_READ_WRITE *) &CBW.CBWCB)->block);
-			u32 wLength = BytesTxed;
-			nvmeWrite(VirtFlashWritePointer, lbOffset, wLength >> 9);
-			while(nvmeGetIOSlip() > 0)
+			int iReceived = usbWriteSlotIndex;
+			u64 lbaReceived = usbWriteLBA;
+			u32 nBlocksReceived = BytesTxed / VFLASH_BLOCK_SIZE;
+			rxBytesLeft -= BytesTxed;
+
+			// Re-arm the endpoint into the next slot before writing this one, so the host keeps sending.
+			if(rxBytesLeft > 0)
 			{
-				nvmeServiceIOCompletions(16);
+				usbWriteSlotIndex = (usbWriteSlotIndex + 1) % USB_WRITE_SLOTS;
+				if(usbBridgeSlotWait(&usbWriteSlot[usbWriteSlotIndex]) != NVME_IO_OK) { usbWriteStatus = NVME_IO_ERROR; }
+				usbWriteLBA = lbaReceived + nBlocksReceived;
+				VirtFlashWritePointer = usbWriteSlotAddr(usbWriteSlotIndex);
+				EpBufferRecv(InstancePtr->PrivateData, 1U, VirtFlashWritePointer,
+				             (rxBytesLeft < USB_WRITE_SLOT_SIZE) ? rxBytesLeft : USB_WRITE_SLOT_SIZE);
+			}
+
+			usbWriteSlotStart(iReceived, lbaReceived, nBlocksReceived);
+			if(rxBytesLeft > 0) { return; }
+
+			// Good status only once the SSD has completed every write of the command.
+			if(usbBridgeWriteDrain() != NVME_IO_OK) { usbWriteStatus = NVME_IO_ERROR; }
+			if(usbWriteStatus != NVME_IO_OK)
+			{
+				SetCSWError(SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_WRITE_ERROR);
 			}
 			// ----------------------------------------------------------------------------
-			VirtFlashWritePointer += BytesTxed;
-			rxBytesLeft -= BytesTxed;
 			break;
 		}
 		default:
 			break;
 		}
-		SendCSW(InstancePtr, 0U);
+		EndDataOut(InstancePtr);
 	}
 }
 
@@ -368,9 +722,27 @@ void BulkInHandler(void *CallBackRef, u32 RequestedBytes,
 {
 	struct Usb_DevData *InstancePtr = CallBackRef;
 
+	if (uasIsActive()) {
+		uasDataInHandler(CallBackRef, RequestedBytes, BytesTxed);
+		return;
+	}
+
 	if (Phase == USB_EP_STATE_DATA_IN) {
-		/* Send the status */
-		SendCSW(InstancePtr, 0U);
+		u8 *BufferPtr;
+		u32 Length;
+
+		AddCSWData(BytesTxed);
+
+		/* Send the next piece of a bridge READ, then the status */
+		Length = usbBridgeReadNext(&BufferPtr);
+		if (Length > 0) {
+			EpBufferSend(InstancePtr->PrivateData, 1U, BufferPtr, Length);
+			return;
+		}
+		if (usbBridgeReadStatus() != NVME_IO_OK) {
+			SetCSWError(SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_UNRECOVERED_READ_ERROR);
+		}
+		EndDataIn(InstancePtr, BytesTxed);
 	} else if (Phase == USB_EP_STATE_STATUS) {
 		Phase = USB_EP_STATE_COMMAND;
 		/* Receive next CBW */
@@ -37,6 +37,15 @@ THE SOFTWARE.
 
 void usbInit(void);
 void usbPoll(void);
+void usbUpdateCapacity(void);
+u8 * usbBridgeRead(u64 lba, u32 nBlocks);
+void usbBridgeReadStart(u64 lba, u32 nBlocks);
+u32 usbBridgeReadNext(u8 ** buffer);
+int usbBridgeReadStatus(void);
+void usbBridgeInvalidate(u64 lba, u32 nBlocks);
+void usbBridgeInvalidateAll(void);
+u32 usbBridgeWriteStart(u64 lba, u32 nBlocks);
+int usbBridgeWriteDrain(void);
 
 // Externed Public Global Variables ------------------------------------------------------------------------------------
 
@@ -0,0 +1,782 @@
+/*
+USB Attached SCSI (UAS) Transport
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <string.h>
+#include "usb_uas.h"
+#include "usb_vendor.h"
+#include "xusb_ch9_storage.h"
+#include "xusb_class_storage.h"
+#include "xusb_wrapper.h"
+#include "nvme.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Pipes: Command OUT and Status IN on EP2, Data IN and Data OUT on EP1 (shared with BOT, alternate setting 0).
+#define UAS_EP_COMMAND       2
+#define UAS_EP_STATUS        2
+#define UAS_EP_DATA          1
+
+// Commands in flight. Each owns a slot in SSD2USB (0x70000000 - 0x78000000) for its data phase.
+#define UAS_TAGS             16
+#define UAS_SLOT_SIZE        0x800000       // 8MiB, longer transfers move through the slot in pieces.
+#define UAS_NVME_CHUNK       0x20000        // 128KiB per NVMe command.
+
+#define UAS_IU_SIZE          64
+#define UAS_STATUS_QUEUE     (2 * UAS_TAGS)
+
+// Information Unit IDs
+#define UAS_IU_COMMAND       0x01
+#define UAS_IU_SENSE         0x03
+#define UAS_IU_RESPONSE      0x04
+#define UAS_IU_TASK_MGMT     0x05
+#define UAS_IU_READ_READY    0x06
+#define UAS_IU_WRITE_READY   0x07
+
+// Response IU codes
+#define UAS_RC_TMF_COMPLETE          0x00
+#define UAS_RC_INVALID_IU            0x02
+#define UAS_RC_TMF_NOT_SUPPORTED     0x04
+#define UAS_RC_TMF_FAILED            0x05
+#define UAS_RC_TMF_SUCCEEDED         0x08
+#define UAS_RC_OVERLAPPED_TAG        0x0A
+
+// Task management functions
+#define UAS_TMF_ABORT_TASK           0x01
+#define UAS_TMF_ABORT_TASK_SET       0x02
+#define UAS_TMF_CLEAR_TASK_SET       0x04
+#define UAS_TMF_LOGICAL_UNIT_RESET   0x08
+#define UAS_TMF_IT_NEXUS_RESET       0x10
+#define UAS_TMF_QUERY_TASK           0x80
+
+// Tag states
+#define UAS_TAG_FREE         0
+#define UAS_TAG_READ         1      // NVMe read of the first piece in flight.
+#define UAS_TAG_DATA_IN      2      // Data ready, waiting for the data pipe.
+#define UAS_TAG_DATA_OUT     3      // Waiting for the data pipe.
+#define UAS_TAG_ACTIVE       4      // Owns the data pipe: ready IU queued or data moving.
+#define UAS_TAG_ACTIVE_READ  5      // Owns the data pipe, NVMe read of the next piece in flight.
+#define UAS_TAG_ACTIVE_WRITE 6      // Owns the data pipe, NVMe write of the last piece in flight.
+#define UAS_TAG_WRITE        7      // All data received, NVMe writes in flight.
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct __attribute__((packed))
+{
+	u8 id;
+	u8 reserved0;
+	u16 tag;				// Big-endian.
+	u8 attribute;
+	u8 reserved1;
+	u8 cdbLength;			// Additional CDB length [DWORD] in bits 7:2.
+	u8 reserved2;
+	u8 lun[8];
+	u8 cdb[16];
+} uasCommandIU_s;
+
+typedef struct __attribute__((packed))
+{
+	u8 id;
+	u8 reserved0;
+	u16 tag;				// Big-endian.
+	u8 function;
+	u8 reserved1;
+	u16 taskTag;			// Big-endian.
+	u8 lun[8];
+} uasTaskMgmtIU_s;
+
+typedef struct __attribute__((packed))
+{
+	u8 id;
+	u8 reserved0;
+	u16 tag;				// Big-endian.
+	u16 statusQualifier;
+	u8 status;
+	u8 reserved1[7];
+	u16 length;				// Big-endian.
+	SCSI_SENSE_DATA sense;
+} uasSenseIU_s;
+
+typedef struct __attribute__((packed))
+{
+	u8 id;
+	u8 reserved0;
+	u16 tag;				// Big-endian.
+	u8 info[3];
+	u8 code;
+} uasResponseIU_s;
+
+typedef struct
+{
+	u16 tag;				// Host tag, big-endian as received.
+	u8 state;
+	u8 write;
+	u64 lba;				// First LBA of the next piece.
+	u32 bytesLeft;			// Data phase bytes not yet transferred, including the current piece.
+	u32 pieceLength;		// [B]
+	u16 cidFirst;			// NVMe commands for the current piece: cidFirst to cidFirst + nCommands - 1.
+	u16 nCommands;
+	u32 ioErrors;			// nvmeGetIOErrorCount() before the current piece's commands were issued.
+	u8 failed;				// An NVMe command of the data phase failed: report it in the status.
+	u32 order;				// Arrival order, the oldest waiting tag gets the data pipe next.
+} uasTag_s;
+
+typedef struct
+{
+	u8 iu[UAS_IU_SIZE];
+	u32 length;
+	s8 iTagStart;			// Start this tag's data phase once the IU is sent, or -1.
+} uasStatusEntry_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+u8 * uasSlotAddr(int i);
+void uasParseCommand(uasCommandIU_s * iu);
+void uasParseTaskMgmt(uasTaskMgmtIU_s * iu);
+int uasTagFind(u16 tag);
+int uasTagAlloc(void);
+void uasTagReadPiece(int i);
+void uasTagWritePiece(int i, u32 length);
+u8 uasTagIODone(int i);
+void uasTagWaitIO(int i);
+void uasTagDataIn(int i, const u8 * data, u32 length, u32 allocationLength);
+void uasTagComplete(int i, u8 status, u8 senseKey, u8 asc);
+void uasTagCompleteIO(int i);
+uasStatusEntry_s * uasStatusAlloc(void);
+void uasArmCommand(void);
+void uasQueueSense(u16 tag, u8 status, u8 senseKey, u8 asc);
+void uasQueueResponse(u16 tag, u8 code);
+void uasQueueReady(int i);
+void uasStartData(int i);
+void uasSendStatus(void);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+extern u64 VFLASH_NUM_BLOCKS;
+extern u32 VFLASH_BLOCK_SIZE;
+extern const SCSI_INQUIRY scsiInquiry[];
+
+struct Usb_DevData * uasInstance;
+u8 uasActive = 0;
+
+u8 uasCommandIU[UAS_IU_SIZE] ALIGNMENT_CACHELINE;
+u8 uasCommandArmed = 0;		// Command pipe waiting for an IU.
+u8 uasStatusIU[UAS_IU_SIZE] ALIGNMENT_CACHELINE;
+
+uasTag_s uasTag[UAS_TAGS];
+u32 uasOrderCounter = 0;
+int uasDataTag = -1;		// Tag that owns the data pipe, or -1.
+
+uasStatusEntry_s uasStatusQueue[UAS_STATUS_QUEUE];
+u32 uasStatusHead = 0;
+u32 uasStatusTail = 0;
+u8 uasStatusBusy = 0;
+s8 uasStatusTagStart = -1;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// Alternate setting 1 selected: EP1 is already enabled for BOT, EP2 carries commands and status.
+void uasStart(struct Usb_DevData * InstancePtr)
+{
+	uasInstance = InstancePtr;
+
+	memset(uasTag, 0, sizeof(uasTag));
+	uasDataTag = -1;
+	uasStatusHead = 0;
+	uasStatusTail = 0;
+	uasStatusBusy = 0;
+	uasStatusTagStart = -1;
+	uasCommandArmed = 0;
+
+	EpEnable(uasInstance->PrivateData, UAS_EP_COMMAND, USB_EP_DIR_OUT, 512, USB_EP_TYPE_BULK);
+	EpEnable(uasInstance->PrivateData, UAS_EP_STATUS, USB_EP_DIR_IN, 512, USB_EP_TYPE_BULK);
+	uasActive = 1;
+
+	uasArmCommand();
+}
+
+// Back to BOT (or deconfigured). Outstanding NVMe I/O is allowed to finish, its results are dropped.
+void uasStop(void)
+{
+	if(!uasActive) { return; }
+
+	for(int i = 0; i < UAS_TAGS; i++)
+	{
+		if(uasTag[i].state != UAS_TAG_FREE) { uasTagWaitIO(i); }
+		uasTag[i].state = UAS_TAG_FREE;
+	}
+
+	EpDisable(uasInstance->PrivateData, UAS_EP_COMMAND, USB_EP_DIR_OUT);
+	EpDisable(uasInstance->PrivateData, UAS_EP_STATUS, USB_EP_DIR_IN);
+	uasActive = 0;
+}
+
+u8 uasIsActive(void)
+{
+	return uasActive;
+}
+
+// Called from the main loop. Moves tags whose NVMe I/O completed on to their next phase.
+void uasService(void)
+{
+	int iNext = -1;
+
+	if(!uasActive) { return; }
+
+	nvmeServiceIOCompletions(16);
+
+	for(int i = 0; i < UAS_TAGS; i++)
+	{
+		switch(uasTag[i].state)
+		{
+		case UAS_TAG_READ:
+			if(uasTagIODone(i)) { uasTag[i].state = UAS_TAG_DATA_IN; }
+			break;
+		case UAS_TAG_ACTIVE_READ:
+			if(uasTagIODone(i)) { uasStartData(i); }
+			break;
+		case UAS_TAG_ACTIVE_WRITE:
+			if(uasTagIODone(i)) { uasStartData(i); }
+			break;
+		case UAS_TAG_WRITE:
+			if(uasTagIODone(i)) { uasTagCompleteIO(i); }
+			break;
+		default:
+			break;
+		}
+
+		// Oldest tag waiting for the data pipe.
+		if(((uasTag[i].state == UAS_TAG_DATA_IN) || (uasTag[i].state == UAS_TAG_DATA_OUT))
+		&& ((iNext < 0) || ((s32)(uasTag[i].order - uasTag[iNext].order) < 0))) { iNext = i; }
+	}
+
+	// Without streams the host learns which tag the data pipe serves from a READ READY or WRITE READY IU.
+	if((uasDataTag < 0) && (iNext >= 0))
+	{
+		uasDataTag = iNext;
+		uasTag[iNext].state = UAS_TAG_ACTIVE;
+		uasQueueReady(iNext);
+	}
+
+	uasSendStatus();
+	uasArmCommand();
+}
+
+void uasCommandHandler(void *CallBackRef, u32 RequestedBytes, u32 BytesTxed)
+{
+	switch(uasCommandIU[0])
+	{
+	case UAS_IU_COMMAND:
+		uasParseCommand((uasCommandIU_s *) uasCommandIU);
+		break;
+	case UAS_IU_TASK_MGMT:
+		uasParseTaskMgmt((uasTaskMgmtIU_s *) uasCommandIU);
+		break;
+	default:
+		uasQueueResponse(((uasCommandIU_s *) uasCommandIU)->tag, UAS_RC_INVALID_IU);
+		break;
+	}
+
+	uasCommandArmed = 0;
+	uasArmCommand();
+	uasSendStatus();
+}
+
+void uasStatusHandler(void *CallBackRef, u32 RequestedBytes, u32 BytesTxed)
+{
+	uasStatusBusy = 0;
+
+	// The ready IU is out, the host has queued the matching data transfer.
+	if(uasStatusTagStart >= 0)
+	{
+		uasStartData(uasStatusTagStart);
+		uasStatusTagStart = -1;
+	}
+
+	uasSendStatus();
+	uasArmCommand();
+}
+
+void uasDataInHandler(void *CallBackRef, u32 RequestedBytes, u32 BytesTxed)
+{
+	int i = uasDataTag;
+
+	if(i < 0) { return; }
+
+	uasTag[i].bytesLeft -= uasTag[i].pieceLength;
+	if(uasTag[i].bytesLeft > 0)
+	{
+		uasTagReadPiece(i);
+		uasTag[i].state = UAS_TAG_ACTIVE_READ;
+		return;
+	}
+
+	uasDataTag = -1;
+	uasTagCompleteIO(i);
+	uasSendStatus();
+}
+
+void uasDataOutHandler(void *CallBackRef, u32 RequestedBytes, u32 BytesTxed)
+{
+	int i = uasDataTag;
+
+	if(i < 0) { return; }
+
+	uasTagWritePiece(i, BytesTxed);
+	uasTag[i].bytesLeft -= (BytesTxed < uasTag[i].bytesLeft) ? BytesTxed : uasTag[i].bytesLeft;
+
+	if(uasTag[i].bytesLeft > 0)
+	{
+		// The slot is reused for the next piece once this one is on the SSD.
+		uasTag[i].state = UAS_TAG_ACTIVE_WRITE;
+		return;
+	}
+
+	// Status goes out when the writes complete, the data pipe is free for the next tag now.
+	uasTag[i].state = UAS_TAG_WRITE;
+	uasDataTag = -1;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+u8 * uasSlotAddr(int i)
+{
+	return (u8 *)((u64) SSD2USB_BUFFER_ADDR + i * UAS_SLOT_SIZE);
+}
+
+void uasParseCommand(uasCommandIU_s * iu)
+{
+	int i;
+	u8 * cdb = iu->cdb;
+
+	if(uasTagFind(iu->tag) >= 0)
+	{
+		uasQueueResponse(iu->tag, UAS_RC_OVERLAPPED_TAG);
+		return;
+	}
+
+	i = uasTagAlloc();
+	if(i < 0)
+	{
+		uasQueueSense(iu->tag, SCSI_STATUS_TASK_SET_FULL, 0, 0);
+		return;
+	}
+
+	uasTag[i].tag = iu->tag;
+	uasTag[i].write = 0;
+	uasTag[i].nCommands = 0;
+	uasTag[i].failed = 0;
+	uasTag[i].order = uasOrderCounter++;
+
+	switch(cdb[0])
+	{
+	case USB_RBC_READ:
+	case USB_RBC_READ16:
+	case USB_RBC_WRITE:
+	case USB_RBC_WRITE16:
+	{
+		u32 nBlocks;
+		u8 asc = ScsiParseReadWrite(cdb, &uasTag[i].lba, &nBlocks);
+
+		uasTag[i].bytesLeft = nBlocks * VFLASH_BLOCK_SIZE;
+		if(asc != SCSI_ASC_NONE)
+		{
+			uasTagComplete(i, SCSI_STATUS_CHECK_CONDITION, SCSI_SENSE_ILLEGAL_REQUEST, asc);
+		}
+		else if(uasTag[i].bytesLeft == 0)
+		{
+			uasTagComplete(i, SCSI_STATUS_GOOD, 0, 0);
+		}
+		else if((cdb[0] == USB_RBC_READ) || (cdb[0] == USB_RBC_READ16))
+		{
+			// Queue the first piece against the SSD now, ahead of its turn on the data pipe.
+			uasTagReadPiece(i);
+			uasTag[i].state = UAS_TAG_READ;
+		}
+		else
+		{
+			vendorInvalidate();
+			uasTag[i].write = 1;
+			uasTag[i].state = UAS_TAG_DATA_OUT;
+		}
+		break;
+	}
+
+	case USB_RBC_INQUIRY:
+		uasTagDataIn(i, (const u8 *) &scsiInquiry[1], sizeof(SCSI_INQUIRY), (cdb[3] << 8) | cdb[4]);
+		break;
+
+	case USB_RBC_READ_CAP:
+	case USB_SERVICE_ACTION_IN16:
+	{
+		u8 cap[sizeof(SCSI_READ_CAPACITY_16)];
+		u32 length = ScsiReadCapacity(cdb, cap);
+		u32 allocationLength = (cdb[0] == USB_RBC_READ_CAP) ? length : ((cdb[10] << 24) | (cdb[11] << 16) | (cdb[12] << 8) | cdb[13]);
+
+		if(length == 0) { uasTagComplete(i, SCSI_STATUS_CHECK_CONDITION, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_FIELD_CDB); }
+		else { uasTagDataIn(i, cap, length, allocationLength); }
+		break;
+	}
+
+	case USB_RBC_MODE_SENSE:
+		uasTagDataIn(i, (const u8 *) "\003\000\000\000", 4, cdb[4]);
+		break;
+
+	case USB_RBC_REQUEST_SENSE:
+	{
+		// Sense data travels in the Sense IU, so there is never anything pending here.
+		SCSI_SENSE_DATA sense;
+		ScsiSenseData(&sense, SCSI_SENSE_NONE, SCSI_ASC_NONE);
+		uasTagDataIn(i, (const u8 *) &sense, sizeof(sense), cdb[4]);
+		break;
+	}
+
+	case USB_SYNC_SCSI:
+	{
+		u16 cidFlush = nvmeGetIOCID();
+
+		nvmeFlush();
+		uasTag[i].failed = (nvmeWaitCIDRange(cidFlush, 1) != NVME_IO_OK);
+		while(nvmeGetIOSlip() > 0)
+		{
+			nvmeServiceIOCompletions(16);
+		}
+		uasTag[i].write = 1;
+		uasTagCompleteIO(i);
+		break;
+	}
+
+	case USB_RBC_TEST_UNIT_READY:
+	case USB_RBC_MEDIUM_REMOVAL:
+	case USB_RBC_STARTSTOP_UNIT:
+	case USB_RBC_VERIFY:
+		uasTagComplete(i, SCSI_STATUS_GOOD, 0, 0);
+		break;
+
+	default:
+		uasTagComplete(i, SCSI_STATUS_CHECK_CONDITION, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_OPCODE);
+		break;
+	}
+}
+
+void uasParseTaskMgmt(uasTaskMgmtIU_s * iu)
+{
+	int i;
+	u8 code = UAS_RC_TMF_COMPLETE;
+
+	switch(iu->function)
+	{
+	case UAS_TMF_ABORT_TASK:
+		i = uasTagFind(iu->taskTag);
+		if(i < 0) { break; }
+		if(i == uasDataTag) { code = UAS_RC_TMF_FAILED; break; }
+		uasTagWaitIO(i);
+		uasTag[i].state = UAS_TAG_FREE;
+		break;
+
+	case UAS_TMF_ABORT_TASK_SET:
+	case UAS_TMF_CLEAR_TASK_SET:
+	case UAS_TMF_LOGICAL_UNIT_RESET:
+	case UAS_TMF_IT_NEXUS_RESET:
+		// The tag on the data pipe is left to finish, the host clears the pipes itself on reset.
+		for(i = 0; i < UAS_TAGS; i++)
+		{
+			if((uasTag[i].state == UAS_TAG_FREE) || (i == uasDataTag)) { continue; }
+			uasTagWaitIO(i);
+			uasTag[i].state = UAS_TAG_FREE;
+		}
+		break;
+
+	case UAS_TMF_QUERY_TASK:
+		if(uasTagFind(iu->taskTag) >= 0) { code = UAS_RC_TMF_SUCCEEDED; }
+		break;
+
+	default:
+		code = UAS_RC_TMF_NOT_SUPPORTED;
+		break;
+	}
+
+	uasQueueResponse(iu->tag, code);
+}
+
+// Tag table index for a host tag in use, or -1. Any 16-bit value is a valid host tag.
+int uasTagFind(u16 tag)
+{
+	for(int i = 0; i < UAS_TAGS; i++)
+	{
+		if((uasTag[i].state != UAS_TAG_FREE) && (uasTag[i].tag == tag)) { return i; }
+	}
+
+	return -1;
+}
+
+// Free tag table entry, or -1.
+int uasTagAlloc(void)
+{
+	for(int i = 0; i < UAS_TAGS; i++)
+	{
+		if(uasTag[i].state == UAS_TAG_FREE) { return i; }
+	}
+
+	return -1;
+}
+
+// Issue the NVMe reads for the next piece without waiting for them.
+void uasTagReadPiece(int i)
+{
+	u32 nBlocksPerCommand = UAS_NVME_CHUNK / VFLASH_BLOCK_SIZE;
+	u32 nBlocksCommand;
+	u32 nBlocks;
+	u8 * dest = uasSlotAddr(i);
+
+	uasTag[i].pieceLength = (uasTag[i].bytesLeft < UAS_SLOT_SIZE) ? uasTag[i].bytesLeft : UAS_SLOT_SIZE;
+	nBlocks = uasTag[i].pieceLength / VFLASH_BLOCK_SIZE;
+
+	nvmeWaitForWrites(uasTag[i].lba, nBlocks);
+
+	uasTag[i].cidFirst = nvmeGetIOCID();
+	uasTag[i].nCommands = 0;
+	uasTag[i].ioErrors = nvmeGetIOErrorCount();
+	for(u32 offset = 0; offset < nBlocks; offset += nBlocksCommand)
+	{
+		nBlocksCommand = (nBlocks - offset < nBlocksPerCommand) ? (nBlocks - offset) : nBlocksPerCommand;
+		nvmeRead(dest + offset * VFLASH_BLOCK_SIZE, uasTag[i].lba + offset, nBlocksCommand);
+		uasTag[i].nCommands++;
+	}
+
+	uasTag[i].lba += nBlocks;
+}
+
+// Issue the NVMe writes for a received piece without waiting for them.
+void uasTagWritePiece(int i, u32 length)
+{
+	u32 nBlocksPerCommand = UAS_NVME_CHUNK / VFLASH_BLOCK_SIZE;
+	u32 nBlocksCommand;
+	u32 nBlocks = length / VFLASH_BLOCK_SIZE;
+	u8 * src = uasSlotAddr(i);
+
+	// The SSD may complete overlapping writes in any order.
+	nvmeWaitForWrites(uasTag[i].lba, nBlocks);
+
+	uasTag[i].cidFirst = nvmeGetIOCID();
+	uasTag[i].nCommands = 0;
+	uasTag[i].ioErrors = nvmeGetIOErrorCount();
+	for(u32 offset = 0; offset < nBlocks; offset += nBlocksCommand)
+	{
+		nBlocksCommand = (nBlocks - offset < nBlocksPerCommand) ? (nBlocks - offset) : nBlocksPerCommand;
+		nvmeWrite(src + offset * VFLASH_BLOCK_SIZE, uasTag[i].lba + offset, nBlocksCommand);
+		uasTag[i].nCommands++;
+	}
+
+	uasTag[i].lba += nBlocks;
+}
+
+// NVMe I/O of the current piece done. A failure marks the tag: the data phase runs to the end, then the status
+// reports it. A piece has as many commands as the I/O queue depth, and nvmeCheckCIDRange() counts ones that old as
+// OK, so any I/O error since the piece was issued fails it.
+u8 uasTagIODone(int i)
+{
+	int status;
+
+	if(uasTag[i].nCommands == 0) { return 1; }
+
+	status = nvmeCheckCIDRange(uasTag[i].cidFirst, uasTag[i].nCommands);
+	if(status == NVME_IO_PENDING) { return 0; }
+	if((status == NVME_IO_ERROR) || (nvmeGetIOErrorCount() != uasTag[i].ioErrors)) { uasTag[i].failed = 1; }
+	uasTag[i].nCommands = 0;
+
+	return 1;
+}
+
+void uasTagWaitIO(int i)
+{
+	if(uasTag[i].nCommands == 0) { return; }
+
+	if((nvmeWaitCIDRange(uasTag[i].cidFirst, uasTag[i].nCommands) == NVME_IO_ERROR)
+	|| (nvmeGetIOErrorCount() != uasTag[i].ioErrors)) { uasTag[i].failed = 1; }
+	uasTag[i].nCommands = 0;
+}
+
+// Short data-in phase for a non-media command, built in the tag's slot.
+void uasTagDataIn(int i, const u8 * data, u32 length, u32 allocationLength)
+{
+	if(length > allocationLength) { length = allocationLength; }
+	if(length == 0)
+	{
+		uasTagComplete(i, SCSI_STATUS_GOOD, 0, 0);
+		return;
+	}
+
+	memcpy(uasSlotAddr(i), data, length);
+	uasTag[i].bytesLeft = length;
+	uasTag[i].pieceLength = length;
+	uasTag[i].state = UAS_TAG_DATA_IN;
+}
+
+void uasTagComplete(int i, u8 status, u8 senseKey, u8 asc)
+{
+	uasQueueSense(uasTag[i].tag, status, senseKey, asc);
+	uasTag[i].state = UAS_TAG_FREE;
+}
+
+// Status of a command whose data phase and NVMe I/O are done.
+void uasTagCompleteIO(int i)
+{
+	if(!uasTag[i].failed)
+	{
+		uasTagComplete(i, SCSI_STATUS_GOOD, 0, 0);
+	}
+	else
+	{
+		uasTagComplete(i, SCSI_STATUS_CHECK_CONDITION, SCSI_SENSE_MEDIUM_ERROR,
+		               uasTag[i].write ? SCSI_ASC_WRITE_ERROR : SCSI_ASC_UNRECOVERED_READ_ERROR);
+	}
+}
+
+void uasQueueSense(u16 tag, u8 status, u8 senseKey, u8 asc)
+{
+	uasStatusEntry_s * entry = uasStatusAlloc();
+	uasSenseIU_s * iu;
+
+	if(entry == NULL) { return; }
+	iu = (uasSenseIU_s *) entry->iu;
+
+	memset(iu, 0, sizeof(uasSenseIU_s));
+	iu->id = UAS_IU_SENSE;
+	iu->tag = tag;
+	iu->status = status;
+	entry->length = 16;
+	if(status == SCSI_STATUS_CHECK_CONDITION)
+	{
+		iu->length = htons(sizeof(iu->sense));
+		ScsiSenseData(&iu->sense, senseKey, asc);
+		entry->length = sizeof(uasSenseIU_s);
+	}
+	entry->iTagStart = -1;
+
+	uasStatusTail++;
+}
+
+void uasQueueResponse(u16 tag, u8 code)
+{
+	uasStatusEntry_s * entry = uasStatusAlloc();
+	uasResponseIU_s * iu;
+
+	if(entry == NULL) { return; }
+	iu = (uasResponseIU_s *) entry->iu;
+
+	memset(iu, 0, sizeof(uasResponseIU_s));
+	iu->id = UAS_IU_RESPONSE;
+	iu->tag = tag;
+	iu->code = code;
+	entry->length = sizeof(uasResponseIU_s);
+	entry->iTagStart = -1;
+
+	uasStatusTail++;
+}
+
+void uasQueueReady(int i)
+{
+	uasStatusEntry_s * entry = uasStatusAlloc();
+
+	if(entry == NULL) { return; }
+
+	entry->iu[0] = uasTag[i].write ? UAS_IU_WRITE_READY : UAS_IU_READ_READY;
+	entry->iu[1] = 0;
+	memcpy(&entry->iu[2], &uasTag[i].tag, 2);
+	entry->length = 4;
+	entry->iTagStart = i;
+
+	uasStatusTail++;
+}
+
+// Next free status queue entry, or NULL if the queue is full. uasArmCommand() keeps room for every IU the tags in use
+// can still queue, so it is never full unless that accounting is broken.
+uasStatusEntry_s * uasStatusAlloc(void)
+{
+	if(uasStatusTail - uasStatusHead >= UAS_STATUS_QUEUE)
+	{
+		xil_printf("UAS status queue full.\r\n");
+		return NULL;
+	}
+
+	return &uasStatusQueue[uasStatusTail % UAS_STATUS_QUEUE];
+}
+
+// Back-pressure on the command pipe: take the next IU only when the status queue has room for a Sense IU from every
+// tag in use, one READ READY or WRITE READY IU, and the status of the new IU.
+void uasArmCommand(void)
+{
+	u32 nReserve = 2;
+
+	if(uasCommandArmed) { return; }
+
+	for(int i = 0; i < UAS_TAGS; i++)
+	{
+		if(uasTag[i].state != UAS_TAG_FREE) { nReserve++; }
+	}
+	if(UAS_STATUS_QUEUE - (uasStatusTail - uasStatusHead) < nReserve) { return; }
+
+	uasCommandArmed = 1;
+	EpBufferRecv(uasInstance->PrivateData, UAS_EP_COMMAND, uasCommandIU, UAS_IU_SIZE);
+}
+
+// Move the current piece of the tag that owns the data pipe.
+void uasStartData(int i)
+{
+	u32 length;
+
+	uasTag[i].state = UAS_TAG_ACTIVE;
+
+	if(uasTag[i].write)
+	{
+		length = (uasTag[i].bytesLeft < UAS_SLOT_SIZE) ? uasTag[i].bytesLeft : UAS_SLOT_SIZE;
+		EpBufferRecv(uasInstance->PrivateData, UAS_EP_DATA, uasSlotAddr(i), length);
+	}
+	else
+	{
+		EpBufferSend(uasInstance->PrivateData, UAS_EP_DATA, uasSlotAddr(i), uasTag[i].pieceLength);
+	}
+}
+
+// Status IUs go out one at a time, in order.
+void uasSendStatus(void)
+{
+	uasStatusEntry_s * entry;
+
+	if(uasStatusBusy || (uasStatusHead == uasStatusTail)) { return; }
+
+	entry = &uasStatusQueue[uasStatusHead % UAS_STATUS_QUEUE];
+	memcpy(uasStatusIU, entry->iu, entry->length);
+	uasStatusTagStart = entry->iTagStart;
+	uasStatusHead++;
+
+	uasStatusBusy = 1;
+	EpBufferSend(uasInstance->PrivateData, UAS_EP_STATUS, uasStatusIU, entry->length);
+}
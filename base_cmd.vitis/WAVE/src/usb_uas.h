@@ -0,0 +1,57 @@
+/*
+USB Attached SCSI (UAS) Transport Include
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __USB_UAS_INCLUDE__
+#define __USB_UAS_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "main.h"
+#include "xusb_ch9.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// Mass storage interface alternate settings. UAS is offered at high speed only: without bulk streams in the USB
+// driver, the data pipe is shared through READ READY and WRITE READY IUs, which USB 3.0 hosts do not accept.
+#define USB_ALT_BOT 0
+#define USB_ALT_UAS 1
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+void uasStart(struct Usb_DevData * InstancePtr);
+void uasStop(void);
+u8 uasIsActive(void);
+void uasService(void);
+
+// Endpoint handlers.
+void uasCommandHandler(void *CallBackRef, u32 RequestedBytes, u32 BytesTxed);
+void uasStatusHandler(void *CallBackRef, u32 RequestedBytes, u32 BytesTxed);
+void uasDataInHandler(void *CallBackRef, u32 RequestedBytes, u32 BytesTxed);
+void uasDataOutHandler(void *CallBackRef, u32 RequestedBytes, u32 BytesTxed);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
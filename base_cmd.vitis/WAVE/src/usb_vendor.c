@@ -0,0 +1,610 @@
+/*
+WAVE USB Vendor Clip Streaming
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <string.h>
+#include "usb_vendor.h"
+#include "xusb_ch9_storage.h"
+#include "xusb_wrapper.h"
+#include "nvme.h"
+#include "ff.h"
+#include "diskio.h"
+#include "fs.h"
+#include "frame.h"
+#include "clip.h"
+#include "camera_state.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Commands on EP3 OUT, response header and data on EP3 IN.
+#define VENDOR_EP                 3
+
+// Stream buffers above USB2SSD (0x79000000 - 0x7A000000). One is filled from the SSD while the other is on the wire.
+#define VENDOR_BUFFER_ADDR        0x79000000
+#define VENDOR_BUFFERS            2
+#define VENDOR_BUFFER_SIZE        0x800000                          // 8MiB, under the 16MiB limit of one transfer.
+#define VENDOR_PIECE_SIZE         (VENDOR_BUFFER_SIZE - 0x2000)     // Leaves room for LBA alignment at both ends.
+
+// Clip index cache, one clip at a time (0x7A000000 - 0x7B000000).
+#define VENDOR_INDEX_ADDR         0x7A000000
+#define VENDOR_INDEX_MAX          0x100000      // 16MiB of vendorFrameIndex_s.
+#define VENDOR_INDEX_STEP         16            // Frame headers read per service call while indexing.
+
+// Interface states
+#define VENDOR_STATE_IDLE         0             // Waiting for a command.
+#define VENDOR_STATE_INDEX        1             // Indexing the clip for the command.
+#define VENDOR_STATE_RESPONSE     2             // Response header on the wire.
+#define VENDOR_STATE_DATA         3             // Response data on the wire.
+#define VENDOR_STATE_ABORT        4             // Zero-length packet on the wire, ending a stream that failed.
+
+// Stream buffer states
+#define VENDOR_BUFFER_EMPTY       0
+#define VENDOR_BUFFER_READ        1             // NVMe reads in flight.
+#define VENDOR_BUFFER_READY       2
+#define VENDOR_BUFFER_SEND        3             // On the wire.
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	u8 state;
+	u32 skew;				// Offset of the first stream byte in the buffer [B].
+	u32 length;				// Stream bytes in the buffer [B].
+	u16 cidFirst;			// NVMe commands filling the buffer: cidFirst to cidFirst + nCommands - 1.
+	u16 nCommands;
+} vendorBuffer_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+u8 * vendorBufferAddr(int b);
+void vendorParseCommand(u32 length);
+void vendorExecuteIndexed(void);
+void vendorRespond(u8 status, u64 length, u32 count, u32 total);
+void vendorFinish(void);
+void vendorIndexStart(int nClipIndex);
+u8 vendorIndexStep(void);
+u8 vendorOpenFile(int nClipOpen, int nFileOpen);
+u8 vendorClipStatus(u8 status);
+u32 vendorStreamNext(u64 * offset);
+void vendorStreamFill(void);
+void vendorPump(void);
+void vendorBufferStart(int b, u64 offset, u32 length);
+int vendorBufferWait(int b);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+struct Usb_DevData * vendorInstance;
+u8 vendorActive = 0;
+u8 vendorState = VENDOR_STATE_IDLE;
+
+vendorCommand_s vendorCommand ALIGNMENT_CACHELINE;
+vendorResponse_s vendorResponse ALIGNMENT_CACHELINE;
+
+// Response data not yet on the wire. Catalog and index replies are sent from memory, clip data is streamed.
+u64 vendorDataLeft = 0;
+u8 * vendorDataAddr;
+u32 vendorSendLength;
+u8 vendorSending = 0;
+
+// Clip data stream: spans of consecutive bytes in one file, merged from consecutive frames in the clip index.
+u8 vendorStreaming = 0;
+u8 vendorStreamError = 0;
+u32 vendorStreamIOErrors = 0;	// nvmeGetIOErrorCount() at the start of the command.
+int vendorStreamClip;
+int vendorStreamFile;
+u64 vendorStreamOffset = 0;		// Next byte of the current span.
+u64 vendorStreamEnd = 0;		// End of the current span.
+u32 vendorStreamFrame = 0;		// Next frame to start a span with.
+u32 vendorStreamFrameEnd = 0;
+
+vendorBuffer_s vendorBuffer[VENDOR_BUFFERS];
+u32 vendorBufferFill = 0;		// Next buffer to fill from the SSD.
+u32 vendorBufferSend = 0;		// Next buffer to send.
+
+// Where the last opened clip file is on the disk.
+clipFile_s vendorFile = {-1, -1};
+
+// Clip index cache, of whole frames. Frame headers are read into the second stream buffer, idle while indexing.
+vendorFrameIndex_s * vendorIndex = (vendorFrameIndex_s *)(VENDOR_INDEX_ADDR);
+clipIndex_s vendorClipIndex = {(clipFrameIndex_s *)(VENDOR_INDEX_ADDR), VENDOR_INDEX_MAX, 16,
+                               (u8 *)(VENDOR_BUFFER_ADDR + VENDOR_BUFFER_SIZE)};
+int vendorIndexClip = -1;
+u8 vendorIndexComplete = 0;
+u8 vendorIndexStatus = VENDOR_STATUS_OK;
+u32 vendorIndexFrames = 0;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// Configuration selected: enable EP3 and wait for the first command.
+void vendorStart(struct Usb_DevData * InstancePtr)
+{
+	u16 MaxPktSize = (InstancePtr->Speed == USB_SPEED_SUPER) ? 1024 : 512;
+
+	vendorInstance = InstancePtr;
+
+	EpEnable(vendorInstance->PrivateData, VENDOR_EP, USB_EP_DIR_OUT, MaxPktSize, USB_EP_TYPE_BULK);
+	EpEnable(vendorInstance->PrivateData, VENDOR_EP, USB_EP_DIR_IN, MaxPktSize, USB_EP_TYPE_BULK);
+	vendorActive = 1;
+
+	vendorFinish();
+}
+
+// Deconfigured or interface reset. Outstanding NVMe reads are allowed to finish, the stream is dropped.
+void vendorStop(void)
+{
+	if(!vendorActive) { return; }
+
+	for(int b = 0; b < VENDOR_BUFFERS; b++)
+	{
+		vendorBufferWait(b);
+		vendorBuffer[b].state = VENDOR_BUFFER_EMPTY;
+	}
+	vendorState = VENDOR_STATE_IDLE;
+	vendorStreaming = 0;
+	vendorSending = 0;
+
+	// An index left half built is restarted by the next command.
+	clipIndexWait(&vendorClipIndex);
+	if(!vendorIndexComplete) { vendorIndexClip = -1; }
+
+	EpDisable(vendorInstance->PrivateData, VENDOR_EP, USB_EP_DIR_OUT);
+	EpDisable(vendorInstance->PrivateData, VENDOR_EP, USB_EP_DIR_IN);
+	vendorActive = 0;
+}
+
+// The disk contents changed (format, or writes through mass storage): forget the clip index and file extents.
+void vendorInvalidate(void)
+{
+	vendorIndexClip = -1;
+	clipForgetFile(&vendorFile);
+}
+
+// Called from the main loop. Indexes a clip a few frames at a time, and keeps the stream buffers moving.
+void vendorService(void)
+{
+	if(!vendorActive) { return; }
+
+	switch(vendorState)
+	{
+	case VENDOR_STATE_INDEX:
+		if(vendorIndexStep()) { vendorExecuteIndexed(); }
+		break;
+	case VENDOR_STATE_RESPONSE:
+	case VENDOR_STATE_DATA:
+		nvmeServiceIOCompletions(16);
+		vendorStreamFill();
+		vendorPump();
+		break;
+	default:
+		break;
+	}
+}
+
+void vendorCommandHandler(void *CallBackRef, u32 RequestedBytes, u32 BytesTxed)
+{
+	if(!vendorActive) { return; }
+
+	vendorParseCommand(BytesTxed);
+}
+
+void vendorDataInHandler(void *CallBackRef, u32 RequestedBytes, u32 BytesTxed)
+{
+	vendorBuffer_s * buf;
+
+	if(!vendorActive) { return; }
+
+	switch(vendorState)
+	{
+	case VENDOR_STATE_RESPONSE:
+		vendorState = VENDOR_STATE_DATA;
+		break;
+	case VENDOR_STATE_DATA:
+		vendorSending = 0;
+		if(vendorStreaming)
+		{
+			buf = &vendorBuffer[vendorBufferSend];
+			buf->state = VENDOR_BUFFER_EMPTY;
+			vendorDataLeft -= buf->length;
+			vendorBufferSend = (vendorBufferSend + 1) % VENDOR_BUFFERS;
+		}
+		else
+		{
+			vendorDataAddr += vendorSendLength;
+			vendorDataLeft -= vendorSendLength;
+		}
+		break;
+	case VENDOR_STATE_ABORT:
+		vendorFinish();
+		return;
+	default:
+		return;
+	}
+
+	if(vendorDataLeft == 0)
+	{
+		vendorFinish();
+		return;
+	}
+
+	vendorStreamFill();
+	vendorPump();
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+u8 * vendorBufferAddr(int b)
+{
+	return (u8 *)((u64) VENDOR_BUFFER_ADDR + b * VENDOR_BUFFER_SIZE);
+}
+
+void vendorParseCommand(u32 length)
+{
+	u32 n;
+	u8 status;
+
+	vendorStreaming = 0;
+	vendorStreamError = 0;
+	vendorStreamIOErrors = nvmeGetIOErrorCount();
+
+	if((length != sizeof(vendorCommand_s)) || (vendorCommand.magic != VENDOR_COMMAND_MAGIC))
+	{
+		vendorRespond(VENDOR_STATUS_BAD_COMMAND, 0, 0, 0);
+		return;
+	}
+
+	// The recorder owns the SSD bandwidth and its clip is still open.
+	if(cState.cSetting[CSETTING_MODE]->val == CSETTING_MODE_REC)
+	{
+		vendorRespond(VENDOR_STATUS_BUSY, 0, 0, 0);
+		return;
+	}
+
+	switch(vendorCommand.opcode)
+	{
+	case VENDOR_OP_LIST_CLIPS:
+		n = VENDOR_BUFFER_SIZE / sizeof(fsCatalogEntry_s);
+		if((vendorCommand.arg[1] != 0) && (vendorCommand.arg[1] < n)) { n = vendorCommand.arg[1]; }
+		n = fsCatalogRead((fsCatalogEntry_s *) vendorBufferAddr(0), vendorCommand.arg[0], n);
+
+		vendorDataAddr = vendorBufferAddr(0);
+		vendorRespond(VENDOR_STATUS_OK, (u64) n * sizeof(fsCatalogEntry_s), n, fsCatalogGetCount());
+		break;
+
+	case VENDOR_OP_GET_CLIP_INDEX:
+	case VENDOR_OP_READ_FRAMES:
+		// Clip data is read straight from the SSD: write back the file system's cached sectors first.
+		disk_ioctl(0, CTRL_SYNC, 0);
+
+		if(vendorIndexClip != (int) vendorCommand.arg[0]) { vendorIndexStart(vendorCommand.arg[0]); }
+		if(vendorIndexComplete) { vendorExecuteIndexed(); }
+		else { vendorState = VENDOR_STATE_INDEX; }
+		break;
+
+	case VENDOR_OP_READ_CLIP_INFO:
+		disk_ioctl(0, CTRL_SYNC, 0);
+
+		vendorStreamClip = vendorCommand.arg[0];
+		status = vendorOpenFile(vendorStreamClip, CLIP_FILE_INFO);
+		if(status != VENDOR_STATUS_OK)
+		{
+			vendorRespond(status, 0, 0, 0);
+			break;
+		}
+
+		// The whole file is one span.
+		vendorStreamFile = CLIP_FILE_INFO;
+		vendorStreamOffset = 0;
+		vendorStreamEnd = vendorFile.size_B;
+		vendorStreamFrame = 0;
+		vendorStreamFrameEnd = 0;
+		vendorStreaming = 1;
+		vendorRespond(VENDOR_STATUS_OK, vendorFile.size_B, 0, 0);
+		break;
+
+	default:
+		vendorRespond(VENDOR_STATUS_BAD_COMMAND, 0, 0, 0);
+		break;
+	}
+}
+
+// Second half of GET_CLIP_INDEX and READ_FRAMES, once the clip is indexed.
+void vendorExecuteIndexed(void)
+{
+	u32 first = vendorCommand.arg[1];
+	u32 n = vendorCommand.arg[2];
+	u64 length = 0;
+
+	if(vendorIndexStatus != VENDOR_STATUS_OK)
+	{
+		vendorRespond(vendorIndexStatus, 0, 0, 0);
+		return;
+	}
+	if(first > vendorIndexFrames)
+	{
+		vendorRespond(VENDOR_STATUS_RANGE, 0, 0, vendorIndexFrames);
+		return;
+	}
+	if((n == 0) || (n > vendorIndexFrames - first)) { n = vendorIndexFrames - first; }
+
+	if(vendorCommand.opcode == VENDOR_OP_GET_CLIP_INDEX)
+	{
+		vendorDataAddr = (u8 *) &vendorIndex[first];
+		vendorRespond(VENDOR_STATUS_OK, (u64) n * sizeof(vendorFrameIndex_s), n, vendorIndexFrames);
+		return;
+	}
+
+	for(u32 i = first; i < first + n; i++) { length += vendorIndex[i].size_B; }
+
+	vendorStreamClip = vendorIndexClip;
+	vendorStreamOffset = 0;
+	vendorStreamEnd = 0;
+	vendorStreamFrame = first;
+	vendorStreamFrameEnd = first + n;
+	vendorStreaming = 1;
+	vendorRespond(VENDOR_STATUS_OK, length, n, vendorIndexFrames);
+}
+
+// Send the response header. Stream reads are issued right away, so the SSD works while the header is on the wire.
+void vendorRespond(u8 status, u64 length, u32 count, u32 total)
+{
+	memset(&vendorResponse, 0, sizeof(vendorResponse_s));
+	vendorResponse.magic = VENDOR_RESPONSE_MAGIC;
+	vendorResponse.opcode = vendorCommand.opcode;
+	vendorResponse.status = status;
+	vendorResponse.tag = vendorCommand.tag;
+	vendorResponse.length = length;
+	vendorResponse.count = count;
+	vendorResponse.total = total;
+
+	vendorDataLeft = length;
+	if(length == 0) { vendorStreaming = 0; }
+
+	vendorState = VENDOR_STATE_RESPONSE;
+	EpBufferSend(vendorInstance->PrivateData, VENDOR_EP, (u8 *) &vendorResponse, sizeof(vendorResponse_s));
+
+	vendorStreamFill();
+}
+
+// Response complete: wait for the next command.
+void vendorFinish(void)
+{
+	for(int b = 0; b < VENDOR_BUFFERS; b++)
+	{
+		vendorBufferWait(b);
+		vendorBuffer[b].state = VENDOR_BUFFER_EMPTY;
+	}
+	vendorBufferFill = 0;
+	vendorBufferSend = 0;
+
+	vendorState = VENDOR_STATE_IDLE;
+	vendorStreaming = 0;
+	vendorStreamError = 0;
+	vendorSending = 0;
+	vendorDataLeft = 0;
+
+	EpBufferRecv(vendorInstance->PrivateData, VENDOR_EP, (u8 *) &vendorCommand, sizeof(vendorCommand_s));
+}
+
+void vendorIndexStart(int nClipIndex)
+{
+	vendorIndexClip = nClipIndex;
+	vendorIndexComplete = 0;
+	vendorIndexStatus = VENDOR_STATUS_OK;
+	vendorIndexFrames = 0;
+	clipIndexStart(&vendorClipIndex, nClipIndex);
+}
+
+// Index up to VENDOR_INDEX_STEP frames, waiting for each header: nothing else uses the SSD until the command can run.
+// Frames whose header can't be read are kept as entries with no data, as for playback. Returns 1 when the index is
+// complete.
+u8 vendorIndexStep(void)
+{
+	for(int k = 0; k < VENDOR_INDEX_STEP; k++)
+	{
+		if(clipIndexStep(&vendorClipIndex))
+		{
+			vendorIndexFrames = vendorClipIndex.nFrames;
+			vendorIndexStatus = vendorClipStatus(vendorClipIndex.status);
+			vendorIndexComplete = 1;
+
+			// Reported once, not cached: the clip may be recorded, or readable, by the next command.
+			if((vendorIndexStatus != VENDOR_STATUS_OK) || (vendorClipIndex.nLost > 0)) { vendorIndexClip = -1; }
+			return 1;
+		}
+		clipIndexWait(&vendorClipIndex);
+	}
+
+	return 0;
+}
+
+// Load the extents of a clip file (or CLIP_FILE_INFO) into vendorFile.
+u8 vendorOpenFile(int nClipOpen, int nFileOpen)
+{
+	return vendorClipStatus(clipOpenFile(&vendorFile, nClipOpen, nFileOpen));
+}
+
+u8 vendorClipStatus(u8 status)
+{
+	switch(status)
+	{
+	case CLIP_OK:
+		return VENDOR_STATUS_OK;
+	case CLIP_ERROR_NOT_FOUND:
+		return VENDOR_STATUS_NOT_FOUND;
+	default:
+		return VENDOR_STATUS_IO_ERROR;
+	}
+}
+
+// Next piece of the stream: up to VENDOR_PIECE_SIZE consecutive bytes of one file, whose extents are loaded on return.
+// Returns its length, or 0 at the end of the stream.
+u32 vendorStreamNext(u64 * offset)
+{
+	u32 length;
+	vendorFrameIndex_s * frame;
+
+	if(vendorStreamError) { return 0; }
+
+	if(vendorStreamOffset == vendorStreamEnd)
+	{
+		// Lost frames have no data to send.
+		while((vendorStreamFrame < vendorStreamFrameEnd) && (vendorIndex[vendorStreamFrame].size_B == 0))
+		{
+			vendorStreamFrame++;
+		}
+		if(vendorStreamFrame == vendorStreamFrameEnd) { return 0; }
+
+		// Frames recorded back to back in the same file are one span.
+		frame = &vendorIndex[vendorStreamFrame++];
+		vendorStreamFile = frame->nFile;
+		vendorStreamOffset = frame->offset_B;
+		vendorStreamEnd = frame->offset_B + frame->size_B;
+		while((vendorStreamFrame < vendorStreamFrameEnd)
+		   && (vendorIndex[vendorStreamFrame].nFile == vendorStreamFile)
+		   && (vendorIndex[vendorStreamFrame].offset_B == vendorStreamEnd))
+		{
+			vendorStreamEnd += vendorIndex[vendorStreamFrame++].size_B;
+		}
+	}
+
+	if(vendorOpenFile(vendorStreamClip, vendorStreamFile) != VENDOR_STATUS_OK)
+	{
+		vendorStreamError = 1;
+		return 0;
+	}
+
+	length = (vendorStreamEnd - vendorStreamOffset < VENDOR_PIECE_SIZE) ? (vendorStreamEnd - vendorStreamOffset) : VENDOR_PIECE_SIZE;
+	*offset = vendorStreamOffset;
+	vendorStreamOffset += length;
+
+	return length;
+}
+
+// Fill empty stream buffers with the next pieces.
+void vendorStreamFill(void)
+{
+	u64 offset;
+	u32 length;
+
+	if(!vendorStreaming) { return; }
+
+	while(vendorBuffer[vendorBufferFill].state == VENDOR_BUFFER_EMPTY)
+	{
+		length = vendorStreamNext(&offset);
+		if(length == 0) { break; }
+
+		vendorBufferStart(vendorBufferFill, offset, length);
+		vendorBufferFill = (vendorBufferFill + 1) % VENDOR_BUFFERS;
+	}
+}
+
+// Put the next piece of response data on the wire, if it is ready and the endpoint is free.
+void vendorPump(void)
+{
+	vendorBuffer_s * buf;
+	int status;
+
+	if((vendorState != VENDOR_STATE_DATA) || vendorSending || (vendorDataLeft == 0)) { return; }
+
+	if(!vendorStreaming)
+	{
+		vendorSendLength = (vendorDataLeft < VENDOR_PIECE_SIZE) ? vendorDataLeft : VENDOR_PIECE_SIZE;
+		vendorSending = 1;
+		EpBufferSend(vendorInstance->PrivateData, VENDOR_EP, vendorDataAddr, vendorSendLength);
+		return;
+	}
+
+	buf = &vendorBuffer[vendorBufferSend];
+	if(buf->state == VENDOR_BUFFER_READ)
+	{
+		// A buffer's oldest CIDs can be reused by the next buffer's reads before it's checked, losing their status, so
+		// an error anywhere since the command started also counts. The stream ends early either way.
+		status = nvmeCheckCIDRange(buf->cidFirst, buf->nCommands);
+		if((status == NVME_IO_OK) && (nvmeGetIOErrorCount() != vendorStreamIOErrors)) { status = NVME_IO_ERROR; }
+
+		switch(status)
+		{
+		case NVME_IO_OK:
+			buf->state = VENDOR_BUFFER_READY;
+			buf->nCommands = 0;
+			break;
+		case NVME_IO_ERROR:
+			// Ends the stream early, same as a clip file that can't be opened.
+			buf->state = VENDOR_BUFFER_EMPTY;
+			buf->nCommands = 0;
+			vendorStreamError = 1;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if(buf->state == VENDOR_BUFFER_READY)
+	{
+		buf->state = VENDOR_BUFFER_SEND;
+		vendorSending = 1;
+		EpBufferSend(vendorInstance->PrivateData, VENDOR_EP, vendorBufferAddr(vendorBufferSend) + buf->skew, buf->length);
+	}
+	else if(vendorStreamError && (buf->state == VENDOR_BUFFER_EMPTY))
+	{
+		// The header promised more than can be read. A zero-length packet tells the host the stream ended early.
+		vendorState = VENDOR_STATE_ABORT;
+		vendorSending = 1;
+		EpBufferSend(vendorInstance->PrivateData, VENDOR_EP, vendorBufferAddr(0), 0);
+	}
+}
+
+// Issue the NVMe reads for bytes [offset, offset + length) of the file whose extents are loaded, without waiting for
+// them. The buffer starts at the LBA holding offset.
+void vendorBufferStart(int b, u64 offset, u32 length)
+{
+	vendorBuffer[b].skew = offset % nvmeGetLBASize();
+	vendorBuffer[b].length = length;
+	vendorBuffer[b].cidFirst = nvmeGetIOCID();
+	vendorBuffer[b].nCommands = clipReadStart(&vendorFile, vendorBufferAddr(b), offset, length);
+	vendorBuffer[b].state = VENDOR_BUFFER_READ;
+
+	// An empty file has no extents and nothing to read.
+	if(vendorBuffer[b].nCommands == 0)
+	{
+		vendorBuffer[b].state = VENDOR_BUFFER_EMPTY;
+		vendorStreamError = 1;
+	}
+}
+
+// Wait for the buffer's NVMe reads. Returns NVME_IO_OK or NVME_IO_ERROR.
+int vendorBufferWait(int b)
+{
+	int status;
+
+	status = nvmeWaitCIDRange(vendorBuffer[b].cidFirst, vendorBuffer[b].nCommands);
+	vendorBuffer[b].nCommands = 0;
+
+	return status;
+}
@@ -0,0 +1,104 @@
+/*
+WAVE USB Vendor Clip Streaming Include
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __USB_VENDOR_INCLUDE__
+#define __USB_VENDOR_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "main.h"
+#include "xusb_ch9.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// Vendor-specific interface, next to mass storage on interface 0. The host client (WAVE_USBClient) mirrors the
+// definitions below.
+#define USB_VENDOR_INTERFACE            1
+
+#define VENDOR_COMMAND_MAGIC            0x43564157      // "WAVC"
+#define VENDOR_RESPONSE_MAGIC           0x52564157      // "WAVR"
+
+// Opcodes
+#define VENDOR_OP_LIST_CLIPS            0x01    // arg[0]: First catalog entry, arg[1]: Maximum entries (0: All).
+#define VENDOR_OP_GET_CLIP_INDEX        0x02    // arg[0]: Clip, arg[1]: First frame, arg[2]: Maximum frames (0: All).
+#define VENDOR_OP_READ_FRAMES           0x03    // arg[0]: Clip, arg[1]: First frame, arg[2]: Number of frames (0: All).
+#define VENDOR_OP_READ_CLIP_INFO        0x04    // arg[0]: Clip.
+
+// Response status
+#define VENDOR_STATUS_OK                0x00
+#define VENDOR_STATUS_BAD_COMMAND       0x01
+#define VENDOR_STATUS_NOT_FOUND         0x02
+#define VENDOR_STATUS_BUSY              0x03    // Recording.
+#define VENDOR_STATUS_IO_ERROR          0x04
+#define VENDOR_STATUS_RANGE             0x05
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// 32B Command, host to device on the bulk-OUT endpoint.
+typedef struct __attribute__((packed))
+{
+	u32 magic;					// VENDOR_COMMAND_MAGIC
+	u8 opcode;					// VENDOR_OP_*
+	u8 reserved0;				// Reserved.
+	u16 tag;					// Echoed in the response.
+	u32 arg[4];					// Opcode arguments.
+	u8 reserved1[8];			// Reserved.
+} vendorCommand_s;
+
+// 32B Response header, device to host on the bulk-IN endpoint. Followed by exactly length bytes of data.
+typedef struct __attribute__((packed))
+{
+	u32 magic;					// VENDOR_RESPONSE_MAGIC
+	u8 opcode;					// Opcode of the command.
+	u8 status;					// VENDOR_STATUS_*
+	u16 tag;					// Tag of the command.
+	u64 length;					// Data following the header in [B].
+	u32 count;					// Catalog entries or frames in the data.
+	u32 total;					// Catalog entries or frames available.
+	u8 reserved[8];				// Reserved.
+} vendorResponse_s;
+
+// 16B Clip Index Entry, one per frame: where its frame header and codestreams are in the clip's .kwv files. A frame
+// whose header could not be read has size_B 0, and no data in READ_FRAMES.
+typedef struct __attribute__((packed))
+{
+	u32 nFile;					// .kwv file number.
+	u32 size_B;					// Frame header and codestreams in [B].
+	u64 offset_B;				// Offset of the frame header in the file in [B].
+} vendorFrameIndex_s;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+void vendorStart(struct Usb_DevData * InstancePtr);
+void vendorStop(void);
+void vendorInvalidate(void);
+void vendorService(void);
+
+// Endpoint handlers.
+void vendorCommandHandler(void *CallBackRef, u32 RequestedBytes, u32 BytesTxed);
+void vendorDataInHandler(void *CallBackRef, u32 RequestedBytes, u32 BytesTxed);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
@@ -52,6 +52,9 @@
 #include "xparameters.h"		/* XPAR parameters */
 #include "xusb_ch9_storage.h"
 #include "xusb_class_storage.h"
+#include "usb_uas.h"
+#include "usb_vendor.h"
+#include "usb.h"
 
 /************************** Constant Definitions *****************************/
 
@@ -117,6 +120,11 @@ USB_STD_DEV_DESC __attribute__ ((aligned(16))) deviceDesc[] = {
 
 /*
  * Configuration Descriptors
+ *
+ * The SuperSpeed configuration has Bulk-Only Transport only. UAS at
+ * SuperSpeed needs bulk streams on the data pipes, one per tag, and the
+ * USB driver queues transfers without a stream ID. The vendor interface is
+ * the fast path at SuperSpeed.
  */
 #ifdef __ICCARM__
 USB30_CONFIG config3 = {
@@ -129,7 +137,7 @@ USB30_CONFIG __attribute__ ((aligned(16))) config3 = {
 		sizeof(USB_STD_CFG_DESC),	/* bLength */
 		USB_TYPE_CONFIG_DESC,	/* bDescriptorType */
 		sizeof(USB30_CONFIG),	/* wTotalLength */
-		0x01,					/* bNumInterfaces */
+		0x02,					/* bNumInterfaces */
 		0x01,					/* bConfigurationValue */
 		0x00,					/* iConfiguration */
 		0xc0,					/* bmAttribute */
@@ -179,6 +187,59 @@ USB30_CONFIG __attribute__ ((aligned(16))) config3 = {
 		0x04,					/* wMaxPacketSize - MSB */
 		0x00					/* bInterval */
 	},
+	{/*
+	  * SS Endpoint companion
+	  */
+		sizeof(USB_STD_EP_SS_COMP_DESC),	/* bLength */
+		0x30, 					/* bDescriptorType */
+		0x0F,					/* bMaxBurst */
+		0x00,					/* bmAttributes */
+		0x00					/* wBytesPerInterval */
+	},
+	{/*
+	  * Vendor Clip Streaming Interface Descriptor
+	  */
+		sizeof(USB_STD_IF_DESC),	/* bLength */
+		USB_TYPE_INTERFACE_DESC,	/* bDescriptorType */
+		USB_VENDOR_INTERFACE,	/* bInterfaceNumber */
+		0x00,					/* bAlternateSetting */
+		0x02,					/* bNumEndPoints */
+		0xFF,					/* bInterfaceClass: Vendor Specific */
+		0x00,					/* bInterfaceSubClass */
+		0x00,					/* bInterfaceProtocol */
+		0x00					/* iInterface */
+	},
+	{/*
+	  * Bulk In Endpoint Config
+	  */
+		sizeof(USB_STD_EP_DESC),	/* bLength */
+		USB_TYPE_ENDPOINT_CFG_DESC,	/* bDescriptorType */
+		USB_EP3_IN,				/* bEndpointAddress */
+		0x02,					/* bmAttribute  */
+		0x00,					/* wMaxPacketSize - LSB */
+		0x04,					/* wMaxPacketSize - MSB */
+		0x00					/* bInterval */
+	},
+	{/*
+	  * SS Endpoint companion
+	  */
+		sizeof(USB_STD_EP_SS_COMP_DESC),	/* bLength */
+		0x30, 					/* bDescriptorType */
+		0x0F,					/* bMaxBurst */
+		0x00,					/* bmAttributes */
+		0x00					/* wBytesPerInterval */
+	},
+	{/*
+	  * Bulk Out Endpoint Config
+	  */
+		sizeof(USB_STD_EP_DESC),	/* bLength */
+		USB_TYPE_ENDPOINT_CFG_DESC,	/* bDescriptorType */
+		USB_EP3_OUT,			/* bEndpointAddress */
+		0x02,					/* bmAttribute */
+		0x00,					/* wMaxPacketSize - LSB */
+		0x04,					/* wMaxPacketSize - MSB */
+		0x00					/* bInterval */
+	},
 	{/*
 	  * SS Endpoint companion
 	  */
@@ -201,7 +262,7 @@ USB_CONFIG __attribute__ ((aligned(16))) config2 = {
 		sizeof(USB_STD_CFG_DESC),	/* bLength */
 		USB_TYPE_CONFIG_DESC,	/* bDescriptorType */
 		sizeof(USB_CONFIG),		/* wTotalLength */
-		0x01,					/* bNumInterfaces */
+		0x02,					/* bNumInterfaces */
 		0x01,					/* bConfigurationValue */
 		0x00,					/* iConfiguration */
 		0xc0,					/* bmAttribute */
@@ -241,6 +302,130 @@ USB_CONFIG __attribute__ ((aligned(16))) config2 = {
 		0x00,					/* wMaxPacketSize - LSB */
 		0x02,					/* wMaxPacketSize - MSB */
 		0x00					/* bInterval */
+	},
+	{/*
+	  * Mass Storage UAS Interface Descriptor (alternate setting 1, high speed only)
+	  */
+		sizeof(USB_STD_IF_DESC),	/* bLength */
+		USB_TYPE_INTERFACE_DESC,	/* bDescriptorType */
+		0x00,					/* bInterfaceNumber */
+		0x01,					/* bAlternateSetting */
+		0x04,					/* bNumEndPoints */
+		USB_CLASS_STORAGE,		/* bInterfaceClass */
+		0x06,					/* bInterfaceSubClass */
+		0x62,					/* bInterfaceProtocol */
+		0x05					/* iInterface */
+	},
+	{/*
+	  * Command Out Endpoint Config
+	  */
+		sizeof(USB_STD_EP_DESC),	/* bLength */
+		USB_TYPE_ENDPOINT_CFG_DESC,	/* bDescriptorType */
+		USB_EP2_OUT,					/* bEndpointAddress */
+		0x02,					/* bmAttribute  */
+		0x00,					/* wMaxPacketSize - LSB */
+		0x02,					/* wMaxPacketSize - MSB */
+		0x00					/* bInterval */
+	},
+	{/*
+	  * UAS Pipe Usage
+	  */
+		sizeof(USB_UAS_PIPE_USAGE_DESC),	/* bLength */
+		USB_UAS_PIPE_USAGE_DESC_TYPE,		/* bDescriptorType */
+		USB_UAS_PIPE_COMMAND,	/* bPipeID */
+		0x00					/* Reserved */
+	},
+	{/*
+	  * Status In Endpoint Config
+	  */
+		sizeof(USB_STD_EP_DESC),	/* bLength */
+		USB_TYPE_ENDPOINT_CFG_DESC,	/* bDescriptorType */
+		USB_EP2_IN,					/* bEndpointAddress */
+		0x02,					/* bmAttribute  */
+		0x00,					/* wMaxPacketSize - LSB */
+		0x02,					/* wMaxPacketSize - MSB */
+		0x00					/* bInterval */
+	},
+	{/*
+	  * UAS Pipe Usage
+	  */
+		sizeof(USB_UAS_PIPE_USAGE_DESC),	/* bLength */
+		USB_UAS_PIPE_USAGE_DESC_TYPE,		/* bDescriptorType */
+		USB_UAS_PIPE_STATUS,	/* bPipeID */
+		0x00					/* Reserved */
+	},
+	{/*
+	  * Data In Endpoint Config
+	  */
+		sizeof(USB_STD_EP_DESC),	/* bLength */
+		USB_TYPE_ENDPOINT_CFG_DESC,	/* bDescriptorType */
+		USB_EP1_IN,					/* bEndpointAddress */
+		0x02,					/* bmAttribute  */
+		0x00,					/* wMaxPacketSize - LSB */
+		0x02,					/* wMaxPacketSize - MSB */
+		0x00					/* bInterval */
+	},
+	{/*
+	  * UAS Pipe Usage
+	  */
+		sizeof(USB_UAS_PIPE_USAGE_DESC),	/* bLength */
+		USB_UAS_PIPE_USAGE_DESC_TYPE,		/* bDescriptorType */
+		USB_UAS_PIPE_DATA_IN,	/* bPipeID */
+		0x00					/* Reserved */
+	},
+	{/*
+	  * Data Out Endpoint Config
+	  */
+		sizeof(USB_STD_EP_DESC),	/* bLength */
+		USB_TYPE_ENDPOINT_CFG_DESC,	/* bDescriptorType */
+		USB_EP1_OUT,					/* bEndpointAddress */
+		0x02,					/* bmAttribute  */
+		0x00,					/* wMaxPacketSize - LSB */
+		0x02,					/* wMaxPacketSize - MSB */
+		0x00					/* bInterval */
+	},
+	{/*
+	  * UAS Pipe Usage
+	  */
+		sizeof(USB_UAS_PIPE_USAGE_DESC),	/* bLength */
+		USB_UAS_PIPE_USAGE_DESC_TYPE,		/* bDescriptorType */
+		USB_UAS_PIPE_DATA_OUT,	/* bPipeID */
+		0x00					/* Reserved */
+	},
+	{/*
+	  * Vendor Clip Streaming Interface Descriptor
+	  */
+		sizeof(USB_STD_IF_DESC),	/* bLength */
+		USB_TYPE_INTERFACE_DESC,	/* bDescriptorType */
+		USB_VENDOR_INTERFACE,	/* bInterfaceNumber */
+		0x00,					/* bAlternateSetting */
+		0x02,					/* bNumEndPoints */
+		0xFF,					/* bInterfaceClass: Vendor Specific */
+		0x00,					/* bInterfaceSubClass */
+		0x00,					/* bInterfaceProtocol */
+		0x00					/* iInterface */
+	},
+	{/*
+	  * Bulk In Endpoint Config
+	  */
+		sizeof(USB_STD_EP_DESC),	/* bLength */
+		USB_TYPE_ENDPOINT_CFG_DESC,	/* bDescriptorType */
+		USB_EP3_IN,					/* bEndpointAddress */
+		0x02,					/* bmAttribute  */
+		0x00,					/* wMaxPacketSize - LSB */
+		0x02,					/* wMaxPacketSize - MSB */
+		0x00					/* bInterval */
+	},
+	{/*
+	  * Bulk Out Endpoint Config
+	  */
+		sizeof(USB_STD_EP_DESC),	/* bLength */
+		USB_TYPE_ENDPOINT_CFG_DESC,	/* bDescriptorType */
+		USB_EP3_OUT,					/* bEndpointAddress */
+		0x02,					/* bmAttribute  */
+		0x00,					/* wMaxPacketSize - LSB */
+		0x02,					/* wMaxPacketSize - MSB */
+		0x00					/* bInterval */
 	}
 };
 
@@ -572,6 +757,13 @@ s32 Usb_SetConfigurationApp(struct Usb_DevData *InstancePtr,
 	/* When we run CV test suite application in Windows, need to
 	 * add SET_CONFIGURATION command with value 0/1 to pass test suite
 	 */
+	/* Configuration always starts on alternate setting 0 (BOT). */
+	uasStop();
+	vendorStop();
+
+	/* The SSD may have been written while the host was away: drop read-ahead data. */
+	usbBridgeInvalidateAll();
+
 	if ((SetupData->wValue && 0xff) ==  1) {
 		/* SET_CONFIGURATION with value 1 */
 
@@ -590,6 +782,9 @@ s32 Usb_SetConfigurationApp(struct Usb_DevData *InstancePtr,
 			return XST_FAILURE;
 		}
 
+		/* Vendor clip streaming interface, EP3 IN/OUT */
+		vendorStart(InstancePtr);
+
 		SetConfigDone(InstancePtr->PrivateData, 1U);
 
 		/* Reset the Phase to default COMMAND STATE */
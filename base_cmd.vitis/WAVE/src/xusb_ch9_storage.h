@@ -66,11 +66,33 @@ extern "C" {
 #pragma pack(push, 1)
 #endif
 
+/*
+ * UAS Pipe Usage descriptor, follows each UAS endpoint descriptor.
+ */
+typedef struct {
+	u8 bLength;
+	u8 bDescriptorType;
+	u8 bPipeID;
+	u8 Reserved;
+} attribute(USB_UAS_PIPE_USAGE_DESC);
+
 typedef struct {
 	USB_STD_CFG_DESC stdCfg;
 	USB_STD_IF_DESC ifCfg;
 	USB_STD_EP_DESC epin;
 	USB_STD_EP_DESC epout;
+	USB_STD_IF_DESC ifUas;
+	USB_STD_EP_DESC epcmd;
+	USB_UAS_PIPE_USAGE_DESC pipecmd;
+	USB_STD_EP_DESC epstatus;
+	USB_UAS_PIPE_USAGE_DESC pipestatus;
+	USB_STD_EP_DESC epdatain;
+	USB_UAS_PIPE_USAGE_DESC pipedatain;
+	USB_STD_EP_DESC epdataout;
+	USB_UAS_PIPE_USAGE_DESC pipedataout;
+	USB_STD_IF_DESC ifVendor;
+	USB_STD_EP_DESC epvendorin;
+	USB_STD_EP_DESC epvendorout;
 } attribute(USB_CONFIG);
 
 typedef struct {
@@ -80,13 +102,26 @@ typedef struct {
 	USB_STD_EP_SS_COMP_DESC epssin;
 	USB_STD_EP_DESC epout;
 	USB_STD_EP_SS_COMP_DESC epssout;
-
+	USB_STD_IF_DESC ifVendor;
+	USB_STD_EP_DESC epvendorin;
+	USB_STD_EP_SS_COMP_DESC epssvendorin;
+	USB_STD_EP_DESC epvendorout;
+	USB_STD_EP_SS_COMP_DESC epssvendorout;
 } attribute(USB30_CONFIG);
 
 #if defined (__ICCARM__)
 #pragma pack(pop)
 #endif
 
+/*
+ * UAS Pipe IDs
+ */
+#define USB_UAS_PIPE_USAGE_DESC_TYPE	0x24
+#define USB_UAS_PIPE_COMMAND			0x01
+#define USB_UAS_PIPE_STATUS				0x02
+#define USB_UAS_PIPE_DATA_IN			0x03
+#define USB_UAS_PIPE_DATA_OUT			0x04
+
 /***************** Macros (Inline Functions) Definitions *********************/
 /* Check where these defines need to go  */
 #define be2le(val)	(u32)(val)
@@ -98,6 +133,9 @@ typedef struct {
 
 #define htons(x)	(u16) ((((u16)(x))<<8) | (((u16)(x))>>8))
 
+#define htonll(val)	((((u64) htonl((u32)(val))) << 32) |	\
+			 ((u64) htonl((u32)((u64)(val) >> 32))))
+
 /************************** Function Prototypes ******************************/
 u32 Usb_Ch9SetupDevDescReply(struct Usb_DevData *InstancePtr,
                                  u8 *BufPtr, u32 BufLen);
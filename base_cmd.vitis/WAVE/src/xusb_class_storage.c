@@ -51,10 +51,12 @@
  *****************************************************************************/
 
 /***************************** Include Files *********************************/
+#include <string.h>
 #include "xusb_class_storage.h"
 #include "xparameters.h"
 #include "xusb_ch9_storage.h"
 #include "nvme.h"
+#include "usb.h"
 
 /************************** Constant Definitions *****************************/
 
@@ -63,6 +65,9 @@
 /**************************** Type Definitions *******************************/
 
 /************************** Function Prototypes ******************************/
+static void FailCommand(struct Usb_DevData *InstancePtr, u8 Key, u8 Asc);
+static void EndDataPhase(struct Usb_DevData *InstancePtr);
+static u32 ClampBlocks(u32 NumBlocks, u8 DirIn);
 
 /************************** Variable Definitions *****************************/
 extern u8 Phase;
@@ -76,9 +81,9 @@ extern u8 Phase;
 #else
 #pragma data_alignment = 32
 #endif
-const static SCSI_INQUIRY scsiInquiry[] = {
+const SCSI_INQUIRY scsiInquiry[] = {
 #else
-const static SCSI_INQUIRY scsiInquiry[] ALIGNMENT_CACHELINE = {
+const SCSI_INQUIRY scsiInquiry[] ALIGNMENT_CACHELINE = {
 #endif
 	{
 		0x00,
@@ -116,7 +121,8 @@ static u8 MaxLUN ALIGNMENT_CACHELINE = 0;
 
 extern USB_CBW CBW;
 extern USB_CSW CSW;
-extern u32 VFLASH_NUM_BLOCKS;
+extern u64 VFLASH_NUM_BLOCKS;
+extern u32 VFLASH_BLOCK_SIZE;
 
 extern u32	rxBytesLeft;
 extern u8	*VirtFlashWritePointer;
@@ -128,6 +134,14 @@ static u8 txBuffer[128];
 static u8 txBuffer[128] ALIGNMENT_CACHELINE;
 #endif
 
+/* Sense data for REQUEST SENSE, from the last command that failed. */
+static u8 SenseKey = SCSI_SENSE_NONE;
+static u8 SenseAsc = SCSI_ASC_NONE;
+
+/* Status for the next CSW, and the data moved by the command so far. */
+static u8 CSWStatus = USB_CSW_PASSED;
+static u32 CSWDataMoved = 0;
+
 /*****************************************************************************/
 /**
 * This function is class handler for Mass storage and is called when
@@ -184,6 +198,10 @@ void ParseCBW(struct Usb_DevData *InstancePtr)
 	u8 Index;
 	s32 Status;
 
+	/* No bridge READ in progress until one is parsed. */
+	usbBridgeReadStart(0, 0);
+	CSWDataMoved = 0;
+
 	switch (CBW.CBWCB[0]) {
 	case USB_RBC_INQUIRY:
 #ifdef CLASS_STORAGE_DEBUG
@@ -214,7 +232,7 @@ void ParseCBW(struct Usb_DevData *InstancePtr)
 #endif
 		CapList->listLength	= 8;
 		CapList->descCode	= 3;
-		CapList->numBlocks	= htonl(VFLASH_NUM_BLOCKS);
+		CapList->numBlocks	= htonl((VFLASH_NUM_BLOCKS > 0xFFFFFFFF) ? 0xFFFFFFFF : (u32) VFLASH_NUM_BLOCKS);
 		CapList->blockLength = htons(VFLASH_BLOCK_SIZE);
 
 		Phase = USB_EP_STATE_DATA_IN;
@@ -223,43 +241,70 @@ void ParseCBW(struct Usb_DevData *InstancePtr)
 		break;
 
 	case USB_RBC_READ_CAP:
+	case USB_SERVICE_ACTION_IN16:
 	{
-		SCSI_READ_CAPACITY	*Cap;
-
-		Cap = (SCSI_READ_CAPACITY *) txBuffer;
+		u32 CapLength;
 #ifdef CLASS_STORAGE_DEBUG
 		printf("SCSI: READCAP\r\n");
 #endif
-		Cap->numBlocks = htonl(VFLASH_NUM_BLOCKS - 1);
-		Cap->blockSize = htonl(VFLASH_BLOCK_SIZE);
+		CapLength = ScsiReadCapacity(CBW.CBWCB, txBuffer);
+		if (CapLength == 0) {
+			FailCommand(InstancePtr, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_FIELD_CDB);
+			break;
+		}
+		/* READ CAPACITY(16) carries an allocation length in bytes 10-13. */
+		if (CBW.CBWCB[0] == USB_SERVICE_ACTION_IN16) {
+			u32 AllocLength = (CBW.CBWCB[10] << 24) | (CBW.CBWCB[11] << 16) |
+					(CBW.CBWCB[12] << 8) | CBW.CBWCB[13];
+			if (CapLength > AllocLength) {
+				CapLength = AllocLength;
+			}
+		}
+		if (CapLength > CBW.dCBWDataTransferLength) {
+			CapLength = CBW.dCBWDataTransferLength;
+		}
+		if (CapLength == 0) {
+			SendCSW(InstancePtr, 0);
+			break;
+		}
 		Phase = USB_EP_STATE_DATA_IN;
-		EpBufferSend(InstancePtr->PrivateData, 1, txBuffer,
-								sizeof(SCSI_READ_CAPACITY));
+		EpBufferSend(InstancePtr->PrivateData, 1, txBuffer, CapLength);
 	}
 		break;
 
 	case USB_RBC_READ:
+	case USB_RBC_READ16:
 	{
 #ifdef CLASS_STORAGE_DEBUG
 		printf("SCSI: READ Offset 0x%08x\r\n", Offset);
 #endif
+		u64 lbOffset;
+		u32 nBlocks;
+		u8 Asc;
+
+		Asc = ScsiParseReadWrite(CBW.CBWCB, &lbOffset, &nBlocks);
+		if (Asc != SCSI_ASC_NONE) {
+			FailCommand(InstancePtr, SCSI_SENSE_ILLEGAL_REQUEST, Asc);
+			break;
+		}
+		nBlocks = ClampBlocks(nBlocks, 1);
+		if (nBlocks == 0) {
+			EndDataPhase(InstancePtr);
+			break;
+		}
 
-		// NVMe Bridge Read
+		// NVMe Bridge Read: sent in pieces, the rest follow from BulkInHandler().
 		// ----------------------------------------------------------------------------
-		u32 lbOffset = htonl(((SCSI_READ_WRITE *) &CBW.CBWCB)->block);
-		u32 rLength = htons(((SCSI_READ_WRITE *) &CBW.CBWCB)->length) * VFLASH_BLOCK_SIZE;
-		nvmeRead((u8 *)((u64) SSD2USB_BUFFER_ADDR), lbOffset, rLength >> 9);
-		while(nvmeGetIOSlip() > 0)
-		{
-			nvmeServiceIOCompletions(16);
-		}
+		u8 * rBuffer;
+		usbBridgeReadStart(lbOffset, nBlocks);
+		u32 rLength = usbBridgeReadNext(&rBuffer);
 		// ----------------------------------------------------------------------------
 
 		Phase = USB_EP_STATE_DATA_IN;
-		u32 RetVal = EpBufferSend(InstancePtr->PrivateData, 1, (u8 *)((u64) SSD2USB_BUFFER_ADDR), rLength);
+		u32 RetVal = EpBufferSend(InstancePtr->PrivateData, 1, rBuffer, rLength);
 
 		if (RetVal != XST_SUCCESS) {
-			xil_printf("Failed: READ LB Offset 0x%08x\n", lbOffset);
+			xil_printf("Failed: READ LB Offset 0x%08x\n", (u32) lbOffset);
 			return;
 		}
 		break;
@@ -304,15 +349,35 @@ void ParseCBW(struct Usb_DevData *InstancePtr)
 		break;
 
 	case USB_RBC_WRITE:
+	case USB_RBC_WRITE16:
+	{
 #ifdef CLASS_STORAGE_DEBUG
 		printf("SCSI: WRITE Offset 0x%08x\r\n", Offset);
 #endif
-		VirtFlashWritePointer = (u8 *)((u64) USB2SSD_BUFFER_ADDR);
-		rxBytesLeft = htons(((SCSI_READ_WRITE *) &CBW.CBWCB)->length) * VFLASH_BLOCK_SIZE;
+		u64 lbOffset;
+		u32 nBlocks;
+		u8 Asc;
+
+		Asc = ScsiParseReadWrite(CBW.CBWCB, &lbOffset, &nBlocks);
+		if (Asc != SCSI_ASC_NONE) {
+			FailCommand(InstancePtr, SCSI_SENSE_ILLEGAL_REQUEST, Asc);
+			break;
+		}
+		nBlocks = ClampBlocks(nBlocks, 0);
+		if (nBlocks == 0) {
+			EndDataPhase(InstancePtr);
+			break;
+		}
+
+		// NVMe Bridge Write: received in slots, written to the SSD in BulkOutHandler().
+		// ----------------------------------------------------------------------------
+		u32 rxLength = usbBridgeWriteStart(lbOffset, nBlocks);
+		// ----------------------------------------------------------------------------
 
 		Phase = USB_EP_STATE_DATA_OUT;
-		EpBufferRecv(InstancePtr->PrivateData, 1, VirtFlashWritePointer, rxBytesLeft);
+		EpBufferRecv(InstancePtr->PrivateData, 1, VirtFlashWritePointer, rxLength);
 		break;
+	}
 
 	case USB_RBC_STARTSTOP_UNIT:
 	{
@@ -332,9 +397,32 @@ void ParseCBW(struct Usb_DevData *InstancePtr)
 	}
 
 	case USB_RBC_REQUEST_SENSE:
+	{
+		u32 SenseLength = sizeof(SCSI_SENSE_DATA);
 #ifdef CLASS_STORAGE_DEBUG
 		printf("SCSI: REQUEST_SENSE\r\n");
 #endif
+		/* Reporting the sense data clears it. */
+		ScsiSenseData((SCSI_SENSE_DATA *) txBuffer, SenseKey, SenseAsc);
+		SenseKey = SCSI_SENSE_NONE;
+		SenseAsc = SCSI_ASC_NONE;
+
+		/* Byte 4 is the allocation length. Never send more than the
+		 * host asked for in the CBW either.
+		 */
+		if (SenseLength > CBW.CBWCB[4]) {
+			SenseLength = CBW.CBWCB[4];
+		}
+		if (SenseLength > CBW.dCBWDataTransferLength) {
+			SenseLength = CBW.dCBWDataTransferLength;
+		}
+		if (SenseLength == 0) {
+			SendCSW(InstancePtr, 0);
+			break;
+		}
+		Phase = USB_EP_STATE_DATA_IN;
+		EpBufferSend(InstancePtr->PrivateData, 1, txBuffer, SenseLength);
+	}
 		break;
 
 	case USB_SYNC_SCSI:
@@ -343,15 +431,282 @@ void ParseCBW(struct Usb_DevData *InstancePtr)
 #endif
 		// NVMe Bridge Sync
 		/// ----------------------------------------------------------------------------
-		nvmeFlush();
-		while(nvmeGetIOSlip() > 0)
 		{
-			nvmeServiceIOCompletions(16);
+			u16 FlushCID = nvmeGetIOCID();
+			u8 Failed = (usbBridgeWriteDrain() != NVME_IO_OK);
+
+			nvmeFlush();
+			Failed |= (nvmeWaitCIDRange(FlushCID, 1) != NVME_IO_OK);
+			while(nvmeGetIOSlip() > 0)
+			{
+				nvmeServiceIOCompletions(16);
+			}
+			if (Failed) {
+				SetCSWError(SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_WRITE_ERROR);
+			}
 		}
 		// ----------------------------------------------------------------------------
 		SendCSW(InstancePtr, 0);
 		break;
+
+	default:
+#ifdef CLASS_STORAGE_DEBUG
+		printf("SCSI: UNSUPPORTED 0x%02x\r\n", CBW.CBWCB[0]);
+#endif
+		FailCommand(InstancePtr, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_OPCODE);
+		break;
+	}
+}
+
+/****************************************************************************/
+/**
+* This function fails the current command with CHECK CONDITION. The sense
+* data is kept for REQUEST SENSE. A pending data-in phase is ended with a
+* zero-length packet, a pending data-out phase by stalling the OUT endpoint.
+*
+* @param	InstancePtr is pointer to Usb_DevData instance.
+* @param	Key is the SCSI sense key.
+* @param	Asc is the SCSI additional sense code.
+*
+* @return	None
+*
+*****************************************************************************/
+static void FailCommand(struct Usb_DevData *InstancePtr, u8 Key, u8 Asc)
+{
+	SenseKey = Key;
+	SenseAsc = Asc;
+	CSWStatus = USB_CSW_FAILED;
+
+	EndDataPhase(InstancePtr);
+}
+
+/****************************************************************************/
+/**
+* This function ends the data phase of a command that moves no data, then
+* sends the CSW. A data-in phase the host expects is ended with a zero-length
+* packet, a data-out phase by stalling the OUT endpoint.
+*
+* @param	InstancePtr is pointer to Usb_DevData instance.
+*
+* @return	None
+*
+*****************************************************************************/
+static void EndDataPhase(struct Usb_DevData *InstancePtr)
+{
+	if (CBW.dCBWDataTransferLength == 0) {
+		SendCSW(InstancePtr, 0);
+	} else if (CBW.bmCBWFlags & 0x80) {
+		Phase = USB_EP_STATE_DATA_IN;
+		EpBufferSend(InstancePtr->PrivateData, 1, NULL, 0);
+	} else {
+		EpSetStall(InstancePtr->PrivateData, 1, USB_EP_DIR_OUT);
+		SendCSW(InstancePtr, 0);
+	}
+}
+
+/****************************************************************************/
+/**
+* This function checks a READ or WRITE against the CBW, so the data phase
+* never moves more than dCBWDataTransferLength or in the wrong direction.
+* A mismatch is a phase error: the command is clamped to the whole blocks the
+* host allows (none if the direction is wrong), and the CSW carries the
+* residue and phase error status.
+*
+* @param	NumBlocks is the number of logical blocks in the CDB.
+* @param	DirIn is 1 for a READ, 0 for a WRITE.
+*
+* @return	Number of logical blocks to move.
+*
+*****************************************************************************/
+static u32 ClampBlocks(u32 NumBlocks, u8 DirIn)
+{
+	u32 MaxBlocks = CBW.dCBWDataTransferLength / VFLASH_BLOCK_SIZE;
+
+	if ((CBW.dCBWDataTransferLength > 0) && (((CBW.bmCBWFlags & 0x80) != 0) != DirIn)) {
+		CSWStatus = USB_CSW_PHASE_ERROR;
+		return 0;
+	}
+
+	if (NumBlocks > MaxBlocks) {
+		CSWStatus = USB_CSW_PHASE_ERROR;
+		return MaxBlocks;
+	}
+
+	return NumBlocks;
+}
+
+/****************************************************************************/
+/**
+* This function decodes the LBA and block count of a READ or WRITE CDB, 10 or
+* 16 bytes.
+*
+* @param	Cdb is the command descriptor block.
+* @param	Block is the first logical block.
+* @param	NumBlocks is the number of logical blocks.
+*
+* @return	SCSI_ASC_NONE, or the additional sense code to fail with.
+*
+*****************************************************************************/
+u8 ScsiParseReadWrite(const u8 *Cdb, u64 *Block, u32 *NumBlocks)
+{
+	if ((Cdb[0] == USB_RBC_READ16) || (Cdb[0] == USB_RBC_WRITE16)) {
+		*Block = htonll(((SCSI_READ_WRITE_16 *) Cdb)->block);
+		*NumBlocks = htonl(((SCSI_READ_WRITE_16 *) Cdb)->length);
+	} else {
+		*Block = htonl(((SCSI_READ_WRITE *) Cdb)->block);
+		*NumBlocks = htons(((SCSI_READ_WRITE *) Cdb)->length);
+	}
+
+	if ((*Block > VFLASH_NUM_BLOCKS) || (*NumBlocks > VFLASH_NUM_BLOCKS - *Block)) {
+		return SCSI_ASC_LBA_OUT_OF_RANGE;
 	}
+
+	/* Transfers are counted in 32-bit bytes. */
+	if ((u64) *NumBlocks * VFLASH_BLOCK_SIZE > 0xFFFFFFFF) {
+		return SCSI_ASC_INVALID_FIELD_CDB;
+	}
+
+	return SCSI_ASC_NONE;
+}
+
+/****************************************************************************/
+/**
+* This function builds the READ CAPACITY(10) or READ CAPACITY(16) reply.
+* READ CAPACITY(10) reports 0xFFFFFFFF blocks for drives it cannot describe,
+* which tells the host to use READ CAPACITY(16).
+*
+* @param	Cdb is the command descriptor block.
+* @param	Buffer is filled with the reply.
+*
+* @return	Reply length, or 0 for an unsupported service action.
+*
+* @note		The caller clamps the reply to the allocation length.
+*
+*****************************************************************************/
+u32 ScsiReadCapacity(const u8 *Cdb, u8 *Buffer)
+{
+	u64 LastBlock = VFLASH_NUM_BLOCKS - 1;
+
+	if (Cdb[0] == USB_RBC_READ_CAP) {
+		SCSI_READ_CAPACITY *Cap = (SCSI_READ_CAPACITY *) Buffer;
+
+		Cap->numBlocks = htonl((LastBlock > 0xFFFFFFFF) ? 0xFFFFFFFF : (u32) LastBlock);
+		Cap->blockSize = htonl(VFLASH_BLOCK_SIZE);
+		return sizeof(SCSI_READ_CAPACITY);
+	}
+
+	if ((Cdb[1] & 0x1F) != USB_SAI_READ_CAP16) {
+		return 0;
+	}
+
+	SCSI_READ_CAPACITY_16 *Cap16 = (SCSI_READ_CAPACITY_16 *) Buffer;
+
+	memset(Cap16, 0, sizeof(SCSI_READ_CAPACITY_16));
+	Cap16->lastBlock = htonll(LastBlock);
+	Cap16->blockSize = htonl(VFLASH_BLOCK_SIZE);
+	return sizeof(SCSI_READ_CAPACITY_16);
+}
+
+/****************************************************************************/
+/**
+* This function builds fixed format sense data.
+*
+* @param	Sense is filled with the sense data.
+* @param	Key is the SCSI sense key.
+* @param	Asc is the SCSI additional sense code.
+*
+* @return	None
+*
+*****************************************************************************/
+void ScsiSenseData(SCSI_SENSE_DATA *Sense, u8 Key, u8 Asc)
+{
+	memset(Sense, 0, sizeof(SCSI_SENSE_DATA));
+	Sense->responseCode = 0x70;
+	Sense->senseKey = Key;
+	Sense->additionalLength = sizeof(SCSI_SENSE_DATA) - 8;
+	Sense->asc = Asc;
+}
+
+/****************************************************************************/
+/**
+* This function fails the current command once its data has moved, e.g. when
+* the SSD reports an error for data already sent. The next CSW carries
+* CHECK CONDITION, and the sense data is kept for REQUEST SENSE.
+*
+* @param	Key is the SCSI sense key.
+* @param	Asc is the SCSI additional sense code.
+*
+* @return	None
+*
+*****************************************************************************/
+void SetCSWError(u8 Key, u8 Asc)
+{
+	SenseKey = Key;
+	SenseAsc = Asc;
+	if (CSWStatus != USB_CSW_PHASE_ERROR) {
+		CSWStatus = USB_CSW_FAILED;
+	}
+}
+
+/****************************************************************************/
+/**
+* This function counts data moved in the data phase of the current command,
+* for the CSW residue. Called as each bulk transfer of the data phase ends.
+*
+* @param	Length is the number of bytes moved.
+*
+* @return	None
+*
+*****************************************************************************/
+void AddCSWData(u32 Length)
+{
+	CSWDataMoved += Length;
+}
+
+/****************************************************************************/
+/**
+* This function ends a data-in phase once its data has been sent. If it fell
+* short of dCBWDataTransferLength on a packet boundary, a zero-length packet
+* is sent first, so the host doesn't take the CSW for data. The CSW follows
+* from the next call, with BytesTxed 0.
+*
+* @param	InstancePtr is pointer to Usb_DevData instance.
+* @param	BytesTxed is the length of the transfer that just ended.
+*
+* @return	None
+*
+*****************************************************************************/
+void EndDataIn(struct Usb_DevData *InstancePtr, u32 BytesTxed)
+{
+	u32 MaxPacket = (IsSuperSpeed(InstancePtr) == XST_SUCCESS) ? 1024 : 512;
+
+	if ((BytesTxed > 0) && (CSWDataMoved < CBW.dCBWDataTransferLength) &&
+	    ((BytesTxed % MaxPacket) == 0)) {
+		EpBufferSend(InstancePtr->PrivateData, 1, NULL, 0);
+		return;
+	}
+
+	SendCSW(InstancePtr, 0);
+}
+
+/****************************************************************************/
+/**
+* This function ends a data-out phase once its data has been received. If the
+* host has more to send than the command takes, the OUT endpoint is stalled
+* before the CSW.
+*
+* @param	InstancePtr is pointer to Usb_DevData instance.
+*
+* @return	None
+*
+*****************************************************************************/
+void EndDataOut(struct Usb_DevData *InstancePtr)
+{
+	if (CSWDataMoved < CBW.dCBWDataTransferLength) {
+		EpSetStall(InstancePtr->PrivateData, 1, USB_EP_DIR_OUT);
+	}
+
+	SendCSW(InstancePtr, 0);
 }
 
 /****************************************************************************/
@@ -359,7 +714,8 @@ void ParseCBW(struct Usb_DevData *InstancePtr)
 * This function is used to send SCSI Command Status Wrapper to Host.
 *
 * @param	InstancePtr is pointer to Usb_DevData instance.
-* @param	Length is the data residue.
+* @param	Length is data residue beyond the bytes the data phase fell short
+*			of dCBWDataTransferLength by, normally 0.
 *
 * @return	None
 *
@@ -368,10 +724,18 @@ void ParseCBW(struct Usb_DevData *InstancePtr)
 *****************************************************************************/
 void SendCSW(struct Usb_DevData *InstancePtr, u32 Length)
 {
+	u32 Residue = 0;
+
+	if (CSWDataMoved < CBW.dCBWDataTransferLength) {
+		Residue = CBW.dCBWDataTransferLength - CSWDataMoved;
+	}
+
 	CSW.dCSWSignature = 0x53425355;
 	CSW.dCSWTag = CBW.dCBWTag;
-	CSW.dCSWDataResidue = Length;
-	CSW.bCSWStatus = 0;
+	CSW.dCSWDataResidue = Residue + Length;
+	CSW.bCSWStatus = CSWStatus;
+	CSWDataMoved = 0;
+	CSWStatus = USB_CSW_PASSED;
 	Phase = USB_EP_STATE_STATUS;
 	EpBufferSend(InstancePtr->PrivateData, 1, (void *) &CSW, 13);
 }
@@ -74,8 +74,34 @@ extern "C" {
 #define USB_RBC_WRITE				0x2a
 #define USB_RBC_VERIFY				0x2f
 #define USB_SYNC_SCSI				0x35
+#define USB_RBC_READ16				0x88
+#define USB_RBC_WRITE16				0x8a
+#define USB_SERVICE_ACTION_IN16		0x9e
+#define USB_SAI_READ_CAP16			0x10
+
+/*
+ * SCSI status, sense keys and additional sense codes.
+ */
+#define SCSI_STATUS_GOOD			0x00
+#define SCSI_STATUS_CHECK_CONDITION	0x02
+#define SCSI_STATUS_TASK_SET_FULL	0x28
+#define SCSI_SENSE_NONE				0x00
+#define SCSI_SENSE_MEDIUM_ERROR		0x03
+#define SCSI_SENSE_ILLEGAL_REQUEST	0x05
+#define SCSI_ASC_NONE				0x00
+#define SCSI_ASC_WRITE_ERROR		0x0c
+#define SCSI_ASC_UNRECOVERED_READ_ERROR	0x11
+#define SCSI_ASC_INVALID_OPCODE		0x20
+#define SCSI_ASC_LBA_OUT_OF_RANGE	0x21
+#define SCSI_ASC_INVALID_FIELD_CDB	0x24
+
+/*
+ * CSW status.
+ */
+#define USB_CSW_PASSED				0x00
+#define USB_CSW_FAILED				0x01
+#define USB_CSW_PHASE_ERROR			0x02
 
-#define VFLASH_BLOCK_SIZE	0x200
 
 // NVME bridge buffer space.
 #define SSD2USB_BUFFER_ADDR 0x70000000
@@ -158,6 +184,37 @@ typedef struct {
 	u8  control;
 } attribute(SCSI_READ_WRITE);
 
+typedef struct {
+	u64 lastBlock;
+	u32 blockSize;
+	u8  protection;
+	u8  blocksPerPhysicalExp;
+	u16 lowestAlignedBlock;
+	u8  reserved[16];
+} attribute(SCSI_READ_CAPACITY_16);
+
+typedef struct {
+	u8  opCode;
+	u8  flags;
+	u64 block;
+	u32 length;
+	u8  group;
+	u8  control;
+} attribute(SCSI_READ_WRITE_16);
+
+typedef struct {
+	u8  responseCode;
+	u8  obsolete;
+	u8  senseKey;
+	u32 information;
+	u8  additionalLength;
+	u32 commandInfo;
+	u8  asc;
+	u8  ascq;
+	u8  fruCode;
+	u8  senseKeySpecific[3];
+} attribute(SCSI_SENSE_DATA);
+
 typedef struct {
 	u8  opCode;
 	u8  immed;
@@ -175,6 +232,13 @@ typedef struct {
 void ClassReq(struct Usb_DevData *InstancePtr, SetupPacket *SetupData);
 void ParseCBW(struct Usb_DevData *InstancePtr);
 void SendCSW(struct Usb_DevData *InstancePtr, u32 Length);
+void SetCSWError(u8 Key, u8 Asc);
+void AddCSWData(u32 Length);
+void EndDataIn(struct Usb_DevData *InstancePtr, u32 BytesTxed);
+void EndDataOut(struct Usb_DevData *InstancePtr);
+u8 ScsiParseReadWrite(const u8 *Cdb, u64 *Block, u32 *NumBlocks);
+u32 ScsiReadCapacity(const u8 *Cdb, u8 *Buffer);
+void ScsiSenseData(SCSI_SENSE_DATA *Sense, u8 Key, u8 Asc);
 
 #ifdef __cplusplus
 }
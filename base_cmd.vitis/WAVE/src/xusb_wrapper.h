@@ -75,6 +75,8 @@ extern "C" {
 #define USB_EP1_OUT		0x01
 #define USB_EP2_IN		0x82
 #define USB_EP2_OUT		0x02
+#define USB_EP3_IN		0x83
+#define USB_EP3_OUT		0x03
 /* @} */
 
 /**
@@ -0,0 +1,266 @@
+/*
+WAVE Dark Frame Benchmark
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "xil_printf.h"
+#include "frame.h"
+#include "dma.h"
+#include "hdmi_dark_frame.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Flash dark frames and their RAM copies, mapped at the same virtual addresses.
+#define BENCH_FLASH_ADDR 0xC0900000
+#define BENCH_RAM_ADDR 0x7B600000
+#define BENCH_DF_SIZE (4 * sizeof(DarkFrame_s))
+
+#define BENCH_VALUES ((DARK_FRAME_H + DARK_FRAME_W) * 4)
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	int tCold;
+	int tSpan;
+	u16 wFrame;
+	u32 range;
+	float tStep;
+} benchOptions_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void benchUsage(const char * name);
+void benchGenerate(const benchOptions_s * opt);
+u32 benchCheck(const benchOptions_s * opt, float temp, const DarkFrame_s * cold, const DarkFrame_s * warm,
+               u32 * maxError);
+u32 benchRand(void);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+extern DarkFrame_s * dfActive;
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+u32 benchRandState = 0x12345678;
+u32 benchUploads = 0;
+u32 benchUploadsOutside = 0;	// Uploads whose source is not in the active dark frame.
+u16 benchOffsetBot, benchOffsetTop;
+DarkFrame_s benchBefore;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+	benchOptions_s opt = {30, 1, 4096, 1023, 0.5f};
+	DarkFrame_s * flash = (DarkFrame_s *) BENCH_FLASH_ADDR;
+	DarkFrame_s * cold, * warm;
+	XTime tStart, tEnd;
+	u64 tCreate = 0;
+	u32 nTemps = 0;
+	u32 mismatches = 0;
+	u32 swapErrors = 0;
+	u32 maxError = 0;
+	int c;
+
+	while((c = getopt(argc, argv, "2c:s:r:t:")) != -1)
+	{
+		switch(c)
+		{
+		case '2': opt.wFrame = 2048; break;
+		case 'c': opt.tCold = atoi(optarg); break;
+		case 's': opt.tSpan = atoi(optarg); break;
+		case 'r': opt.range = strtoul(optarg, NULL, 0); break;
+		case 't': opt.tStep = strtof(optarg, NULL); break;
+		default: benchUsage(argv[0]); return 1;
+		}
+	}
+	if((argc != optind) || (opt.tCold < -128) || (opt.tCold + opt.tSpan > 127) || (opt.range == 0)
+	|| (opt.range > 16383) || (opt.tStep <= 0.0f))
+	{ benchUsage(argv[0]); return 1; }
+
+	if((mmap((void *) BENCH_FLASH_ADDR, BENCH_DF_SIZE, PROT_READ | PROT_WRITE,
+	         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void *) BENCH_FLASH_ADDR)
+	|| (mmap((void *) BENCH_RAM_ADDR, BENCH_DF_SIZE, PROT_READ | PROT_WRITE,
+	         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void *) BENCH_RAM_ADDR))
+	{
+		xil_printf("Unable to map the dark frames. Build with -no-pie.\r\n");
+		return 1;
+	}
+
+	benchGenerate(&opt);
+	hdmiDarkFrameInit();
+	cold = (opt.wFrame == 4096) ? &flash[0] : &flash[2];
+	warm = (opt.wFrame == 4096) ? &flash[1] : &flash[3];
+
+	// Sensor temperatures from 10C below the clamp range to 10C above it, through Create and the swap at VSYNC.
+	for(float temp = -10.0f; temp <= 80.0f; temp += opt.tStep)
+	{
+		memcpy(&benchBefore, dfActive, sizeof(DarkFrame_s));
+		benchUploads = 0;
+
+		XTime_GetTime(&tStart);
+		hdmiDarkFrameCreate(opt.wFrame, temp);
+		XTime_GetTime(&tEnd);
+		tCreate += tEnd - tStart;
+		nTemps++;
+
+		// The active dark frame may be uploading: it must not change, and Apply leaves the upload to the swap.
+		hdmiDarkFrameApply(opt.wFrame, (opt.wFrame == 4096) ? 3072 : 1536);
+		if((memcmp(&benchBefore, dfActive, sizeof(DarkFrame_s)) != 0) || (benchUploads != 0)
+		|| !hdmiDarkFrameSwapPending()) { swapErrors++; }
+
+		if(!hdmiDarkFrameSwap() || hdmiDarkFrameSwapPending()) { swapErrors++; }
+		if((benchUploads != 2) || (benchUploadsOutside != 0)
+		|| (benchOffsetBot != dfActive->offsetBot) || (benchOffsetTop != dfActive->offsetTop)) { swapErrors++; }
+
+		mismatches += benchCheck(&opt, temp, cold, warm, &maxError);
+	}
+
+	xil_printf("%dK dark frames at %dC and %dC, values within +/-%d.\r\n", opt.wFrame / 1024, opt.tCold,
+	           opt.tCold + opt.tSpan, opt.range);
+#ifdef __ARM_NEON
+	xil_printf("NEON interpolation.\r\n");
+#else
+	xil_printf("Scalar interpolation.\r\n");
+#endif
+	printf("%.1fus per hdmiDarkFrameCreate().\r\n", (double) tCreate / 1000.0 / nTemps);
+	xil_printf("%d temperatures: %d values more than 1 LSB off the float interpolation (max %d).\r\n", nTemps,
+	           mismatches, maxError);
+	xil_printf("%d swap errors.\r\n", swapErrors);
+
+	return (mismatches != 0) || (swapErrors != 0);
+}
+
+// Firmware API: XTime -------------------------------------------------------------------------------------------------
+
+void XTime_GetTime(XTime * Xtime_Global)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	*Xtime_Global = (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Firmware API: DMA, Sensor, Frames -----------------------------------------------------------------------------------
+
+void dmaUpload(void * dst, const void * src, u32 size, dmaCallback_t callback, void * ctx)
+{
+	const u8 * p = (const u8 *) src;
+
+	benchUploads++;
+	if((p < (const u8 *) dfActive) || (p + size > (const u8 *) (dfActive + 1))) { benchUploadsOutside++; }
+}
+
+u32 dmaBusy(void)
+{
+	return 0;
+}
+
+void cmvSetOffsets(u16 offsetBot, u16 offsetTop)
+{
+	benchOffsetBot = offsetBot;
+	benchOffsetTop = offsetTop;
+}
+
+FrameHeader_s * frameGetHeader(u32 iFrame)
+{
+	return NULL;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+void benchUsage(const char * name)
+{
+	xil_printf("Usage: %s [options]\r\n", name);
+	xil_printf("  -2       2K dark frames (default 4K).\r\n");
+	xil_printf("  -c <C>   Cold dark frame temperature (default 30).\r\n");
+	xil_printf("  -s <C>   Warm minus cold temperature (default 1).\r\n");
+	xil_printf("  -r <n>   Dark frame values within +/-n (default 1023).\r\n");
+	xil_printf("  -t <C>   Sensor temperature step (default 0.5).\r\n");
+}
+
+// Random cold and warm dark frames, for 4K and 2K, in flash.
+void benchGenerate(const benchOptions_s * opt)
+{
+	DarkFrame_s * flash = (DarkFrame_s *) BENCH_FLASH_ADDR;
+	s16 * v;
+
+	memset(flash, 0, BENCH_DF_SIZE);
+	for(int i = 0; i < 4; i++)
+	{
+		v = (s16 *) flash[i].row;
+		for(u32 k = 0; k < BENCH_VALUES; k++)
+		{
+			v[k] = (s16)((s32)(benchRand() % (2 * opt->range + 1)) - (s32) opt->range);
+		}
+		flash[i].offsetBot = 400 + benchRand() % 200;
+		flash[i].offsetTop = 400 + benchRand() % 200;
+		flash[i].temp = (i & 1) ? (opt->tCold + opt->tSpan) : opt->tCold;
+	}
+}
+
+// Compare the active dark frame with cold + w * (warm - cold) in double precision, floored and saturated as the
+// firmware stores it. Returns the number of values more than 1 LSB off.
+u32 benchCheck(const benchOptions_s * opt, float temp, const DarkFrame_s * cold, const DarkFrame_s * warm,
+               u32 * maxError)
+{
+	const s16 * c = (const s16 *) cold->row;
+	const s16 * h = (const s16 *) warm->row;
+	const s16 * out = (const s16 *) dfActive->row;
+	double w, ref;
+	u32 error;
+	u32 n = 0;
+
+	if(temp < 0.0f) { temp = 0.0f; }
+	else if(temp > 70.0f) { temp = 70.0f; }
+	w = (opt->tSpan == 0) ? 0.0 : ((double) temp - cold->temp) / (double)(warm->temp - cold->temp);
+
+	for(u32 k = 0; k < BENCH_VALUES; k++)
+	{
+		ref = floor(c[k] + w * (h[k] - c[k]));
+		if(ref < 0.0) { ref = 0.0; }
+		else if(ref > 32767.0) { ref = 32767.0; }
+
+		error = (u32) fabs(ref - out[k]);
+		if(error > *maxError) { *maxError = error; }
+		if(error > 1) { n++; }
+	}
+
+	return n;
+}
+
+u32 benchRand(void)
+{
+	benchRandState = benchRandState * 1664525 + 1013904223;
+	return benchRandState >> 8;
+}
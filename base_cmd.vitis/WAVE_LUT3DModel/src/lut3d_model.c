@@ -0,0 +1,118 @@
+/*
+WAVE 3D LUT Model
+
+Bit-exact model of color_3dlut.v: the subcube address and remainder of each input, the two multiply stages, and the
+output sum with its saturation to 8b. Each product is taken at the width of the HDL net it is assigned to, and each
+shift and sum wraps to 16b where the HDL's does.
+
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "lut3d_model.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+u8 lut3dModelAddr(s16 x);
+s64 lut3dModelWrap(s64 x, int width);
+u8 lut3dModelSaturate(s16 s);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+void lut3dModelEval(const lut3dModelPack_s * pack, const s16 * in, s16 * sum, u8 * out)
+{
+	u8 addr[3];
+	s16 d[3];
+	s16 dBdR, dRdG, dGdB;
+	const s16 * c30;
+	const s16 * c74;
+	s16 c7dR;
+	s16 p[4];
+	u32 lutIndex;
+
+	// Shared address and remainders: R, G, B.
+	for(int a = 0; a < 3; a++)
+	{
+		addr[a] = lut3dModelAddr(in[a]);
+		d[a] = (s16)(in[a] - (addr[a] << 10));
+	}
+	lutIndex = (addr[2] << 8) + (addr[1] << 4) + addr[0];
+
+	// Common products, at 32b before the shift.
+	dBdR = (s16)(((s64) d[2] * d[0]) >> 14);
+	dRdG = (s16)(((s64) d[0] * d[1]) >> 14);
+	dGdB = (s16)(((s64) d[1] * d[2]) >> 14);
+
+	for(int ch = 0; ch < 3; ch++)
+	{
+		c30 = &pack->c30[ch][lutIndex * 4];
+		c74 = &pack->c74[ch][lutIndex * 4];
+
+		c7dR = (s16)(((s64) c74[3] * d[0]) >> 10);
+
+		// Second stage: 32b sums, except the 30b one of the constant term.
+		p[0] = (s16)(lut3dModelWrap((s64) c74[0] * dBdR + (s64) c30[1] * d[2], 32) >> 10);
+		p[1] = (s16)(lut3dModelWrap((s64) c74[1] * dRdG + (s64) c30[2] * d[0], 32) >> 10);
+		p[2] = (s16)(lut3dModelWrap((s64) c74[2] * dGdB + (s64) c30[3] * d[1], 32) >> 10);
+		p[3] = (s16)(lut3dModelWrap((s64) c7dR * dGdB + ((s64) c30[0] << 14), 30) >> 14);
+
+		sum[ch] = (s16)(p[0] + p[1] + p[2] + p[3]);
+		out[ch] = lut3dModelSaturate(sum[ch]);
+	}
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Negative inputs use subcube 0 and inputs of 1.0 or more use subcube 15, both with an out-of-range remainder.
+u8 lut3dModelAddr(s16 x)
+{
+	if(x < 0) { return 0; }
+	if(x & 0x4000) { return 15; }
+	return (x >> 10) & 0xF;
+}
+
+// Two's complement wrap to width bits, sign extended.
+s64 lut3dModelWrap(s64 x, int width)
+{
+	u64 m = 1ULL << (width - 1);
+	u64 u = (u64) x & ((m << 1) - 1);
+
+	return (s64)(u ^ m) - (s64) m;
+}
+
+u8 lut3dModelSaturate(s16 s)
+{
+	if(s < 0) { return 0x00; }
+	if(s & 0x4000) { return 0xFF; }
+	return (s >> 6) & 0xFF;
+}
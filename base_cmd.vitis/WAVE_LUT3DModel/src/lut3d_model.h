@@ -0,0 +1,54 @@
+/*
+WAVE 3D LUT Model Include
+
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __LUT3D_MODEL_INCLUDE__
+#define __LUT3D_MODEL_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+#define LUT3D_MODEL_ENTRIES 4096        // Subcubes, {B, G, R} 4b addresses.
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Coefficient tables of a pack, as the URAMs hold them: four s16 per entry, lowest first. Index 0, 1, 2: R, G, B.
+typedef struct
+{
+	const s16 * c30[3];
+	const s16 * c74[3];
+} lut3dModelPack_s;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+// One pixel through color_3dlut.v. in[] is R_14b, G_14b, B_14b, sum[] the 14b output sums before saturation, and
+// out[] R_8b, G_8b, B_8b.
+void lut3dModelEval(const lut3dModelPack_s * pack, const s16 * in, s16 * sum, u8 * out);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
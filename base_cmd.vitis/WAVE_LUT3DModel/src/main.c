@@ -0,0 +1,532 @@
+/*
+WAVE 3D LUT Model Test
+
+Loads generated .cube files through the firmware's hdmi_lut3d.c, checks the 17x17x17 grid it resamples them to against
+a reference trilinear sampler of each table, and runs the packs it builds from that grid through the color_3dlut.v
+model.
+
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "main.h"
+#include "fs.h"
+#include "dma.h"
+#include "hdmi_lut3d.h"
+#include "lut3d_model.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// hdmi_lut3d.c pack cache at its DDR4 address, mapped at the same virtual address.
+#define MODEL_CACHE_ADDR 0x7B400000
+#define MODEL_CACHE_SIZE (8 << 18)
+#define MODEL_PACK_SIZE (1 << 18)
+
+#define MODEL_GRID 17
+
+// Pass limits.
+#define MODEL_GRID_TOL 1e-5             // Grid point error, in the .cube's output units.
+#define MODEL_PACK_TOL 8.0              // Pixel error, in 14b LSB, of a .cube pack.
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	int size;
+	u32 nPixels;
+	const char * path;
+} modelOptions_s;
+
+// A generated .cube file.
+typedef struct
+{
+	const char * name;
+	int size;
+	double domainMin;
+	double domainMax;
+	u8 inputRange;                      // LUT_3D_INPUT_RANGE instead of DOMAIN_MIN/MAX.
+	u8 crlf;
+} modelCube_s;
+
+// A file the loader must reject.
+typedef struct
+{
+	const char * name;
+	const char * text;
+	int status;
+} modelReject_s;
+
+// Errors of a pack against its ideal, over the pixels run through it.
+typedef struct
+{
+	u32 n;
+	double maxError;                    // [14b LSB]
+	double sumError;
+	u32 maxCodeError;                   // [8b code]
+} modelPackStats_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void modelUsage(const char * name);
+void modelGrade(double r, double g, double b, double * rgb);
+double * modelWriteCube(const modelOptions_s * opt, const modelCube_s * cube);
+double modelCheckGrid(const modelCube_s * cube, const double * table);
+double modelSample(const double * table, int size, const double * x);
+void modelPack(lut3dModelPack_s * pack);
+void modelCheckPack(const modelOptions_s * opt, float (* grid)[MODEL_GRID][MODEL_GRID][3], hdmiLUT3DRangeType range,
+                    modelPackStats_s * stats);
+void modelPackPixel(const lut3dModelPack_s * pack, const double * ref, double offset, double scale, const s16 * in,
+                    modelPackStats_s * stats);
+double modelTime_ms(void);
+u32 modelRand(void);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// hdmi_lut3d.c internals read by the model.
+extern u32 lut3dActiveSlot;
+extern float lut3dCubeGrid[MODEL_GRID][MODEL_GRID][MODEL_GRID][3];
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+const modelCube_s modelCubes[] =
+{
+	{"2-point",              2,  0.0, 1.0, 0, 0},
+	{"17-point",            17,  0.0, 1.0, 0, 0},
+	{"33-point",            33,  0.0, 1.0, 0, 0},
+	{"65-point, CRLF",      65,  0.0, 1.0, 0, 1},
+	{"32-point, domain",    32, -0.1, 1.2, 0, 0},
+	{"24-point, range",     24,  0.1, 0.9, 1, 0},
+};
+
+const modelReject_s modelRejects[] =
+{
+	{"1D LUT",      "LUT_1D_SIZE 4\n0 0 0\n1 1 1\n", HDMI_LUT3D_ERROR_FORMAT},
+	{"size 66",     "LUT_3D_SIZE 66\n", HDMI_LUT3D_ERROR_SIZE},
+	{"short table", "LUT_3D_SIZE 2\n0 0 0\n1 0 0\n0 1 0\n", HDMI_LUT3D_ERROR_FORMAT},
+	{"long table",  "LUT_3D_SIZE 2\n0 0 0\n1 0 0\n0 1 0\n1 1 0\n0 0 1\n1 0 1\n0 1 1\n1 1 1\n1 1 1\n",
+	                HDMI_LUT3D_ERROR_FORMAT},
+	{"no size",     "0 0 0\n", HDMI_LUT3D_ERROR_FORMAT},
+	{"bad entry",   "LUT_3D_SIZE 2\n0 0 0\n1 0 x\n", HDMI_LUT3D_ERROR_FORMAT},
+	{"bad domain",  "LUT_3D_SIZE 2\nDOMAIN_MIN 1 0 0\nDOMAIN_MAX 1 1 1\n0 0 0\n", HDMI_LUT3D_ERROR_FORMAT},
+};
+
+FILE * modelFile = NULL;
+u32 modelRandState = 0x12345678;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+	modelOptions_s opt;
+	modelCube_s cube;
+	modelPackStats_s stats;
+	float (* identity)[MODEL_GRID][MODEL_GRID][3];
+	double * table;
+	double gridError;
+	double tLoad, tBuild;
+	FILE * f;
+	int status;
+	u32 nFailed = 0;
+	int c;
+
+	opt.size = 33;
+	opt.nPixels = 1000000;
+	opt.path = "/tmp/lut3dmodel.cube";
+
+	while((c = getopt(argc, argv, "s:n:f:")) != -1)
+	{
+		switch(c)
+		{
+		case 's': opt.size = (int)strtol(optarg, NULL, 0); break;
+		case 'n': opt.nPixels = (u32)strtoul(optarg, NULL, 0); break;
+		case 'f': opt.path = optarg; break;
+		default: modelUsage(argv[0]); return 1;
+		}
+	}
+	if((argc != optind) || (opt.size < 2) || (opt.size > 65)) { modelUsage(argv[0]); return 1; }
+
+	if(mmap((void *) MODEL_CACHE_ADDR, MODEL_CACHE_SIZE, PROT_READ | PROT_WRITE,
+	        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void *) MODEL_CACHE_ADDR)
+	{
+		printf("Unable to map 0x%08X-0x%08X. Build with -no-pie.\n", MODEL_CACHE_ADDR, MODEL_CACHE_ADDR + MODEL_CACHE_SIZE);
+		return 1;
+	}
+
+	// Grid points of each file against the reference sampler of its table.
+	printf("Grid, max error [output units]:\n");
+	for(u32 i = 0; i < sizeof(modelCubes) / sizeof(modelCube_s); i++)
+	{
+		table = modelWriteCube(&opt, &modelCubes[i]);
+		status = hdmiLUT3DLoadCube(opt.path);
+		if(status != HDMI_LUT3D_OK)
+		{
+			printf("  %-20s load status %d.\n", modelCubes[i].name, status);
+			nFailed++;
+		}
+		else
+		{
+			gridError = modelCheckGrid(&modelCubes[i], table);
+			printf("  %-20s %.2e\n", modelCubes[i].name, gridError);
+			if(gridError > MODEL_GRID_TOL) { nFailed++; }
+		}
+		free(table);
+	}
+
+	// Files the loader must reject, leaving no LUT loaded.
+	printf("Rejected files, status:\n");
+	for(u32 i = 0; i < sizeof(modelRejects) / sizeof(modelReject_s); i++)
+	{
+		f = fopen(opt.path, "wb");
+		if(f == NULL) { printf("Could not write %s.\n", opt.path); return 1; }
+		fputs(modelRejects[i].text, f);
+		fclose(f);
+
+		status = hdmiLUT3DLoadCube(opt.path);
+		printf("  %-20s %d (expected %d)\n", modelRejects[i].name, status, modelRejects[i].status);
+		if(status != modelRejects[i].status) { nFailed++; }
+	}
+	status = hdmiLUT3DLoadCube("/nonexistent/lut.cube");
+	printf("  %-20s %d (expected %d)\n", "missing file", status, HDMI_LUT3D_ERROR_FILE);
+	if(status != HDMI_LUT3D_ERROR_FILE) { nFailed++; }
+
+	// Identity packs: exact in the full range.
+	identity = malloc(sizeof(float) * MODEL_GRID * MODEL_GRID * MODEL_GRID * 3);
+	for(int b = 0; b < MODEL_GRID; b++)
+	{
+		for(int g = 0; g < MODEL_GRID; g++)
+		{
+			for(int r = 0; r < MODEL_GRID; r++)
+			{
+				identity[b][g][r][0] = (float) r / (MODEL_GRID - 1);
+				identity[b][g][r][1] = (float) g / (MODEL_GRID - 1);
+				identity[b][g][r][2] = (float) b / (MODEL_GRID - 1);
+			}
+		}
+	}
+	printf("Packs through color_3dlut.v, %u random pixels and the grid points:\n", opt.nPixels);
+	printf("                       max [14b]  mean [14b]  max [8b]\n");
+
+	hdmiLUT3DIdentity(HDMI_LUT3D_RANGE_FULL);
+	modelCheckPack(&opt, identity, HDMI_LUT3D_RANGE_FULL, &stats);
+	printf("  %-20s %9.2f  %10.3f  %8u\n", "Identity, full", stats.maxError, stats.sumError / stats.n, stats.maxCodeError);
+	if(stats.maxError != 0.0) { nFailed++; }
+
+	hdmiLUT3DIdentity(HDMI_LUT3D_RANGE_REC709);
+	modelCheckPack(&opt, identity, HDMI_LUT3D_RANGE_REC709, &stats);
+	printf("  %-20s %9.2f  %10.3f  %8u\n", "Identity, Rec.709", stats.maxError, stats.sumError / stats.n,
+	       stats.maxCodeError);
+	if(stats.maxError > MODEL_PACK_TOL) { nFailed++; }
+
+	// A .cube pack of the chosen size, timed.
+	memset(&cube, 0, sizeof(cube));
+	cube.name = "Pack";
+	cube.size = opt.size;
+	cube.domainMax = 1.0;
+	table = modelWriteCube(&opt, &cube);
+	tLoad = modelTime_ms();
+	status = hdmiLUT3DLoadCube(opt.path);
+	tLoad = modelTime_ms() - tLoad;
+	if(status != HDMI_LUT3D_OK) { printf("Load status %d.\n", status); return 1; }
+	free(table);
+
+	for(int range = HDMI_LUT3D_RANGE_FULL; range <= HDMI_LUT3D_RANGE_REC709; range++)
+	{
+		tBuild = modelTime_ms();
+		hdmiLUT3DCube((hdmiLUT3DRangeType) range);
+		tBuild = modelTime_ms() - tBuild;
+
+		modelCheckPack(&opt, lut3dCubeGrid, (hdmiLUT3DRangeType) range, &stats);
+		printf("  %d-point, %-11s %9.2f  %10.3f  %8u\n", opt.size,
+		       (range == HDMI_LUT3D_RANGE_FULL) ? "full" : "Rec.709", stats.maxError, stats.sumError / stats.n,
+		       stats.maxCodeError);
+		if(stats.maxError > MODEL_PACK_TOL) { nFailed++; }
+	}
+
+	printf("Host time: %.2fms to load the %d-point file, %.2fms to build a pack.\n", tLoad, opt.size, tBuild);
+	printf("%u checks failed.\n", nFailed);
+
+	free(identity);
+	remove(opt.path);
+	return (nFailed != 0);
+}
+
+// Firmware API: fs, dma -----------------------------------------------------------------------------------------------
+
+int fsOpenFile(const char * path)
+{
+	modelFile = fopen(path, "rb");
+	return (modelFile == NULL);
+}
+
+int fsReadFile(u8 * dest, u32 size, u32 * bytesRead)
+{
+	*bytesRead = fread(dest, 1, size, modelFile);
+	return ferror(modelFile);
+}
+
+void fsCloseClipFile(void)
+{
+	if(modelFile != NULL) { fclose(modelFile); }
+	modelFile = NULL;
+}
+
+// Not used: the model reads the packs in RAM.
+void dmaUpload(void * dst, const void * src, u32 size, dmaCallback_t callback, void * ctx)
+{
+	if(callback != NULL) { callback(ctx, DMA_OK); }
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+void modelUsage(const char * name)
+{
+	printf("Usage: %s [options]\n", name);
+	printf("  -s N      LUT_3D_SIZE of the timed pack, 2-65 (33).\n");
+	printf("  -n N      Random pixels run through each pack (1000000).\n");
+	printf("  -f FILE   Scratch .cube file (/tmp/lut3dmodel.cube).\n");
+}
+
+// A look with cross terms between the channels: saturation, a toe and shoulder, and a warm shift of the highlights.
+void modelGrade(double r, double g, double b, double * rgb)
+{
+	double y = 0.2126 * r + 0.7152 * g + 0.0722 * b;
+	double in[3] = {r, g, b};
+	double x;
+
+	for(int ch = 0; ch < 3; ch++)
+	{
+		x = y + 1.4 * (in[ch] - y);
+		if(x < 0.0) { x = 0.0; }
+		x = x * x * (3.0 - 2.0 * x) * 0.6 + x * 0.4;
+		if(ch == 0) { x += 0.08 * y * y; }
+		if(ch == 2) { x -= 0.06 * y * y; }
+		rgb[ch] = x;
+	}
+}
+
+// Writes the file and returns its table as read back from the text, [B][G][R][R/G/B].
+double * modelWriteCube(const modelOptions_s * opt, const modelCube_s * cube)
+{
+	const char * eol = cube->crlf ? "\r\n" : "\n";
+	int n = cube->size;
+	double * table = malloc(sizeof(double) * n * n * n * 3);
+	double x[3], rgb[3];
+	char line[96];
+	FILE * f;
+
+	f = fopen(opt->path, "wb");
+	if(f == NULL)
+	{
+		printf("Could not write %s.\n", opt->path);
+		exit(1);
+	}
+
+	fprintf(f, "# WAVE 3D LUT model: %s%s", cube->name, eol);
+	fprintf(f, "TITLE \"%s\"%s%s", cube->name, eol, eol);
+	fprintf(f, "LUT_3D_SIZE %d%s", n, eol);
+	if(cube->inputRange)
+	{ fprintf(f, "LUT_3D_INPUT_RANGE %.6f %.6f%s", cube->domainMin, cube->domainMax, eol); }
+	else if((cube->domainMin != 0.0) || (cube->domainMax != 1.0))
+	{
+		fprintf(f, "DOMAIN_MIN %.6f %.6f %.6f%s", cube->domainMin, cube->domainMin, cube->domainMin, eol);
+		fprintf(f, "DOMAIN_MAX %.6f %.6f %.6f%s", cube->domainMax, cube->domainMax, cube->domainMax, eol);
+	}
+	fprintf(f, "%s", eol);
+
+	// R changes fastest, then G, then B.
+	for(int i = 0; i < n * n * n; i++)
+	{
+		for(int a = 0; a < 3; a++)
+		{
+			x[a] = cube->domainMin + (cube->domainMax - cube->domainMin) * ((i / (a ? (a == 1 ? n : n * n) : 1)) % n)
+			     / (n - 1);
+		}
+		modelGrade(x[0], x[1], x[2], rgb);
+		snprintf(line, sizeof(line), "%.6f %.6f %.6f", rgb[0], rgb[1], rgb[2]);
+		fprintf(f, "%s%s", line, eol);
+
+		table[i * 3 + 0] = strtod(line, NULL);
+		table[i * 3 + 1] = strtod(strchr(line, ' ') + 1, NULL);
+		table[i * 3 + 2] = strtod(strrchr(line, ' ') + 1, NULL);
+	}
+
+	fclose(f);
+	return table;
+}
+
+// Largest difference between the loaded grid and the reference sampler at each grid point, input n / 16 per axis.
+double modelCheckGrid(const modelCube_s * cube, const double * table)
+{
+	double x[3], t[3], e;
+	double maxError = 0.0;
+
+	for(int b = 0; b < MODEL_GRID; b++)
+	{
+		for(int g = 0; g < MODEL_GRID; g++)
+		{
+			for(int r = 0; r < MODEL_GRID; r++)
+			{
+				x[0] = (double) r / (MODEL_GRID - 1);
+				x[1] = (double) g / (MODEL_GRID - 1);
+				x[2] = (double) b / (MODEL_GRID - 1);
+				for(int a = 0; a < 3; a++)
+				{
+					t[a] = (x[a] - cube->domainMin) / (cube->domainMax - cube->domainMin) * (cube->size - 1);
+				}
+
+				for(int ch = 0; ch < 3; ch++)
+				{
+					e = fabs(modelSample(&table[ch], cube->size, t) - lut3dCubeGrid[b][g][r][ch]);
+					if(e > maxError) { maxError = e; }
+				}
+			}
+		}
+	}
+
+	return maxError;
+}
+
+// Trilinear sample of one channel of a size^3 table of RGB triples, at table coordinates t[] (R, G, B), clamped.
+double modelSample(const double * table, int size, const double * t)
+{
+	int i0[3];
+	double f[3], x, v = 0.0, w;
+
+	for(int a = 0; a < 3; a++)
+	{
+		x = t[a];
+		if(x < 0.0) { x = 0.0; }
+		else if(x > size - 1) { x = size - 1; }
+		i0[a] = (int) floor(x);
+		if(i0[a] > size - 2) { i0[a] = size - 2; }
+		f[a] = x - i0[a];
+	}
+
+	// Corner bit 0: R, bit 1: G, bit 2: B.
+	for(int i = 0; i < 8; i++)
+	{
+		w = 1.0;
+		for(int a = 0; a < 3; a++) { w *= ((i >> a) & 1) ? f[a] : (1.0 - f[a]); }
+		v += w * table[3 * (((i0[2] + ((i >> 2) & 1)) * size + i0[1] + ((i >> 1) & 1)) * size + i0[0] + (i & 1))];
+	}
+
+	return v;
+}
+
+// Coefficient tables of the active pack, in the order of the URAMs.
+void modelPack(lut3dModelPack_s * pack)
+{
+	const s16 * base = (const s16 *)(UINTPTR)(MODEL_CACHE_ADDR + lut3dActiveSlot * MODEL_PACK_SIZE);
+
+	for(int ch = 0; ch < 3; ch++)
+	{
+		pack->c30[ch] = base + (2 * ch) * LUT3D_MODEL_ENTRIES * 4;
+		pack->c74[ch] = base + (2 * ch + 1) * LUT3D_MODEL_ENTRIES * 4;
+	}
+}
+
+// Runs the active pack at every grid point and at random pixels. The ideal output is the grid's trilinear
+// interpolation, in the pack's 14b output range.
+void modelCheckPack(const modelOptions_s * opt, float (* grid)[MODEL_GRID][MODEL_GRID][3], hdmiLUT3DRangeType range,
+                    modelPackStats_s * stats)
+{
+	lut3dModelPack_s pack;
+	double * ref = malloc(sizeof(double) * MODEL_GRID * MODEL_GRID * MODEL_GRID * 3);
+	double offset, scale;
+	s16 in[3];
+
+	modelPack(&pack);
+	for(int i = 0; i < MODEL_GRID * MODEL_GRID * MODEL_GRID * 3; i++) { ref[i] = (&grid[0][0][0][0])[i]; }
+	offset = (range == HDMI_LUT3D_RANGE_FULL) ? 0.0 : 1024.0;
+	scale = (range == HDMI_LUT3D_RANGE_FULL) ? 16384.0 : 14336.0;
+	memset(stats, 0, sizeof(modelPackStats_s));
+
+	for(int b = 0; b < MODEL_GRID; b++)
+	{
+		for(int g = 0; g < MODEL_GRID; g++)
+		{
+			for(int r = 0; r < MODEL_GRID; r++)
+			{
+				in[0] = r << 10;
+				in[1] = g << 10;
+				in[2] = b << 10;
+				modelPackPixel(&pack, ref, offset, scale, in, stats);
+			}
+		}
+	}
+
+	for(u32 i = 0; i < opt->nPixels; i++)
+	{
+		for(int a = 0; a < 3; a++) { in[a] = modelRand() % 16385; }
+		modelPackPixel(&pack, ref, offset, scale, in, stats);
+	}
+
+	free(ref);
+}
+
+void modelPackPixel(const lut3dModelPack_s * pack, const double * ref, double offset, double scale, const s16 * in,
+                    modelPackStats_s * stats)
+{
+	double t[3], ideal, e;
+	s16 sum[3];
+	u8 out[3];
+	int code;
+
+	lut3dModelEval(pack, in, sum, out);
+
+	for(int a = 0; a < 3; a++) { t[a] = in[a] / 1024.0; }
+	for(int ch = 0; ch < 3; ch++)
+	{
+		ideal = offset + scale * modelSample(&ref[ch], MODEL_GRID, t);
+		e = fabs(sum[ch] - ideal);
+		if(e > stats->maxError) { stats->maxError = e; }
+		stats->sumError += e;
+
+		code = (ideal < 0.0) ? 0 : ((ideal >= 16384.0) ? 255 : (int) floor(ideal / 64.0));
+		if((u32) abs(out[ch] - code) > stats->maxCodeError) { stats->maxCodeError = abs(out[ch] - code); }
+	}
+	stats->n += 3;
+}
+
+double modelTime_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+u32 modelRand(void)
+{
+	modelRandState = modelRandState * 1664525 + 1013904223;
+	return modelRandState >> 8;
+}
@@ -0,0 +1,48 @@
+/*
+Host Shim: Xilinx Cache and Barrier Functions
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef XIL_CACHE_H
+#define XIL_CACHE_H
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// The simulated controller runs in the caller's context. The driver issues a barrier around every doorbell write and
+// completion queue poll, so the data barrier doubles as the point where the controller model advances.
+#define isb() __sync_synchronize()
+#define dsb() nvmeSimPoll()
+
+#define Xil_DCacheFlush()
+#define Xil_DCacheInvalidate()
+#define Xil_DCacheFlushRange(adr, len)
+#define Xil_DCacheInvalidateRange(adr, len)
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+void nvmeSimPoll(void);
+
+#endif
@@ -0,0 +1,381 @@
+/*
+WAVE NVMe Simulator Recording Benchmark
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "xil_printf.h"
+#include "xtime_l.h"
+#include "nvme.h"
+#include "ff.h"
+#include "nvme_sim.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define FH_BUFFER_SIZE 4096
+#define FRAME_HEADER_SIZE 512
+#define US_PER_COUNT (1000000.0 / COUNTS_PER_SECOND)
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	const char * image;
+	const char * profile;
+	u64 capacity_GiB;
+	u8 flbas;
+	u32 nFrames;
+	u32 nFramesPerFile;
+	float frameSize_MB;
+	float fps;
+	u32 nTakes;
+	float tStandby_s;
+	u8 noStandby;
+	u8 optimizeLBA;
+	u32 nSeeks;
+} benchOptions_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void benchUsage(const char * name);
+int benchFormat(u8 optimizeLBA);
+void benchCreateFile(u32 nClip, u32 nFile);
+void benchRecord(const benchOptions_s * opt, u32 nClip);
+void benchSeek(const benchOptions_s * opt, u32 nClip, u8 fastSeek);
+void benchWaitUntil(XTime t);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// Same fixed DDR4 layout as frame.c and encoder.c.
+u8 * fhBuffer = (u8 *)(0x18000000);
+const u32 csBaseAddr[16] = {0x20000000, 0x38000000, 0x3E000000, 0x44000000,
+                            0x4A000000, 0x4D000000, 0x50000000, 0x53000000,
+                            0x56000000, 0x59000000, 0x5C000000, 0x5F000000,
+                            0x62000000, 0x65000000, 0x68000000, 0x6B000000};
+const u32 csFullAddr[16] = {0x37F00000, 0x3DF00000, 0x43F00000, 0x49F00000,
+                            0x4CF00000, 0x4FF00000, 0x52F00000, 0x55F00000,
+                            0x58F00000, 0x5BF00000, 0x5EF00000, 0x61F00000,
+                            0x64F00000, 0x67F00000, 0x6AF00000, 0x6DF00000};
+
+// Same cluster link map table location and size as fs.c.
+DWORD * clmtRead = (DWORD *)(0x10050000);
+#define FS_CLMT_SIZE 0x4000
+
+FATFS fs;
+FIL fil;
+FIL filRead;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+	benchOptions_s opt = {"/tmp/wave_nvmesim.img", "gen3", 256, 0, 2000, 481, 3.15f, 0.0f, 1, 60.0f, 0, 0, 0};
+	const nvmeSimProfile_s * profile;
+	nvmeSimStats_s simStats;
+	int status;
+	int c;
+
+	while((c = getopt(argc, argv, "i:p:c:4Fn:f:m:r:t:s:Sk:h")) != -1)
+	{
+		switch(c)
+		{
+		case 'i': opt.image = optarg; break;
+		case 'p': opt.profile = optarg; break;
+		case 'c': opt.capacity_GiB = strtoull(optarg, NULL, 0); break;
+		case '4': opt.flbas = 1; break;
+		case 'F': opt.optimizeLBA = 1; break;
+		case 'n': opt.nFrames = strtoul(optarg, NULL, 0); break;
+		case 'f': opt.nFramesPerFile = strtoul(optarg, NULL, 0); break;
+		case 'm': opt.frameSize_MB = strtof(optarg, NULL); break;
+		case 'r': opt.fps = strtof(optarg, NULL); break;
+		case 't': opt.nTakes = strtoul(optarg, NULL, 0); break;
+		case 's': opt.tStandby_s = strtof(optarg, NULL); break;
+		case 'S': opt.noStandby = 1; break;
+		case 'k': opt.nSeeks = strtoul(optarg, NULL, 0); break;
+		default: benchUsage(argv[0]); return 1;
+		}
+	}
+
+	profile = nvmeSimFindProfile(opt.profile);
+	if(profile == NULL) { benchUsage(argv[0]); return 1; }
+
+	status = nvmeSimStart(opt.image, opt.capacity_GiB << 30, opt.flbas, profile);
+	if(status != NVME_SIM_OK) { xil_printf("Simulator start failed: 0x%08X\r\n", status); return 1; }
+
+	status = nvmeInit();
+	if(status != NVME_OK) { xil_printf("nvmeInit() failed: 0x%08X\r\n", status); return 1; }
+	xil_printf("NVMe: %llu LBAs of %dB, profile %s, HMB %uMiB.\r\n", (unsigned long long) nvmeGetLBACount(),
+	           nvmeGetLBASize(), profile->name, nvmeGetHMBSize() >> 20);
+
+	if(benchFormat(opt.optimizeLBA)) { return 1; }
+
+	// Camera starts in STANDBY. Each take wakes the SSD, records a clip, and returns to STANDBY.
+	if(!opt.noStandby) { nvmeEnterStandby(); }
+	for(u32 nClip = 0; nClip < opt.nTakes; nClip++)
+	{
+		if(nClip > 0) { nvmeSimSkip((u64)(opt.tStandby_s * 1e9f)); }
+
+		nvmeGetMetrics();
+		nvmeSimGetStats(&simStats);
+		xil_printf("Take %u: SSD at %.1fC in power state %u.\r\n", nClip, simStats.tempNow_C, simStats.powerState);
+
+		if(!opt.noStandby) { nvmeExitStandby(); }
+		benchRecord(&opt, nClip);
+		if(opt.nSeeks)
+		{
+			benchSeek(&opt, nClip, 0);
+			benchSeek(&opt, nClip, 1);
+		}
+		if(!opt.noStandby) { nvmeEnterStandby(); }
+	}
+
+	nvmeSimStop();
+
+	return 0;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+void benchUsage(const char * name)
+{
+	xil_printf("Usage: %s [-p profile] [-i image] [-c capacity GiB] [-4] [-F] [-n frames] [-f frames/file] "
+	           "[-m MB/frame] [-r fps] [-t takes] [-s standby s] [-S] [-k seeks]\r\n", name);
+	xil_printf("  -4  Start with the namespace formatted to 4KiB LBAs.\r\n");
+	xil_printf("  -F  Switch to the best LBA format before building the FAT, as fsFormat(1) does.\r\n");
+	xil_printf("  -r  Pace frames at a fixed rate and report backlog. Default is as fast as possible.\r\n");
+	xil_printf("  -t  Number of takes, separated by -s seconds of STANDBY. -S keeps the SSD at full power.\r\n");
+	xil_printf("  -k  After each take, read frame headers at random offsets in the first file, with and without fast seek.\r\n");
+	xil_printf("Profiles:\r\n");
+	nvmeSimListProfiles();
+}
+
+// Same sequence and parameters as fsFormat().
+int benchFormat(u8 optimizeLBA)
+{
+	FRESULT res;
+	MKFS_PARM opt;
+	static BYTE work[FF_MAX_SS];	// Not on the host stack, which sits above 0x10000000 and would get write slip.
+
+	if(optimizeLBA)
+	{
+		if(nvmeSelectBestLBAFormat() != NVME_OK) { xil_printf("SSD LBA format change failed.\r\n"); return 1; }
+		xil_printf("SSD LBA size: %dB, %llu LBAs.\r\n", nvmeGetLBASize(), (unsigned long long) nvmeGetLBACount());
+	}
+
+	opt.fmt = FM_EXFAT;
+	opt.au_size = 0x100000;
+	opt.align = 1;
+	opt.n_fat = 1;
+	opt.n_root = 0;
+	res = f_mkfs("", &opt, work, sizeof work);
+	if(res) { xil_printf("SSD format failed: %d\r\n", res); return 1; }
+
+	res = f_mount(&fs, "", 1);
+	if(res) { xil_printf("SSD mount failed: %d\r\n", res); return 1; }
+
+	return 0;
+}
+
+// Same sequence as fsCreateFile().
+void benchCreateFile(u32 nClip, u32 nFile)
+{
+	char strWorking[32];
+
+	if(nFile > 0)
+	{
+		f_truncate(&fil);
+		f_close(&fil);
+	}
+
+	sprintf(strWorking, "/c%04u/f%06u.kwv", nClip, nFile);
+	f_open(&fil, strWorking, FA_CREATE_NEW | FA_WRITE);
+	f_expand(&fil, 0x100000000, 0);
+}
+
+// Replay the frameRecord() write pattern: one 512B header plus 16 codestreams per frame from the encoder buffers.
+void benchRecord(const benchOptions_s * opt, u32 nClip)
+{
+	u32 csAddr[16];
+	u32 csSize[16];
+	u32 frameBytes = (u32)(opt->frameSize_MB * 1000000.0f);
+	u8 * fh;
+	UINT bw;
+	XTime tStart, tFrameStart, tFrameEnd, tNow, tFrameMax = 0, tFrameSum = 0;
+	u64 bytesTotal = 0;
+	u32 nFramesIn, backlog, backlogMax = 0;
+	u32 nFile = 0;
+	u32 nWriteErrors = 0;
+	nvmeSimStats_s simStats;
+	const nvmeHistogram_s * hist;
+	double t_s;
+
+	char strWorking[32];
+
+	for(int iCS = 0; iCS < 16; iCS++) { csAddr[iCS] = csBaseAddr[iCS]; }
+	srand(1);
+
+	sprintf(strWorking, "/c%04u", nClip);
+	if(f_mkdir(strWorking)) { xil_printf("Clip folder creation failed.\r\n"); return; }
+
+	nvmeHistogramReset();
+	XTime_GetTime(&tStart);
+	for(u32 nFramesOut = 0; nFramesOut < opt->nFrames; nFramesOut++)
+	{
+		// With a fixed frame rate, wait for the frame to exist and track how far behind the recorder is.
+		if(opt->fps > 0.0f)
+		{
+			benchWaitUntil(tStart + (XTime)((double) nFramesOut * COUNTS_PER_SECOND / opt->fps));
+			XTime_GetTime(&tNow);
+			nFramesIn = (u32)((double)(tNow - tStart) * opt->fps / COUNTS_PER_SECOND) + 1;
+			backlog = nFramesIn - nFramesOut;
+			if(backlog > backlogMax) { backlogMax = backlog; }
+		}
+
+		XTime_GetTime(&tFrameStart);
+
+		// Codestream sizes vary +/-25% around the mean, 16B granularity like the encoder address counters.
+		for(int iCS = 0; iCS < 16; iCS++)
+		{
+			csSize[iCS] = (frameBytes / 16) * (0.75f + 0.5f * (float) rand() / (float) RAND_MAX);
+			csSize[iCS] &= ~0xF;
+			if(csAddr[iCS] + csSize[iCS] > csFullAddr[iCS]) { csAddr[iCS] = csBaseAddr[iCS]; }
+		}
+
+		fh = fhBuffer + (nFramesOut % FH_BUFFER_SIZE) * FRAME_HEADER_SIZE;
+		memset(fh, 0, FRAME_HEADER_SIZE);
+		memcpy(fh, "WAVE HELLO!\n", 12);
+		memcpy(fh + 16, &nFramesOut, sizeof(u32));
+		memcpy(fh + 64, csAddr, sizeof(csAddr));
+		memcpy(fh + 128, csSize, sizeof(csSize));
+
+		if((nFramesOut % opt->nFramesPerFile) == 0)
+		{
+			nvmeGetMetrics();
+			benchCreateFile(nClip, nFile++);
+		}
+
+		if(f_write(&fil, fh, FRAME_HEADER_SIZE, &bw) || (bw != FRAME_HEADER_SIZE)) { nWriteErrors++; }
+		bytesTotal += FRAME_HEADER_SIZE;
+		for(int iCS = 0; iCS < 16; iCS++)
+		{
+			if(f_write(&fil, (u8 *)(u64) csAddr[iCS], csSize[iCS], &bw) || (bw != csSize[iCS])) { nWriteErrors++; }
+			bytesTotal += csSize[iCS];
+			csAddr[iCS] += csSize[iCS];
+		}
+
+		XTime_GetTime(&tFrameEnd);
+		tFrameSum += tFrameEnd - tFrameStart;
+		if((tFrameEnd - tFrameStart) > tFrameMax) { tFrameMax = tFrameEnd - tFrameStart; }
+	}
+
+	f_truncate(&fil);
+	f_close(&fil);
+	XTime_GetTime(&tNow);
+	t_s = (double)(tNow - tStart) / COUNTS_PER_SECOND;
+
+	nvmeGetMetrics();
+	nvmeSimGetStats(&simStats);
+
+	xil_printf("Recorded %u frames in %u files, %.1fMB in %.2fs: %.1fMB/s, %.1ffps.\r\n",
+	           opt->nFrames, nFile, bytesTotal * 1e-6, t_s, bytesTotal * 1e-6 / t_s, opt->nFrames / t_s);
+	xil_printf("Frame write time: mean %.2fms, max %.2fms.\r\n",
+	           tFrameSum * US_PER_COUNT * 1e-3 / opt->nFrames, tFrameMax * US_PER_COUNT * 1e-3);
+	if(opt->fps > 0.0f) { xil_printf("Maximum backlog at %.1ffps: %u frames.\r\n", opt->fps, backlogMax); }
+	xil_printf("Write errors: %u, controller errors: %u.\r\n", nWriteErrors, simStats.nErrors);
+	xil_printf("Controller: %llu writes (%.1fMB), %llu reads, %llu flushes, %llu admin, %llu GC stalls.\r\n",
+	           (unsigned long long) simStats.nWriteCommands, simStats.bytesWritten * 1e-6,
+	           (unsigned long long) simStats.nReadCommands, (unsigned long long) simStats.nFlushCommands,
+	           (unsigned long long) simStats.nAdminCommands, (unsigned long long) simStats.nGCStalls);
+	hist = nvmeGetHistogram();
+	xil_printf("Write latency: p50 <%uus, p99 <%uus, p99.9 <%uus, max %uus over %llu commands.\r\n",
+	           nvmeHistogramPercentile_us(0.5f), nvmeHistogramPercentile_us(0.99f),
+	           nvmeHistogramPercentile_us(0.999f), hist->latencyMax_us, (unsigned long long) hist->nWrites);
+	xil_printf("Write queue depth at submit:");
+	for(int b = 0; b < NVME_HIST_QD_BINS; b++) { if(hist->queueDepth[b]) { xil_printf(" %d:%u", b, hist->queueDepth[b]); } }
+	xil_printf("\r\n");
+	xil_printf("Temperature: now %.1fC, max %.1fC, throttled %.2fs, SMART %.1fC, power state %u.\r\n",
+	           simStats.tempNow_C, simStats.tempMax_C, simStats.tThrottled_us * 1e-6, nvmeGetTemp(),
+	           simStats.powerState);
+}
+
+// Random seeks plus one header-sized read in the clip's first file, as a playback scrub would do.
+// With fastSeek, the file is opened the same way as fsOpenClipFile(): with a cluster link map table.
+void benchSeek(const benchOptions_s * opt, u32 nClip, u8 fastSeek)
+{
+	char strWorking[32];
+	u8 * dest = fhBuffer;
+	FSIZE_t offset;
+	XTime tStart, tEnd;
+	nvmeSimStats_s statsStart, statsEnd;
+	UINT br;
+	u32 nErrors = 0;
+
+	sprintf(strWorking, "/c%04u/f%06u.kwv", nClip, 0);
+	if(f_open(&filRead, strWorking, FA_READ) != FR_OK) { xil_printf("Clip file open failed.\r\n"); return; }
+
+	if(fastSeek)
+	{
+		clmtRead[0] = FS_CLMT_SIZE;
+		filRead.cltbl = clmtRead;
+		if(f_lseek(&filRead, CREATE_LINKMAP) != FR_OK) { filRead.cltbl = 0; }
+	}
+
+	srand(2);
+	nvmeSimGetStats(&statsStart);
+	XTime_GetTime(&tStart);
+	for(u32 i = 0; i < opt->nSeeks; i++)
+	{
+		offset = ((FSIZE_t)((double) rand() / RAND_MAX * (f_size(&filRead) - FRAME_HEADER_SIZE))) & ~(FSIZE_t) 0x1FF;
+		if(f_lseek(&filRead, offset) != FR_OK) { nErrors++; }
+		if(f_read(&filRead, dest, FRAME_HEADER_SIZE, &br) || (br != FRAME_HEADER_SIZE)) { nErrors++; }
+	}
+	XTime_GetTime(&tEnd);
+	nvmeSimGetStats(&statsEnd);
+
+	xil_printf("%s seek: %u seeks in %.1fMB, mean %.1fus, %.2f reads/seek, %u errors, link map %s.\r\n",
+	           fastSeek ? "Fast" : "FAT", opt->nSeeks, f_size(&filRead) * 1e-6,
+	           (tEnd - tStart) * US_PER_COUNT / opt->nSeeks,
+	           (double)(statsEnd.nReadCommands - statsStart.nReadCommands) / opt->nSeeks, nErrors,
+	           filRead.cltbl ? "used" : "not used");
+
+	f_close(&filRead);
+}
+
+void benchWaitUntil(XTime t)
+{
+	XTime tNow;
+
+	do
+	{
+		nvmeServiceIOCompletions(16);
+		XTime_GetTime(&tNow);
+	}
+	while(tNow < t);
+}
@@ -0,0 +1,956 @@
+/*
+WAVE NVMe Controller Simulator
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "nvme.h"
+#include "nvme_priv.h"
+#include "xtime_l.h"
+#include "nvme_sim.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Fixed address windows that the firmware dereferences directly. They are reproduced at the same virtual addresses.
+#define SIM_DDR_BASE        0x10000000ULL       // Queues, identify structures, PRP heap, frame headers, codestreams, USB
+#define SIM_DDR_SIZE        0x70000000ULL
+#define SIM_BAR_BASE        0xB0000000ULL       // NVMe controller registers
+#define SIM_BAR_SIZE        0x2000ULL
+#define SIM_BRIDGE_BASE     0x500000000ULL      // AXI/PCIe bridge PHY and root port registers
+#define SIM_CFG_BASE        0x500100000ULL      // Endpoint configuration space
+#define SIM_PAGE_SIZE       0x1000ULL
+
+// Controller register offsets within the BAR.
+#define SIM_REG_CAP         0x00
+#define SIM_REG_VS          0x08
+#define SIM_REG_CC          0x14
+#define SIM_REG_CSTS        0x1C
+#define SIM_REG_AQA         0x24
+#define SIM_REG_ASQ         0x28
+#define SIM_REG_ACQ         0x30
+#define SIM_REG_SQ0TDBL     0x1000
+#define SIM_REG_CQ0HDBL     0x1004
+#define SIM_REG_SQ1TDBL     0x1008
+#define SIM_REG_CQ1HDBL     0x100C
+
+#define SIM_MQES            0x3FF               // Maximum Queue Entries Supported (0's Based)
+#define SIM_MDTS            9                   // 2MiB, the span of one PRP list page in nvme.c
+#define SIM_NPSS            4                   // Five power states, PS3 and PS4 non-operational
+#define SIM_PENDING_SIZE    256                 // In-flight I/O commands awaiting completion
+#define SIM_NO_HMB_FACTOR   0.35f               // Bandwidth multiplier for a drive that requested but has no HMB
+#define SIM_IDLE_RISE_C     12.0f               // Idle temperature rise above ambient in PS0 [C], scaled by state power
+
+// Status Field = (SCT << 8 | SC), shifted into place above the phase bit when posted.
+#define SIM_SC_SUCCESS              0x000
+#define SIM_SC_INVALID_OPCODE       0x001
+#define SIM_SC_INVALID_FIELD        0x002
+#define SIM_SC_INVALID_NAMESPACE    0x00B
+#define SIM_SC_LBA_OUT_OF_RANGE     0x080
+#define SIM_SC_CQ_INVALID           0x100
+#define SIM_SC_INVALID_QID          0x101
+#define SIM_SC_INVALID_QSIZE        0x102
+#define SIM_SC_INVALID_LOG_PAGE     0x109
+#define SIM_SC_DATA_TRANSFER_ERROR  0x004
+#define SIM_SC_UNRECOVERED_READ     0x281
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	u64 base;
+	u16 size;
+	u16 head;
+	u16 tail;
+	u8 phase;
+	u8 valid;
+} simQueue_s;
+
+typedef struct
+{
+	u64 tComplete_ns;
+	u16 CID;
+	u16 status;
+	u32 CDW0;
+} simPending_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+int simMapWindow(u64 base, u64 size);
+void simBuildIdentify(void);
+void simSetPowerStateDescriptor(u8 * psd, u16 mp, u8 mxps, u8 nops, u32 enlat, u32 exlat, u8 rel);
+void simReset(void);
+
+void simServiceController(void);
+void simServiceAdmin(void);
+void simServiceIO(void);
+void simServiceCompletions(void);
+void simServiceThermal(u64 tNow_ns);
+void simServiceAPST(u64 tNow_ns);
+
+u16 simExecAdmin(const sqe_prp_type * sqe, u32 * cdw0);
+u16 simSetHostMemoryBuffer(const sqe_prp_type * sqe);
+u16 simFormatNVM(const sqe_prp_type * sqe);
+u16 simExecIO(const sqe_prp_type * sqe, u64 * tComplete_ns);
+int simTransfer(u64 prp1, u64 prp2, u64 offset, u64 bytes, int write);
+int simSegment(u64 addr, u64 len, u64 * offset, int write);
+int simCopyOut(u64 addr, const void * src, u64 bytes);
+int simPostCompletion(simQueue_s * cq, u16 sqhd, u16 sqid, u16 cid, u16 status, u32 cdw0);
+
+u64 simWallTime(void);
+u64 simTime(void);
+float simBandwidthFactor(void);
+float simPowerStateMax_W(u8 ps);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+const nvmeSimProfile_s simProfiles[] =
+{
+	// name        wr MB/s  rd MB/s  wr us   rd us  flush us  gc MiB    gc ms   amb C  C/GiB   tau s  thr C  factor  HMPRE   HMMIN
+	{"ideal",         0.0f,    0.0f,  0.0f,  0.0f,     0.0f,    0.0f,   0.0f, 40.0f, 0.00f, 120.0f, 70.0f, 1.00f,      0,      0},
+	{"gen3",       2400.0f, 3200.0f, 20.0f, 80.0f,   200.0f,    0.0f,   0.0f, 40.0f, 0.05f, 120.0f, 70.0f, 1.00f,      0,      0},
+	{"dramless",   1500.0f, 2000.0f, 30.0f, 90.0f,   500.0f, 1024.0f,  60.0f, 40.0f, 0.05f, 120.0f, 70.0f, 1.00f, 0x2000, 0x0800},
+	{"hot",        2400.0f, 3200.0f, 20.0f, 80.0f,   200.0f,    0.0f,   0.0f, 45.0f, 4.00f, 120.0f, 70.0f, 0.35f,      0,      0},
+};
+
+const nvmeSimProfile_s * profile = NULL;
+
+// Controller registers and the host-visible identify data it returns.
+u8 * bar = NULL;
+idController_type simIdController;
+idNamespace_type simIdNamespace;
+logSMARTHealth_type simLogSMART;
+u32 features[256];
+
+// Queue state as seen from the controller side.
+simQueue_s simASQ, simACQ, simIOSQ, simIOCQ;
+simPending_s pending[SIM_PENDING_SIZE];
+u16 pendingHead = 0;
+u16 pendingCount = 0;
+u64 tLastComplete_ns = 0;
+
+// Backing store.
+int fdImage = -1;
+u64 nsze = 0;
+u8 simLBAExp = 9;
+
+// Timing and thermal model. The simulated clock excludes time spent moving data to and from the image file.
+u64 tOverhead_ns = 0;
+u64 tBusyUntil_ns = 0;
+u64 tThermal_ns = 0;
+u64 gcBytes = 0;
+float tempC = 0.0f;
+u8 psLastOperational = 0;
+u32 hmbSize = 0;                                // Enabled Host Memory Buffer [4KiB]
+u64 simAPSTTable[32];
+u64 tLastActivity_ns = 0;
+
+nvmeSimStats_s stats;
+u8 inPoll = 0;
+
+// Reads touching these LBAs fail with Unrecovered Read Error.
+u64 failLBAFirst = 0;
+u64 failLBACount = 0;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+const nvmeSimProfile_s * nvmeSimFindProfile(const char * name)
+{
+	for(u32 i = 0; i < sizeof(simProfiles) / sizeof(nvmeSimProfile_s); i++)
+	{
+		if(strcmp(simProfiles[i].name, name) == 0) { return &simProfiles[i]; }
+	}
+
+	return NULL;
+}
+
+void nvmeSimListProfiles(void)
+{
+	for(u32 i = 0; i < sizeof(simProfiles) / sizeof(nvmeSimProfile_s); i++)
+	{
+		printf("  %-10s write %6.0fMB/s, read %6.0fMB/s, GC every %5.0fMiB, throttle x%.2f above %.0fC\r\n",
+		       simProfiles[i].name, simProfiles[i].bwWrite_MBps, simProfiles[i].bwRead_MBps,
+		       simProfiles[i].gcInterval_MiB, simProfiles[i].throttleFactor, simProfiles[i].tThrottle_C);
+	}
+}
+
+int nvmeSimStart(const char * imagePath, u64 capacity_B, u8 flbas, const nvmeSimProfile_s * simProfile)
+{
+	if(simProfile == NULL) { return NVME_SIM_ERROR_PROFILE; }
+	profile = simProfile;
+
+	if(simMapWindow(SIM_DDR_BASE, SIM_DDR_SIZE)) { return NVME_SIM_ERROR_MAP; }
+	if(simMapWindow(SIM_BAR_BASE, SIM_BAR_SIZE)) { return NVME_SIM_ERROR_MAP; }
+	if(simMapWindow(SIM_BRIDGE_BASE, SIM_PAGE_SIZE)) { return NVME_SIM_ERROR_MAP; }
+	if(simMapWindow(SIM_CFG_BASE, SIM_PAGE_SIZE)) { return NVME_SIM_ERROR_MAP; }
+
+	fdImage = open(imagePath, O_RDWR | O_CREAT, 0644);
+	if(fdImage < 0) { return NVME_SIM_ERROR_IMAGE; }
+	if(ftruncate(fdImage, capacity_B)) { return NVME_SIM_ERROR_IMAGE; }
+
+	// Bridge: Gen3 x4 link up, endpoint reports the NVMe class code.
+	*(u32 *)(SIM_BRIDGE_BASE + 0x144) = PHY_OK;
+	*(u32 *)(SIM_CFG_BASE + 0x008) = (CLASS_CODE_OK << 8) | 0x01;
+
+	bar = (u8 *)(SIM_BAR_BASE);
+	*(u64 *)(bar + SIM_REG_CAP) = (1ULL << REG_CAP_CCS_Pos) | (0x14ULL << REG_CAP_TO_Pos) | REG_CAP_CQR | SIM_MQES;
+	*(u32 *)(bar + SIM_REG_VS) = 0x00010400;
+
+	simLBAExp = (flbas == 1) ? 12 : 9;
+	nsze = capacity_B >> simLBAExp;
+	simBuildIdentify();
+	simIdNamespace.FLBAS = flbas;
+
+	memset(features, 0, sizeof(features));
+	memset(&stats, 0, sizeof(stats));
+	tempC = profile->tAmbient_C;
+	stats.tempNow_C = tempC;
+	stats.tempMax_C = tempC;
+	tThermal_ns = simTime();
+	tLastActivity_ns = simTime();
+
+	simReset();
+
+	return NVME_SIM_OK;
+}
+
+void nvmeSimStop(void)
+{
+	if(fdImage >= 0)
+	{
+		fsync(fdImage);
+		close(fdImage);
+		fdImage = -1;
+	}
+}
+
+void nvmeSimGetStats(nvmeSimStats_s * simStats)
+{
+	*simStats = stats;
+}
+
+// Reads of any of the nBlocks LBAs from lba on complete with Unrecovered Read Error. nBlocks = 0 ends the failures.
+void nvmeSimFailReads(u64 lba, u64 nBlocks)
+{
+	failLBAFirst = lba;
+	failLBACount = nBlocks;
+}
+
+// Advance the controller model. Called from every data barrier and timer read the driver makes.
+void nvmeSimPoll(void)
+{
+	__sync_synchronize();
+	if((bar == NULL) || inPoll) { return; }
+	inPoll = 1;
+
+	simServiceController();
+	if(*(u32 *)(bar + SIM_REG_CSTS) & REG_CSTS_RDY)
+	{
+		simServiceAdmin();
+		simServiceIO();
+		simServiceCompletions();
+	}
+	simServiceAPST(simTime());
+	simServiceThermal(simTime());
+
+	inPoll = 0;
+	__sync_synchronize();
+}
+
+// Let simulated time pass without running the host, e.g. for the camera sitting in STANDBY.
+void nvmeSimSkip(u64 t_ns)
+{
+	u64 tStep_ns = 100000000;
+
+	while(t_ns > 0)
+	{
+		if(tStep_ns > t_ns) { tStep_ns = t_ns; }
+		tOverhead_ns -= tStep_ns;
+		t_ns -= tStep_ns;
+		nvmeSimPoll();
+	}
+}
+
+void XTime_GetTime(XTime * Xtime_Global)
+{
+	nvmeSimPoll();
+	*Xtime_Global = simTime();
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+int simMapWindow(u64 base, u64 size)
+{
+	void * p = mmap((void *) base, size, PROT_READ | PROT_WRITE,
+	                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0);
+	if(p != (void *) base)
+	{
+		printf("Unable to map 0x%09llX-0x%09llX. Build with -no-pie.\r\n",
+		       (unsigned long long) base, (unsigned long long)(base + size));
+		return 1;
+	}
+
+	return 0;
+}
+
+void simBuildIdentify(void)
+{
+	memset(&simIdController, 0, sizeof(simIdController));
+	simIdController.VID = 0x1D1D;
+	simIdController.SSVID = 0x1D1D;
+	memcpy(simIdController.SN, "SIM0000000000001    ", 20);
+	memset(simIdController.MN, ' ', 40);
+	memcpy(simIdController.MN, "WAVE NVMe Simulator ", 20);
+	memcpy(simIdController.MN + 20, profile->name, strlen(profile->name) < 20 ? strlen(profile->name) : 20);
+	memcpy(simIdController.FR, "1.0     ", 8);
+	simIdController.MDTS = SIM_MDTS;
+	simIdController.VER = 0x00010400;
+	simIdController.OACS = OACS_FORMAT_NVM;
+	simIdController.NPSS = SIM_NPSS;
+	simIdController.APSTA = 0x01;
+	simIdController.WCTEMP = (u16)(profile->tThrottle_C + 273.15f);
+	simIdController.CCTEMP = (u16)(profile->tThrottle_C + 15.0f + 273.15f);
+	simIdController.HMPRE = profile->HMPRE;
+	simIdController.HMMIN = profile->HMMIN;
+	simIdController.TNVMCAP_L = nsze << simLBAExp;
+	simIdController.SQES = 0x66;
+	simIdController.CQES = 0x44;
+	simIdController.MAXCMD = SIM_MQES + 1;
+	simIdController.NN = 1;
+	simIdController.VWC = 0x01;
+
+	// Three operational states scaled by maximum power, two non-operational idle states.
+	simSetPowerStateDescriptor(simIdController.PSD0 + 0 * 32, 800, 0, 0, 0, 0, 0);
+	simSetPowerStateDescriptor(simIdController.PSD0 + 1 * 32, 600, 0, 0, 0, 0, 1);
+	simSetPowerStateDescriptor(simIdController.PSD0 + 2 * 32, 450, 0, 0, 0, 0, 2);
+	simSetPowerStateDescriptor(simIdController.PSD0 + 3 * 32, 700, 1, 1, 210, 1200, 3);
+	simSetPowerStateDescriptor(simIdController.PSD0 + 4 * 32, 50, 1, 1, 2000, 8000, 4);
+
+	memset(&simIdNamespace, 0, sizeof(simIdNamespace));
+	simIdNamespace.NSZE = nsze;
+	simIdNamespace.NCAP = nsze;
+	simIdNamespace.NUSE = nsze;
+	simIdNamespace.NLBAF = 1;                           // Two formats (0's Based)
+	simIdNamespace.LBAF[0] = (0x2 << 24) | (9 << 16);   // 512B, Relative Performance: Good
+	simIdNamespace.LBAF[1] = (0x0 << 24) | (12 << 16);  // 4KiB, Relative Performance: Best
+	simIdNamespace.NVMCAP_L = nsze << simLBAExp;
+	simIdNamespace.NOWS = ((128 * 1024) >> simLBAExp) - 1;
+}
+
+void simSetPowerStateDescriptor(u8 * psd, u16 mp, u8 mxps, u8 nops, u32 enlat, u32 exlat, u8 rel)
+{
+	memcpy(psd + PSD_MXPS_Offset, &mp, 2);
+	psd[3] = (mxps ? 0x01 : 0x00) | (nops ? 0x02 : 0x00);
+	memcpy(psd + PSD_ENLAT_Offset, &enlat, 4);
+	memcpy(psd + PSD_EXLAT_Offset, &exlat, 4);
+	psd[PSD_RXX_Offset + 0] = rel;
+	psd[PSD_RXX_Offset + 1] = rel;
+	psd[PSD_RXX_Offset + 2] = rel;
+	psd[PSD_RXX_Offset + 3] = rel;
+}
+
+void simReset(void)
+{
+	memset(&simASQ, 0, sizeof(simQueue_s));
+	memset(&simACQ, 0, sizeof(simQueue_s));
+	memset(&simIOSQ, 0, sizeof(simQueue_s));
+	memset(&simIOCQ, 0, sizeof(simQueue_s));
+	pendingHead = 0;
+	pendingCount = 0;
+	tLastComplete_ns = 0;
+}
+
+// Controller enable, disable, and shutdown handshakes.
+void simServiceController(void)
+{
+	u32 cc = *(volatile u32 *)(bar + SIM_REG_CC);
+	u32 csts = *(volatile u32 *)(bar + SIM_REG_CSTS);
+	u32 aqa;
+
+	if((cc & REG_CC_EN) && !(csts & REG_CSTS_RDY))
+	{
+		simReset();
+		aqa = *(u32 *)(bar + SIM_REG_AQA);
+		simASQ.base = *(u64 *)(bar + SIM_REG_ASQ);
+		simASQ.size = (aqa & 0xFFF) + 1;
+		simASQ.valid = 1;
+		simACQ.base = *(u64 *)(bar + SIM_REG_ACQ);
+		simACQ.size = ((aqa >> 16) & 0xFFF) + 1;
+		simACQ.phase = 1;
+		simACQ.valid = 1;
+		csts |= REG_CSTS_RDY;
+	}
+	else if(!(cc & REG_CC_EN) && (csts & REG_CSTS_RDY))
+	{
+		simReset();
+		csts &= ~(REG_CSTS_RDY | REG_CSTS_SHST_Msk);
+	}
+
+	if((cc & REG_CC_SHN_Msk) && !(csts & REG_CSTS_SHST_Msk))
+	{
+		fsync(fdImage);
+		csts |= (0x2 << REG_CSTS_SHST_Pos);
+	}
+
+	*(volatile u32 *)(bar + SIM_REG_CSTS) = csts;
+}
+
+// Admin commands complete immediately.
+void simServiceAdmin(void)
+{
+	sqe_prp_type sqe;
+	u16 status;
+	u32 cdw0;
+	u16 tail = *(volatile u32 *)(bar + SIM_REG_SQ0TDBL) % simASQ.size;
+
+	simACQ.head = *(volatile u32 *)(bar + SIM_REG_CQ0HDBL) % simACQ.size;
+	while((simASQ.head != tail) && (((simACQ.tail + 1) % simACQ.size) != simACQ.head))
+	{
+		memcpy(&sqe, (void *)(simASQ.base + simASQ.head * sizeof(sqe_prp_type)), sizeof(sqe_prp_type));
+		simASQ.head = (simASQ.head + 1) % simASQ.size;
+
+		cdw0 = 0;
+		status = simExecAdmin(&sqe, &cdw0);
+		simPostCompletion(&simACQ, simASQ.head, 0, sqe.CID, status, cdw0);
+		stats.nAdminCommands++;
+	}
+}
+
+// I/O commands move data at fetch time and are completed later, in order, per the timing model.
+void simServiceIO(void)
+{
+	sqe_prp_type sqe;
+	simPending_s * p;
+	u64 tComplete_ns;
+	u16 tail;
+
+	if(!simIOSQ.valid) { return; }
+
+	tail = *(volatile u32 *)(bar + SIM_REG_SQ1TDBL) % simIOSQ.size;
+	while((simIOSQ.head != tail) && (pendingCount < SIM_PENDING_SIZE))
+	{
+		memcpy(&sqe, (void *)(simIOSQ.base + simIOSQ.head * sizeof(sqe_prp_type)), sizeof(sqe_prp_type));
+		simIOSQ.head = (simIOSQ.head + 1) % simIOSQ.size;
+
+		p = &pending[(pendingHead + pendingCount) % SIM_PENDING_SIZE];
+		p->CID = sqe.CID;
+		p->CDW0 = 0;
+		p->status = simExecIO(&sqe, &tComplete_ns);
+		tLastActivity_ns = tComplete_ns;
+
+		// Completions are posted in submission order, which the driver's slip accounting relies on.
+		if(tComplete_ns < tLastComplete_ns) { tComplete_ns = tLastComplete_ns; }
+		tLastComplete_ns = tComplete_ns;
+		p->tComplete_ns = tComplete_ns;
+		pendingCount++;
+	}
+}
+
+void simServiceCompletions(void)
+{
+	simPending_s * p;
+	u64 tNow_ns = simTime();
+
+	if(!simIOCQ.valid) { return; }
+
+	simIOCQ.head = *(volatile u32 *)(bar + SIM_REG_CQ1HDBL) % simIOCQ.size;
+	while(pendingCount > 0)
+	{
+		p = &pending[pendingHead];
+		if(p->tComplete_ns > tNow_ns) { break; }
+		if(simPostCompletion(&simIOCQ, simIOSQ.head, 1, p->CID, p->status, p->CDW0)) { break; }
+
+		pendingHead = (pendingHead + 1) % SIM_PENDING_SIZE;
+		pendingCount--;
+	}
+}
+
+// Exponential settling toward the power state's idle temperature, heating is added per byte in simExecIO().
+void simServiceThermal(u64 tNow_ns)
+{
+	float dt_s;
+	float tIdle_C = profile->tAmbient_C + SIM_IDLE_RISE_C * simPowerStateMax_W(features[0x02] & 0x1F) / simPowerStateMax_W(0);
+
+	if(tNow_ns <= tThermal_ns) { return; }
+	dt_s = (float)(tNow_ns - tThermal_ns) * 1e-9f;
+	if(dt_s < 0.001f) { return; }
+
+	if(tempC > profile->tThrottle_C) { stats.tThrottled_us += (tNow_ns - tThermal_ns) / 1000; }
+	tempC = tIdle_C + (tempC - tIdle_C) * expf(-dt_s / profile->tauCool_s);
+	tThermal_ns = tNow_ns;
+
+	stats.tempNow_C = tempC;
+	if(tempC > stats.tempMax_C) { stats.tempMax_C = tempC; }
+}
+
+// Autonomous transition once the controller has been idle for the current state's Idle Time Prior to Transition.
+void simServiceAPST(u64 tNow_ns)
+{
+	u8 ps = features[0x02] & 0x1F;
+	u64 tIdle_ns = (u64)((simAPSTTable[ps] >> 8) & 0xFFFFFF) * 1000000;
+
+	if(!(features[0x0C] & 0x1) || (pendingCount > 0) || (tIdle_ns == 0)) { return; }
+	if(tNow_ns < tLastActivity_ns + tIdle_ns) { return; }
+
+	features[0x02] = (features[0x02] & ~0x1F) | ((simAPSTTable[ps] >> 3) & 0x1F);
+	stats.powerState = features[0x02] & 0x1F;
+	tLastActivity_ns = tNow_ns;
+}
+
+u16 simExecAdmin(const sqe_prp_type * sqe, u32 * cdw0)
+{
+	u8 cns, fid, lid;
+	u32 nBytes;
+	u32 nsList[1024];
+
+	switch(sqe->OPC)
+	{
+	case 0x06:	// Identify
+		cns = sqe->CDW10 & 0xFF;
+		switch(cns)
+		{
+		case 0x00:
+			if(sqe->NSID != 1) { return SIM_SC_INVALID_NAMESPACE; }
+			simCopyOut(sqe->PRP1, &simIdNamespace, sizeof(simIdNamespace));
+			return SIM_SC_SUCCESS;
+		case 0x01:
+			simCopyOut(sqe->PRP1, &simIdController, sizeof(simIdController));
+			return SIM_SC_SUCCESS;
+		case 0x02:
+			memset(nsList, 0, sizeof(nsList));
+			nsList[0] = 1;
+			simCopyOut(sqe->PRP1, nsList, sizeof(nsList));
+			return SIM_SC_SUCCESS;
+		default:
+			return SIM_SC_INVALID_FIELD;
+		}
+
+	case 0x05:	// Create I/O Completion Queue
+		if((sqe->CDW10 & 0xFFFF) != 1) { return SIM_SC_INVALID_QID; }
+		if((sqe->CDW10 >> 16) > SIM_MQES) { return SIM_SC_INVALID_QSIZE; }
+		if((sqe->CDW11 & 0x1) == 0) { return SIM_SC_INVALID_FIELD; }
+		simIOCQ.base = sqe->PRP1;
+		simIOCQ.size = (sqe->CDW10 >> 16) + 1;
+		simIOCQ.head = 0;
+		simIOCQ.tail = 0;
+		simIOCQ.phase = 1;
+		simIOCQ.valid = 1;
+		return SIM_SC_SUCCESS;
+
+	case 0x01:	// Create I/O Submission Queue
+		if((sqe->CDW10 & 0xFFFF) != 1) { return SIM_SC_INVALID_QID; }
+		if((sqe->CDW10 >> 16) > SIM_MQES) { return SIM_SC_INVALID_QSIZE; }
+		if(((sqe->CDW11 >> 16) != 1) || !simIOCQ.valid) { return SIM_SC_CQ_INVALID; }
+		simIOSQ.base = sqe->PRP1;
+		simIOSQ.size = (sqe->CDW10 >> 16) + 1;
+		simIOSQ.head = 0;
+		simIOSQ.valid = 1;
+		return SIM_SC_SUCCESS;
+
+	case 0x02:	// Get Log Page
+		lid = sqe->CDW10 & 0xFF;
+		nBytes = ((sqe->CDW10 >> 16) + 1) * 4;
+		if(lid != 0x02) { return SIM_SC_INVALID_LOG_PAGE; }
+		if(nBytes > sizeof(simLogSMART)) { nBytes = sizeof(simLogSMART); }
+		memset(&simLogSMART, 0, sizeof(simLogSMART));
+		simLogSMART.Critical_Warning = (tempC > profile->tThrottle_C) ? 0x02 : 0x00;
+		simLogSMART.Composite_Temperature = (u16)(tempC + 273.15f);
+		simLogSMART.Available_Spare = 100;
+		simLogSMART.Available_Spare_Threshold = 10;
+		simLogSMART.Data_Units_Read_L = (stats.bytesRead + 511999) / 512000;
+		simLogSMART.Data_Units_Written_L = (stats.bytesWritten + 511999) / 512000;
+		simLogSMART.Host_Read_Commands_L = stats.nReadCommands;
+		simLogSMART.Host_Write_Commands_L = stats.nWriteCommands;
+		simLogSMART.Power_Cycles_L = 1;
+		simLogSMART.Warning_Composite_Temperature_Time = stats.tThrottled_us / 60000000;
+		simLogSMART.Temperature_Sensor[0] = simLogSMART.Composite_Temperature;
+		simCopyOut(sqe->PRP1, &simLogSMART, nBytes);
+		return SIM_SC_SUCCESS;
+
+	case 0x09:	// Set Features
+		fid = sqe->CDW10 & 0xFF;
+		if(fid == 0x02)
+		{
+			if((sqe->CDW11 & 0x1F) > SIM_NPSS) { return SIM_SC_INVALID_FIELD; }
+			if(!(simIdController.PSD0[(sqe->CDW11 & 0x1F) * 32 + 3] & 0x02)) { psLastOperational = sqe->CDW11 & 0x1F; }
+			stats.powerState = sqe->CDW11 & 0x1F;
+		}
+		else if(fid == 0x0C)
+		{
+			if(!(simIdController.APSTA & 0x01)) { return SIM_SC_INVALID_FIELD; }
+			if(sqe->CDW11 & 0x1) { memcpy(simAPSTTable, (void *) sqe->PRP1, sizeof(simAPSTTable)); }
+			tLastActivity_ns = simTime();
+		}
+		else if(fid == 0x0D)
+		{
+			return simSetHostMemoryBuffer(sqe);
+		}
+		features[fid] = sqe->CDW11;
+		*cdw0 = sqe->CDW11;
+		return SIM_SC_SUCCESS;
+
+	case 0x0A:	// Get Features
+		fid = sqe->CDW10 & 0xFF;
+		*cdw0 = features[fid];
+		return SIM_SC_SUCCESS;
+
+	case 0x80:	// Format NVM
+		return simFormatNVM(sqe);
+
+	default:
+		return SIM_SC_INVALID_OPCODE;
+	}
+}
+
+u16 simSetHostMemoryBuffer(const sqe_prp_type * sqe)
+{
+	const hmbDescriptor_type * list = (const hmbDescriptor_type *)(((u64) sqe->CDW14 << 32) | sqe->CDW13);
+	u64 total = 0;
+
+	// Memory Return or disable: the controller keeps nothing in host memory.
+	if((sqe->CDW11 & 0x1) == 0)
+	{
+		hmbSize = 0;
+		features[0x0D] = 0;
+		return SIM_SC_SUCCESS;
+	}
+
+	if((simIdController.HMPRE == 0) || (sqe->CDW15 == 0)) { return SIM_SC_INVALID_FIELD; }
+	if(((u64) list & 0xF) || ((u64) list < SIM_DDR_BASE) || ((u64) list >= SIM_DDR_BASE + SIM_DDR_SIZE))
+	{
+		return SIM_SC_INVALID_FIELD;
+	}
+
+	for(u32 i = 0; i < sqe->CDW15; i++)
+	{
+		if(list[i].BADD & (SIM_PAGE_SIZE - 1)) { return SIM_SC_INVALID_FIELD; }
+		if((list[i].BADD < SIM_DDR_BASE) ||
+		   (list[i].BADD + ((u64) list[i].BSIZE << 12) > SIM_DDR_BASE + SIM_DDR_SIZE)) { return SIM_SC_INVALID_FIELD; }
+		total += list[i].BSIZE;
+	}
+	if((total != sqe->CDW12) || (total < simIdController.HMMIN)) { return SIM_SC_INVALID_FIELD; }
+
+	hmbSize = sqe->CDW12;
+	features[0x0D] = sqe->CDW11;
+	stats.hmbSize_B = (u64) hmbSize << 12;
+
+	return SIM_SC_SUCCESS;
+}
+
+// Switch LBA format and discard all data. The capacity in bytes is unchanged.
+u16 simFormatNVM(const sqe_prp_type * sqe)
+{
+	u8 lbaf = sqe->CDW10 & FLBAS_FORMAT_Msk;
+	u64 capacity_B = nsze << simLBAExp;
+
+	if((sqe->NSID != 1) && (sqe->NSID != 0xFFFFFFFF)) { return SIM_SC_INVALID_NAMESPACE; }
+	if(lbaf > simIdNamespace.NLBAF) { return SIM_SC_INVALID_FIELD; }
+	if(sqe->CDW10 & 0xFF0) { return SIM_SC_INVALID_FIELD; }	// No metadata, protection, or secure erase.
+	if(pendingCount > 0) { return SIM_SC_INVALID_FIELD; }
+
+	if(ftruncate(fdImage, 0) || ftruncate(fdImage, capacity_B)) { return SIM_SC_DATA_TRANSFER_ERROR; }
+
+	simLBAExp = (simIdNamespace.LBAF[lbaf] & LBAF_LBADS_Msk) >> LBAF_LBADS_Pos;
+	nsze = capacity_B >> simLBAExp;
+	simIdNamespace.FLBAS = lbaf;
+	simIdNamespace.NSZE = nsze;
+	simIdNamespace.NCAP = nsze;
+	simIdNamespace.NUSE = nsze;
+	simIdNamespace.NOWS = ((128 * 1024) >> simLBAExp) - 1;
+
+	return SIM_SC_SUCCESS;
+}
+
+u16 simExecIO(const sqe_prp_type * sqe, u64 * tComplete_ns)
+{
+	u64 tNow_ns = simTime();
+	u64 tStart_ns;
+	u64 slba = ((u64) sqe->CDW11 << 32) | sqe->CDW10;
+	u64 nlb = (sqe->CDW12 & 0xFFFF) + 1;
+	u64 bytes = nlb << simLBAExp;
+	u8 ps = features[0x02] & 0x1F;
+	float bw_MBps;
+	float tLatency_us;
+	u32 exlat;
+
+	*tComplete_ns = tNow_ns;
+	if(sqe->NSID != 1) { stats.nErrors++; return SIM_SC_INVALID_NAMESPACE; }
+
+	// I/O in a non-operational state returns the controller to the last operational state after the exit latency.
+	tStart_ns = (tNow_ns > tBusyUntil_ns) ? tNow_ns : tBusyUntil_ns;
+	if(simIdController.PSD0[ps * 32 + 3] & 0x02)
+	{
+		memcpy(&exlat, simIdController.PSD0 + ps * 32 + PSD_EXLAT_Offset, 4);
+		tStart_ns += (u64) exlat * 1000;
+		features[0x02] = (features[0x02] & ~0x1F) | psLastOperational;
+		stats.powerState = psLastOperational;
+	}
+
+	switch(sqe->OPC)
+	{
+	case 0x00:	// Flush
+		stats.nFlushCommands++;
+		fdatasync(fdImage);
+		*tComplete_ns = tStart_ns + (u64)(profile->tFlush_us * 1000.0f);
+		return SIM_SC_SUCCESS;
+
+	case 0x01:	// Write
+	case 0x02:	// Read
+		if((slba + nlb) > nsze) { stats.nErrors++; return SIM_SC_LBA_OUT_OF_RANGE; }
+		if(bytes > (SIM_PAGE_SIZE << SIM_MDTS)) { stats.nErrors++; return SIM_SC_INVALID_FIELD; }
+		if((sqe->OPC == 0x02) && (slba < failLBAFirst + failLBACount) && (slba + nlb > failLBAFirst))
+		{
+			stats.nErrors++;
+			return SIM_SC_UNRECOVERED_READ;
+		}
+		if(simTransfer(sqe->PRP1, sqe->PRP2, slba << simLBAExp, bytes, sqe->OPC == 0x01))
+		{
+			stats.nErrors++;
+			return SIM_SC_DATA_TRANSFER_ERROR;
+		}
+
+		if(sqe->OPC == 0x01)
+		{
+			stats.nWriteCommands++;
+			stats.bytesWritten += bytes;
+			bw_MBps = profile->bwWrite_MBps;
+			tLatency_us = profile->tWrite_us;
+		}
+		else
+		{
+			stats.nReadCommands++;
+			stats.bytesRead += bytes;
+			bw_MBps = profile->bwRead_MBps;
+			tLatency_us = profile->tRead_us;
+		}
+
+		// Media is a single server: transfers queue behind each other at the (possibly throttled) bandwidth.
+		tBusyUntil_ns = tStart_ns;
+		if(bw_MBps > 0.0f)
+		{
+			tBusyUntil_ns += (u64)((float) bytes * 1000.0f / (bw_MBps * simBandwidthFactor()));
+		}
+
+		if((sqe->OPC == 0x01) && (profile->gcInterval_MiB > 0.0f))
+		{
+			gcBytes += bytes;
+			if(gcBytes >= (u64)(profile->gcInterval_MiB * 1048576.0f))
+			{
+				gcBytes = 0;
+				tBusyUntil_ns += (u64)(profile->gcStall_ms * 1000000.0f);
+				stats.nGCStalls++;
+			}
+		}
+
+		tempC += profile->heat_CperGiB * (float) bytes / 1073741824.0f;
+
+		*tComplete_ns = tNow_ns + (u64)(tLatency_us * 1000.0f);
+		if(*tComplete_ns < tBusyUntil_ns) { *tComplete_ns = tBusyUntil_ns; }
+		return SIM_SC_SUCCESS;
+
+	default:
+		stats.nErrors++;
+		return SIM_SC_INVALID_OPCODE;
+	}
+}
+
+// Walk PRP1, PRP2, and chained PRP lists for a transfer of bytes at image offset.
+int simTransfer(u64 prp1, u64 prp2, u64 offset, u64 bytes, int write)
+{
+	u64 tStart_ns = simWallTime();
+	u64 segAddr = prp1;
+	u64 segLen;
+	u64 * prpList;
+	u32 iEntry, nEntries;
+	u64 len;
+	int status = 0;
+
+	segLen = SIM_PAGE_SIZE - (prp1 & (SIM_PAGE_SIZE - 1));
+	if(segLen > bytes) { segLen = bytes; }
+	bytes -= segLen;
+
+	if(bytes > SIM_PAGE_SIZE)
+	{
+		prpList = (u64 *) prp2;
+		iEntry = 0;
+		nEntries = (SIM_PAGE_SIZE - (prp2 & (SIM_PAGE_SIZE - 1))) >> 3;
+		while(bytes > 0)
+		{
+			// The last entry of a full list page points to the next list page.
+			if((iEntry == nEntries - 1) && (bytes > SIM_PAGE_SIZE))
+			{
+				prpList = (u64 *) prpList[iEntry];
+				iEntry = 0;
+				nEntries = SIM_PAGE_SIZE >> 3;
+			}
+
+			len = (bytes > SIM_PAGE_SIZE) ? SIM_PAGE_SIZE : bytes;
+			if(prpList[iEntry] & 0x3) { return 1; }
+			if(prpList[iEntry] == segAddr + segLen)
+			{
+				segLen += len;
+			}
+			else
+			{
+				status |= simSegment(segAddr, segLen, &offset, write);
+				segAddr = prpList[iEntry];
+				segLen = len;
+			}
+			bytes -= len;
+			iEntry++;
+		}
+	}
+	else if(bytes > 0)
+	{
+		if(prp2 == segAddr + segLen)
+		{
+			segLen += bytes;
+		}
+		else
+		{
+			status |= simSegment(segAddr, segLen, &offset, write);
+			segAddr = prp2;
+			segLen = bytes;
+		}
+	}
+	status |= simSegment(segAddr, segLen, &offset, write);
+
+	tOverhead_ns += simWallTime() - tStart_ns;
+
+	return status;
+}
+
+// Move one host-contiguous segment. All-zero writes punch a hole instead, keeping long benchmark images sparse.
+int simSegment(u64 addr, u64 len, u64 * offset, int write)
+{
+	static const u8 zeros[4096];
+	u64 i;
+	int allZero = 1;
+
+	if((addr == 0) || (addr & 0x3)) { return 1; }
+
+	if(write)
+	{
+		for(i = 0; allZero && (i < len); i += sizeof(zeros))
+		{
+			allZero = (memcmp((void *)(addr + i), zeros, (len - i) < sizeof(zeros) ? (len - i) : sizeof(zeros)) == 0);
+		}
+
+		if(allZero)
+		{
+			if(fallocate(fdImage, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, *offset, len)) { allZero = 0; }
+		}
+		if(!allZero)
+		{
+			if(pwrite(fdImage, (void *) addr, len, *offset) != (ssize_t) len) { return 1; }
+		}
+	}
+	else
+	{
+		if(pread(fdImage, (void *) addr, len, *offset) != (ssize_t) len) { return 1; }
+	}
+
+	*offset += len;
+
+	return 0;
+}
+
+int simCopyOut(u64 addr, const void * src, u64 bytes)
+{
+	if((addr == 0) || (addr & 0x3)) { return 1; }
+	memcpy((void *) addr, src, bytes);
+
+	return 0;
+}
+
+int simPostCompletion(simQueue_s * cq, u16 sqhd, u16 sqid, u16 cid, u16 status, u32 cdw0)
+{
+	volatile cqe_type * cqe;
+
+	if(((cq->tail + 1) % cq->size) == cq->head) { return 1; }	// Full
+
+	cqe = (volatile cqe_type *)(cq->base + cq->tail * sizeof(cqe_type));
+	cqe->CDW0 = cdw0;
+	cqe->reserved = 0;
+	cqe->SQHD = sqhd;
+	cqe->SQID = sqid;
+	cqe->CID = cid;
+	__sync_synchronize();
+	cqe->SF_P = (status << 1) | cq->phase;	// Phase bit last.
+
+	cq->tail = (cq->tail + 1) % cq->size;
+	if(cq->tail == 0) { cq->phase ^= 0x1; }
+
+	return 0;
+}
+
+u64 simWallTime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+u64 simTime(void)
+{
+	return simWallTime() - tOverhead_ns;
+}
+
+float simPowerStateMax_W(u8 ps)
+{
+	u16 mp;
+
+	memcpy(&mp, simIdController.PSD0 + ps * 32 + PSD_MXPS_Offset, 2);
+
+	return (simIdController.PSD0[ps * 32 + 3] & 0x01) ? mp * 0.0001f : mp * 0.01f;
+}
+
+float simBandwidthFactor(void)
+{
+	u8 ps = features[0x02] & 0x1F;
+	u16 mp, mp0;
+	float factor = 1.0f;
+
+	// Operational power states below PS0 are modeled as proportionally power-limited.
+	memcpy(&mp, simIdController.PSD0 + ps * 32 + PSD_MXPS_Offset, 2);
+	memcpy(&mp0, simIdController.PSD0 + PSD_MXPS_Offset, 2);
+	if(!(simIdController.PSD0[ps * 32 + 3] & 0x03) && (mp0 > 0)) { factor = (float) mp / (float) mp0; }
+
+	if(tempC > profile->tThrottle_C) { factor *= profile->throttleFactor; }
+
+	// DRAM-less drives keep their mapping tables in the HMB. Without it, every write pays for table misses.
+	if((profile->HMPRE > 0) && (hmbSize == 0)) { factor *= SIM_NO_HMB_FACTOR; }
+
+	return factor;
+}
@@ -0,0 +1,92 @@
+/*
+WAVE NVMe Controller Simulator Include
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __NVME_SIM_INCLUDE__
+#define __NVME_SIM_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+#define NVME_SIM_OK                        0x00000000
+#define NVME_SIM_ERROR_MAP                 0x00000001
+#define NVME_SIM_ERROR_IMAGE               0x00000002
+#define NVME_SIM_ERROR_PROFILE             0x00000004
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Controller timing and thermal model parameters. Zero bandwidth means unlimited.
+typedef struct
+{
+	const char * name;
+	float bwWrite_MBps;         // Sustained media write bandwidth [MB/s]
+	float bwRead_MBps;          // Sustained media read bandwidth [MB/s]
+	float tWrite_us;            // Minimum write command latency [us]
+	float tRead_us;             // Minimum read command latency [us]
+	float tFlush_us;            // Flush latency after media is idle [us]
+	float gcInterval_MiB;       // Media written between garbage collection stalls [MiB], 0 = none
+	float gcStall_ms;           // Garbage collection stall duration [ms]
+	float tAmbient_C;           // Composite temperature at rest [C]
+	float heat_CperGiB;         // Temperature rise per GiB transferred [C/GiB]
+	float tauCool_s;            // Cooling time constant toward ambient [s]
+	float tThrottle_C;          // Thermal throttling threshold [C]
+	float throttleFactor;       // Bandwidth multiplier while throttled
+	u32 HMPRE;                  // Host Memory Buffer Preferred Size [4KiB], 0 = none
+	u32 HMMIN;                  // Host Memory Buffer Minimum Size [4KiB]
+} nvmeSimProfile_s;
+
+typedef struct
+{
+	u64 nWriteCommands;
+	u64 nReadCommands;
+	u64 nFlushCommands;
+	u64 nAdminCommands;
+	u64 bytesWritten;
+	u64 bytesRead;
+	u64 nGCStalls;
+	u64 tThrottled_us;          // Time spent above the throttling threshold [us]
+	u32 nErrors;                // Commands completed with non-zero status
+	float tempNow_C;
+	float tempMax_C;
+	u64 hmbSize_B;              // Host Memory Buffer granted by the host [B]
+	u8 powerState;
+} nvmeSimStats_s;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+const nvmeSimProfile_s * nvmeSimFindProfile(const char * name);
+void nvmeSimListProfiles(void);
+
+int nvmeSimStart(const char * imagePath, u64 capacity_B, u8 flbas, const nvmeSimProfile_s * profile);
+void nvmeSimStop(void);
+void nvmeSimPoll(void);
+void nvmeSimSkip(u64 t_ns);
+void nvmeSimGetStats(nvmeSimStats_s * stats);
+void nvmeSimFailReads(u64 lba, u64 nBlocks);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
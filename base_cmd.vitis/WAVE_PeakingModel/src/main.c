@@ -0,0 +1,369 @@
+/*
+WAVE Focus Peaking Model Test
+
+Runs the focus peaking model on a synthetic focus chart and writes random test vectors for the IV2 and IH2 lifting
+cores and the focus_peaking corner select, with their expected outputs, for the testbenches in tb/.
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include "peaking_model.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define MODEL_ZONES 4                   // Blur zones across the chart, sharp on the left.
+#define MODEL_CHART_PERIOD 48.0f        // Checker period [LL1 px].
+#define MODEL_CHART_ANGLE 0.35f         // Checker rotation [rad], for diagonal (HH2) detail.
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	u16 w;
+	u16 h;
+	u16 q;
+	u32 nVectors;
+	const char * pathImage;
+	const char * pathVectors;
+	peakModelControl_s ctrl;
+} modelOptions_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void modelUsage(const char * name);
+void modelChart(s16 * ll1, u16 w, u16 h);
+void modelQuantize(s16 * d, u32 n, u16 q);
+u8 modelZoneStats(const modelOptions_s * opt, const peakModelSubbands_s * sb, u8 bands, const char * name);
+int modelWriteImage(const char * path, const s16 * ll1, const u8 * pk, u16 w, u16 h, const peakModelControl_s * ctrl);
+int modelWriteVectors(const char * prefix, u32 n, const peakModelControl_s * ctrl);
+u32 modelRand(void);
+s16 modelRandPx(void);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+u32 modelRandState = 0x12345678;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+	modelOptions_s opt;
+	peakModelSubbands_s sb;
+	s16 * chart;
+	s16 * ll1;
+	u8 * pk;
+	u32 nMismatch = 0;
+	u8 sharpMost;
+	int c;
+
+	opt.w = 1024;
+	opt.h = 540;
+	opt.q = 0;
+	opt.nVectors = 10000;
+	opt.pathImage = NULL;
+	opt.pathVectors = NULL;
+	opt.ctrl.thr = 32;
+	opt.ctrl.bands = PEAK_MODEL_BAND_HL2 | PEAK_MODEL_BAND_LH2 | PEAK_MODEL_BAND_HH2;
+	opt.ctrl.enabled = 1;
+	opt.ctrl.color = 0xFF0000;
+
+	while((c = getopt(argc, argv, "w:h:t:b:c:q:o:v:n:")) != -1)
+	{
+		switch(c)
+		{
+		case 'w': opt.w = (u16)strtoul(optarg, NULL, 0) & ~0x3; break;
+		case 'h': opt.h = (u16)strtoul(optarg, NULL, 0) & ~0x3; break;
+		case 't': opt.ctrl.thr = (u16)strtoul(optarg, NULL, 0) & 0xFFF; break;
+		case 'b': opt.ctrl.bands = (u8)strtoul(optarg, NULL, 0) & 0x7; break;
+		case 'c': opt.ctrl.color = (u32)strtoul(optarg, NULL, 16) & 0xFFFFFF; break;
+		case 'q': opt.q = (u16)strtoul(optarg, NULL, 0); break;
+		case 'o': opt.pathImage = optarg; break;
+		case 'v': opt.pathVectors = optarg; break;
+		case 'n': opt.nVectors = (u32)strtoul(optarg, NULL, 0); break;
+		default: modelUsage(argv[0]); return 1;
+		}
+	}
+	if((opt.w < 8) || (opt.h < 8)) { modelUsage(argv[0]); return 1; }
+
+	chart = malloc(sizeof(s16) * opt.w * opt.h);
+	ll1 = malloc(sizeof(s16) * opt.w * opt.h);
+	pk = malloc(opt.w * opt.h);
+	sb.LL2 = malloc(sizeof(s16) * opt.w * opt.h / 4);
+	sb.LH2 = malloc(sizeof(s16) * opt.w * opt.h / 4);
+	sb.HL2 = malloc(sizeof(s16) * opt.w * opt.h / 4);
+	sb.HH2 = malloc(sizeof(s16) * opt.w * opt.h / 4);
+
+	// Encode the chart, optionally with a coarse quantizer on the detail subbands.
+	modelChart(chart, opt.w, opt.h);
+	peakModelForward(chart, opt.w, opt.h, &sb);
+	modelQuantize(sb.LH2, sb.w * sb.h, opt.q);
+	modelQuantize(sb.HL2, sb.w * sb.h, opt.q);
+	modelQuantize(sb.HH2, sb.w * sb.h, opt.q);
+
+	peakModelDecode(&sb, &opt.ctrl, ll1, pk);
+
+	for(u32 i = 0; i < (u32)opt.w * opt.h; i++)
+	{
+		if(ll1[i] != chart[i]) { nMismatch++; }
+	}
+	printf("Field %dx%d, threshold %d, bands 0x%x, q %d.\n", opt.w, opt.h, opt.ctrl.thr, opt.ctrl.bands, opt.q);
+	if(opt.q == 0) { printf("Reconstruction: %u mismatched pixels.\n", nMismatch); }
+
+	// Share of flagged pixels in each blur zone, for each band alone and for the selected bands.
+	printf("Flagged [%%] by zone (blur radius 0, 1, 2, 4 px):\n");
+	modelZoneStats(&opt, &sb, PEAK_MODEL_BAND_HL2, "HL2");
+	modelZoneStats(&opt, &sb, PEAK_MODEL_BAND_LH2, "LH2");
+	modelZoneStats(&opt, &sb, PEAK_MODEL_BAND_HH2, "HH2");
+	sharpMost = modelZoneStats(&opt, &sb, opt.ctrl.bands, "Selected");
+	printf("Sharp zone flagged most: %s.\n", sharpMost ? "yes" : "NO");
+
+	if(opt.pathImage && modelWriteImage(opt.pathImage, ll1, pk, opt.w, opt.h, &opt.ctrl))
+	{
+		printf("Could not write %s.\n", opt.pathImage);
+		return 1;
+	}
+	if(opt.pathVectors && modelWriteVectors(opt.pathVectors, opt.nVectors, &opt.ctrl))
+	{
+		printf("Could not write %s_*.hex.\n", opt.pathVectors);
+		return 1;
+	}
+
+	return (((opt.q == 0) && (nMismatch > 0)) || !sharpMost) ? 1 : 0;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+void modelUsage(const char * name)
+{
+	printf("Usage: %s [options]\n", name);
+	printf("  -w W      LL1 field width [px], multiple of 4 (1024).\n");
+	printf("  -h H      LL1 field height [px], multiple of 4 (540).\n");
+	printf("  -t T      Threshold, 0-4095 (32).\n");
+	printf("  -b B      Band mask: 1 HL2, 2 LH2, 4 HH2 (7).\n");
+	printf("  -c RRGGBB Peaking color (FF0000).\n");
+	printf("  -q Q      Quantize the detail subbands with step Q, 0 for lossless (0).\n");
+	printf("  -o FILE   Write the decoded field with the overlay as a PPM.\n");
+	printf("  -v PREFIX Write test vectors to PREFIX_iv2.hex, PREFIX_ih2.hex, and PREFIX_fp.hex.\n");
+	printf("  -n N      Number of test vectors of each kind (10000).\n");
+}
+
+// Rotated checker, 200-800 (10b), box-blurred with a radius that grows across the zones.
+void modelChart(s16 * ll1, u16 w, u16 h)
+{
+	static const int radius[MODEL_ZONES] = {0, 1, 2, 4};
+	float * sharp = malloc(sizeof(float) * w * h);
+	float * tmp = malloc(sizeof(float) * w * h);
+	float u, v, sum;
+	int r, n;
+
+	for(int y = 0; y < h; y++)
+	{
+		for(int x = 0; x < w; x++)
+		{
+			u = (x * cosf(MODEL_CHART_ANGLE) + y * sinf(MODEL_CHART_ANGLE)) / MODEL_CHART_PERIOD;
+			v = (y * cosf(MODEL_CHART_ANGLE) - x * sinf(MODEL_CHART_ANGLE)) / MODEL_CHART_PERIOD;
+			sharp[y * w + x] = (((int)floorf(u) + (int)floorf(v)) & 0x1) ? 1.0f : 0.0f;
+		}
+	}
+
+	// Horizontal, then vertical.
+	for(int pass = 0; pass < 2; pass++)
+	{
+		float * src = pass ? tmp : sharp;
+		float * dst = pass ? sharp : tmp;
+		for(int y = 0; y < h; y++)
+		{
+			for(int x = 0; x < w; x++)
+			{
+				r = radius[x * MODEL_ZONES / w];
+				sum = 0.0f;
+				n = 0;
+				for(int k = -r; k <= r; k++)
+				{
+					int xs = pass ? x : x + k;
+					int ys = pass ? y + k : y;
+					if((xs < 0) || (xs >= w) || (ys < 0) || (ys >= h)) { continue; }
+					sum += src[ys * w + xs];
+					n++;
+				}
+				dst[y * w + x] = sum / n;
+			}
+		}
+	}
+
+	for(int i = 0; i < w * h; i++) { ll1[i] = (s16)lrintf(200.0f + 600.0f * sharp[i]); }
+
+	free(sharp);
+	free(tmp);
+}
+
+// Mid-tread quantizer, as a stand-in for the encoder's.
+void modelQuantize(s16 * d, u32 n, u16 q)
+{
+	if(q == 0) { return; }
+	for(u32 i = 0; i < n; i++) { d[i] = (s16)(lrintf((float)d[i] / q) * q); }
+}
+
+// Returns 1 if the sharp zone has more flagged pixels than any blurred one.
+u8 modelZoneStats(const modelOptions_s * opt, const peakModelSubbands_s * sb, u8 bands, const char * name)
+{
+	peakModelControl_s ctrl = opt->ctrl;
+	s16 * ll1 = malloc(sizeof(s16) * opt->w * opt->h);
+	u8 * pk = malloc(opt->w * opt->h);
+	u32 nZone[MODEL_ZONES] = {0};
+	u8 sharpMost = 1;
+	int zone;
+
+	ctrl.bands = bands;
+	peakModelDecode(sb, &ctrl, ll1, pk);
+	for(int y = 0; y < opt->h; y++)
+	{
+		for(int x = 0; x < opt->w; x++)
+		{
+			zone = x * MODEL_ZONES / opt->w;
+			nZone[zone] += pk[y * opt->w + x];
+		}
+	}
+
+	printf("  %-8s", name);
+	for(int i = 0; i < MODEL_ZONES; i++) { printf(" %6.2f", 100.0f * nZone[i] * MODEL_ZONES / (opt->w * opt->h)); }
+	printf("\n");
+
+	for(int i = 1; i < MODEL_ZONES; i++) { if(nZone[i] >= nZone[0]) { sharpMost = 0; } }
+
+	free(ll1);
+	free(pk);
+
+	return sharpMost;
+}
+
+// 10b to 8b gray, with the peaking override from ui_mixer.
+int modelWriteImage(const char * path, const s16 * ll1, const u8 * pk, u16 w, u16 h, const peakModelControl_s * ctrl)
+{
+	FILE * f = fopen(path, "wb");
+	u8 rgb[3];
+	int v;
+
+	if(f == NULL) { return 1; }
+	fprintf(f, "P6\n%d %d\n255\n", w, h);
+	for(int i = 0; i < w * h; i++)
+	{
+		v = ll1[i] >> 2;
+		if(v < 0) { v = 0; }
+		if(v > 255) { v = 255; }
+		rgb[0] = rgb[1] = rgb[2] = (u8)v;
+		peakModelMix(pk[i], ctrl, rgb);
+		fwrite(rgb, 1, 3, f);
+	}
+	fclose(f);
+
+	return 0;
+}
+
+// One vector per line, hex fields separated by spaces, in $readmemh-friendly widths:
+// PREFIX_iv2.hex: S_above S S_below D thr | Xeven Xodd pk
+// PREFIX_ih2.hex: S(n-1) S S(n+1) D pkV thr bands | Xeven Xodd pk
+// PREFIX_fp.hex: x0_G1 y0_G1 x0_G2 y0_G2 xOut yOut pk_row0_G1 pk_row1_G1 pk_row0_G2 pk_row1_G2 | peak
+int modelWriteVectors(const char * prefix, u32 n, const peakModelControl_s * ctrl)
+{
+	char path[256];
+	FILE * fV;
+	FILE * fH;
+	FILE * fP;
+	s16 in[4];
+	s16 xEven, xOdd;
+	u16 thr;
+	u8 bands, pkV, pk;
+	u16 xy[6];
+	u8 pkRow[4];
+
+	snprintf(path, sizeof(path), "%s_iv2.hex", prefix);
+	fV = fopen(path, "w");
+	snprintf(path, sizeof(path), "%s_ih2.hex", prefix);
+	fH = fopen(path, "w");
+	snprintf(path, sizeof(path), "%s_fp.hex", prefix);
+	fP = fopen(path, "w");
+	if((fV == NULL) || (fH == NULL) || (fP == NULL)) { return 1; }
+
+	for(u32 i = 0; i < n; i++)
+	{
+		// Every 16th vector uses the control settings given, the rest are random.
+		thr = (i % 16) ? (modelRand() & 0xFFF) : ctrl->thr;
+		bands = (i % 16) ? (modelRand() & 0x7) : ctrl->bands;
+		pkV = modelRand() & 0x3;
+
+		for(int k = 0; k < 4; k++) { in[k] = modelRandPx(); }
+		pk = peakModelIV2(in[0], in[1], in[2], in[3], thr, &xEven, &xOdd);
+		fprintf(fV, "%04x %04x %04x %04x %03x %04x %04x %x\n", (u16)in[0], (u16)in[1], (u16)in[2], (u16)in[3],
+		        thr, (u16)xEven, (u16)xOdd, pk);
+
+		for(int k = 0; k < 4; k++) { in[k] = modelRandPx(); }
+		pk = peakModelIH2(in[0], in[1], in[2], in[3], pkV, thr, bands, &xEven, &xOdd);
+		fprintf(fH, "%04x %04x %04x %04x %x %03x %x %04x %04x %x\n", (u16)in[0], (u16)in[1], (u16)in[2], (u16)in[3],
+		        pkV, thr, bands, (u16)xEven, (u16)xOdd, pk);
+
+		// Output pixel in the grid square of both green fields, or anywhere one time in eight to cover the wrap.
+		xy[0] = modelRand() >> 16;
+		xy[1] = modelRand() >> 16;
+		xy[2] = modelRand() >> 16;
+		xy[3] = modelRand() >> 16;
+		xy[4] = (modelRand() & 0x7) ? (xy[0] + (modelRand() & ((1 << PEAK_MODEL_GRID_EXP) - 1))) : (modelRand() >> 16);
+		xy[5] = (modelRand() & 0x7) ? (xy[1] + (modelRand() & ((1 << PEAK_MODEL_GRID_EXP) - 1))) : (modelRand() >> 16);
+		for(int k = 0; k < 4; k++) { pkRow[k] = modelRand() & 0x3; }
+		pk = peakModelSelect(xy[0], xy[1], xy[4], xy[5], pkRow[0], pkRow[1])
+		   | peakModelSelect(xy[2], xy[3], xy[4], xy[5], pkRow[2], pkRow[3]);
+		fprintf(fP, "%04x %04x %04x %04x %04x %04x %x %x %x %x %x\n", xy[0], xy[1], xy[2], xy[3], xy[4], xy[5],
+		        pkRow[0], pkRow[1], pkRow[2], pkRow[3], pk);
+	}
+
+	fclose(fV);
+	fclose(fH);
+	fclose(fP);
+
+	return 0;
+}
+
+u32 modelRand(void)
+{
+	modelRandState ^= modelRandState << 13;
+	modelRandState ^= modelRandState >> 17;
+	modelRandState ^= modelRandState << 5;
+	return modelRandState;
+}
+
+// Mostly image-like values, with full-range values mixed in to cover truncation and 16b wrap.
+s16 modelRandPx(void)
+{
+	u32 r = modelRand();
+	if((r & 0x7) == 0) { return (s16)(r >> 16); }
+	return (s16)((int)((r >> 16) & 0x7FF) - 0x400);
+}
@@ -0,0 +1,248 @@
+/*
+WAVE Focus Peaking Model
+
+Bit-exact model of the focus peaking path of the HDMI pipeline:
+- idwt26_v2.v: Vertical Stage 2 IDWT and the LH2/HH2 detail flags.
+- idwt26_h2.v: Horizontal Stage 2 IDWT, the HL2 detail flag, and the band select.
+- focus_peaking.v: Nearest-corner flag select.
+- ui_mixer.v: Peaking color override.
+
+Arithmetic is done in the same widths as the HDL, including the PX_MATH_WIDTH truncation of the IV2 sums and the
+16b wrap of every lifting step. Rows and columns at the edge of the field use clamped neighbours. (The HDL reads
+whatever its line buffers hold there, which is outside the displayed image.)
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include "peaking_model.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+s16 peakModelPxMath(s16 x);
+u16 peakModelAbs(s16 x);
+s16 peakModelLift(s16 sPrev, s16 sNext);
+u8 peakModelSharp(s16 d2, s16 lift);
+int peakModelClamp(int i, int n);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// One IV2 lane: S_above, S, and S_below are truncated to PX_MATH_WIDTH. Returns the detail flag (out_4pk).
+u8 peakModelIV2(s16 sAbove, s16 s, s16 sBelow, s16 d, u16 thr, s16 * xEven, s16 * xOdd)
+{
+	s16 lift, d2;
+
+	lift = peakModelLift(peakModelPxMath(sAbove), peakModelPxMath(sBelow));
+	d2 = (s16)(d - lift);
+	*xEven = (s16)(peakModelPxMath(s) - (d2 >> 1));
+	*xOdd = (s16)(*xEven + d2);
+
+	return (peakModelAbs(d2) > thr) && peakModelSharp(d2, lift);
+}
+
+// One IH2 pixel pair. pkV holds the IV2 flags of the pair's L (LH2) and H (HH2) columns. Returns the pair's flag.
+u8 peakModelIH2(s16 sLeft, s16 s, s16 sRight, s16 d, u8 pkV, u16 thr, u8 bands, s16 * xEven, s16 * xOdd)
+{
+	s16 lift, d2;
+	u8 pk = 0;
+
+	lift = peakModelLift(sLeft, sRight);
+	d2 = (s16)(d - lift);
+	*xEven = (s16)(s - (d2 >> 1));
+	*xOdd = (s16)(*xEven + d2);
+
+	if((bands & PEAK_MODEL_BAND_HL2) && (peakModelAbs(d2) > thr) && peakModelSharp(d2, lift)) { pk = 1; }
+	if((bands & PEAK_MODEL_BAND_LH2) && (pkV & PEAK_MODEL_PK_LH2)) { pk = 1; }
+	if((bands & PEAK_MODEL_BAND_HH2) && (pkV & PEAK_MODEL_PK_HH2)) { pk = 1; }
+
+	return pk;
+}
+
+// Flag of the grid corner nearest (xOut, yOut) for one color field. Bit 0 of pkRow0/1 is the left pixel (in00/in01).
+u8 peakModelSelect(u16 x0, u16 y0, u16 xOut, u16 yOut, u8 pkRow0, u8 pkRow1)
+{
+	u16 xOffset = xOut - x0;
+	u16 yOffset = yOut - y0;
+	u8 pkRow = ((yOffset >> (PEAK_MODEL_GRID_EXP - 1)) & 0x1) ? pkRow1 : pkRow0;
+
+	return (pkRow >> ((xOffset >> (PEAK_MODEL_GRID_EXP - 1)) & 0x1)) & 0x1;
+}
+
+// Preview pixel override in ui_mixer, ahead of the UI blend. rgb is {R, G, B}.
+void peakModelMix(u8 peak, const peakModelControl_s * ctrl, u8 * rgb)
+{
+	if(!(peak && ctrl->enabled)) { return; }
+
+	rgb[0] = (ctrl->color >> 16) & 0xFF;
+	rgb[1] = (ctrl->color >> 8) & 0xFF;
+	rgb[2] = ctrl->color & 0xFF;
+}
+
+// IV2 then IH2 over a whole color field. ll1 and pk are (2 * sb->w) x (2 * sb->h), row-major.
+void peakModelDecode(const peakModelSubbands_s * sb, const peakModelControl_s * ctrl, s16 * ll1, u8 * pk)
+{
+	int w = sb->w;
+	int h = sb->h;
+	int up, dn, lt, rt;
+	s16 * L = malloc(sizeof(s16) * w * 2 * h);
+	s16 * H = malloc(sizeof(s16) * w * 2 * h);
+	u8 * pkV = malloc(w * h);
+	u8 pkL, pkH;
+
+	// IV2: L columns are LL2 (S) and LH2 (D), H columns are HL2 (S) and HH2 (D).
+	for(int r = 0; r < h; r++)
+	{
+		up = peakModelClamp(r - 1, h);
+		dn = peakModelClamp(r + 1, h);
+		for(int j = 0; j < w; j++)
+		{
+			pkL = peakModelIV2(sb->LL2[up * w + j], sb->LL2[r * w + j], sb->LL2[dn * w + j], sb->LH2[r * w + j],
+			                   ctrl->thr, &L[(2 * r) * w + j], &L[(2 * r + 1) * w + j]);
+			pkH = peakModelIV2(sb->HL2[up * w + j], sb->HL2[r * w + j], sb->HL2[dn * w + j], sb->HH2[r * w + j],
+			                   ctrl->thr, &H[(2 * r) * w + j], &H[(2 * r + 1) * w + j]);
+			pkV[r * w + j] = (pkL ? PEAK_MODEL_PK_LH2 : 0) | (pkH ? PEAK_MODEL_PK_HH2 : 0);
+		}
+	}
+
+	// IH2: Both rows of an IV2 pair share its flags.
+	for(int y = 0; y < 2 * h; y++)
+	{
+		for(int j = 0; j < w; j++)
+		{
+			lt = peakModelClamp(j - 1, w);
+			rt = peakModelClamp(j + 1, w);
+			pk[y * 2 * w + 2 * j] = peakModelIH2(L[y * w + lt], L[y * w + j], L[y * w + rt], H[y * w + j],
+			                                      pkV[(y / 2) * w + j], ctrl->thr, ctrl->bands,
+			                                      &ll1[y * 2 * w + 2 * j], &ll1[y * 2 * w + 2 * j + 1]);
+			pk[y * 2 * w + 2 * j + 1] = pk[y * 2 * w + 2 * j];
+		}
+	}
+
+	free(L);
+	free(H);
+	free(pkV);
+}
+
+// Forward 2/6 DWT of a w x h LL1 field into Stage 2 subbands, the exact inverse of peakModelDecode() with the same
+// edge clamping. sb->w and sb->h are set here, the subband buffers must hold (w / 2) x (h / 2) values.
+void peakModelForward(const s16 * ll1, u16 w, u16 h, peakModelSubbands_s * sb)
+{
+	int w2 = w / 2;
+	int h2 = h / 2;
+	s16 * L = malloc(sizeof(s16) * w2 * h);
+	s16 * H = malloc(sizeof(s16) * w2 * h);
+	s16 * col = malloc(sizeof(s16) * h);
+	s16 d;
+	s16 * s;
+	s16 * dOut;
+
+	sb->w = w2;
+	sb->h = h2;
+
+	// Horizontal: S is the pair average, D the difference with the neighbouring sums' slope added back in.
+	for(int y = 0; y < h; y++)
+	{
+		for(int j = 0; j < w2; j++)
+		{
+			d = (s16)(ll1[y * w + 2 * j + 1] - ll1[y * w + 2 * j]);
+			L[y * w2 + j] = (s16)(ll1[y * w + 2 * j] + (d >> 1));
+			H[y * w2 + j] = d;
+		}
+		for(int j = 0; j < w2; j++)
+		{
+			// The lift only reads L, so H can be updated in place.
+			H[y * w2 + j] = (s16)(H[y * w2 + j] + peakModelLift(L[y * w2 + peakModelClamp(j - 1, w2)],
+			                                                      L[y * w2 + peakModelClamp(j + 1, w2)]));
+		}
+	}
+
+	// Vertical, on the L columns into LL2/LH2 and the H columns into HL2/HH2.
+	for(int band = 0; band < 2; band++)
+	{
+		s16 * src = band ? H : L;
+		s = band ? sb->HL2 : sb->LL2;
+		dOut = band ? sb->HH2 : sb->LH2;
+		for(int j = 0; j < w2; j++)
+		{
+			for(int r = 0; r < h2; r++)
+			{
+				d = (s16)(src[(2 * r + 1) * w2 + j] - src[(2 * r) * w2 + j]);
+				s[r * w2 + j] = (s16)(src[(2 * r) * w2 + j] + (d >> 1));
+				col[r] = d;
+			}
+			for(int r = 0; r < h2; r++)
+			{
+				dOut[r * w2 + j] = (s16)(col[r] + peakModelLift(s[peakModelClamp(r - 1, h2) * w2 + j],
+				                                                s[peakModelClamp(r + 1, h2) * w2 + j]));
+			}
+		}
+	}
+
+	free(L);
+	free(H);
+	free(col);
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Sign-extend the low PX_MATH_WIDTH bits, as the IV2 S registers do.
+s16 peakModelPxMath(s16 x)
+{
+	return (s16)((s16)((u16)x << (16 - PEAK_MODEL_PX_MATH_WIDTH)) >> (16 - PEAK_MODEL_PX_MATH_WIDTH));
+}
+
+// 16b two's complement magnitude: (16'h0000 - x) for negative x, so -32768 maps to 32768.
+u16 peakModelAbs(s16 x)
+{
+	return (x < 0) ? (u16)(0 - (u16)x) : (u16)x;
+}
+
+// ((S(n-1) - S(n+1) + 2) >>> 2), in 16b.
+s16 peakModelLift(s16 sPrev, s16 sNext)
+{
+	return (s16)((s16)(sPrev - sNext + 2) >> 2);
+}
+
+// Detail more than twice the lift: the step within the pair is over half the difference of the neighbouring sums.
+// A sharp edge puts its whole contrast in one pair, a blurred one spreads it over the sums as a ramp.
+u8 peakModelSharp(s16 d2, s16 lift)
+{
+	return ((u32) peakModelAbs(d2) > ((u32) peakModelAbs(lift) << 1));
+}
+
+int peakModelClamp(int i, int n)
+{
+	if(i < 0) { return 0; }
+	if(i > n - 1) { return n - 1; }
+	return i;
+}
@@ -0,0 +1,79 @@
+/*
+WAVE Focus Peaking Model Include
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __PEAKING_MODEL_INCLUDE__
+#define __PEAKING_MODEL_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+#define PEAK_MODEL_PX_MATH_WIDTH 12     // idwt26_v2 PX_MATH_WIDTH, as set by HDMI_v1_0.
+#define PEAK_MODEL_GRID_EXP 6           // focus_peaking GRID_EXP.
+
+// peak_bands, Slave Reg 21 [14:12].
+#define PEAK_MODEL_BAND_HL2 0x1
+#define PEAK_MODEL_BAND_LH2 0x2
+#define PEAK_MODEL_BAND_HH2 0x4
+
+// IV2 flag bits of one IV2 column pair, as stored in the IH2 URAM.
+#define PEAK_MODEL_PK_LH2 0x1
+#define PEAK_MODEL_PK_HH2 0x2
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Stage 2 subbands of one color field, w x h each, row-major.
+typedef struct
+{
+	u16 w;
+	u16 h;
+	s16 * LL2;
+	s16 * LH2;
+	s16 * HL2;
+	s16 * HH2;
+} peakModelSubbands_s;
+
+// Slave Reg 21 and 22.
+typedef struct
+{
+	u16 thr;
+	u8 bands;
+	u8 enabled;
+	u32 color;
+} peakModelControl_s;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+u8 peakModelIV2(s16 sAbove, s16 s, s16 sBelow, s16 d, u16 thr, s16 * xEven, s16 * xOdd);
+u8 peakModelIH2(s16 sLeft, s16 s, s16 sRight, s16 d, u8 pkV, u16 thr, u8 bands, s16 * xEven, s16 * xOdd);
+u8 peakModelSelect(u16 x0, u16 y0, u16 xOut, u16 yOut, u8 pkRow0, u8 pkRow1);
+void peakModelMix(u8 peak, const peakModelControl_s * ctrl, u8 * rgb);
+void peakModelDecode(const peakModelSubbands_s * sb, const peakModelControl_s * ctrl, s16 * ll1, u8 * pk);
+void peakModelForward(const s16 * ll1, u16 w, u16 h, peakModelSubbands_s * sb);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
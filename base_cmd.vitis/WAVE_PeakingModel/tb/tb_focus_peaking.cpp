@@ -0,0 +1,106 @@
+/*
+WAVE Focus Peaking Testbench: focus_peaking
+
+Runs focus_peaking.v against the model's corner select vectors (PREFIX_fp.hex). One vector is applied per clock,
+and the peak output for it comes out PEAK_LATENCY (9) clocks later.
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "verilated.h"
+#include "Vfocus_peaking.h"
+#include "tb_vectors.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// x0_G1 y0_G1 x0_G2 y0_G2 xOut yOut pk_row0_G1 pk_row1_G1 pk_row0_G2 pk_row1_G2 | peak
+#define TB_FIELDS 11
+
+// focus_peaking PEAK_LATENCY, as set by HDMI_v1_0.
+#define TB_LATENCY 9
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+double sc_time_stamp() { return 0; }
+
+int main(int argc, char ** argv)
+{
+	const char * path = "vec_fp.hex";
+	uint32_t * vec;
+	uint32_t nVectors;
+	uint32_t nFail = 0;
+	const uint32_t * v;
+	Vfocus_peaking * top;
+
+	Verilated::commandArgs(argc, argv);
+	if((argc > 1) && (argv[argc - 1][0] != '+')) { path = argv[argc - 1]; }
+
+	nVectors = tbLoadVectors(path, TB_FIELDS, &vec);
+	if(nVectors == 0)
+	{
+		printf("Could not read %s.\n", path);
+		return 1;
+	}
+
+	top = new Vfocus_peaking;
+
+	for(uint32_t i = 0; i < nVectors + TB_LATENCY - 1; i++)
+	{
+		// Past the end, the last vector is held.
+		v = &vec[((i < nVectors) ? i : (nVectors - 1)) * TB_FIELDS];
+		top->x0_G1 = v[0];
+		top->y0_G1 = v[1];
+		top->x0_G2 = v[2];
+		top->y0_G2 = v[3];
+		top->xOut = v[4];
+		top->yOut = v[5];
+		top->pk_row0_G1 = v[6];
+		top->pk_row1_G1 = v[7];
+		top->pk_row0_G2 = v[8];
+		top->pk_row1_G2 = v[9];
+		tbTick(top, top->clk);
+
+		if(i >= TB_LATENCY - 1)
+		{
+			v = &vec[(i - (TB_LATENCY - 1)) * TB_FIELDS];
+			if(top->peak != v[10])
+			{
+				if(nFail < TB_PRINT_MAX)
+				{
+					printf("Vector %u: %04x %04x %04x %04x %04x %04x %x %x %x %x, expected %x, got %x\n",
+					       i - (TB_LATENCY - 1), v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8], v[9], v[10],
+					       top->peak);
+				}
+				nFail++;
+			}
+		}
+	}
+
+	printf("focus_peaking: %u of %u vectors mismatched.\n", nFail, nVectors);
+
+	top->final();
+	delete top;
+	free(vec);
+
+	return (nFail != 0);
+}
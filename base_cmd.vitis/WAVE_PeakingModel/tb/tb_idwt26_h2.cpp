@@ -0,0 +1,200 @@
+/*
+WAVE Focus Peaking Testbench: idwt26_h2
+
+Runs idwt26_h2.v against the model's IH2 vectors (PREFIX_ih2.hex), through its ports only. The vectors are laid out
+in a stream of H2/L2 pixel pairs, three pairs per vector: S(n-1), S, and S(n+1) are the sums of consecutive pairs,
+and the middle pair carries D and the IV2 flags. Other D values and flags are 0, and only the middle pairs are checked.
+
+The stream goes in on in_4px_row0/1 and in_4pk, two pairs per word, as IV2 writes it to row N+6. Three rows later
+H2 reads it back from row N+3. Stream pair p is lifted at count 2p + 12 * cols + 1, where cols is the number of URAM
+words per row (256 at 4K, 128 at 2K), and peak_thr and peak_bands of the vector are applied there. The result is
+stored to row N+2 and comes out on the row 1 outputs one row later and the row 0 outputs two rows later, after the
+counts 2p + 16 * cols and 2p + 20 * cols. Both must match the expected Xeven, Xodd, and flag. The whole stream is run at
+4K, then at 2K.
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "verilated.h"
+#include "Vidwt26_h2.h"
+#include "tb_vectors.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// S(n-1) S S(n+1) D pkV peak_thr peak_bands | Xeven Xodd pk
+#define TB_FIELDS 10
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+uint32_t tbRun(Vidwt26_h2 * top, uint8_t ss, const uint32_t * vec, uint32_t nVectors);
+uint8_t tbCheck(uint32_t px, uint8_t pk, const uint32_t * v);
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// Stream of pixel pairs: sum, difference, and IV2 flags.
+uint16_t * tbS;
+uint16_t * tbD;
+uint8_t * tbP;
+uint32_t tbPairs;
+
+uint32_t tbFail = 0;
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+double sc_time_stamp() { return 0; }
+
+int main(int argc, char ** argv)
+{
+	const char * path = "vec_ih2.hex";
+	uint32_t * vec;
+	uint32_t nVectors;
+	uint32_t nFail;
+	Vidwt26_h2 * top;
+
+	Verilated::commandArgs(argc, argv);
+	if((argc > 1) && (argv[argc - 1][0] != '+')) { path = argv[argc - 1]; }
+
+	nVectors = tbLoadVectors(path, TB_FIELDS, &vec);
+	if(nVectors == 0)
+	{
+		printf("Could not read %s.\n", path);
+		return 1;
+	}
+
+	// Three pairs per vector, and one spare so the last S(n+1) is in a whole word.
+	tbPairs = 3 * nVectors + 1;
+	tbS = (uint16_t *) calloc(tbPairs, sizeof(uint16_t));
+	tbD = (uint16_t *) calloc(tbPairs, sizeof(uint16_t));
+	tbP = (uint8_t *) calloc(tbPairs, sizeof(uint8_t));
+	for(uint32_t j = 0; j < nVectors; j++)
+	{
+		tbS[3 * j + 0] = vec[j * TB_FIELDS + 0];
+		tbS[3 * j + 1] = vec[j * TB_FIELDS + 1];
+		tbS[3 * j + 2] = vec[j * TB_FIELDS + 2];
+		tbD[3 * j + 1] = vec[j * TB_FIELDS + 3];
+		tbP[3 * j + 1] = vec[j * TB_FIELDS + 4];
+	}
+
+	top = new Vidwt26_h2;
+
+	nFail = tbRun(top, 0, vec, nVectors);
+	printf("idwt26_h2 4K: %u of %u vectors mismatched.\n", nFail, nVectors);
+	tbFail += nFail;
+
+	nFail = tbRun(top, 1, vec, nVectors);
+	printf("idwt26_h2 2K: %u of %u vectors mismatched.\n", nFail, nVectors);
+	tbFail += nFail;
+
+	top->final();
+	delete top;
+	free(vec);
+	free(tbS);
+	free(tbD);
+	free(tbP);
+
+	return (tbFail != 0);
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Returns the number of vectors that mismatched on either output row.
+uint32_t tbRun(Vidwt26_h2 * top, uint8_t ss, const uint32_t * vec, uint32_t nVectors)
+{
+	int cols = ss ? 128 : 256;
+	int cEnd = 2 * tbPairs + 20 * cols + 2;
+	uint32_t nWords = tbPairs / 2;
+	uint32_t w, p, j;
+	uint64_t word;
+	uint8_t * fail = (uint8_t *) calloc(nVectors, sizeof(uint8_t));
+	uint32_t nFail = 0;
+
+	top->SS = ss;
+
+	// Starts from -1 so that count 0 is an increment.
+	for(int c = -1; c < cEnd; c++)
+	{
+		// Stream word w is written by IV2 at count 4w + 5.
+		word = 0;
+		top->in_4pk = 0;
+		if(((c & 0x3) == 1) && (c >= 5) && ((uint32_t)((c - 4) >> 2) < nWords))
+		{
+			w = (c - 4) >> 2;
+			word = (uint64_t) tbS[2 * w] | ((uint64_t) tbD[2 * w] << 16) | ((uint64_t) tbS[2 * w + 1] << 32)
+			     | ((uint64_t) tbD[2 * w + 1] << 48);
+			top->in_4pk = (tbP[2 * w] & 0x3) | ((tbP[2 * w + 1] & 0x3) << 2);
+		}
+		top->in_4px_row0 = word;
+		top->in_4px_row1 = word;
+
+		// Controls of the vector whose pair is lifted at this count.
+		if((c >= 12 * cols + 1) && (((c - 12 * cols - 1) & 0x1) == 0))
+		{
+			p = (c - 12 * cols - 1) / 2;
+			if((p % 3 == 1) && (p / 3 < nVectors))
+			{
+				top->peak_thr = vec[(p / 3) * TB_FIELDS + 5];
+				top->peak_bands = vec[(p / 3) * TB_FIELDS + 6];
+			}
+		}
+
+		top->opx_count = c & 0xFFFFFF;
+		tbTick(top, top->opx_clk);
+
+		// Row 1 output.
+		if((c >= 16 * cols) && (((c - 16 * cols) & 0x1) == 0))
+		{
+			p = (c - 16 * cols) / 2;
+			j = p / 3;
+			if((p % 3 == 1) && (j < nVectors) && !tbCheck(top->out_2px_row1, top->out_2pk_row1, &vec[j * TB_FIELDS]))
+			{
+				if((tbFail + nFail < TB_PRINT_MAX) && !fail[j])
+				{ printf("Vector %u, row 1: got %08x %x (SS %d)\n", j, top->out_2px_row1, top->out_2pk_row1, ss); }
+				nFail += !fail[j];
+				fail[j] = 1;
+			}
+		}
+
+		// Row 0 output.
+		if((c >= 20 * cols) && (((c - 20 * cols) & 0x1) == 0))
+		{
+			p = (c - 20 * cols) / 2;
+			j = p / 3;
+			if((p % 3 == 1) && (j < nVectors) && !tbCheck(top->out_2px_row0, top->out_2pk_row0, &vec[j * TB_FIELDS]))
+			{
+				if((tbFail + nFail < TB_PRINT_MAX) && !fail[j])
+				{ printf("Vector %u, row 0: got %08x %x (SS %d)\n", j, top->out_2px_row0, top->out_2pk_row0, ss); }
+				nFail += !fail[j];
+				fail[j] = 1;
+			}
+		}
+	}
+
+	free(fail);
+	return nFail;
+}
+
+// The pair is {Xodd, Xeven}, and both flag bits are the pair's flag.
+uint8_t tbCheck(uint32_t px, uint8_t pk, const uint32_t * v)
+{
+	return ((px & 0xFFFF) == v[7]) && ((px >> 16) == v[8]) && (pk == (v[9] ? 0x3 : 0x0));
+}
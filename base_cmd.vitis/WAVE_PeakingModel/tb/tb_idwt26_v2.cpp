@@ -0,0 +1,153 @@
+/*
+WAVE Focus Peaking Testbench: idwt26_v2
+
+Runs idwt26_v2.v against the model's IV2 vectors (PREFIX_iv2.hex). Each batch of vectors is written into the URAM
+through the write port, one vector per column, the same vector in all four lanes: S_above, S, and S_below in rows 0-2
+and D in the HH2/LH2 row read in state 3 (row 9 at 4K, 17 at 2K). The pixel counter then scans the batch as the HDMI
+pipeline does. The outputs for column m are registered at count 4m + 5, with the peak_thr of the vector applied, and
+must match the expected Xeven, Xodd, and flag in every lane. Batches alternate between 4K and 2K addressing.
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "verilated.h"
+#include "Vidwt26_v2.h"
+#include "tb_vectors.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// S_above S S_below D peak_thr | Xeven Xodd pk
+#define TB_FIELDS 8
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void tbWrite(Vidwt26_v2 * top, uint8_t ss, uint32_t row, uint32_t col, uint16_t x);
+uint32_t tbCheck(const Vidwt26_v2 * top, const uint32_t * v, uint32_t nVector, uint32_t nFail);
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+double sc_time_stamp() { return 0; }
+
+int main(int argc, char ** argv)
+{
+	const char * path = "vec_iv2.hex";
+	uint32_t * vec;
+	uint32_t nVectors;
+	uint32_t nCols, n, m;
+	uint32_t nFail = 0;
+	uint8_t ss = 0;
+	const uint32_t * v;
+	Vidwt26_v2 * top;
+
+	Verilated::commandArgs(argc, argv);
+	if((argc > 1) && (argv[argc - 1][0] != '+')) { path = argv[argc - 1]; }
+
+	nVectors = tbLoadVectors(path, TB_FIELDS, &vec);
+	if(nVectors == 0)
+	{
+		printf("Could not read %s.\n", path);
+		return 1;
+	}
+
+	top = new Vidwt26_v2;
+	top->opx_count_iv2_out = 0;
+	top->wr_en = 0;
+
+	for(uint32_t first = 0; first < nVectors; first += n)
+	{
+		top->SS = ss;
+		nCols = ss ? 128 : 256;
+		n = ((nVectors - first) < nCols) ? (nVectors - first) : nCols;
+
+		// Load the batch, with the pixel counter held.
+		for(m = 0; m < n; m++)
+		{
+			v = &vec[(first + m) * TB_FIELDS];
+			tbWrite(top, ss, 0, m, v[0]);
+			tbWrite(top, ss, 1, m, v[1]);
+			tbWrite(top, ss, 2, m, v[2]);
+			tbWrite(top, ss, ss ? 17 : 9, m, v[3]);
+		}
+
+		// Scan it. Starts from -1 so that count 0 is an increment.
+		for(int c = -1; c < (int)(4 * n + 6); c++)
+		{
+			m = (c - 5) / 4;
+			if((c >= 5) && ((c - 5) % 4 == 0) && (m < n)) { top->peak_thr = vec[(first + m) * TB_FIELDS + 4]; }
+
+			top->opx_count_iv2_out = c & 0xFFFFFF;
+			tbTick(top, top->opx_clk);
+
+			if((c >= 5) && ((c - 5) % 4 == 0) && (m < n))
+			{
+				nFail += tbCheck(top, &vec[(first + m) * TB_FIELDS], first + m, nFail);
+			}
+		}
+
+		ss ^= 1;
+	}
+
+	printf("idwt26_v2: %u of %u vectors mismatched.\n", nFail, nVectors);
+
+	top->final();
+	delete top;
+	free(vec);
+
+	return (nFail != 0);
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Write x to all four lanes of one URAM word.
+void tbWrite(Vidwt26_v2 * top, uint8_t ss, uint32_t row, uint32_t col, uint16_t x)
+{
+	top->wr_en = 1;
+	top->wr_addr = ss ? ((row << 7) | col) : ((row << 8) | col);
+	top->wr_data = (uint64_t) x * 0x0001000100010001ULL;
+	tbTick(top, top->opx_clk);
+	top->wr_en = 0;
+}
+
+uint32_t tbCheck(const Vidwt26_v2 * top, const uint32_t * v, uint32_t nVector, uint32_t nFail)
+{
+	uint16_t xEven, xOdd;
+	uint8_t pk;
+	uint32_t fail = 0;
+
+	for(int lane = 0; lane < 4; lane++)
+	{
+		xEven = (top->out_4px_row0 >> (16 * lane)) & 0xFFFF;
+		xOdd = (top->out_4px_row1 >> (16 * lane)) & 0xFFFF;
+		pk = (top->out_4pk >> lane) & 0x1;
+		if((xEven != v[5]) || (xOdd != v[6]) || (pk != v[7])) { fail = 1; }
+	}
+
+	if(fail && (nFail < TB_PRINT_MAX))
+	{
+		printf("Vector %u: %04x %04x %04x %04x %03x, expected %04x %04x %x, got %016llx %016llx %x (SS %d)\n",
+		       nVector, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], (unsigned long long) top->out_4px_row0,
+		       (unsigned long long) top->out_4px_row1, top->out_4pk, top->SS);
+	}
+
+	return fail;
+}
@@ -0,0 +1,88 @@
+/*
+WAVE Focus Peaking Testbench Vectors
+
+Vector file reader and clock for the Verilator testbenches of the focus peaking HDL. The vector files are written by
+the model (peakmodel -v PREFIX), one vector per line, in hex fields separated by spaces.
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __TB_VECTORS_INCLUDE__
+#define __TB_VECTORS_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// Mismatches printed before the rest are only counted.
+#define TB_PRINT_MAX 10
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// Reads every vector of a file with nFields fields per vector into a new array. Returns the number of vectors, or 0 if
+// the file can't be read or ends partway through a vector.
+static inline uint32_t tbLoadVectors(const char * path, uint32_t nFields, uint32_t ** vec)
+{
+	FILE * f;
+	uint32_t * v = NULL;
+	uint32_t n = 0;
+	uint32_t size = 0;
+	unsigned int x;
+
+	f = fopen(path, "r");
+	if(f == NULL) { return 0; }
+
+	while(fscanf(f, "%x", &x) == 1)
+	{
+		if(n == size)
+		{
+			size = size ? (size * 2) : 4096;
+			v = (uint32_t *) realloc(v, sizeof(uint32_t) * size);
+		}
+		v[n++] = x;
+	}
+	fclose(f);
+
+	if((n == 0) || (n % nFields))
+	{
+		free(v);
+		return 0;
+	}
+
+	*vec = v;
+	return n / nFields;
+}
+
+// One clock cycle: inputs set before the call are sampled at the rising edge. Registered outputs are valid on return.
+// clk is the model's clock input (a reference member in newer Verilator versions, so not a pointer to member).
+template <class T> static inline void tbTick(T * top, uint8_t & clk)
+{
+	clk = 0;
+	top->eval();
+	clk = 1;
+	top->eval();
+}
+
+#endif
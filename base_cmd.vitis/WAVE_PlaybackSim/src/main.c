@@ -0,0 +1,474 @@
+/*
+WAVE Playback Simulator
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "xil_printf.h"
+#include "frame.h"
+#include "playback.h"
+#include "clip.h"
+#include "playback_sim.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define SIM_FRAMES_MAX 0x80000
+#define SIM_SEEKS_MAX 1024
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	const char * dir;
+	int nClip;
+	float tRun_s;
+	float tService_us;
+	u32 nSeeks;
+	int badFrame;
+	playbackSimDisk_s disk;
+
+	// Synthetic clip
+	float genFps;
+	u32 genFrames;
+	u32 genFramesPerFile;
+	u16 genWidth;
+	u16 genHeight;
+	float genPreview_MB;
+	float genFrame_MB;
+} simOptions_s;
+
+// Where each frame of the clip is, from the .kwv files, to check what the decoder would be given.
+typedef struct
+{
+	u32 nFrame;
+	int nFile;
+	int fd;
+	u64 offset_B;
+	u32 csSize[4];
+} simFrame_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void simUsage(const char * name);
+int simGenerate(const simOptions_s * opt);
+void simClose(FILE * f, u64 size);
+u32 simIndex(const simOptions_s * opt);
+void simVSYNC(void);
+u8 simCheck(const FrameHeader_s * fh, u32 * iFrame);
+u32 simRand(void);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// Playback internals reported at the end.
+extern float playRate;
+extern u32 playDecimation;
+extern volatile u32 playLate;
+extern u32 playDropped;
+extern u32 playReadErrors;
+extern clipIndex_s playIndex;
+
+simFrame_s * simFrames;
+u32 simFrameCount = 0;
+u8 * simCheckBuffer;
+
+u32 simVSYNCs = 0;
+u32 simShown = 0;               // Frame changes on screen.
+u32 simMismatches = 0;
+u32 simBackwards = 0;           // Frame changes to an earlier frame without a seek.
+int simLastFrame = -1;
+
+// Time from start or seek to the first frame of the new position on screen.
+u64 simSeekTime;
+u32 simSeekFrame;
+u32 simSeekFromFrame;           // On screen when the seek was made.
+u8 simSeekPending = 0;
+u64 simSeekLatencyMax = 0;
+u64 simSeekLatencySum = 0;
+u32 simSeekLatencyCount = 0;
+
+// Steady playback since the last seek, for the speed measurement.
+u32 simRunFirstFrame;
+u64 simRunFirstTime;
+u32 simRunLastFrame;
+u64 simRunLastTime;
+u8 simRunValid = 0;
+
+u32 simRandState = 0x12345678;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Same use of playbackVSYNC() as isrVSYNC(), plus a check of the frame the decoder would read.
+void simVSYNC(void)
+{
+	FrameHeader_s * fh;
+	u32 iFrame;
+
+	simVSYNCs++;
+
+	fh = playbackVSYNC();
+	if(fh == NULL) { return; }
+
+	if(!simCheck(fh, &iFrame))
+	{
+		simMismatches++;
+		return;
+	}
+	if((int) iFrame == simLastFrame) { return; }
+
+	if(simSeekPending)
+	{
+		// Still the frame on screen before the seek. The one after the target is shown if the target can't be read.
+		if((iFrame < simSeekFrame) || ((iFrame != simSeekFrame) && (iFrame == simSeekFromFrame))) { return; }
+		simSeekPending = 0;
+		simSeekLatencySum += playbackSimTime() - simSeekTime;
+		simSeekLatencyCount++;
+		if(playbackSimTime() - simSeekTime > simSeekLatencyMax) { simSeekLatencyMax = playbackSimTime() - simSeekTime; }
+		simRunFirstFrame = iFrame;
+		simRunFirstTime = playbackSimTime();
+		simRunValid = 0;
+	}
+	else if((int) iFrame < simLastFrame) { simBackwards++; }
+	else
+	{
+		simRunLastFrame = iFrame;
+		simRunLastTime = playbackSimTime();
+		simRunValid = 1;
+	}
+
+	simLastFrame = iFrame;
+	simShown++;
+}
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+	simOptions_s opt = {".", 0, 10.0f, 20.0f, 0, -1, {1500.0f, 100.0f, 512, 16, 0, NULL, 0},
+	                    0.0f, 300, 100, 4096, 3072, 0.75f, 3.0f};
+	playbackSimStats_s stats;
+	char badPath[1100];
+	u64 tSeekNext = 0;
+	u32 nSeeks = 0;
+	int status;
+	int c;
+
+	while((c = getopt(argc, argv, "t:c:k:b:l:4x:e:E:g:n:f:w:h:m:M:")) != -1)
+	{
+		switch(c)
+		{
+		case 't': opt.tRun_s = strtof(optarg, NULL); break;
+		case 'c': opt.tService_us = strtof(optarg, NULL); break;
+		case 'k': opt.nSeeks = strtoul(optarg, NULL, 0); break;
+		case 'b': opt.disk.bwRead_MBps = strtof(optarg, NULL); break;
+		case 'l': opt.disk.tRead_us = strtof(optarg, NULL); break;
+		case '4': opt.disk.sizeLBA = 4096; break;
+		case 'x': opt.disk.sizeFragment_MiB = strtoul(optarg, NULL, 0); break;
+		case 'e': opt.disk.failEvery = strtoul(optarg, NULL, 0); break;
+		case 'E': opt.badFrame = strtol(optarg, NULL, 0); break;
+		case 'g': opt.genFps = strtof(optarg, NULL); break;
+		case 'n': opt.genFrames = strtoul(optarg, NULL, 0); break;
+		case 'f': opt.genFramesPerFile = strtoul(optarg, NULL, 0); break;
+		case 'w': opt.genWidth = strtoul(optarg, NULL, 0); break;
+		case 'h': opt.genHeight = strtoul(optarg, NULL, 0); break;
+		case 'm': opt.genPreview_MB = strtof(optarg, NULL); break;
+		case 'M': opt.genFrame_MB = strtof(optarg, NULL); break;
+		default: simUsage(argv[0]); return 1;
+		}
+	}
+	if((argc - optind != 2) || (opt.disk.sizeFragment_MiB == 0)) { simUsage(argv[0]); return 1; }
+	opt.dir = argv[optind];
+	opt.nClip = strtol(argv[optind + 1], NULL, 0);
+
+	if((opt.genFps > 0.0f) && simGenerate(&opt)) { return 1; }
+
+	simFrames = malloc(SIM_FRAMES_MAX * sizeof(simFrame_s));
+	simCheckBuffer = malloc(64 << 20);
+	if(simIndex(&opt) == 0) { xil_printf("No frames found in %s/c%04d.\r\n", opt.dir, opt.nClip); return 1; }
+
+	// A bad block on a frame header: the firmware can't size the frame and has to find the next one.
+	if((opt.badFrame >= 0) && ((u32) opt.badFrame < simFrameCount))
+	{
+		snprintf(badPath, sizeof(badPath), "%s/c%04d/f%06d.kwv", opt.dir, opt.nClip, simFrames[opt.badFrame].nFile);
+		opt.disk.failPath = badPath;
+		opt.disk.failOffset_B = simFrames[opt.badFrame].offset_B + 64;
+	}
+
+	status = playbackSimStart(opt.dir, &opt.disk, simVSYNC);
+	if(status != PLAYBACK_SIM_OK) { return 1; }
+
+	status = playbackStart(opt.nClip);
+	if(status != PLAYBACK_OK) { xil_printf("playbackStart() failed: %d\r\n", status); return 1; }
+	simSeekTime = playbackSimTime();
+	simSeekFrame = 0;
+	simSeekFromFrame = 0xFFFFFFFF;
+	simSeekPending = 1;
+	if(opt.nSeeks) { tSeekNext = (u64)(opt.tRun_s * 1e9f) / (opt.nSeeks + 1); }
+
+	// Main loop: playbackService() as often as the camera's main loop would call it.
+	while(playbackSimTime() < (u64)(opt.tRun_s * 1e9f))
+	{
+		playbackService();
+		playbackSimAdvance(playbackSimTime() + (u64)(opt.tService_us * 1000.0f));
+
+		// Jump to random frames at even intervals and keep playing, also after the end of the clip.
+		if((nSeeks < opt.nSeeks) && (playbackSimTime() >= tSeekNext * (nSeeks + 1)))
+		{
+			simSeekFrame = simFrames[simRand() % (simFrameCount - simFrameCount / 8)].nFrame;
+			for(u32 i = 0; i < simFrameCount; i++) { if(simFrames[i].nFrame == simSeekFrame) { simSeekFrame = i; break; } }
+			simSeekTime = playbackSimTime();
+			simSeekFromFrame = playbackGetFrame();
+			simSeekPending = 1;
+			playbackSeek(simSeekFrame);
+			playbackPause(0);
+			nSeeks++;
+		}
+	}
+
+	playbackStop();
+	playbackSimGetStats(&stats);
+
+	xil_printf("Clip c%04d: %u frames, %.1f fps recorded, %u indexed by the firmware%s.\r\n", opt.nClip, simFrameCount,
+	           playRate, playbackGetFrameCount(), playIndex.complete ? "" : " (incomplete)");
+	xil_printf("Every %u shown: %.2f fps on HDMI at %d Hz.\r\n", playDecimation, playRate / playDecimation,
+	           PLAYBACK_VSYNC_HZ);
+	xil_printf("%.2fs: %u VSYNCs, %u frame changes, %u late VSYNCs, %u frames dropped.\r\n",
+	           playbackSimTime() * 1e-9, simVSYNCs, simShown, playLate, playDropped);
+	if(simRunValid && (simRunLastTime > simRunFirstTime))
+	{
+		xil_printf("Speed %.3fx real time: frames %u to %u in %.3fs.\r\n",
+		           (simRunLastFrame - simRunFirstFrame) / playRate / ((simRunLastTime - simRunFirstTime) * 1e-9),
+		           simRunFirstFrame, simRunLastFrame, (simRunLastTime - simRunFirstTime) * 1e-9);
+	}
+	if(simSeekLatencyCount)
+	{
+		xil_printf("First frame on screen after start or seek: %.1fms average, %.1fms max (%u of %u).\r\n",
+		           simSeekLatencySum * 1e-6 / simSeekLatencyCount, simSeekLatencyMax * 1e-6, simSeekLatencyCount,
+		           nSeeks + 1);
+	}
+	xil_printf("SSD: %.1fMB in %llu commands, %.1fMB/s.\r\n", stats.bytesRead * 1e-6,
+	           (unsigned long long) stats.nReadCommands, stats.bytesRead * 1e-6 / (playbackSimTime() * 1e-9));
+	if(stats.nFailedCommands)
+	{
+		xil_printf("%u read commands failed, %u frames skipped for read errors.\r\n", stats.nFailedCommands,
+		           playReadErrors);
+	}
+	xil_printf("Checks: %u mismatches, %u backward steps, %u bad commands.\r\n", simMismatches, simBackwards,
+	           stats.nBadCommands);
+
+	playbackSimStop();
+
+	return (simMismatches || simBackwards || stats.nBadCommands) ? 1 : 0;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+void simUsage(const char * name)
+{
+	xil_printf("Usage: %s [options] <dir> <clip>\r\n", name);
+	xil_printf("Plays <dir>/cNNNN/ (e.g. pulled with waveusb) through playback.c against a modelled SSD.\r\n");
+	xil_printf("  -t s        Simulated time. Default 10.\r\n");
+	xil_printf("  -c us       Main loop time between playbackService() calls. Default 20.\r\n");
+	xil_printf("  -k n        Scrub to n random frames at even intervals.\r\n");
+	xil_printf("  -b MB/s     SSD read bandwidth. Default 1500.\r\n");
+	xil_printf("  -l us       SSD read latency. Default 100.\r\n");
+	xil_printf("  -4          4KiB LBAs.\r\n");
+	xil_printf("  -x MiB      Contiguous run size of the clip files on the disk. Default 16.\r\n");
+	xil_printf("  -e n        Fail every nth read command.\r\n");
+	xil_printf("  -E frame    Fail every read of this frame's header.\r\n");
+	xil_printf("  -g fps      First write a synthetic clip at this frame rate, with:\r\n");
+	xil_printf("  -n frames   Frames. Default 300.\r\n");
+	xil_printf("  -f frames   Frames per file. Default 100.\r\n");
+	xil_printf("  -w, -h px   Frame size. Default 4096x3072.\r\n");
+	xil_printf("  -m MB       LL2, LH2, HL2 and HH2 codestreams per frame. Default 0.75.\r\n");
+	xil_printf("  -M MB       All codestreams per frame. Default 3.0. Only the preview codestreams hold data.\r\n");
+}
+
+// Same layout as frameCreateClip() and frameRecord(): clip info file, then frame headers and 16 codestreams.
+int simGenerate(const simOptions_s * opt)
+{
+	char path[1100];
+	ClipHeader_s ch;
+	FrameHeader_s fh;
+	const float csShare[16] = {0.4f, 0.25f, 0.25f, 0.1f};
+	u64 offset = 0;
+	u8 * data;
+	FILE * f = NULL;
+	u32 sizeOther;
+
+	snprintf(path, sizeof(path), "%s/c%04d", opt->dir, opt->nClip);
+	mkdir(opt->dir, 0755);
+	mkdir(path, 0755);
+
+	memset(&ch, 0, sizeof(ch));
+	memcpy(ch.strDelimiter, "WAVE HELLO!\n", 12);
+	ch.wFrame = opt->genWidth;
+	ch.hFrame = opt->genHeight;
+	ch.fps = opt->genFps;
+	snprintf(path, sizeof(path), "%s/c%04d/c%04d.kwi", opt->dir, opt->nClip, opt->nClip);
+	f = fopen(path, "wb");
+	if(f == NULL) { perror(path); return 1; }
+	fwrite(&ch, sizeof(ch), 1, f);
+	fclose(f);
+	f = NULL;
+
+	data = malloc((u32)(opt->genPreview_MB * 2e6f) + 0x10000);
+	sizeOther = (u32)((opt->genFrame_MB - opt->genPreview_MB) * 1e6f / 12.0f) & ~0x1FF;
+
+	for(u32 i = 0; i < opt->genFrames; i++)
+	{
+		if((i % opt->genFramesPerFile) == 0)
+		{
+			if(f) { simClose(f, offset); }
+			snprintf(path, sizeof(path), "%s/c%04d/f%06d.kwv", opt->dir, opt->nClip, i / opt->genFramesPerFile);
+			f = fopen(path, "wb");
+			if(f == NULL) { perror(path); return 1; }
+			offset = 0;
+		}
+
+		memset(&fh, 0, sizeof(fh));
+		memcpy(fh.strDelimiter, "WAVE HELLO!\n", 12);
+		fh.nFrame = 1000 + i;
+		fh.wFrame = opt->genWidth;
+		fh.hFrame = opt->genHeight;
+		fh.q_mult_HH2_HL2_LH2 = 0x00400040;
+		for(int iCS = 0; iCS < 16; iCS++)
+		{
+			// Codestream sizes are whole 512B RAM writes, and vary from frame to frame.
+			if(iCS < 4) { fh.csSize[iCS] = (u32)(opt->genPreview_MB * 1e6f * csShare[iCS] * (0.8f + 0.4f * (simRand() % 1000) / 1000.0f)); }
+			else { fh.csSize[iCS] = sizeOther; }
+			fh.csSize[iCS] &= ~0x1FF;
+			fh.csAddr[iCS] = 0x20000000 + iCS * 0x3000000;
+			fh.csFIFOState[iCS] = simRand() % 64;
+		}
+
+		fwrite(&fh, sizeof(fh), 1, f);
+		offset += sizeof(fh);
+		for(int iCS = 0; iCS < 4; iCS++)
+		{
+			for(u32 j = 0; j < fh.csSize[iCS]; j += 4) { *(u32 *)(data + j) = simRand(); }
+			fwrite(data, 1, fh.csSize[iCS], f);
+			offset += fh.csSize[iCS];
+		}
+
+		// The rest of the codestreams are holes: playback never reads them.
+		offset += 12 * (u64) sizeOther;
+		fseek(f, offset, SEEK_SET);
+	}
+	if(f) { simClose(f, offset); }
+	free(data);
+
+	xil_printf("Wrote c%04d: %u frames, %ux%u, %.1f fps.\r\n", opt->nClip, opt->genFrames, opt->genWidth, opt->genHeight,
+	           opt->genFps);
+	return 0;
+}
+
+// Extend the file over the codestreams skipped at its end.
+void simClose(FILE * f, u64 size)
+{
+	fflush(f);
+	if(ftruncate(fileno(f), size)) { perror("ftruncate"); }
+	fclose(f);
+}
+
+// Walk the frame headers of the clip's .kwv files, independently of the firmware's index.
+u32 simIndex(const simOptions_s * opt)
+{
+	char path[1100];
+	FrameHeader_s fh;
+	struct stat st;
+	u64 offset, size;
+	int fd;
+
+	for(int nFile = 0; ; nFile++)
+	{
+		snprintf(path, sizeof(path), "%s/c%04d/f%06d.kwv", opt->dir, opt->nClip, nFile);
+		fd = open(path, O_RDONLY);
+		if(fd < 0) { break; }
+		fstat(fd, &st);
+
+		offset = 0;
+		while((offset + sizeof(fh) <= (u64) st.st_size) && (simFrameCount < SIM_FRAMES_MAX))
+		{
+			if(pread(fd, &fh, sizeof(fh), offset) != sizeof(fh)) { break; }
+			size = sizeof(fh);
+			for(int iCS = 0; iCS < 16; iCS++) { size += fh.csSize[iCS]; }
+			if((memcmp(fh.strDelimiter, "WAVE HELLO!\n", 12) != 0) || (offset + size > (u64) st.st_size)) { break; }
+
+			simFrames[simFrameCount].nFrame = fh.nFrame;
+			simFrames[simFrameCount].nFile = nFile;
+			simFrames[simFrameCount].fd = fd;
+			simFrames[simFrameCount].offset_B = offset;
+			memcpy(simFrames[simFrameCount].csSize, fh.csSize, sizeof(simFrames[0].csSize));
+			simFrameCount++;
+			offset += size;
+		}
+	}
+
+	return simFrameCount;
+}
+
+// The header handed to the decoder must be the frame's own, with LL2, LH2, HL2 and HH2 addresses pointing at exactly
+// the bytes recorded in the .kwv file.
+u8 simCheck(const FrameHeader_s * fh, u32 * iFrame)
+{
+	simFrame_s * sf = NULL;
+	u32 size = 0;
+	u32 lo = 0, hi = simFrameCount;
+
+	// Frame numbers increase through the clip.
+	while(lo < hi)
+	{
+		u32 mid = (lo + hi) / 2;
+		if(simFrames[mid].nFrame < fh->nFrame) { lo = mid + 1; }
+		else { hi = mid; }
+	}
+	if((lo == simFrameCount) || (simFrames[lo].nFrame != fh->nFrame)) { return 0; }
+	sf = &simFrames[lo];
+	*iFrame = lo;
+
+	for(int iCS = 0; iCS < 4; iCS++)
+	{
+		if(fh->csSize[iCS] != sf->csSize[iCS]) { return 0; }
+		if(fh->csAddr[iCS] != (u32)((u64) fh + sizeof(FrameHeader_s) + size)) { return 0; }
+		size += sf->csSize[iCS];
+	}
+
+	if(pread(sf->fd, simCheckBuffer, size, sf->offset_B + sizeof(FrameHeader_s)) != size) { return 0; }
+	return (memcmp(simCheckBuffer, (u8 *)((u64) fh->csAddr[0]), size) == 0);
+}
+
+u32 simRand(void)
+{
+	simRandState ^= simRandState << 13;
+	simRandState ^= simRandState >> 17;
+	simRandState ^= simRandState << 5;
+	return simRandState;
+}
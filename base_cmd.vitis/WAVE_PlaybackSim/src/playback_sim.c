@@ -0,0 +1,433 @@
+/*
+WAVE Playback Simulator Disk and Clock Model
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "xil_types.h"
+#include "xtime_l.h"
+#include "ff.h"
+#include "fs.h"
+#include "nvme.h"
+#include "playback.h"
+#include "playback_sim.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Same fixed DDR4 window as playback.c: header buffer, clip index, and read-ahead ring.
+#define SIM_DDR_BASE            0x7B7F0000
+#define SIM_DDR_SIZE            0x04810000u
+
+#define SIM_IO_QUEUE            64          // I/O submission queue depth, as nvme.c.
+#define SIM_FILES_MAX           4096
+#define SIM_POLL_NS             1000        // Time spent by one completion poll that finds nothing.
+#define SIM_VSYNC_NS            (1000000000ULL / PLAYBACK_VSYNC_HZ)
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	char path[1024];
+	int fd;
+	u64 size_B;
+	u64 nRuns;
+} simFile_s;
+
+typedef struct
+{
+	u8 busy;
+	u16 cid;
+	u8 * dest;
+	int iFile;                  // -1: outside any file.
+	u64 offset_B;
+	u32 size_B;
+	u64 tDone;
+	u8 fail;
+} simCommand_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+int simOpen(const char * path);
+u64 simRunLBAs(void);
+u32 simComplete(u16 maxCompletions);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+const char * simDir;
+playbackSimDisk_s simDisk;
+playbackSimStats_s simStats;
+void (*simISR)(void);
+
+u64 simNow = 0;
+u64 simNextVSYNC = SIM_VSYNC_NS;
+u64 simChannelFree = 0;
+u8 simInISR = 0;
+
+simFile_s simFile[SIM_FILES_MAX];
+u32 simFiles = 0;
+int simOpenFile = -1;           // File open for reading through the fs API.
+u64 simOpenPos = 0;
+
+simCommand_s simCommand[SIM_IO_QUEUE];
+u16 simCID = 0;
+u8 simCIDFailed[SIM_IO_QUEUE];  // Indexed by CID, as in nvme.c.
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int playbackSimStart(const char * dir, const playbackSimDisk_s * disk, void (*isrVSYNC)(void))
+{
+	void * p = mmap((void *) SIM_DDR_BASE, SIM_DDR_SIZE, PROT_READ | PROT_WRITE,
+	                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0);
+	if(p != (void *) SIM_DDR_BASE)
+	{
+		printf("Unable to map 0x%08X-0x%08X. Build with -no-pie.\r\n", SIM_DDR_BASE, SIM_DDR_BASE + (u32) SIM_DDR_SIZE);
+		return PLAYBACK_SIM_ERROR_MAP;
+	}
+
+	simDir = dir;
+	memcpy(&simDisk, disk, sizeof(playbackSimDisk_s));
+	memset(&simStats, 0, sizeof(playbackSimStats_s));
+	simISR = isrVSYNC;
+
+	return PLAYBACK_SIM_OK;
+}
+
+void playbackSimStop(void)
+{
+	for(u32 i = 0; i < simFiles; i++) { close(simFile[i].fd); }
+	simFiles = 0;
+	munmap((void *) SIM_DDR_BASE, SIM_DDR_SIZE);
+}
+
+u64 playbackSimTime(void)
+{
+	return simNow;
+}
+
+// Run the clock to t_ns. VSYNCs on the way interrupt the caller, as they would on the camera.
+void playbackSimAdvance(u64 t_ns)
+{
+	while(!simInISR && (simNextVSYNC <= t_ns))
+	{
+		simNow = simNextVSYNC;
+		simNextVSYNC += SIM_VSYNC_NS;
+		simInISR = 1;
+		simISR();
+		simInISR = 0;
+	}
+	if(t_ns > simNow) { simNow = t_ns; }
+}
+
+void playbackSimGetStats(playbackSimStats_s * stats)
+{
+	memcpy(stats, &simStats, sizeof(playbackSimStats_s));
+}
+
+// Firmware API: XTime -------------------------------------------------------------------------------------------------
+
+void XTime_GetTime(XTime * Xtime_Global)
+{
+	*Xtime_Global = simNow;
+}
+
+// Firmware API: fs.c --------------------------------------------------------------------------------------------------
+
+int fsOpenClipFile(int nClipRead, int nFileRead)
+{
+	char path[1100];
+
+	snprintf(path, sizeof(path), "%s/c%04d/f%06d.kwv", simDir, nClipRead, nFileRead);
+	simOpenFile = simOpen(path);
+	simOpenPos = 0;
+	return (simOpenFile < 0) ? FR_NO_FILE : FR_OK;
+}
+
+int fsOpenClipInfoFile(int nClipRead)
+{
+	char path[1100];
+
+	snprintf(path, sizeof(path), "%s/c%04d/c%04d.kwi", simDir, nClipRead, nClipRead);
+	simOpenFile = simOpen(path);
+	simOpenPos = 0;
+	return (simOpenFile < 0) ? FR_NO_FILE : FR_OK;
+}
+
+u64 fsGetClipFileSize(void)
+{
+	return (simOpenFile < 0) ? 0 : simFile[simOpenFile].size_B;
+}
+
+// One extent per run. Each file has its own LBA space, (file + 1) << 32, with its runs in reverse order.
+u32 fsGetClipFileExtents(fsExtent_s * extents, u32 maxExtents)
+{
+	simFile_s * f;
+	u64 runLBAs = simRunLBAs();
+	u64 sizeRun = runLBAs * simDisk.sizeLBA;
+
+	if(simOpenFile < 0) { return 0; }
+	f = &simFile[simOpenFile];
+	if(f->nRuns > maxExtents) { return 0; }
+
+	for(u64 r = 0; r < f->nRuns; r++)
+	{
+		extents[r].offset_B = r * sizeRun;
+		extents[r].size_B = ((r + 1) * sizeRun > f->size_B) ? (f->size_B - r * sizeRun) : sizeRun;
+		extents[r].lba = ((u64)(simOpenFile + 1) << 32) + (f->nRuns - 1 - r) * runLBAs;
+	}
+
+	return (u32) f->nRuns;
+}
+
+int fsSeekClipFile(u64 offset)
+{
+	simOpenPos = offset;
+	return FR_OK;
+}
+
+int fsReadClipFile(u64 destAddress, u32 size)
+{
+	if(simOpenFile < 0) { return FR_INVALID_OBJECT; }
+	if(pread(simFile[simOpenFile].fd, (void *) destAddress, size, simOpenPos) != size) { return FR_DENIED; }
+	simOpenPos += size;
+	return FR_OK;
+}
+
+void fsCloseClipFile(void)
+{
+	simOpenFile = -1;
+}
+
+// Firmware API: nvme.c ------------------------------------------------------------------------------------------------
+
+u16 nvmeGetLBASize(void)
+{
+	return simDisk.sizeLBA;
+}
+
+int nvmeEnterStandby(void)
+{
+	return 0;
+}
+
+int nvmeExitStandby(void)
+{
+	return 0;
+}
+
+int nvmeRead(u8 * destByte, u64 srcLBA, u32 numLBA)
+{
+	simCommand_s * cmd = NULL;
+	u64 runLBAs = simRunLBAs();
+	u64 iFile = (srcLBA >> 32) - 1;
+	u64 rel = srcLBA & 0xFFFFFFFF;
+	u64 slot;
+	simFile_s * f;
+
+	if((u64) destByte & 0x3) { return 1; }
+
+	// Wait for a free submission queue slot.
+	while(cmd == NULL)
+	{
+		for(int i = 0; i < SIM_IO_QUEUE; i++) { if(!simCommand[i].busy) { cmd = &simCommand[i]; break; } }
+		if(cmd == NULL) { nvmeServiceIOCompletions(16); }
+	}
+
+	cmd->busy = 1;
+	cmd->cid = simCID++;
+	cmd->dest = destByte;
+	cmd->size_B = numLBA * simDisk.sizeLBA;
+	cmd->iFile = -1;
+	cmd->fail = (simDisk.failEvery > 0) && ((simStats.nReadCommands + 1) % simDisk.failEvery == 0);
+	simCIDFailed[cmd->cid % SIM_IO_QUEUE] = 0;
+
+	// Back to the file offset, through the reversed runs.
+	if(iFile < simFiles)
+	{
+		f = &simFile[iFile];
+		slot = rel / runLBAs;
+		if((slot < f->nRuns) && ((rel % runLBAs) + numLBA <= runLBAs))
+		{
+			cmd->iFile = (int) iFile;
+			cmd->offset_B = ((f->nRuns - 1 - slot) * runLBAs + rel % runLBAs) * simDisk.sizeLBA;
+		}
+	}
+	if(cmd->iFile < 0) { simStats.nBadCommands++; }
+	else if((simDisk.failPath != NULL) && (strcmp(simFile[cmd->iFile].path, simDisk.failPath) == 0)
+	     && (simDisk.failOffset_B >= cmd->offset_B) && (simDisk.failOffset_B < cmd->offset_B + cmd->size_B))
+	{
+		cmd->fail = 1;
+	}
+
+	if(simChannelFree < simNow) { simChannelFree = simNow; }
+	if(simDisk.bwRead_MBps > 0.0f) { simChannelFree += (u64)(cmd->size_B * 1000.0 / simDisk.bwRead_MBps); }
+	cmd->tDone = simChannelFree + (u64)(simDisk.tRead_us * 1000.0f);
+
+	simStats.nReadCommands++;
+	simStats.bytesRead += cmd->size_B;
+
+	return 0;
+}
+
+// Polling for completions takes time when there are none, so spin-waits in the firmware move the clock forward.
+int nvmeServiceIOCompletions(u16 maxCompletions)
+{
+	u32 n = simComplete(maxCompletions);
+	u8 pending = 0;
+
+	for(int i = 0; i < SIM_IO_QUEUE; i++) { pending |= simCommand[i].busy; }
+	if((n == 0) && pending) { playbackSimAdvance(simNow + SIM_POLL_NS); }
+
+	return n;
+}
+
+// Playback never writes, so there are no writes to wait for.
+void nvmeWaitForWrites(u64 lba, u32 numLBA)
+{
+	(void) lba;
+	(void) numLBA;
+}
+
+u16 nvmeGetIOCID(void)
+{
+	return simCID;
+}
+
+u32 nvmeGetIOErrorCount(void)
+{
+	return simStats.nFailedCommands;
+}
+
+u8 nvmeIOCompleted(u16 cid)
+{
+	for(int i = 0; i < SIM_IO_QUEUE; i++)
+	{
+		if(simCommand[i].busy && (simCommand[i].cid == cid)) { return 0; }
+	}
+	return 1;
+}
+
+int nvmeCheckCIDRange(u16 cidFirst, u16 nCommands)
+{
+	int status = NVME_IO_OK;
+	u16 cid;
+
+	for(u16 c = 0; c < nCommands; c++)
+	{
+		cid = cidFirst + c;
+		if((u16)(simCID - cid) > SIM_IO_QUEUE) { continue; }
+
+		if(!nvmeIOCompleted(cid)) { return NVME_IO_PENDING; }
+		if(simCIDFailed[cid % SIM_IO_QUEUE]) { status = NVME_IO_ERROR; }
+	}
+
+	return status;
+}
+
+int nvmeWaitCIDRange(u16 cidFirst, u16 nCommands)
+{
+	int status;
+
+	while((status = nvmeCheckCIDRange(cidFirst, nCommands)) == NVME_IO_PENDING)
+	{
+		nvmeServiceIOCompletions(16);
+	}
+
+	return status;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+int simOpen(const char * path)
+{
+	struct stat st;
+	u64 sizeRun = simRunLBAs() * simDisk.sizeLBA;
+	int fd;
+
+	for(u32 i = 0; i < simFiles; i++)
+	{
+		if(strcmp(simFile[i].path, path) == 0) { return i; }
+	}
+
+	if(simFiles == SIM_FILES_MAX) { return -1; }
+	fd = open(path, O_RDONLY);
+	if(fd < 0) { return -1; }
+	fstat(fd, &st);
+
+	snprintf(simFile[simFiles].path, sizeof(simFile[simFiles].path), "%s", path);
+	simFile[simFiles].fd = fd;
+	simFile[simFiles].size_B = st.st_size;
+	simFile[simFiles].nRuns = (st.st_size + sizeRun - 1) / sizeRun;
+
+	return simFiles++;
+}
+
+u64 simRunLBAs(void)
+{
+	return ((u64) simDisk.sizeFragment_MiB << 20) / simDisk.sizeLBA;
+}
+
+// Commands whose completion time has passed copy their data into place and free their slot.
+u32 simComplete(u16 maxCompletions)
+{
+	simCommand_s * cmd;
+	ssize_t n;
+	u32 nCompleted = 0;
+
+	for(int i = 0; (i < SIM_IO_QUEUE) && (nCompleted < maxCompletions); i++)
+	{
+		cmd = &simCommand[i];
+		if(!cmd->busy || (cmd->tDone > simNow)) { continue; }
+
+		// A failed read leaves garbage, which the VSYNC check catches if the frame is ever shown.
+		if(cmd->fail)
+		{
+			memset(cmd->dest, 0xA5, cmd->size_B);
+			simCIDFailed[cmd->cid % SIM_IO_QUEUE] = 1;
+			simStats.nFailedCommands++;
+			cmd->busy = 0;
+			nCompleted++;
+			continue;
+		}
+
+		n = 0;
+		if(cmd->iFile >= 0) { n = pread(simFile[cmd->iFile].fd, cmd->dest, cmd->size_B, cmd->offset_B); }
+		if(n < 0) { n = 0; }
+		memset(cmd->dest + n, 0, cmd->size_B - n);		// Past the end of the file.
+
+		cmd->busy = 0;
+		nCompleted++;
+	}
+
+	return nCompleted;
+}
@@ -0,0 +1,69 @@
+/*
+WAVE Playback Simulator Disk and Clock Model Include
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __PLAYBACK_SIM_INCLUDE__
+#define __PLAYBACK_SIM_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+#define PLAYBACK_SIM_OK                    0x00000000
+#define PLAYBACK_SIM_ERROR_MAP             0x00000001
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// SSD read model. Commands share the bandwidth in submission order and complete a fixed latency after their data.
+typedef struct
+{
+	float bwRead_MBps;          // Sustained read bandwidth [MB/s]
+	float tRead_us;             // Read command latency [us]
+	u16 sizeLBA;                // LBA size [B]
+	u32 sizeFragment_MiB;       // Clip files are split into runs of this size, laid out on the disk in reverse order.
+	u32 failEvery;              // Every Nth read command completes with an error status and no data. 0: none.
+	const char * failPath;      // Every read of byte failOffset_B of this file fails too, as on a bad block. NULL: none.
+	u64 failOffset_B;
+} playbackSimDisk_s;
+
+typedef struct
+{
+	u64 nReadCommands;
+	u64 bytesRead;
+	u32 nBadCommands;           // Reads outside a file or across two of its runs.
+	u32 nFailedCommands;        // Reads failed on purpose, see failEvery.
+} playbackSimStats_s;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+int playbackSimStart(const char * dir, const playbackSimDisk_s * disk, void (*isrVSYNC)(void));
+void playbackSimStop(void);
+u64 playbackSimTime(void);
+void playbackSimAdvance(u64 t_ns);
+void playbackSimGetStats(playbackSimStats_s * stats);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
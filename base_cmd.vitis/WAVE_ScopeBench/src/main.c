@@ -0,0 +1,280 @@
+/*
+WAVE Exposure Scope Benchmark
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "xil_printf.h"
+#include "frame.h"
+#include "scope.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// LL2 codestream at its DDR4 address, mapped at the same virtual address.
+#define BENCH_LL2_ADDR 0x20000000
+#define BENCH_LL2_SIZE (16 << 20)
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	u16 wFrame;
+	u16 hFrame;
+	u32 bitDiscard;
+	u32 nScans;
+	u32 tBudget_us;
+} benchOptions_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void benchUsage(const char * name);
+void benchGenerate(const benchOptions_s * opt, FrameHeader_s * fh, u16 * px);
+void benchReference(const benchOptions_s * opt, const u16 * px, Scope_s * ref);
+u32 bitOffsetInLL2(u16 x, u16 y, u8 color, u16 wLL2);
+u32 benchRand(void);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+u32 benchRandState = 0x12345678;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+	benchOptions_s opt = {4096, 3072, 37, 100, 2000};
+	FrameHeader_s fh;
+	Scope_s ref;
+	u16 * px;
+	XTime tStart, tEnd;
+	u32 count, calls;
+	u32 rows;
+	u32 mismatches = 0;
+	double tScan_us;
+	int c;
+
+	while((c = getopt(argc, argv, "2h:d:n:b:")) != -1)
+	{
+		switch(c)
+		{
+		case '2': opt.wFrame = 2048; break;
+		case 'h': opt.hFrame = strtoul(optarg, NULL, 0); break;
+		case 'd': opt.bitDiscard = strtoul(optarg, NULL, 0); break;
+		case 'n': opt.nScans = strtoul(optarg, NULL, 0); break;
+		case 'b': opt.tBudget_us = strtoul(optarg, NULL, 0); break;
+		default: benchUsage(argv[0]); return 1;
+		}
+	}
+	if((argc != optind) || (opt.nScans == 0) || (opt.hFrame < 8) || (opt.hFrame > 3072) || (opt.bitDiscard > 127))
+	{ benchUsage(argv[0]); return 1; }
+
+	if(mmap((void *) BENCH_LL2_ADDR, BENCH_LL2_SIZE, PROT_READ | PROT_WRITE,
+	        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void *) BENCH_LL2_ADDR)
+	{
+		xil_printf("Unable to map 0x%08X-0x%08X. Build with -no-pie.\r\n", BENCH_LL2_ADDR, BENCH_LL2_ADDR + BENCH_LL2_SIZE);
+		return 1;
+	}
+
+	px = malloc(sizeof(u16) * 4 * (opt.wFrame >> 3) * (opt.hFrame >> 3));
+	benchGenerate(&opt, &fh, px);
+	benchReference(&opt, px, &ref);
+	rows = ((opt.hFrame >> 3) + SCOPE_ROW_STEP - 1) / SCOPE_ROW_STEP;
+
+	// Scans at the given budget per call, as the main loop runs them: check every result.
+	scopeInit();
+	calls = 0;
+	XTime_GetTime(&tStart);
+	for(u32 n = 0; n < opt.nScans; n++)
+	{
+		fh.nFrame = n;
+		scopeVSYNC(&fh);
+		count = scopeGetResultCount();
+		while(scopeGetResultCount() == count)
+		{
+			scopeService(opt.tBudget_us);
+			calls++;
+		}
+
+		ref.nFrame = n;
+		if(memcmp(scopeGetResult(), &ref, sizeof(Scope_s)) != 0) { mismatches++; }
+	}
+	XTime_GetTime(&tEnd);
+	tScan_us = (double)(tEnd - tStart) / 1000.0 / opt.nScans;
+
+	xil_printf("%dx%d, %d discarded bits: %d of %d LL2 rows per scan.\r\n", opt.wFrame, opt.hFrame, opt.bitDiscard,
+	           rows, opt.hFrame >> 3);
+#ifdef __ARM_NEON
+	xil_printf("NEON unpack.\r\n");
+#else
+	xil_printf("Scalar unpack.\r\n");
+#endif
+	printf("%.1fus per scan, %.2fus per row, %.2fns per pixel.\r\n", tScan_us, tScan_us / rows,
+	       tScan_us * 1000.0 / (rows * 4.0 * (opt.wFrame >> 3)));
+	printf("%.2f calls per scan at %dus budget per call.\r\n", (double) calls / opt.nScans, opt.tBudget_us);
+	xil_printf("%d of %d scans mismatched the reference.\r\n", mismatches, opt.nScans);
+
+	free(px);
+	return (mismatches != 0);
+}
+
+// Firmware API: XTime -------------------------------------------------------------------------------------------------
+
+void XTime_GetTime(XTime * Xtime_Global)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	*Xtime_Global = (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+void benchUsage(const char * name)
+{
+	xil_printf("Usage: %s [options]\r\n", name);
+	xil_printf("  -2       2K frame (default 4K).\r\n");
+	xil_printf("  -h <px>  Frame height (default 3072).\r\n");
+	xil_printf("  -d <b>   LL2 bits discarded, 0 to 127 (default 37).\r\n");
+	xil_printf("  -n <n>   Scans (default 100).\r\n");
+	xil_printf("  -b <us>  Budget per scopeService() call (default 2000).\r\n");
+}
+
+// A test chart in every color field: a horizontal ramp, a clipped patch at the top right, and noise. It's packed into
+// LL2 with the firmware's own mapping, after the discarded bits and pixels.
+void benchGenerate(const benchOptions_s * opt, FrameHeader_s * fh, u16 * px)
+{
+	u16 wLL2 = opt->wFrame >> 3;
+	u16 hLL2 = opt->hFrame >> 3;
+	u32 pxDiscard = (wLL2 == 512) ? 6336 : 3328;
+	u8 * ll2 = (u8 *) BENCH_LL2_ADDR;
+	u32 bit;
+	u16 v;
+
+	memset(fh, 0, sizeof(FrameHeader_s));
+	fh->wFrame = opt->wFrame;
+	fh->hFrame = opt->hFrame;
+	fh->csAddr[0] = BENCH_LL2_ADDR;
+	fh->csFIFOState[0] = opt->bitDiscard & 0x3F;
+	fh->csFIFOFlags = (opt->bitDiscard & 0x40) ? (1 << 16) : 0;
+
+	memset(ll2, 0, BENCH_LL2_SIZE);
+	for(u16 y = 0; y < hLL2; y++)
+	{
+		for(u16 x = 0; x < wLL2; x++)
+		{
+			for(u8 color = 0; color < 4; color++)
+			{
+				if((x >= wLL2 * 7 / 8) && (y < hLL2 / 8))
+				{ v = 1023; }
+				else
+				{
+					v = 64 + (x * 768) / wLL2 + color * 32 + (benchRand() % 64);
+					if(v > 1023) { v = 1023; }
+				}
+				px[(y * wLL2 + x) * 4 + color] = v;
+
+				bit = opt->bitDiscard + 10 * pxDiscard + bitOffsetInLL2(x, y, color, wLL2);
+				for(u8 i = 0; i < 10; i++)
+				{
+					if((v >> i) & 0x1) { ll2[(bit + i) >> 3] |= 1 << ((bit + i) & 0x7); }
+				}
+			}
+		}
+	}
+}
+
+// The same counts, straight from the chart.
+void benchReference(const benchOptions_s * opt, const u16 * px, Scope_s * ref)
+{
+	const u8 section[4] = {SCOPE_PARADE_R, SCOPE_PARADE_G, SCOPE_PARADE_G, SCOPE_PARADE_B};
+	u16 wLL2 = opt->wFrame >> 3;
+	u16 hLL2 = opt->hFrame >> 3;
+	u16 v;
+
+	memset(ref, 0, sizeof(Scope_s));
+	for(u16 y = 0; y < hLL2; y += SCOPE_ROW_STEP)
+	{
+		for(u16 x = 0; x < wLL2; x++)
+		{
+			for(u8 color = 0; color < 4; color++)
+			{
+				v = px[(y * wLL2 + x) * 4 + color];
+				ref->hist[color][v >> 3]++;
+				ref->parade[section[color]][v >> 4][(x * SCOPE_PARADE_COLS) / wLL2]++;
+				if((color == SCOPE_G1) || (color == SCOPE_G2))
+				{ ref->wave[v >> 4][(x * SCOPE_WAVE_COLS) / wLL2]++; }
+			}
+		}
+		ref->nPx += wLL2;
+	}
+}
+
+// Copy of bitOffsetInLL2() in hdmi_dark_frame.c.
+u32 bitOffsetInLL2(u16 x, u16 y, u8 color, u16 wLL2)
+{
+	u32 bitsPerRow;
+	u32 bitOffset;
+	u16 xShifted, xOffset;
+
+	bitsPerRow = 10 * 4 * wLL2;	// 10 [bit/px] * 4 [color] * wLL2 [px/color/row];
+	bitOffset = y * bitsPerRow;
+
+	// Account for the horizontal circular wrap of 1px.
+	// (The first pixel in LL2 row data is pixel location x = 1 of LL2.)
+	xShifted = (x + wLL2 - 1) % wLL2;
+
+	// Map the x location and color to an offset, in [px], within an LL2 row.
+	if(wLL2 == 512)
+	{
+		// 4K Mapping
+		xOffset =  ((xShifted >> 0) & 0x03) << 0;	// xOffset[1:0] = xShifted[1:0]
+		xOffset += ((xShifted >> 7) & 0x03) << 2;	// xOffset[3:2] = xShifted[8:7]
+		xOffset += (color & 0x03) << 4;				// xOffset[5:4] = c[1:0]
+		xOffset += ((xShifted >> 2) & 0x1F) << 6;	// xOffset[10:6] = xShifted[6:2]
+	}
+	else
+	{
+		// 2K Mapping
+		xOffset =  ((xShifted >> 0) & 0x03) << 0;	// xOffset[1:0] = xShifted[1:0]
+		xOffset += ((xShifted >> 6) & 0x03) << 2;	// xOffset[3:2] = xShifted[7:6]
+		xOffset += (color & 0x03) << 4;				// xOffset[5:4] = c[1:0]
+		xOffset += ((xShifted >> 2) & 0x0F) << 6;	// xOffset[9:6] = xShifted[5:2]
+	}
+	bitOffset += 10 * xOffset;
+
+	return bitOffset;
+}
+
+u32 benchRand(void)
+{
+	benchRandState = benchRandState * 1664525 + 1013904223;
+	return benchRandState >> 8;
+}
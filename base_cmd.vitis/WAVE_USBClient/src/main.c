@@ -0,0 +1,283 @@
+/*
+WAVE USB Clip Streaming Client Command Line
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <libusb.h>
+#include "wave_usb.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define LIST_PAGE 256
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Splits a frame stream back into .kwv files along the clip index.
+typedef struct
+{
+	const char * dir;
+	const waveUsbFrameIndex_s * index;
+	uint32_t iFrame;			// Frame the next byte belongs to.
+	uint32_t frameLeft;			// Bytes of that frame still to come.
+	int nFile;					// File open for writing, or -1.
+	FILE * f;
+} pullSink_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void usage(const char * name);
+int cmdList(waveUsb_s * dev);
+int cmdIndex(waveUsb_s * dev, uint32_t nClip);
+int cmdFrames(waveUsb_s * dev, uint32_t nClip, uint32_t first, uint32_t n, const char * path);
+int cmdPull(waveUsb_s * dev, uint32_t nClip, const char * dir);
+int fileSink(void * ctx, const uint8_t * data, uint32_t length);
+int pullSink(void * ctx, const uint8_t * data, uint32_t length);
+double timeNow(void);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+	waveUsb_s * dev;
+	int r;
+
+	if((argc < 2) || !((!strcmp(argv[1], "list") && (argc == 2)) || (!strcmp(argv[1], "index") && (argc == 3))
+	|| (!strcmp(argv[1], "frames") && (argc == 6)) || (!strcmp(argv[1], "pull") && (argc == 4))))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	r = waveUsbOpen(&dev);
+	if(r != 0)
+	{
+		fprintf(stderr, "%s\n", waveUsbErrorString(r));
+		return 1;
+	}
+
+	if(!strcmp(argv[1], "list")) { r = cmdList(dev); }
+	else if(!strcmp(argv[1], "index")) { r = cmdIndex(dev, strtoul(argv[2], NULL, 0)); }
+	else if(!strcmp(argv[1], "frames"))
+	{
+		r = cmdFrames(dev, strtoul(argv[2], NULL, 0), strtoul(argv[3], NULL, 0), strtoul(argv[4], NULL, 0), argv[5]);
+	}
+	else { r = cmdPull(dev, strtoul(argv[2], NULL, 0), argv[3]); }
+
+	// Output errors were reported where they happened.
+	if((r != 0) && (r != WAVE_USB_ERROR_SINK)) { fprintf(stderr, "%s\n", waveUsbErrorString(r)); }
+
+	waveUsbClose(dev);
+	return (r != 0);
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+void usage(const char * name)
+{
+	printf("Usage: %s list                                List the clips in the camera's catalog.\n", name);
+	printf("       %s index <clip>                        Print the clip's frame index.\n", name);
+	printf("       %s frames <clip> <first> <n> <file>    Save n frames (0: to the end) back to back.\n", name);
+	printf("       %s pull <clip> <dir>                   Save the whole clip as <dir>/cNNNN/.\n", name);
+}
+
+int cmdList(waveUsb_s * dev)
+{
+	waveUsbClip_s clips[LIST_PAGE];
+	uint32_t first = 0, count, total;
+	int r;
+
+	printf(" Clip  Files   Frames    Size [GB]   Width  Height      fps  Shutter\n");
+	do
+	{
+		r = waveUsbListClips(dev, first, LIST_PAGE, clips, &count, &total);
+		if(r != 0) { return r; }
+
+		for(uint32_t i = 0; i < count; i++)
+		{
+			printf("%5u  %5u  %7u  %11.3f   %5u  %6u  %7.2f  %6.1f%s\n", clips[i].nClip, clips[i].nFiles,
+			       clips[i].nFrames, clips[i].size_B * 1e-9, clips[i].wFrame, clips[i].hFrame, clips[i].fps,
+			       clips[i].shutterAngle, (clips[i].flags & WAVE_USB_CLIP_INCOMPLETE) ? "  Incomplete" : "");
+		}
+		first += count;
+	} while((count > 0) && (first < total));
+
+	return 0;
+}
+
+int cmdIndex(waveUsb_s * dev, uint32_t nClip)
+{
+	waveUsbFrameIndex_s * index;
+	waveUsbFrameIndex_s first;
+	uint32_t count, total;
+	double t0 = timeNow();
+	int r;
+
+	// The first request indexes the clip on the camera and returns the number of frames.
+	r = waveUsbGetClipIndex(dev, nClip, 0, 1, &first, &count, &total);
+	if(r != 0) { return r; }
+
+	index = malloc((total ? total : 1) * sizeof(waveUsbFrameIndex_s));
+	if(index == NULL) { return LIBUSB_ERROR_NO_MEM; }
+	r = waveUsbGetClipIndex(dev, nClip, 0, total, index, &count, &total);
+	if(r == 0)
+	{
+		printf("  Frame    File        Offset [B]    Size [B]\n");
+		for(uint32_t i = 0; i < count; i++)
+		{
+			printf("%7u  %6u  %16llu  %10u\n", i, index[i].nFile, (unsigned long long) index[i].offset_B, index[i].size_B);
+		}
+		fprintf(stderr, "%u frames indexed in %.2fs.\n", count, timeNow() - t0);
+	}
+
+	free(index);
+	return r;
+}
+
+int cmdFrames(waveUsb_s * dev, uint32_t nClip, uint32_t first, uint32_t n, const char * path)
+{
+	FILE * f;
+	uint64_t length = 0;
+	double t0, t;
+	int r;
+
+	f = fopen(path, "wb");
+	if(f == NULL) { perror(path); return WAVE_USB_ERROR_SINK; }
+
+	t0 = timeNow();
+	r = waveUsbReadFrames(dev, nClip, first, n, fileSink, f, &length);
+	t = timeNow() - t0;
+	fclose(f);
+
+	if(r == 0) { fprintf(stderr, "%.1fMB in %.2fs: %.1fMB/s.\n", length * 1e-6, t, length * 1e-6 / t); }
+	return r;
+}
+
+// Same layout as on the camera: cNNNN.kwi and fNNNNNN.kwv files, rebuilt from the index.
+int cmdPull(waveUsb_s * dev, uint32_t nClip, const char * dir)
+{
+	char path[1024];
+	char clipDir[1024];
+	waveUsbFrameIndex_s * index = NULL;
+	waveUsbFrameIndex_s first;
+	pullSink_s pull;
+	uint32_t count, total;
+	uint64_t length, lengthInfo = 0;
+	FILE * f;
+	double t0, t;
+	int r;
+
+	snprintf(clipDir, sizeof(clipDir), "%s/c%04u", dir, nClip);
+	mkdir(dir, 0755);
+	if((mkdir(clipDir, 0755) != 0) && (errno != EEXIST)) { perror(clipDir); return WAVE_USB_ERROR_SINK; }
+
+	t0 = timeNow();
+
+	snprintf(path, sizeof(path), "%s/c%04u.kwi", clipDir, nClip);
+	f = fopen(path, "wb");
+	if(f == NULL) { perror(path); return WAVE_USB_ERROR_SINK; }
+	r = waveUsbReadClipInfo(dev, nClip, fileSink, f, &lengthInfo);
+	fclose(f);
+	if(r != 0) { return r; }
+
+	r = waveUsbGetClipIndex(dev, nClip, 0, 1, &first, &count, &total);
+	if(r != 0) { return r; }
+	index = malloc((total ? total : 1) * sizeof(waveUsbFrameIndex_s));
+	if(index == NULL) { return LIBUSB_ERROR_NO_MEM; }
+	r = waveUsbGetClipIndex(dev, nClip, 0, total, index, &count, &total);
+
+	if(r == 0)
+	{
+		memset(&pull, 0, sizeof(pull));
+		pull.dir = clipDir;
+		pull.index = index;
+		pull.nFile = -1;
+		r = waveUsbReadFrames(dev, nClip, 0, 0, pullSink, &pull, &length);
+		if(pull.f) { fclose(pull.f); }
+	}
+	t = timeNow() - t0;
+
+	if(r == 0)
+	{
+		length += lengthInfo;
+		fprintf(stderr, "%u frames, %.1fMB in %.2fs: %.1fMB/s.\n", count, length * 1e-6, t, length * 1e-6 / t);
+	}
+
+	free(index);
+	return r;
+}
+
+int fileSink(void * ctx, const uint8_t * data, uint32_t length)
+{
+	return (fwrite(data, 1, length, (FILE *) ctx) != length);
+}
+
+int pullSink(void * ctx, const uint8_t * data, uint32_t length)
+{
+	pullSink_s * pull = ctx;
+	char path[1100];
+	uint32_t n;
+
+	while(length > 0)
+	{
+		if(pull->frameLeft == 0)
+		{
+			// Frames are streamed in index order, each starting a new file when its file number changes.
+			if((int) pull->index[pull->iFrame].nFile != pull->nFile)
+			{
+				if(pull->f) { fclose(pull->f); }
+				pull->nFile = pull->index[pull->iFrame].nFile;
+				snprintf(path, sizeof(path), "%s/f%06d.kwv", pull->dir, pull->nFile);
+				pull->f = fopen(path, "wb");
+				if(pull->f == NULL) { perror(path); return 1; }
+			}
+			pull->frameLeft = pull->index[pull->iFrame++].size_B;
+		}
+
+		n = (length < pull->frameLeft) ? length : pull->frameLeft;
+		if(fwrite(data, 1, n, pull->f) != n) { return 1; }
+		data += n;
+		length -= n;
+		pull->frameLeft -= n;
+	}
+
+	return 0;
+}
+
+double timeNow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
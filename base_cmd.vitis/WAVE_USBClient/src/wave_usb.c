@@ -0,0 +1,362 @@
+/*
+WAVE USB Clip Streaming Client
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <libusb.h>
+#include "wave_usb.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define WAVE_USB_TRANSFERS              4               // Bulk-IN transfers kept queued while streaming.
+#define WAVE_USB_TRANSFER_SIZE          0x400000        // 4MiB each.
+#define WAVE_USB_TIMEOUT_MS             5000
+#define WAVE_USB_INDEX_TIMEOUT_MS       120000          // The first index request walks every frame header.
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+struct waveUsb_s
+{
+	libusb_context * ctx;
+	libusb_device_handle * handle;
+	uint8_t epIn;
+	uint8_t epOut;
+	uint16_t maxPacket;
+	uint16_t tag;
+	uint8_t * buffer[WAVE_USB_TRANSFERS];
+};
+
+typedef struct
+{
+	uint8_t * dest;
+	uint64_t size;
+} waveUsbMemorySink_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+int waveUsbFindInterface(waveUsb_s * dev);
+int waveUsbCommand(waveUsb_s * dev, uint8_t opcode, uint32_t arg0, uint32_t arg1, uint32_t arg2,
+                   unsigned int timeout_ms, waveUsbResponse_s * rsp);
+int waveUsbReceive(waveUsb_s * dev, uint64_t length, waveUsbSink_t sink, void * ctx);
+int waveUsbMemorySink(void * ctx, const uint8_t * data, uint32_t length);
+void LIBUSB_CALL waveUsbTransferDone(struct libusb_transfer * transfer);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int waveUsbOpen(waveUsb_s ** devOut)
+{
+	waveUsb_s * dev;
+	int r;
+
+	dev = calloc(1, sizeof(waveUsb_s));
+	if(dev == NULL) { return LIBUSB_ERROR_NO_MEM; }
+
+	r = libusb_init(&dev->ctx);
+	if(r < 0) { free(dev); return r; }
+
+	dev->handle = libusb_open_device_with_vid_pid(dev->ctx, WAVE_USB_VID_SS, WAVE_USB_PID_SS);
+	if(dev->handle == NULL) { dev->handle = libusb_open_device_with_vid_pid(dev->ctx, WAVE_USB_VID_HS, WAVE_USB_PID_HS); }
+	if(dev->handle == NULL) { r = WAVE_USB_ERROR_NO_DEVICE; }
+
+	// Interface 0 stays with the mass storage driver.
+	if(r == 0) { r = waveUsbFindInterface(dev); }
+	if(r == 0) { libusb_set_auto_detach_kernel_driver(dev->handle, 1); }
+	if(r == 0) { r = libusb_claim_interface(dev->handle, WAVE_USB_INTERFACE); }
+
+	for(int i = 0; (r == 0) && (i < WAVE_USB_TRANSFERS); i++)
+	{
+		dev->buffer[i] = malloc(WAVE_USB_TRANSFER_SIZE);
+		if(dev->buffer[i] == NULL) { r = LIBUSB_ERROR_NO_MEM; }
+	}
+
+	if(r != 0)
+	{
+		waveUsbClose(dev);
+		return r;
+	}
+
+	*devOut = dev;
+	return 0;
+}
+
+void waveUsbClose(waveUsb_s * dev)
+{
+	if(dev == NULL) { return; }
+
+	if(dev->handle)
+	{
+		libusb_release_interface(dev->handle, WAVE_USB_INTERFACE);
+		libusb_close(dev->handle);
+	}
+	if(dev->ctx) { libusb_exit(dev->ctx); }
+	for(int i = 0; i < WAVE_USB_TRANSFERS; i++) { free(dev->buffer[i]); }
+	free(dev);
+}
+
+// Up to maxClips catalog entries from entry first. total is the number of clips in the catalog.
+int waveUsbListClips(waveUsb_s * dev, uint32_t first, uint32_t maxClips, waveUsbClip_s * clips,
+                     uint32_t * count, uint32_t * total)
+{
+	waveUsbResponse_s rsp;
+	waveUsbMemorySink_s mem = {(uint8_t *) clips, (uint64_t) maxClips * sizeof(waveUsbClip_s)};
+	int r;
+
+	r = waveUsbCommand(dev, WAVE_USB_OP_LIST_CLIPS, first, maxClips, 0, WAVE_USB_TIMEOUT_MS, &rsp);
+	if(r != 0) { return r; }
+	if(rsp.length != (uint64_t) rsp.count * sizeof(waveUsbClip_s)) { return WAVE_USB_ERROR_PROTOCOL; }
+
+	r = waveUsbReceive(dev, rsp.length, waveUsbMemorySink, &mem);
+	if(r != 0) { return r; }
+
+	*count = rsp.count;
+	if(total) { *total = rsp.total; }
+	return 0;
+}
+
+// Up to maxFrames index entries from frame first. The camera indexes a clip on its first request, which takes a
+// header read per frame. total is the number of frames in the clip.
+int waveUsbGetClipIndex(waveUsb_s * dev, uint32_t nClip, uint32_t first, uint32_t maxFrames,
+                        waveUsbFrameIndex_s * index, uint32_t * count, uint32_t * total)
+{
+	waveUsbResponse_s rsp;
+	waveUsbMemorySink_s mem = {(uint8_t *) index, (uint64_t) maxFrames * sizeof(waveUsbFrameIndex_s)};
+	int r;
+
+	r = waveUsbCommand(dev, WAVE_USB_OP_GET_CLIP_INDEX, nClip, first, maxFrames, WAVE_USB_INDEX_TIMEOUT_MS, &rsp);
+	if(r != 0) { return r; }
+	if(rsp.length != (uint64_t) rsp.count * sizeof(waveUsbFrameIndex_s)) { return WAVE_USB_ERROR_PROTOCOL; }
+
+	r = waveUsbReceive(dev, rsp.length, waveUsbMemorySink, &mem);
+	if(r != 0) { return r; }
+
+	*count = rsp.count;
+	if(total) { *total = rsp.total; }
+	return 0;
+}
+
+// Stream nFrames frames (0: to the end of the clip) from frame first, each a frame header and its codestreams exactly
+// as stored in the .kwv files. length is set to the total before the data reaches the sink.
+int waveUsbReadFrames(waveUsb_s * dev, uint32_t nClip, uint32_t first, uint32_t nFrames,
+                      waveUsbSink_t sink, void * ctx, uint64_t * length)
+{
+	waveUsbResponse_s rsp;
+	int r;
+
+	r = waveUsbCommand(dev, WAVE_USB_OP_READ_FRAMES, nClip, first, nFrames, WAVE_USB_INDEX_TIMEOUT_MS, &rsp);
+	if(r != 0) { return r; }
+
+	if(length) { *length = rsp.length; }
+	return waveUsbReceive(dev, rsp.length, sink, ctx);
+}
+
+// Stream the clip info file (clip header, dark frames, trailer).
+int waveUsbReadClipInfo(waveUsb_s * dev, uint32_t nClip, waveUsbSink_t sink, void * ctx, uint64_t * length)
+{
+	waveUsbResponse_s rsp;
+	int r;
+
+	r = waveUsbCommand(dev, WAVE_USB_OP_READ_CLIP_INFO, nClip, 0, 0, WAVE_USB_TIMEOUT_MS, &rsp);
+	if(r != 0) { return r; }
+
+	if(length) { *length = rsp.length; }
+	return waveUsbReceive(dev, rsp.length, sink, ctx);
+}
+
+const char * waveUsbErrorString(int err)
+{
+	switch(err)
+	{
+	case WAVE_USB_OK:                   return "OK";
+	case WAVE_USB_STATUS_BAD_COMMAND:   return "Camera rejected the command";
+	case WAVE_USB_STATUS_NOT_FOUND:     return "Clip not found";
+	case WAVE_USB_STATUS_BUSY:          return "Camera is recording";
+	case WAVE_USB_STATUS_IO_ERROR:      return "Camera could not read the clip";
+	case WAVE_USB_STATUS_RANGE:         return "Frame out of range";
+	case WAVE_USB_ERROR_PROTOCOL:       return "Malformed response";
+	case WAVE_USB_ERROR_SHORT:          return "Stream ended early";
+	case WAVE_USB_ERROR_SINK:           return "Output error";
+	case WAVE_USB_ERROR_NO_DEVICE:      return "Camera not found";
+	default:                            return libusb_error_name(err);
+	}
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Bulk endpoints of the vendor interface.
+int waveUsbFindInterface(waveUsb_s * dev)
+{
+	struct libusb_config_descriptor * config;
+	const struct libusb_interface_descriptor * alt;
+	const struct libusb_endpoint_descriptor * ep;
+	int r;
+
+	r = libusb_get_active_config_descriptor(libusb_get_device(dev->handle), &config);
+	if(r < 0) { return r; }
+
+	r = WAVE_USB_ERROR_NO_DEVICE;
+	if(config->bNumInterfaces > WAVE_USB_INTERFACE)
+	{
+		alt = &config->interface[WAVE_USB_INTERFACE].altsetting[0];
+		if(alt->bInterfaceClass == LIBUSB_CLASS_VENDOR_SPEC)
+		{
+			for(int i = 0; i < alt->bNumEndpoints; i++)
+			{
+				ep = &alt->endpoint[i];
+				if((ep->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) != LIBUSB_TRANSFER_TYPE_BULK) { continue; }
+				if(ep->bEndpointAddress & LIBUSB_ENDPOINT_IN)
+				{
+					dev->epIn = ep->bEndpointAddress;
+					dev->maxPacket = ep->wMaxPacketSize;
+				}
+				else { dev->epOut = ep->bEndpointAddress; }
+			}
+			if(dev->epIn && dev->epOut && dev->maxPacket) { r = 0; }
+		}
+	}
+
+	libusb_free_config_descriptor(config);
+	return r;
+}
+
+// Send a command and receive its response header. Returns the device status if it is not OK.
+int waveUsbCommand(waveUsb_s * dev, uint8_t opcode, uint32_t arg0, uint32_t arg1, uint32_t arg2,
+                   unsigned int timeout_ms, waveUsbResponse_s * rsp)
+{
+	waveUsbCommand_s cmd;
+	int n;
+	int r;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.magic = WAVE_USB_COMMAND_MAGIC;
+	cmd.opcode = opcode;
+	cmd.tag = ++dev->tag;
+	cmd.arg[0] = arg0;
+	cmd.arg[1] = arg1;
+	cmd.arg[2] = arg2;
+
+	r = libusb_bulk_transfer(dev->handle, dev->epOut, (uint8_t *) &cmd, sizeof(cmd), &n, WAVE_USB_TIMEOUT_MS);
+	if(r != 0) { return r; }
+	if(n != sizeof(cmd)) { return WAVE_USB_ERROR_PROTOCOL; }
+
+	r = libusb_bulk_transfer(dev->handle, dev->epIn, (uint8_t *) rsp, sizeof(*rsp), &n, timeout_ms);
+	if(r != 0) { return r; }
+	if((n != sizeof(*rsp)) || (rsp->magic != WAVE_USB_RESPONSE_MAGIC) || (rsp->tag != cmd.tag)
+	|| (rsp->opcode != opcode)) { return WAVE_USB_ERROR_PROTOCOL; }
+
+	return rsp->status;
+}
+
+// Receive exactly length bytes of response data. The camera sends it in pieces that may end in short packets, so
+// several transfers stay queued, never asking for more than is left: the next response must not land in one of them.
+int waveUsbReceive(waveUsb_s * dev, uint64_t length, waveUsbSink_t sink, void * ctx)
+{
+	struct libusb_transfer * transfer[WAVE_USB_TRANSFERS] = {0};
+	int done[WAVE_USB_TRANSFERS];
+	uint32_t size[WAVE_USB_TRANSFERS];
+	uint64_t received = 0;
+	uint64_t requested = 0;		// Requested by queued transfers.
+	uint32_t request;
+	int head = 0;
+	int nQueued = 0;
+	int i, n;
+	int r = 0;
+
+	for(i = 0; i < WAVE_USB_TRANSFERS; i++)
+	{
+		transfer[i] = libusb_alloc_transfer(0);
+		if(transfer[i] == NULL) { r = LIBUSB_ERROR_NO_MEM; }
+	}
+
+	while((r == 0) && (received < length))
+	{
+		while((nQueued < WAVE_USB_TRANSFERS) && (received + requested < length))
+		{
+			i = (head + nQueued) % WAVE_USB_TRANSFERS;
+			size[i] = (length - received - requested < WAVE_USB_TRANSFER_SIZE) ? (length - received - requested) : WAVE_USB_TRANSFER_SIZE;
+
+			// Whole packets only, or a full last packet would overflow.
+			request = (size[i] + dev->maxPacket - 1) / dev->maxPacket * dev->maxPacket;
+
+			libusb_fill_bulk_transfer(transfer[i], dev->handle, dev->epIn, dev->buffer[i], request,
+			                          waveUsbTransferDone, &done[i], WAVE_USB_TIMEOUT_MS);
+			done[i] = 0;
+			r = libusb_submit_transfer(transfer[i]);
+			if(r != 0) { break; }
+
+			requested += size[i];
+			nQueued++;
+		}
+		if(r != 0) { break; }
+
+		while((r == 0) && !done[head]) { r = libusb_handle_events_completed(dev->ctx, &done[head]); }
+		if(r != 0) { break; }
+
+		n = transfer[head]->actual_length;
+		if(transfer[head]->status == LIBUSB_TRANSFER_TIMED_OUT) { r = LIBUSB_ERROR_TIMEOUT; }
+		else if(transfer[head]->status != LIBUSB_TRANSFER_COMPLETED) { r = LIBUSB_ERROR_IO; }
+		else if(n == 0) { r = WAVE_USB_ERROR_SHORT; }
+		else if((uint64_t) n > length - received) { r = WAVE_USB_ERROR_PROTOCOL; }
+		else if(sink(ctx, dev->buffer[head], n) != 0) { r = WAVE_USB_ERROR_SINK; }
+
+		received += n;
+		requested -= size[head];
+		head = (head + 1) % WAVE_USB_TRANSFERS;
+		nQueued--;
+	}
+
+	// Cancel whatever is still queued after an error.
+	for(int k = 0; k < nQueued; k++)
+	{
+		i = (head + k) % WAVE_USB_TRANSFERS;
+		libusb_cancel_transfer(transfer[i]);
+		while(!done[i]) { libusb_handle_events_completed(dev->ctx, &done[i]); }
+	}
+
+	for(i = 0; i < WAVE_USB_TRANSFERS; i++) { libusb_free_transfer(transfer[i]); }
+
+	return r;
+}
+
+int waveUsbMemorySink(void * ctx, const uint8_t * data, uint32_t length)
+{
+	waveUsbMemorySink_s * mem = ctx;
+
+	if(length > mem->size) { return -1; }
+	memcpy(mem->dest, data, length);
+	mem->dest += length;
+	mem->size -= length;
+
+	return 0;
+}
+
+void LIBUSB_CALL waveUsbTransferDone(struct libusb_transfer * transfer)
+{
+	*(int *) transfer->user_data = 1;
+}
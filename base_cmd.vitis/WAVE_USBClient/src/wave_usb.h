@@ -0,0 +1,132 @@
+/*
+WAVE USB Clip Streaming Client Include
+
+Copyright (C) 2020 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __WAVE_USB_INCLUDE__
+#define __WAVE_USB_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdint.h>
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// The camera enumerates with different IDs at high speed and SuperSpeed.
+#define WAVE_USB_VID_HS                 0x03FD
+#define WAVE_USB_PID_HS                 0x0500
+#define WAVE_USB_VID_SS                 0x0525
+#define WAVE_USB_PID_SS                 0xA4A5
+
+// Protocol, same as the firmware's usb_vendor.h.
+#define WAVE_USB_INTERFACE              1
+#define WAVE_USB_COMMAND_MAGIC          0x43564157      // "WAVC"
+#define WAVE_USB_RESPONSE_MAGIC         0x52564157      // "WAVR"
+
+#define WAVE_USB_OP_LIST_CLIPS          0x01
+#define WAVE_USB_OP_GET_CLIP_INDEX      0x02
+#define WAVE_USB_OP_READ_FRAMES         0x03
+#define WAVE_USB_OP_READ_CLIP_INFO      0x04
+
+#define WAVE_USB_CLIP_INCOMPLETE        0x01            // Catalog entry flag: no clip trailer, frame count unknown.
+
+// Return codes: 0 or a positive device status, or a negative libusb or client error.
+#define WAVE_USB_OK                     0x00
+#define WAVE_USB_STATUS_BAD_COMMAND     0x01
+#define WAVE_USB_STATUS_NOT_FOUND       0x02
+#define WAVE_USB_STATUS_BUSY            0x03
+#define WAVE_USB_STATUS_IO_ERROR        0x04
+#define WAVE_USB_STATUS_RANGE           0x05
+#define WAVE_USB_ERROR_PROTOCOL         -100    // Malformed or mismatched response.
+#define WAVE_USB_ERROR_SHORT            -101    // The camera ended a stream early.
+#define WAVE_USB_ERROR_SINK             -102    // The data sink returned an error.
+#define WAVE_USB_ERROR_NO_DEVICE        -103
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+typedef struct __attribute__((packed))
+{
+	uint32_t magic;
+	uint8_t opcode;
+	uint8_t reserved0;
+	uint16_t tag;
+	uint32_t arg[4];
+	uint8_t reserved1[8];
+} waveUsbCommand_s;
+
+typedef struct __attribute__((packed))
+{
+	uint32_t magic;
+	uint8_t opcode;
+	uint8_t status;
+	uint16_t tag;
+	uint64_t length;			// Data following the header in [B].
+	uint32_t count;				// Catalog entries or frames in the data.
+	uint32_t total;				// Catalog entries or frames available.
+	uint8_t reserved[8];
+} waveUsbResponse_s;
+
+// 64B Clip catalog entry, as in /clips.kwc.
+typedef struct __attribute__((packed))
+{
+	uint32_t nClip;				// Clip number.
+	uint32_t nFiles;			// Number of .kwv files in the clip.
+	uint32_t nFrames;			// Number of frames recorded.
+	uint32_t reserved0;
+	uint64_t size_B;			// Total size of the .kwv files in [B].
+	uint16_t wFrame;			// Frame width in [px].
+	uint16_t hFrame;			// Frame height in [px].
+	float fps;					// Target capture frame rate in [fps].
+	float shutterAngle;			// Target shutter angle in [deg].
+	float colorTemp;			// Color temperature hint in [K].
+	uint8_t gain;				// Enumerated gain setting (0: Linear, 1: HDR).
+	uint8_t flags;				// WAVE_USB_CLIP_INCOMPLETE.
+	uint8_t reserved1[22];
+} waveUsbClip_s;
+
+// 16B Clip index entry, one per frame. A frame the camera could not read has size_B 0, and no data in READ_FRAMES.
+typedef struct __attribute__((packed))
+{
+	uint32_t nFile;				// .kwv file number.
+	uint32_t size_B;			// Frame header and codestreams in [B].
+	uint64_t offset_B;			// Offset of the frame header in the file in [B].
+} waveUsbFrameIndex_s;
+
+typedef struct waveUsb_s waveUsb_s;
+
+// Receives streamed data in order. Returns 0 to continue.
+typedef int (*waveUsbSink_t)(void * ctx, const uint8_t * data, uint32_t length);
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+int waveUsbOpen(waveUsb_s ** dev);
+void waveUsbClose(waveUsb_s * dev);
+int waveUsbListClips(waveUsb_s * dev, uint32_t first, uint32_t maxClips, waveUsbClip_s * clips,
+                     uint32_t * count, uint32_t * total);
+int waveUsbGetClipIndex(waveUsb_s * dev, uint32_t nClip, uint32_t first, uint32_t maxFrames,
+                        waveUsbFrameIndex_s * index, uint32_t * count, uint32_t * total);
+int waveUsbReadFrames(waveUsb_s * dev, uint32_t nClip, uint32_t first, uint32_t nFrames,
+                      waveUsbSink_t sink, void * ctx, uint64_t * length);
+int waveUsbReadClipInfo(waveUsb_s * dev, uint32_t nClip, waveUsbSink_t sink, void * ctx, uint64_t * length);
+const char * waveUsbErrorString(int err);
+
+#endif
@@ -0,0 +1,89 @@
+/*
+Host Shim: Xilinx USB 3.0 Device Driver
+
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef XUSBPSU_H
+#define XUSBPSU_H
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+#define ALIGNMENT_CACHELINE __attribute__((aligned(64)))
+
+#define XUSBPSU_EP_DIR_IN               1
+#define XUSBPSU_EP_DIR_OUT              0
+
+#define XUSBPSU_ENDPOINT_XFER_CONTROL   0
+#define XUSBPSU_ENDPOINT_XFER_ISOC      1
+#define XUSBPSU_ENDPOINT_XFER_BULK      2
+#define XUSBPSU_ENDPOINT_XFER_INT       3
+
+#define XUSBPSU_SPEED_UNKNOWN           0
+#define XUSBPSU_SPEED_LOW               1
+#define XUSBPSU_SPEED_FULL              2
+#define XUSBPSU_SPEED_HIGH              3
+#define XUSBPSU_SPEED_SUPER             4
+
+#define XUSBPSU_STATE_ATTACHED          0
+#define XUSBPSU_STATE_POWERED           1
+#define XUSBPSU_STATE_DEFAULT           2
+#define XUSBPSU_STATE_ADDRESS           3
+#define XUSBPSU_STATE_CONFIGURED        4
+#define XUSBPSU_STATE_SUSPENDED         5
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Only what xusb_wrapper.h and the firmware's endpoint users need. The endpoint functions are implemented by the
+// simulator, which stands in for the host on the other end of the cable.
+typedef struct
+{
+	u8 bRequestType;
+	u8 bRequest;
+	u16 wValue;
+	u16 wIndex;
+	u16 wLength;
+} SetupPacket;
+
+struct XUsbPsu
+{
+	u32 reserved;
+};
+
+typedef struct
+{
+	u16 DeviceId;
+	UINTPTR BaseAddress;
+} Usb_Config;
+
+struct Usb_DevData
+{
+	u8 Speed;
+	u8 State;
+	void * PrivateData;
+};
+
+#endif
@@ -0,0 +1,839 @@
+/*
+WAVE Vendor Interface Simulator
+
+Runs the firmware's usb_vendor.c against clips recorded through fs.c onto a simulated SSD. The endpoint functions stand
+in for the host: each command is handed to the firmware as a completed bulk-OUT transfer, and every bulk-IN transfer
+the firmware queues is completed from the main loop, as the interrupt would be on the camera.
+
+
+Copyright (C) 2021 by Shane W. Colton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "xil_printf.h"
+#include "xtime_l.h"
+#include "nvme.h"
+#include "ff.h"
+#include "fs.h"
+#include "frame.h"
+#include "camera_state.h"
+#include "usb_vendor.h"
+#include "nvme_sim.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Frame headers and codestreams are written from their DDR4 buffers, as frame.c does. Those writes slip, so each
+// frame gets its own slot in a ring deeper than DISK_SLIP_MAX, as the camera's frames each get their own buffers.
+#define SIM_FH_ADDR               0x18000000
+#define SIM_CS_ADDR               0x20000000
+#define SIM_FH_SLOT               0x1000
+#define SIM_CS_SLOT               (16 << 20)        // Largest frame: 8MB mean, +25%.
+#define SIM_SLOTS                 32
+
+#define SIM_CLIPS_MAX             16
+#define SIM_FRAMES_MAX            10000
+#define SIM_INFO_SIZE             (4096 + 1234)     // Clip header and dark frames stand-in, not sector-aligned.
+#define SIM_TRAILER_SIZE          512
+#define SIM_TIMEOUT_S             10                // Simulated time allowed for one command.
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	const char * image;
+	const char * profile;
+	u8 flbas;
+	u32 nClips;
+	u32 nFrames;
+	u32 nFramesPerFile;
+	float frameSize_MB;
+} simOptions_s;
+
+// A clip as recorded, for checking the replies.
+typedef struct
+{
+	u32 nFrames;				// Complete frames.
+	u32 nFiles;
+	u64 size_B;					// Bytes written to the .kwv files.
+	u8 complete;				// Closed with a trailer and a catalog entry.
+	vendorFrameIndex_s index[SIM_FRAMES_MAX];
+} simClip_s;
+
+// A reply as the host sees it.
+typedef struct
+{
+	vendorResponse_s response;
+	u8 * data;
+	u64 nData;					// Data bytes received.
+	u8 aborted;					// Ended by a zero-length packet.
+	u8 error;					// Framing error or timeout.
+} simReply_s;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void simUsage(const char * name);
+int simFormat(void);
+void simRecord(const simOptions_s * opt, u32 nClipRec, u8 cutShort);
+u32 simFrame(const simOptions_s * opt, u32 nClipGen, u32 nFrame, FrameHeader_s * fh, u8 * cs);
+void simClipInfo(u32 nClipGen, u32 nFrames, u8 * dest);
+u64 simFrameLBA(u32 nClipFind, u32 nFrame);
+
+void simCommand(u8 opcode, u32 arg0, u32 arg1, u32 arg2, u32 length, simReply_s * reply);
+void simFree(simReply_s * reply);
+u8 simFraming(const simReply_s * reply, u8 opcode);
+
+void simCheckCatalog(void);
+void simCheckList(void);
+void simCheckIndex(void);
+void simCheckFrames(const simOptions_s * opt);
+u8 simCheckStream(const simOptions_s * opt, u32 nClipRead, u32 first, u32 n, const simReply_s * reply);
+void simCheckClipInfo(void);
+void simCheckCommands(void);
+void simCheckErrors(const simOptions_s * opt);
+void simCheckStop(void);
+void simCheckNewClip(const simOptions_s * opt);
+void simResult(const char * name, u8 pass);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Read by usb_vendor.c: only the mode setting is used.
+CameraSetting_s simMode = {CSETTING_MODE, CSETTING_MODE_STANDBY};
+CameraState_s cState = {{&simMode}};
+
+// diskio.c sector cache: dirty sectors not yet on the SSD.
+extern UINT diskCacheDirty;
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+simClip_s simClips[SIM_CLIPS_MAX];
+u32 simClipCount = 0;
+
+struct Usb_DevData simUsb = {USB_SPEED_SUPER, USB_STATE_CONFIGURED, NULL};
+
+// Loopback endpoint: the transfers the firmware has queued.
+u8 simEpEnabled[2] = {0, 0};	// OUT, IN
+u8 * simRecvBuffer = NULL;
+u8 simRecvArmed = 0;
+const u8 * simSendBuffer = NULL;
+u32 simSendLength = 0;
+u8 simSendPending = 0;
+u32 simEpErrors = 0;			// Transfers queued on a disabled or busy endpoint.
+
+u16 simTag = 0;
+u32 simFailed = 0;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+	simOptions_s opt = {"/tmp/wave_vendorsim.img", "gen3", 0, 3, 120, 50, 0.25f};
+	const nvmeSimProfile_s * profile;
+	int status;
+	int c;
+
+	while((c = getopt(argc, argv, "i:p:4c:n:f:m:")) != -1)
+	{
+		switch(c)
+		{
+		case 'i': opt.image = optarg; break;
+		case 'p': opt.profile = optarg; break;
+		case '4': opt.flbas = 1; break;
+		case 'c': opt.nClips = strtoul(optarg, NULL, 0); break;
+		case 'n': opt.nFrames = strtoul(optarg, NULL, 0); break;
+		case 'f': opt.nFramesPerFile = strtoul(optarg, NULL, 0); break;
+		case 'm': opt.frameSize_MB = strtof(optarg, NULL); break;
+		default: simUsage(argv[0]); return 1;
+		}
+	}
+	profile = nvmeSimFindProfile(opt.profile);
+	if((profile == NULL) || (opt.nClips < 3) || (opt.nClips >= SIM_CLIPS_MAX) || (opt.nFrames < 20)
+	|| (opt.nFrames > SIM_FRAMES_MAX) || (opt.nFramesPerFile < 5) || (opt.nFramesPerFile >= opt.nFrames)
+	|| (opt.frameSize_MB < 0.01f) || (opt.frameSize_MB > 8.0f))
+	{ simUsage(argv[0]); return 1; }
+
+	status = nvmeSimStart(opt.image, 64ULL << 30, opt.flbas, profile);
+	if(status != NVME_SIM_OK) { xil_printf("Simulator start failed: 0x%08X\r\n", status); return 1; }
+	status = nvmeInit();
+	if(status != NVME_OK) { xil_printf("nvmeInit() failed: 0x%08X\r\n", status); return 1; }
+	xil_printf("NVMe: %dB LBAs, profile %s.\r\n", nvmeGetLBASize(), profile->name);
+
+	// Clip 1 and the last clip end with a frame cut short and have no trailer, as if power was lost while recording.
+	if(simFormat()) { return 1; }
+	for(u32 n = 0; n < opt.nClips; n++) { simRecord(&opt, n, (n == 1) || (n == opt.nClips - 1)); }
+	xil_printf("Recorded %u clips of %u frames, %u frames per file, %.2fMB per frame. %u dirty sectors in the "
+	           "disk cache.\r\n", opt.nClips, opt.nFrames, opt.nFramesPerFile, opt.frameSize_MB, diskCacheDirty);
+
+	simCheckCatalog();
+	vendorStart(&simUsb);
+
+	simCheckClipInfo();
+	simCheckList();
+	simCheckIndex();
+	simCheckFrames(&opt);
+	simCheckCommands();
+	simCheckErrors(&opt);
+	simCheckStop();
+	simCheckNewClip(&opt);
+
+	vendorStop();
+	nvmeSimStop();
+
+	xil_printf("%u checks failed, %u endpoint errors.\r\n", simFailed, simEpErrors);
+	return (simFailed != 0) || (simEpErrors != 0);
+}
+
+// Firmware API: USB endpoints -----------------------------------------------------------------------------------------
+
+s32 EpEnable(void * InstancePtr, u8 UsbEpNum, u8 Dir, u16 Maxsize, u8 Type)
+{
+	simEpEnabled[Dir] = 1;
+	return XST_SUCCESS;
+}
+
+s32 EpDisable(void * InstancePtr, u8 UsbEpNum, u8 Dir)
+{
+	simEpEnabled[Dir] = 0;
+	if(Dir == USB_EP_DIR_OUT) { simRecvArmed = 0; }
+	else { simSendPending = 0; }
+	return XST_SUCCESS;
+}
+
+// The command buffer is filled by the next simCommand().
+s32 EpBufferRecv(void * InstancePtr, u8 UsbEp, u8 * BufferPtr, u32 Length)
+{
+	if(!simEpEnabled[USB_EP_DIR_OUT] || simRecvArmed || (Length < sizeof(vendorCommand_s))) { simEpErrors++; }
+
+	simRecvBuffer = BufferPtr;
+	simRecvArmed = 1;
+	return XST_SUCCESS;
+}
+
+// Completed from simCommand()'s loop, never from here: the firmware's handler must not run inside its own call.
+s32 EpBufferSend(void * InstancePtr, u8 UsbEp, u8 * BufferPtr, u32 BufferLen)
+{
+	if(!simEpEnabled[USB_EP_DIR_IN] || simSendPending) { simEpErrors++; }
+
+	simSendBuffer = BufferPtr;
+	simSendLength = BufferLen;
+	simSendPending = 1;
+	return XST_SUCCESS;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+void simUsage(const char * name)
+{
+	xil_printf("Usage: %s [-p profile] [-i image] [-4] [-c clips] [-n frames] [-f frames/file] [-m MB/frame]\r\n", name);
+	xil_printf("  -4  Namespace formatted to 4KiB LBAs.\r\n");
+	xil_printf("  -c  Clips to record, 3 to %d (3).\r\n", SIM_CLIPS_MAX - 1);
+	xil_printf("  -n  Frames per clip, 20 to %d (120). -f: frames per file, 5 or more, fewer than -n (50).\r\n",
+	           SIM_FRAMES_MAX);
+	xil_printf("  -m  Mean frame size, 0.01 to 8.0MB (0.25).\r\n");
+	xil_printf("Profiles:\r\n");
+	nvmeSimListProfiles();
+}
+
+// Same parameters as fsFormat(), then mounted by fsInit(), which creates the clip catalog.
+int simFormat(void)
+{
+	FRESULT res;
+	MKFS_PARM opt;
+	static BYTE work[FF_MAX_SS];	// Not on the host stack, which sits above 0x10000000 and would get write slip.
+
+	opt.fmt = FM_EXFAT;
+	opt.au_size = 0x100000;
+	opt.align = 1;
+	opt.n_fat = 1;
+	opt.n_root = 0;
+	res = f_mkfs("", &opt, work, sizeof work);
+	if(res) { xil_printf("SSD format failed: %d\r\n", res); return 1; }
+
+	fsInit();
+	return 0;
+}
+
+// Same sequence as frameRecord() and its start and end of clip, through fs.c.
+void simRecord(const simOptions_s * opt, u32 nClipRec, u8 cutShort)
+{
+	FrameHeader_s * fh;
+	u8 * cs;
+	static u8 info[SIM_INFO_SIZE + SIM_TRAILER_SIZE];		// Off the host stack, as in simFormat().
+	static fsCatalogEntry_s entry;
+	simClip_s * clip = &simClips[nClipRec];
+	u64 offset = 0;
+	u32 size;
+
+	simClipInfo(nClipRec, opt->nFrames, info);
+	fsCreateClip();
+	fsWriteClipInfo((u64) info, SIM_INFO_SIZE);
+	fsCloseClipInfo();
+
+	clip->nFrames = 0;
+	clip->nFiles = 0;
+	clip->size_B = 0;
+	for(u32 n = 0; n < opt->nFrames; n++)
+	{
+		if((n % opt->nFramesPerFile) == 0)
+		{
+			fsCreateFile();
+			clip->nFiles++;
+			offset = 0;
+		}
+
+		fh = (FrameHeader_s *)(SIM_FH_ADDR + (u64)(n % SIM_SLOTS) * SIM_FH_SLOT);
+		cs = (u8 *)(SIM_CS_ADDR + (u64)(n % SIM_SLOTS) * SIM_CS_SLOT);
+		size = simFrame(opt, nClipRec, n, fh, cs);
+		if(cutShort && (n == opt->nFrames - 1))
+		{
+			// Header and half the codestreams.
+			fsWriteFile((u64) fh, sizeof(FrameHeader_s));
+			fsWriteFile((u64) cs, (size - sizeof(FrameHeader_s)) / 2);
+			clip->size_B += sizeof(FrameHeader_s) + (size - sizeof(FrameHeader_s)) / 2;
+			break;
+		}
+		fsWriteFile((u64) fh, sizeof(FrameHeader_s));
+		fsWriteFile((u64) cs, size - sizeof(FrameHeader_s));
+
+		clip->index[n].nFile = clip->nFiles - 1;
+		clip->index[n].size_B = size;
+		clip->index[n].offset_B = offset;
+		clip->nFrames++;
+		clip->size_B += size;
+		offset += size;
+	}
+
+	// A clip cut short by power loss gets neither its trailer nor its catalog entry.
+	clip->complete = !cutShort;
+	if(clip->complete)
+	{
+		fsAppendClipInfo((u64) &info[SIM_INFO_SIZE], SIM_TRAILER_SIZE);
+
+		memset(&entry, 0, sizeof(entry));
+		entry.nFrames = opt->nFrames;
+		entry.wFrame = 4096;
+		entry.hFrame = 3072;
+		entry.fps = 24.0f + nClipRec;
+		entry.shutterAngle = 180.0f;
+		fsCatalogAddClip(&entry);
+	}
+	fsCloseClip();
+	simClipCount++;
+}
+
+// Frame header and codestreams of a frame, codestreams back to back. Codestream sizes vary +/-25% around the mean, in
+// 16B steps like the encoder's. Returns the size of the frame.
+u32 simFrame(const simOptions_s * opt, u32 nClipGen, u32 nFrame, FrameHeader_s * fh, u8 * cs)
+{
+	u32 state = (nClipGen << 16) ^ nFrame ^ 0x5A5A5A5A;
+	u32 csMean = (u32)(opt->frameSize_MB * 1000000.0f) / 16;
+	u32 size = 0;
+
+	memset(fh, 0, sizeof(FrameHeader_s));
+	memcpy(fh->strDelimiter, "WAVE HELLO!\n", 12);
+	fh->nFrame = nFrame;
+	fh->wFrame = 4096;
+	fh->hFrame = 3072;
+	for(int iCS = 0; iCS < 16; iCS++)
+	{
+		state = state * 1664525 + 1013904223;
+		fh->csSize[iCS] = (u32)(csMean * (0.75 + 0.5 * (state >> 8) / 16777216.0)) & ~0xF;
+		size += fh->csSize[iCS];
+	}
+
+	for(u32 i = 0; i < size; i += 4)
+	{
+		state = state * 1664525 + 1013904223;
+		memcpy(&cs[i], &state, 4);
+	}
+
+	return sizeof(FrameHeader_s) + size;
+}
+
+// Clip info file: the fields of the clip header and trailer that the catalog is rebuilt from, over a known pattern.
+void simClipInfo(u32 nClipGen, u32 nFrames, u8 * dest)
+{
+	ClipHeader_s * header = (ClipHeader_s *) dest;
+	ClipTrailer_s * trailer = (ClipTrailer_s *) &dest[SIM_INFO_SIZE];
+
+	for(u32 i = 0; i < SIM_INFO_SIZE + SIM_TRAILER_SIZE; i++) { dest[i] = (u8)(nClipGen * 37 + i * 11 + (i >> 9)); }
+
+	memcpy(header->strDelimiter, "WAVE HELLO!\n", 12);
+	header->wFrame = 4096;
+	header->hFrame = 3072;
+	header->fps = 24.0f + nClipGen;
+	header->shutterAngle = 180.0f;
+	header->colorTemp = 0.0f;
+	header->gain = 0;
+	memcpy(trailer->strDelimiter, "WAVE STATS!\n", 12);
+	trailer->nFrames = nFrames;
+}
+
+// First LBA of a frame, from the clip file's extents.
+u64 simFrameLBA(u32 nClipFind, u32 nFrame)
+{
+	vendorFrameIndex_s * frame = &simClips[nClipFind].index[nFrame];
+	fsExtent_s extents[64];
+	u32 n;
+	u64 lba = 0;
+
+	if(fsOpenClipFile(nClipFind, frame->nFile) != 0) { return 0; }
+	n = fsGetClipFileExtents(extents, 64);
+	fsCloseClipFile();
+
+	for(u32 e = 0; e < n; e++)
+	{
+		if(frame->offset_B < extents[e].offset_B + extents[e].size_B)
+		{
+			lba = extents[e].lba + (frame->offset_B - extents[e].offset_B) / nvmeGetLBASize();
+			break;
+		}
+	}
+
+	return lba;
+}
+
+// Send a command, then run the firmware until it has sent the whole response and waits for the next command.
+// length is the size of the command transfer.
+void simCommand(u8 opcode, u32 arg0, u32 arg1, u32 arg2, u32 length, simReply_s * reply)
+{
+	vendorCommand_s cmd;
+	XTime tStart, tNow;
+	u8 header = 1;
+	u32 len;
+
+	memset(reply, 0, sizeof(simReply_s));
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.magic = VENDOR_COMMAND_MAGIC;
+	cmd.opcode = opcode;
+	cmd.tag = ++simTag;
+	cmd.arg[0] = arg0;
+	cmd.arg[1] = arg1;
+	cmd.arg[2] = arg2;
+
+	if(!simRecvArmed)
+	{
+		reply->error = 1;
+		return;
+	}
+	memcpy(simRecvBuffer, &cmd, sizeof(cmd));
+	if(opcode == 0xFF) { ((vendorCommand_s *) simRecvBuffer)->magic = 0; }
+	simRecvArmed = 0;
+	vendorCommandHandler(&simUsb, sizeof(vendorCommand_s), length);
+
+	XTime_GetTime(&tStart);
+	while(1)
+	{
+		if(simSendPending)
+		{
+			simSendPending = 0;
+			len = simSendLength;
+
+			if(header)
+			{
+				if(len != sizeof(vendorResponse_s)) { reply->error = 1; }
+				memcpy(&reply->response, simSendBuffer, sizeof(vendorResponse_s));
+				reply->data = malloc(reply->response.length + 1);
+				header = 0;
+			}
+			else if(len == 0) { reply->aborted = 1; }
+			else if(reply->nData + len > reply->response.length) { reply->error = 1; }
+			else
+			{
+				memcpy(reply->data + reply->nData, simSendBuffer, len);
+				reply->nData += len;
+			}
+
+			vendorDataInHandler(&simUsb, len, len);
+			continue;
+		}
+
+		// Response complete.
+		if(simRecvArmed) { break; }
+
+		vendorService();
+
+		XTime_GetTime(&tNow);
+		if(tNow - tStart > SIM_TIMEOUT_S * COUNTS_PER_SECOND)
+		{
+			reply->error = 1;
+			break;
+		}
+	}
+}
+
+void simFree(simReply_s * reply)
+{
+	free(reply->data);
+	reply->data = NULL;
+}
+
+// Header and data as the protocol requires: echoed opcode and tag, and exactly length bytes unless aborted.
+u8 simFraming(const simReply_s * reply, u8 opcode)
+{
+	return !reply->error && (reply->response.magic == VENDOR_RESPONSE_MAGIC) && (reply->response.opcode == opcode)
+	    && (reply->response.tag == simTag) && (reply->aborted || (reply->nData == reply->response.length));
+}
+
+// The catalog as recorded has no entry for the clips cut short. At the next mount, the last clip gets its entry from
+// the clip on disk. Truncated, then deleted, the catalog is rebuilt from the clips on disk, with one entry per clip and
+// the ones cut short marked incomplete. Before the rebuild, c0000 and c0001 are renamed away and back, which lists
+// c0001 first, so the entries must still come out in clip order. LIST_CLIPS checks the entries.
+void simCheckCatalog(void)
+{
+	static FATFS fsWork;			// Not on the host stack, as in simFormat().
+	static FIL filWork;
+	u32 nEntries = fsCatalogGetCount();
+	FRESULT res;
+
+	fsDeinit();
+	fsInit();
+	simResult("Catalog gains the last clip, cut short", (nEntries == simClipCount - 2)
+	          && (fsCatalogGetCount() == simClipCount - 1));
+
+	fsDeinit();
+	res = f_mount(&fsWork, "", 1);
+	if(res == FR_OK) { res = f_open(&filWork, "/clips.kwc", FA_READ | FA_WRITE); }
+	if(res == FR_OK) { res = f_lseek(&filWork, f_size(&filWork) - 1); }
+	if(res == FR_OK) { res = f_truncate(&filWork); }
+	if(res == FR_OK) { res = f_close(&filWork); }
+	f_mount(0, "", 0);
+	fsInit();
+	simResult("Catalog shorter than its header, rebuilt", (res == FR_OK) && (fsCatalogGetCount() == simClipCount));
+
+	fsDeinit();
+	res = f_mount(&fsWork, "", 1);
+	if(res == FR_OK) { res = f_unlink("/clips.kwc"); }
+	if(res == FR_OK) { res = f_rename("/c0000", "/c9000"); }
+	if(res == FR_OK) { res = f_rename("/c0001", "/c9001"); }
+	if(res == FR_OK) { res = f_rename("/c9000", "/c0000"); }
+	if(res == FR_OK) { res = f_rename("/c9001", "/c0001"); }
+	f_mount(0, "", 0);
+	fsInit();
+	simResult("Catalog rebuilt from the clips", (res == FR_OK) && (fsCatalogGetCount() == simClipCount));
+}
+
+void simCheckList(void)
+{
+	simReply_s reply;
+	fsCatalogEntry_s * entry;
+	u8 pass;
+
+	simCommand(VENDOR_OP_LIST_CLIPS, 0, 0, 0, sizeof(vendorCommand_s), &reply);
+	pass = simFraming(&reply, VENDOR_OP_LIST_CLIPS) && (reply.response.status == VENDOR_STATUS_OK)
+	    && (reply.response.count == simClipCount) && (reply.response.total == simClipCount)
+	    && (reply.nData == simClipCount * sizeof(fsCatalogEntry_s));
+	for(u32 i = 0; pass && (i < simClipCount); i++)
+	{
+		entry = &((fsCatalogEntry_s *) reply.data)[i];
+		pass = (entry->nClip == i) && (entry->nFiles == simClips[i].nFiles) && (entry->size_B == simClips[i].size_B)
+		    && (entry->wFrame == 4096) && (entry->hFrame == 3072) && (entry->fps == 24.0f + i)
+		    && (entry->nFrames == (simClips[i].complete ? simClips[i].nFrames : 0))
+		    && (entry->flags == (simClips[i].complete ? 0 : FS_CLIP_INCOMPLETE));
+	}
+	simResult("LIST_CLIPS, all", pass);
+	simFree(&reply);
+
+	simCommand(VENDOR_OP_LIST_CLIPS, 1, 1, 0, sizeof(vendorCommand_s), &reply);
+	entry = (fsCatalogEntry_s *) reply.data;
+	pass = simFraming(&reply, VENDOR_OP_LIST_CLIPS) && (reply.response.status == VENDOR_STATUS_OK)
+	    && (reply.response.count == 1) && (reply.response.total == simClipCount) && (entry->nClip == 1);
+	simResult("LIST_CLIPS, entry 1", pass);
+	simFree(&reply);
+}
+
+void simCheckIndex(void)
+{
+	simReply_s reply;
+	simClip_s * clip;
+	char name[64];
+	u8 pass;
+
+	for(u32 n = 0; n < simClipCount; n++)
+	{
+		clip = &simClips[n];
+		simCommand(VENDOR_OP_GET_CLIP_INDEX, n, 0, 0, sizeof(vendorCommand_s), &reply);
+		pass = simFraming(&reply, VENDOR_OP_GET_CLIP_INDEX) && (reply.response.status == VENDOR_STATUS_OK)
+		    && (reply.response.count == clip->nFrames) && (reply.response.total == clip->nFrames)
+		    && (memcmp(reply.data, clip->index, clip->nFrames * sizeof(vendorFrameIndex_s)) == 0);
+		sprintf(name, "GET_CLIP_INDEX c%04u, %u frames", n, clip->nFrames);
+		simResult(name, pass);
+		simFree(&reply);
+	}
+
+	// Clip 0 again: from the index cache after clip 2.
+	clip = &simClips[0];
+	simCommand(VENDOR_OP_GET_CLIP_INDEX, 0, 10, 5, sizeof(vendorCommand_s), &reply);
+	pass = simFraming(&reply, VENDOR_OP_GET_CLIP_INDEX) && (reply.response.status == VENDOR_STATUS_OK)
+	    && (reply.response.count == 5) && (reply.response.total == clip->nFrames)
+	    && (memcmp(reply.data, &clip->index[10], 5 * sizeof(vendorFrameIndex_s)) == 0);
+	simResult("GET_CLIP_INDEX, frames 10-14", pass);
+	simFree(&reply);
+
+	simCommand(VENDOR_OP_GET_CLIP_INDEX, 0, clip->nFrames + 1, 0, sizeof(vendorCommand_s), &reply);
+	pass = simFraming(&reply, VENDOR_OP_GET_CLIP_INDEX) && (reply.response.status == VENDOR_STATUS_RANGE)
+	    && (reply.response.length == 0) && (reply.response.total == clip->nFrames);
+	simResult("GET_CLIP_INDEX, first past the end", pass);
+	simFree(&reply);
+
+	simCommand(VENDOR_OP_GET_CLIP_INDEX, simClipCount, 0, 0, sizeof(vendorCommand_s), &reply);
+	pass = simFraming(&reply, VENDOR_OP_GET_CLIP_INDEX) && (reply.response.status == VENDOR_STATUS_NOT_FOUND)
+	    && (reply.response.length == 0);
+	simResult("GET_CLIP_INDEX, missing clip", pass);
+	simFree(&reply);
+}
+
+void simCheckFrames(const simOptions_s * opt)
+{
+	simReply_s reply;
+	XTime tStart, tEnd;
+	char name[64];
+	u32 first;
+	u8 pass;
+
+	for(u32 n = 0; n < simClipCount; n++)
+	{
+		XTime_GetTime(&tStart);
+		simCommand(VENDOR_OP_READ_FRAMES, n, 0, 0, sizeof(vendorCommand_s), &reply);
+		XTime_GetTime(&tEnd);
+		pass = simFraming(&reply, VENDOR_OP_READ_FRAMES) && !reply.aborted
+		    && simCheckStream(opt, n, 0, simClips[n].nFrames, &reply);
+		sprintf(name, "READ_FRAMES c%04u, all", n);
+		simResult(name, pass);
+		if(n == 0)
+		{
+			xil_printf("    %.1fMB in %.1fms of simulated SSD time (USB not modelled).\r\n", reply.nData * 1e-6,
+			           (double)(tEnd - tStart) * 1e3 / COUNTS_PER_SECOND);
+		}
+		simFree(&reply);
+	}
+
+	first = opt->nFramesPerFile - 2;
+	simCommand(VENDOR_OP_READ_FRAMES, 0, first, 5, sizeof(vendorCommand_s), &reply);
+	pass = simFraming(&reply, VENDOR_OP_READ_FRAMES) && !reply.aborted && simCheckStream(opt, 0, first, 5, &reply);
+	simResult("READ_FRAMES, across a file boundary", pass);
+	simFree(&reply);
+
+	simCommand(VENDOR_OP_READ_FRAMES, 2, 7, 1, sizeof(vendorCommand_s), &reply);
+	pass = simFraming(&reply, VENDOR_OP_READ_FRAMES) && !reply.aborted && simCheckStream(opt, 2, 7, 1, &reply);
+	simResult("READ_FRAMES, one frame", pass);
+	simFree(&reply);
+}
+
+// The reply must hold frames [first, first + n) of the clip back to back. An aborted reply must hold a prefix of them.
+u8 simCheckStream(const simOptions_s * opt, u32 nClipRead, u32 first, u32 n, const simReply_s * reply)
+{
+	FrameHeader_s * fh = (FrameHeader_s *) SIM_FH_ADDR;
+	u8 * cs = (u8 *) SIM_CS_ADDR;
+	u64 pos = 0, length = 0;
+	u32 size, m;
+
+	for(u32 i = first; i < first + n; i++) { length += simClips[nClipRead].index[i].size_B; }
+	if((reply->response.status != VENDOR_STATUS_OK) || (reply->response.count != n)
+	|| (reply->response.total != simClips[nClipRead].nFrames) || (reply->response.length != length))
+	{ return 0; }
+
+	for(u32 i = first; (i < first + n) && (pos < reply->nData); i++)
+	{
+		size = simFrame(opt, nClipRead, i, fh, cs);
+		m = (reply->nData - pos < sizeof(FrameHeader_s)) ? (reply->nData - pos) : sizeof(FrameHeader_s);
+		if(memcmp(reply->data + pos, fh, m) != 0) { return 0; }
+		pos += m;
+		m = (reply->nData - pos < size - sizeof(FrameHeader_s)) ? (reply->nData - pos) : (size - sizeof(FrameHeader_s));
+		if(memcmp(reply->data + pos, cs, m) != 0) { return 0; }
+		pos += m;
+	}
+
+	return 1;
+}
+
+// Header and trailer of each clip info file, read back in one piece. The command writes back any dirty disk cache
+// sectors with CTRL_SYNC before its direct reads. fsCloseClip() has already synced, so the count shown is normally 0.
+void simCheckClipInfo(void)
+{
+	simReply_s reply;
+	u8 info[SIM_INFO_SIZE + SIM_TRAILER_SIZE];
+	char name[64];
+	u32 size;
+	u8 pass;
+
+	for(u32 n = 0; n < simClipCount; n++)
+	{
+		simClipInfo(n, simClips[n].nFrames, info);
+		size = SIM_INFO_SIZE + (simClips[n].complete ? SIM_TRAILER_SIZE : 0);
+		sprintf(name, "READ_CLIP_INFO c%04u, %u dirty sectors", n, diskCacheDirty);
+		simCommand(VENDOR_OP_READ_CLIP_INFO, n, 0, 0, sizeof(vendorCommand_s), &reply);
+		pass = simFraming(&reply, VENDOR_OP_READ_CLIP_INFO) && !reply.aborted
+		    && (reply.response.status == VENDOR_STATUS_OK) && (reply.nData == size)
+		    && (memcmp(reply.data, info, size) == 0);
+		simResult(name, pass);
+		simFree(&reply);
+	}
+
+	simCommand(VENDOR_OP_READ_CLIP_INFO, simClipCount, 0, 0, sizeof(vendorCommand_s), &reply);
+	pass = simFraming(&reply, VENDOR_OP_READ_CLIP_INFO) && (reply.response.status == VENDOR_STATUS_NOT_FOUND);
+	simResult("READ_CLIP_INFO, missing clip", pass);
+	simFree(&reply);
+}
+
+void simCheckCommands(void)
+{
+	simReply_s reply;
+	u8 pass;
+
+	simCommand(0xFF, 0, 0, 0, sizeof(vendorCommand_s), &reply);
+	pass = !reply.error && (reply.response.status == VENDOR_STATUS_BAD_COMMAND) && (reply.response.length == 0);
+	simResult("Bad magic", pass);
+	simFree(&reply);
+
+	simCommand(VENDOR_OP_LIST_CLIPS, 0, 0, 0, 16, &reply);
+	pass = simFraming(&reply, VENDOR_OP_LIST_CLIPS) && (reply.response.status == VENDOR_STATUS_BAD_COMMAND);
+	simResult("Short command", pass);
+	simFree(&reply);
+
+	simCommand(0x7E, 0, 0, 0, sizeof(vendorCommand_s), &reply);
+	pass = simFraming(&reply, 0x7E) && (reply.response.status == VENDOR_STATUS_BAD_COMMAND);
+	simResult("Unknown opcode", pass);
+	simFree(&reply);
+
+	simMode.val = CSETTING_MODE_REC;
+	simCommand(VENDOR_OP_READ_FRAMES, 0, 0, 0, sizeof(vendorCommand_s), &reply);
+	pass = simFraming(&reply, VENDOR_OP_READ_FRAMES) && (reply.response.status == VENDOR_STATUS_BUSY)
+	    && (reply.response.length == 0);
+	simResult("Recording", pass);
+	simFree(&reply);
+	simMode.val = CSETTING_MODE_STANDBY;
+}
+
+void simCheckErrors(const simOptions_s * opt)
+{
+	simReply_s reply;
+	u32 nFail = simClips[0].nFrames * 3 / 4;
+	u32 nFailIndex = simClips[2].nFrames / 2;
+	u8 pass;
+
+	// Clip 0 indexed, then a read error three quarters into it: the stream ends early with a zero-length packet. What
+	// was sent before it, whole stream buffers, must be the start of the clip.
+	simCommand(VENDOR_OP_GET_CLIP_INDEX, 0, 0, 0, sizeof(vendorCommand_s), &reply);
+	simFree(&reply);
+	nvmeSimFailReads(simFrameLBA(0, nFail) + 1, 1);
+	simCommand(VENDOR_OP_READ_FRAMES, 0, 0, 0, sizeof(vendorCommand_s), &reply);
+	nvmeSimFailReads(0, 0);
+	pass = simFraming(&reply, VENDOR_OP_READ_FRAMES) && reply.aborted && (reply.nData < reply.response.length)
+	    && simCheckStream(opt, 0, 0, simClips[0].nFrames, &reply);
+	simResult("READ_FRAMES, read error mid-stream", pass);
+	xil_printf("    %.1fMB of %.1fMB sent before the zero-length packet.\r\n", reply.nData * 1e-6,
+	           reply.response.length * 1e-6);
+	simFree(&reply);
+
+	// Clip 2 not indexed, with a frame header that can't be read. The frame keeps its place with no data, the rest of
+	// the clip is indexed past it, and the index is not cached.
+	nvmeSimFailReads(simFrameLBA(2, nFailIndex), 1);
+	simCommand(VENDOR_OP_GET_CLIP_INDEX, 2, 0, 0, sizeof(vendorCommand_s), &reply);
+	nvmeSimFailReads(0, 0);
+	pass = simFraming(&reply, VENDOR_OP_GET_CLIP_INDEX) && (reply.response.status == VENDOR_STATUS_OK)
+	    && (reply.response.count == simClips[2].nFrames)
+	    && (memcmp(reply.data, simClips[2].index, nFailIndex * sizeof(vendorFrameIndex_s)) == 0)
+	    && (((vendorFrameIndex_s *) reply.data)[nFailIndex].size_B == 0)
+	    && (memcmp(reply.data + (nFailIndex + 1) * sizeof(vendorFrameIndex_s), &simClips[2].index[nFailIndex + 1],
+	               (simClips[2].nFrames - nFailIndex - 1) * sizeof(vendorFrameIndex_s)) == 0);
+	simResult("GET_CLIP_INDEX, read error", pass);
+	simFree(&reply);
+
+	simCommand(VENDOR_OP_GET_CLIP_INDEX, 2, 0, 0, sizeof(vendorCommand_s), &reply);
+	pass = simFraming(&reply, VENDOR_OP_GET_CLIP_INDEX) && (reply.response.status == VENDOR_STATUS_OK)
+	    && (reply.response.count == simClips[2].nFrames)
+	    && (memcmp(reply.data, simClips[2].index, simClips[2].nFrames * sizeof(vendorFrameIndex_s)) == 0);
+	simResult("GET_CLIP_INDEX, after the error", pass);
+	simFree(&reply);
+}
+
+// Interface reset in the middle of a stream, with reads in flight: the next configuration starts clean.
+void simCheckStop(void)
+{
+	vendorCommand_s cmd;
+	simReply_s reply;
+	u32 nSends = 0;
+	u8 pass;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.magic = VENDOR_COMMAND_MAGIC;
+	cmd.opcode = VENDOR_OP_READ_FRAMES;
+	cmd.tag = ++simTag;
+	memcpy(simRecvBuffer, &cmd, sizeof(cmd));
+	simRecvArmed = 0;
+	vendorCommandHandler(&simUsb, sizeof(vendorCommand_s), sizeof(vendorCommand_s));
+
+	// Header and one piece of data.
+	while(nSends < 2)
+	{
+		if(simSendPending)
+		{
+			simSendPending = 0;
+			vendorDataInHandler(&simUsb, simSendLength, simSendLength);
+			nSends++;
+		}
+		else { vendorService(); }
+	}
+
+	vendorStop();
+	vendorStart(&simUsb);
+
+	simCommand(VENDOR_OP_GET_CLIP_INDEX, 1, 0, 0, sizeof(vendorCommand_s), &reply);
+	pass = simFraming(&reply, VENDOR_OP_GET_CLIP_INDEX) && (reply.response.status == VENDOR_STATUS_OK)
+	    && (reply.response.count == simClips[1].nFrames)
+	    && (memcmp(reply.data, simClips[1].index, simClips[1].nFrames * sizeof(vendorFrameIndex_s)) == 0);
+	simResult("Stop mid-stream, then GET_CLIP_INDEX", pass);
+	simFree(&reply);
+}
+
+// A clip looked up before it was recorded, then recorded: NOT_FOUND must not stay cached. simRecord() leaves out the
+// vendorInvalidate() calls of frameCreateClip() and frameCloseClip(), so this checks the index on its own.
+void simCheckNewClip(const simOptions_s * opt)
+{
+	simReply_s reply;
+	simClip_s * clip = &simClips[simClipCount];
+	u32 nClipNew = simClipCount;
+	u8 pass;
+
+	simCommand(VENDOR_OP_GET_CLIP_INDEX, nClipNew, 0, 0, sizeof(vendorCommand_s), &reply);
+	pass = simFraming(&reply, VENDOR_OP_GET_CLIP_INDEX) && (reply.response.status == VENDOR_STATUS_NOT_FOUND);
+	simFree(&reply);
+
+	simRecord(opt, nClipNew, 0);
+	simCommand(VENDOR_OP_GET_CLIP_INDEX, nClipNew, 0, 0, sizeof(vendorCommand_s), &reply);
+	pass = pass && simFraming(&reply, VENDOR_OP_GET_CLIP_INDEX) && (reply.response.status == VENDOR_STATUS_OK)
+	    && (reply.response.count == clip->nFrames)
+	    && (memcmp(reply.data, clip->index, clip->nFrames * sizeof(vendorFrameIndex_s)) == 0);
+	simResult("GET_CLIP_INDEX, recorded after NOT_FOUND", pass);
+	simFree(&reply);
+}
+
+void simResult(const char * name, u8 pass)
+{
+	xil_printf("  %-44s %s\r\n", name, pass ? "ok" : "FAILED");
+	if(!pass) { simFailed++; }
+}